@@ -31,6 +31,9 @@
 
 #include "itkLogEuclideanTensorImageFilter.h"
 #include "itkExpEuclideanTensorImageFilter.h"
+#include "itkParallelNrrdImageIOFactory.h"
+#include "itkMappedImageFileReader.h"
+#include "imageio.h"
 #include "dtiaverageCLP.h"
 
 template <class TElementType>
@@ -63,11 +66,13 @@ enum StatisticsType { Euclidean, LogEuclidean, PGA };
 int main(int argc, char* argv[])
 {
   PARSE_ARGS;
+  // NRRD files are compressed and decompressed on all the cores
+  itk::ParallelNrrdImageIOFactory::RegisterOneFactory();
 
   typedef double                                       RealType;
   typedef itk::DiffusionTensor3D<RealType>             TensorPixelType;
   typedef itk::Image<TensorPixelType, 3>               TensorImageType;
-  typedef itk::ImageFileReader<TensorImageType>        TensorFileReader;
+  typedef itk::MappedImageFileReader<TensorImageType>  TensorFileReader;
   typedef itk::LogEuclideanTensorImageFilter<RealType> LogEuclideanFilter;
   typedef LogEuclideanFilter::OutputImageType          LogTensorImageType;
   typedef LogTensorImageType::PixelType                LogTensorPixelType;
@@ -89,6 +94,14 @@ int main(int argc, char* argv[])
     LogEuclideanFilter::Pointer logfilt = LogEuclideanFilter::New();
 
     DuplicateImageFilter::Pointer dup = DuplicateImageFilter::New();
+    // The output written over an input would truncate its mapping
+    for( int i = 0; i < numberofinputs; ++i )
+      {
+      if( isWrittenOver(inputs[i], std::vector<std::string>(1, tensorOutput) ) )
+        {
+        reader->UseMappingOff();
+        }
+      }
     std::cout << "lbl1" << std::endl;
     if( verbose )
       {
@@ -21,6 +21,10 @@
 #include <string>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
 
 // ITK includes
 // datastructures
@@ -28,35 +32,34 @@
 #include <itkVector.h>
 #include <itkMetaDataObject.h>
 #include <itkVersion.h>
+#include <itkImageRegionIterator.h>
+#include <itkImageRegionConstIterator.h>
 
 // IO
 #include <itkImageFileReader.h>
 #include <itkImageFileWriter.h>
+#include <itkImageIOFactory.h>
+#include <itkStreamingImageFilter.h>
+#include <itkImageAlgorithm.h>
+#include <itkMultiThreader.h>
+#include <itksys/SystemTools.hxx>
 
 // Filters
 #include <itkTensorFractionalAnisotropyImageFilter.h>
 #include <itkShiftScaleImageFilter.h>
-#include <itkVectorIndexSelectionCastImageFilter.h>
 #include <itkBinaryThresholdImageFilter.h>
-#include <itkLogImageFilter.h>
-#include <itkAddImageFilter.h>
-#include "itkDivideImageFilter.h"
-#include <itkExpImageFilter.h>
 #include <itkCastImageFilter.h>
 #include <itkNthElementImageAdaptor.h>
-#if ITK_VERSION_MAJOR < 4
-#include <itkOtsuThresholdImageCalculator.h>
-#else
-#include <itkOtsuThresholdImageFilter.h>
-#endif
 
-#include "itkVectorMaskNegatedImageFilter.h"
-#include "itkVectorMaskImageFilter.h"
+#include "itkDiffusionWeightedBaselineImageFilter.h"
 #include "itkDiffusionTensor3DReconstructionNonlinearImageFilter.h"
 #include "itkDiffusionTensor3DReconstructionWeightedImageFilter.h"
 #include "itkDiffusionTensor3DReconstructionRicianImageFilter.h"
 #include "itkDiffusionTensor3DReconstructionLinearImageFilter.h"
 #include "itkTensorRotateImageFilter.h"
+#include "itkParallelNrrdImageIOFactory.h"
+#include "itkMappedImageFileReader.h"
+#include "imageio.h"
 
 // tensor correction headers
 #include "itkDiffusionTensor3DZeroCorrection.h"
@@ -70,80 +73,341 @@
 
 const char* NRRD_MEASUREMENT_KEY = "NRRD_measurement frame";
 
-enum EstimationType { LinearEstimate, NonlinearEstimate, WeightedEstimate, MaximumLikelihoodEstimate };
+// Restricts the processing of a filter to the non-zero voxels of the
+// mask, if there is one.  The mask has the size of the dwi, its
+// spacing and origin may have been rounded differently.
+template <class TFilter>
+void SetEstimationMask(TFilter * filter, const LabelImageType * mask)
+{
+  if( mask )
+    {
+    filter->SetMaskImage(mask);
+    filter->SetCoordinateTolerance( 0.001 ) ;
+    filter->SetDirectionTolerance( 0.001 ) ;
+    }
+}
 
+// Number of z-slabs needed to keep the working set of one slab (dwi
+// signals, baseline and idwi, and the tensor images of the estimation
+// and correction filters, of tensorPixelSize bytes per voxel) under
+// maxMemory megabytes.  A budget of 0 processes the whole image at once.
+unsigned int ComputeNumberOfSlabs(const VectorImageType * dwi, int maxMemory, unsigned int tensorPixelSize)
+{
+  if( maxMemory <= 0 )
+    {
+    return 1;
+    }
+  const VectorImageType::SizeType size = dwi->GetLargestPossibleRegion().GetSize();
+  const double bytesPerVoxel = dwi->GetNumberOfComponentsPerPixel() * sizeof(ScalarPixelType)
+    + 2 * sizeof(RealType) + sizeof(LabelType) + 3 * tensorPixelSize;
+  const double bytesPerSlice = bytesPerVoxel * size[0] * size[1];
+  const unsigned int slicesPerSlab =
+    std::max(1u, static_cast<unsigned int>(maxMemory * 1024.0 * 1024.0 / bytesPerSlice) );
+  return std::max(1u, static_cast<unsigned int>( (size[2] + slicesPerSlab - 1) / slicesPerSlab) );
+}
 
-int main(int argc, char* argv[])
+// Slab number slab out of numberOfSlabs of region, along z
+template <class TRegion>
+TRegion GetSlab(const TRegion & region, unsigned int slab, unsigned int numberOfSlabs)
 {
-  PARSE_ARGS;
-  // End option reading configuration
+  TRegion                  slabRegion = region;
+  const itk::SizeValueType depth = region.GetSize(2);
+  const itk::SizeValueType begin = depth * slab / numberOfSlabs;
+  const itk::SizeValueType end = depth * ( slab + 1 ) / numberOfSlabs;
+  slabRegion.SetIndex(2, region.GetIndex(2) + static_cast<itk::IndexValueType>(begin) );
+  slabRegion.SetSize(2, end - begin);
+  return slabRegion;
+}
 
-  // Display help if asked or program improperly called
-  if( dwiImage == "" || tensorOutput == "" )
+// New image with the geometry of image, allocated over its largest
+// possible region
+template <class TImage>
+typename TImage::Pointer AllocateLike(const TImage * image)
+{
+  typename TImage::Pointer copy = TImage::New();
+  copy->CopyInformation(image);
+  copy->SetRegions(image->GetLargestPossibleRegion() );
+  copy->Allocate();
+  return copy;
+}
+
+// Creates the IO of a file.  The IOs are created on the main thread,
+// as the object factories are not thread safe, and given to the
+// readers and writers run on the other threads.  Returns NULL if no IO
+// can read or write the file.
+itk::ImageIOBase::Pointer CreateImageIO(const std::string & fileName, itk::ImageIOFactory::FileModeType mode)
+{
+  itk::ImageIOBase::Pointer io = itk::ImageIOFactory::CreateImageIO(fileName.c_str(), mode);
+  if( io.IsNull() )
     {
-    /*   if(help == true)
+    std::cerr << "Could not create IO object for file " << fileName << std::endl;
+    }
+  return io;
+}
+
+// Writer of fileName with its IO (see CreateImageIO), NULL if there is
+// no IO for the file
+template <class TImage>
+typename itk::ImageFileWriter<TImage>::Pointer CreateWriter(const std::string & fileName)
+{
+  typename itk::ImageFileWriter<TImage>::Pointer writer;
+  itk::ImageIOBase::Pointer io = CreateImageIO(fileName, itk::ImageIOFactory::WriteMode);
+  if( io.IsNotNull() )
     {
-      std::cout << "Version: $Date: 2009-03-03 15:15:31 $ $Revision: 1.10 $" << std::endl;
-      std::cout << ITK_SOURCE_VERSION << std::endl;
-      return EXIT_SUCCESS;
+    writer = itk::ImageFileWriter<TImage>::New();
+    writer->SetFileName(fileName.c_str() );
+    writer->SetImageIO(io);
     }
+  return writer;
+}
+
+// Writes image with writer, pulling it through its pipeline in
+// numberOfSlabs pieces.  The pieces are written as they are computed
+// (uncompressed) when the file format supports streamed writing,
+// otherwise they are assembled in memory and written compressed.  Both
+// cases are reported, as they depart from the memory budget or from
+// the compression of the other outputs.
+template <class TImage>
+void WriteStreamed(itk::ImageFileWriter<TImage> * writer, TImage * image, unsigned int numberOfSlabs)
+{
+  typedef itk::StreamingImageFilter<TImage, TImage> StreamerType;
+  typename StreamerType::Pointer streamer;
+  writer->SetUseCompression(true);
+  writer->SetInput(image);
+  if( numberOfSlabs > 1 )
+    {
+    itk::ImageIOBase * io = writer->GetImageIO();
+    io->SetUseCompression(false);
+    if( io->CanStreamWrite() )
+      {
+      std::cout << "Writing " << writer->GetFileName() << " slab by slab, uncompressed" << std::endl;
+      writer->SetUseCompression(false);
+      writer->SetNumberOfStreamDivisions(numberOfSlabs);
+      }
     else
-    {*/
-    std::cerr << "DWI image and output tensor filename needs to be specified." << std::endl;
+      {
+      std::cout << "warning " << writer->GetFileName() << " cannot be written slab by slab: the whole image is"
+                << " assembled in memory, beyond the memory budget, and written compressed."
+                << " Write it as .mhd to stream it" << std::endl;
+      streamer = StreamerType::New();
+      streamer->SetInput(image);
+      streamer->SetNumberOfStreamDivisions(numberOfSlabs);
+      streamer->Update();
+      streamer->GetOutput()->SetMetaDataDictionary(image->GetMetaDataDictionary() );
+      writer->SetInput(streamer->GetOutput() );
+      }
+    }
+  writer->Update();
+}
+
+enum EstimationType { LinearEstimate, NonlinearEstimate, WeightedEstimate, MaximumLikelihoodEstimate };
+
+typedef itk::DiffusionTensor3DReconstructionLinearImageFilter<ScalarPixelType, RealType>
+  DiffusionEstimationFilterType;
+typedef itk::DiffusionTensor3DReconstructionNonlinearImageFilter<ScalarPixelType, RealType>
+  NLDiffusionEstimationFilterType;
+typedef itk::DiffusionTensor3DReconstructionRicianImageFilter<ScalarPixelType, ScalarPixelType, RealType>
+  MLDiffusionEstimationFilterType;
+typedef itk::DiffusionTensor3DReconstructionWeightedImageFilter<ScalarPixelType, RealType>
+  WLDiffusionEstimationFilterType;
+
+typedef DiffusionEstimationFilterType::GradientDirectionContainerType GradientContainerType;
+typedef DiffusionEstimationFilterType::GradientDirectionType          GradientType;
+
+typedef itk::DiffusionTensor3D<float>         TensorFloatPixelType;
+typedef itk::Image<TensorFloatPixelType, DIM> TensorFloatImageType;
+
+// Options of the estimation, the same for all the subjects
+struct EstimationParameters
+{
+  std::string     method;
+  std::string     correction;
+  int             threshold;
+  int             weightIterations;
+  double          weightTolerance;
+  double          stepSize;
+  int             maxIterations;
+  double          sigma;
+  bool            doubleDTI;
+  bool            floatPrecision;
+  int             maxMemory;
+  bool            verbose;
+  TensorPixelType defaultTensor;
+  bool            shiftNegativeEigenvalues;
+  double          shiftNegativeEigenvaluesCoefficient;
+};
+
+// Files of one subject, empty when not requested
+struct SubjectFiles
+{
+  std::string dwiImage;
+  std::string tensorOutput;
+  std::string brainMask;
+  std::string badRegionMask;
+  std::string B0;
+  std::string IDWI;
+  std::string B0MaskOutput;
+};
+
+typedef itk::MappedImageFileReader<VectorImageType> DWIReaderType;
+typedef itk::ImageFileReader<LabelImageType>        MaskReaderType;
+typedef itk::ImageFileWriter<RealImageType>         RealWriterType;
+typedef itk::ImageFileWriter<LabelImageType>        MaskWriterType;
+typedef itk::ImageFileWriter<TensorImageType>       TensorWriterType;
+typedef itk::ImageFileWriter<TensorFloatImageType>  TensorFloatWriterType;
+
+// Inputs of one subject.  The readers are created on the main thread
+// (see CreateSubjectReaders).  The dwi reader is kept with the dwi,
+// which may only be read slab by slab by the estimation; the mask
+// readers are released once read.
+struct SubjectData
+{
+  DWIReaderType::Pointer         dwiReader;
+  MaskReaderType::Pointer        brainMaskReader;
+  MaskReaderType::Pointer        badRegionMaskReader;
+  VectorImageType::Pointer       dwi;
+  GradientContainerType::Pointer gradientContainer;
+  double                         bValue;
+  LabelImageType::Pointer        estimationMask;
+};
+
+// Outputs of one subject.  The tensors may still be a pipeline, which
+// is then executed while they are written: its filters are held in
+// pipeline until then, as an output is disconnected from its source
+// when the source is deleted.  Only one of tensors and floatTensors is
+// set, the latter when the tensors are estimated in float.  The
+// writers are created on the main thread (see CreateSubjectWriters),
+// the files whose writer could not be created are not written.
+struct SubjectOutputs
+{
+  RealImageType::Pointer                   B0Image;
+  RealImageType::Pointer                   idwiImage;
+  LabelImageType::Pointer                  B0Mask;
+  TensorImageType::Pointer                 tensors;
+  TensorFloatImageType::Pointer            floatTensors;
+  itk::MetaDataDictionary                  dictionary;
+  unsigned int                             numberOfSlabs;
+  std::vector<itk::ProcessObject::Pointer> pipeline;
+  RealWriterType::Pointer                  B0Writer;
+  RealWriterType::Pointer                  idwiWriter;
+  MaskWriterType::Pointer                  B0MaskWriter;
+  TensorWriterType::Pointer                tensorWriter;
+  TensorFloatWriterType::Pointer           floatTensorWriter;
+};
+
+// Reader of a mask with its IO (see CreateImageIO), NULL if there is
+// no IO for the file
+MaskReaderType::Pointer CreateMaskReader(const std::string & fileName)
+{
+  MaskReaderType::Pointer   reader;
+  itk::ImageIOBase::Pointer io = CreateImageIO(fileName, itk::ImageIOFactory::ReadMode);
+  if( io.IsNotNull() )
+    {
+    reader = MaskReaderType::New();
+    reader->SetFileName(fileName.c_str() );
+    reader->SetImageIO(io);
+    }
+  return reader;
+}
+
+// Creates the readers of a subject and their IO, on the main thread
+int CreateSubjectReaders(const SubjectFiles & files, SubjectData & data)
+{
+  itk::ImageIOBase::Pointer io = CreateImageIO(files.dwiImage, itk::ImageIOFactory::ReadMode);
+  if( io.IsNull() )
+    {
     return EXIT_FAILURE;
-    /* }
-    */
     }
-  if( defaultTensorValue.size() != 6 )
-  {
-      std::cerr << "Default tensor must have 6 components" << std::endl ;
-      return EXIT_FAILURE ;
-  }
-  bool VERBOSE(verbose);
-  if( stepSize < 0.0 )
+  data.dwiReader = DWIReaderType::New();
+  data.dwiReader->SetFileName(files.dwiImage.c_str() );
+  data.dwiReader->SetImageIO(io);
+  // An output written over the dwi would truncate its mapping
+  std::vector<std::string> outputs;
+  outputs.push_back(files.tensorOutput);
+  outputs.push_back(files.B0);
+  outputs.push_back(files.IDWI);
+  outputs.push_back(files.B0MaskOutput);
+  if( isWrittenOver(files.dwiImage, outputs) )
     {
-//   if(vm["method"].as<EstimationType>() == NonlinearEstimate ||
-//      vm["method"].as<EstimationType>() == MaximumLikelihoodEstimate)
-    if( method == "nls" || method == "ml" )
+    data.dwiReader->UseMappingOff();
+    }
+  if( files.brainMask != "" )
+    {
+    data.brainMaskReader = CreateMaskReader(files.brainMask);
+    if( data.brainMaskReader.IsNull() )
       {
-      std::cerr << "Step size not set for optimization method" << std::endl;
       return EXIT_FAILURE;
       }
     }
-  if( sigma < 0.0 )
+  if( files.badRegionMask != "" )
     {
-    //    if(vm["method"].as<EstimationType>() == MaximumLikelihoodEstimate)
-    if( method == "ml" )
+    data.badRegionMaskReader = CreateMaskReader(files.badRegionMask);
+    if( data.badRegionMaskReader.IsNull() )
       {
-      std::cerr << "Noise level not set for optimization method" << std::endl;
       return EXIT_FAILURE;
       }
     }
-  if( ShiftNegativeEigenvaluesCoefficient < 1.0 || ShiftNegativeEigenvaluesCoefficient > 1.001 )
-  {
-    std::cerr << "Shift Negative Eigenvalues Coefficient must be between 1.0 and 1.001" << std::endl;
-    return EXIT_FAILURE;
-  }
+  return EXIT_SUCCESS;
+}
+
+// Creates the writers of the outputs of a subject and their IO, on the
+// main thread.  Only the lack of a writer for the tensors is an error.
+int CreateSubjectWriters(const SubjectFiles & files, const EstimationParameters & parameters,
+                         SubjectOutputs & outputs)
+{
+  if( files.B0 != "" )
+    {
+    outputs.B0Writer = CreateWriter<RealImageType>(files.B0);
+    }
+  if( files.B0MaskOutput != "" )
+    {
+    outputs.B0MaskWriter = CreateWriter<LabelImageType>(files.B0MaskOutput);
+    }
+  if( files.IDWI != "" )
+    {
+    outputs.idwiWriter = CreateWriter<RealImageType>(files.IDWI);
+    }
+  if( parameters.doubleDTI )
+    {
+    outputs.tensorWriter = CreateWriter<TensorImageType>(files.tensorOutput);
+    return outputs.tensorWriter.IsNotNull() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  outputs.floatTensorWriter = CreateWriter<TensorFloatImageType>(files.tensorOutput);
+  return outputs.floatTensorWriter.IsNotNull() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Reads the dwi of a subject, its gradients and b-value, and combines
+// its masks into the estimation mask.  The readers are those of
+// CreateSubjectReaders.
+int ReadSubject(const SubjectFiles & files, const EstimationParameters & parameters, SubjectData & data)
+{
+  const bool VERBOSE = parameters.verbose;
+
   // Read diffusion weighted MR
 
-  typedef itk::ImageFileReader<VectorImageType> FileReaderType;
-  FileReaderType::Pointer dwireader = FileReaderType::New();
-  dwireader->SetFileName(dwiImage.c_str() );
+  DWIReaderType * dwireader = data.dwiReader;
 
   try
     {
-    if( VERBOSE )
+    if( parameters.maxMemory > 0 )
       {
-      std::cout << "Reading Data" << std::endl;
+      // The dwi is read slab by slab while the outputs are computed
+      dwireader->UpdateOutputInformation();
+      }
+    else
+      {
+      if( VERBOSE )
+        {
+        std::cout << "Reading Data" << std::endl;
+        }
+      dwireader->Update();
       }
-    dwireader->Update();
     }
   catch( itk::ExceptionObject & e )
     {
     std::cerr << e << std::endl;
     return EXIT_FAILURE;
     }
-
   VectorImageType::Pointer dwi = dwireader->GetOutput();
 
   // Read dwi meta-data
@@ -154,19 +418,7 @@ int main(int argc, char* argv[])
   bool   readbvalue = false;
 
   // read into gradientContainer the gradients
-  typedef itk::DiffusionTensor3DReconstructionLinearImageFilter<ScalarPixelType, RealType>
-    DiffusionEstimationFilterType;
-  typedef itk::DiffusionTensor3DReconstructionNonlinearImageFilter<ScalarPixelType, RealType>
-    NLDiffusionEstimationFilterType;
-  typedef itk::DiffusionTensor3DReconstructionRicianImageFilter<ScalarPixelType, ScalarPixelType, RealType>
-    MLDiffusionEstimationFilterType;
-  typedef itk::DiffusionTensor3DReconstructionWeightedImageFilter<ScalarPixelType, RealType>
-    WLDiffusionEstimationFilterType;
-
-  DiffusionEstimationFilterType::GradientDirectionContainerType::Pointer gradientContainer =
-    DiffusionEstimationFilterType::GradientDirectionContainerType::New();
-
-  typedef DiffusionEstimationFilterType::GradientDirectionType GradientType;
+  GradientContainerType::Pointer gradientContainer = GradientContainerType::New();
 
   itk::MetaDataDictionary & dict = dwi->GetMetaDataDictionary();
 
@@ -310,12 +562,14 @@ int main(int argc, char* argv[])
 
     }
 
-  // Read brain mask if it is specified.
-  if( brainMask != "" )
+  // Read brain mask if it is specified.  The masks are not applied to
+  // the dwi: the filters take the combined mask and only process its
+  // non-zero voxels.
+  LabelImageType::Pointer estimationMask;
+  if( files.brainMask != "" )
     {
-    typedef itk::ImageFileReader<LabelImageType> MaskFileReaderType;
-    MaskFileReaderType::Pointer maskreader = MaskFileReaderType::New();
-    maskreader->SetFileName(brainMask.c_str() );
+    MaskReaderType::Pointer maskreader = data.brainMaskReader;
+    data.brainMaskReader = ITK_NULLPTR;
 
     try
       {
@@ -347,17 +601,13 @@ int main(int argc, char* argv[])
 	  (maskreader->GetOutput())->SetOrigin(dwiOrigin);
 	}
       }
+      else
+        {
+        std::cerr << "Brain mask and dwi do not have the same size" << std::endl;
+        return EXIT_FAILURE;
+        }
 
-      typedef itk::VectorMaskImageFilter<VectorImageType, LabelImageType, VectorImageType> MaskFilterType;
-      MaskFilterType::Pointer mask = MaskFilterType::New();
-//      mask->ReleaseDataFlagOn();
-      mask->SetInput1(dwireader->GetOutput() );
-      mask->SetInput2(maskreader->GetOutput() );
-      mask->SetCoordinateTolerance( 0.001 ) ;
-      mask->SetDirectionTolerance( 0.001 ) ;
-      mask->Update();
-
-      dwi = mask->GetOutput();
+      estimationMask = maskreader->GetOutput();
       }
     catch( itk::ExceptionObject & e )
       {
@@ -368,13 +618,11 @@ int main(int argc, char* argv[])
     }
 
   // Read negative mask
-  if( badRegionMask != "" )
+  if( files.badRegionMask != "" )
     {
-    typedef itk::ImageFileReader<LabelImageType> MaskFileReaderType;
-    MaskFileReaderType::Pointer maskreader = MaskFileReaderType::New();
-    maskreader->SetFileName(badRegionMask);
+    MaskReaderType::Pointer maskreader = data.badRegionMaskReader;
+    data.badRegionMaskReader = ITK_NULLPTR;
 
-    //  Go ahead and read data so we can use adaptors as necessary
     try
       {
       if( VERBOSE )
@@ -383,155 +631,326 @@ int main(int argc, char* argv[])
         }
 
       maskreader->Update();
-
-      typedef itk::VectorMaskNegatedImageFilter<VectorImageType, LabelImageType, VectorImageType> MaskFilterType;
-      MaskFilterType::Pointer mask = MaskFilterType::New();
-//      mask->ReleaseDataFlagOn();
-      mask->SetInput1(dwi);
-      mask->SetInput2(maskreader->GetOutput() );
-      mask->Update();
-
-      dwi = mask->GetOutput();
       }
     catch( itk::ExceptionObject & e )
       {
       std::cerr << e << std::endl;
       return EXIT_FAILURE;
       }
+
+    LabelImageType::Pointer badRegions = maskreader->GetOutput();
+    if( badRegions->GetLargestPossibleRegion().GetSize() != dwi->GetLargestPossibleRegion().GetSize() )
+      {
+      std::cerr << "Bad region mask and dwi do not have the same size" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if( estimationMask.IsNull() )
+      {
+      estimationMask = LabelImageType::New();
+      estimationMask->CopyInformation(dwi);
+      estimationMask->SetRegions(dwi->GetLargestPossibleRegion() );
+      estimationMask->Allocate();
+      estimationMask->FillBuffer(1);
+      }
+    // Remove the bad regions from the estimation mask
+    itk::ImageRegionConstIterator<LabelImageType> bit(badRegions, badRegions->GetLargestPossibleRegion() );
+    itk::ImageRegionIterator<LabelImageType>      mit(estimationMask, estimationMask->GetLargestPossibleRegion() );
+    for( ; !bit.IsAtEnd(); ++bit, ++mit )
+      {
+      if( bit.Get() != 0 )
+        {
+        mit.Set(0);
+        }
+      }
     }
 
-  // Compute average B0 image
-  typedef itk::VectorIndexSelectionCastImageFilter<VectorImageType, RealImageType> VectorSelectionFilterType;
-  VectorSelectionFilterType::Pointer biextract = VectorSelectionFilterType::New();
-  biextract->SetInput(dwi);
-  int numberB0Directions = 0;
+  data.dwi = dwi;
+  data.gradientContainer = gradientContainer;
+  data.bValue = b0;
+  data.estimationMask = estimationMask;
+  return EXIT_SUCCESS;
+}
 
-  RealImageType::Pointer B0Image;
-  for( unsigned int directionIndex = 0; directionIndex < gradientContainer->Size(); directionIndex++ )
+// Applies the requested correction to the tensors, in place.  The
+// correction filter is added to pipeline.
+template <class TTensorImage>
+typename TTensorImage::Pointer CorrectTensors(TTensorImage * tensors, const std::string & correction,
+                                              std::vector<itk::ProcessObject::Pointer> & pipeline)
+{
+  typename TTensorImage::Pointer corrected = tensors;
+  if( !correction.compare( "zero" ) )
     {
-    // get information whether image is b0 or not
-    GradientType g = gradientContainer->GetElement(directionIndex);
-    if( g[0] == 0 && g[1] == 0 && g[2] == 0 )
-      {
-      // image is not b0 image
-      biextract->SetIndex(directionIndex);
+    typedef itk::DiffusionTensor3DZeroCorrectionFilter<TTensorImage, TTensorImage> ZeroCorrection;
+    typename ZeroCorrection::Pointer zeroFilter = ZeroCorrection::New();
+    zeroFilter->SetInput( tensors );
+    zeroFilter->InPlaceOn();
+    pipeline.push_back(zeroFilter.GetPointer() );
+    corrected = zeroFilter->GetOutput();
+    }
+  else if( !correction.compare( "abs" ) )
+    {
+    typedef itk::DiffusionTensor3DAbsCorrectionFilter<TTensorImage, TTensorImage> AbsCorrection;
+    typename AbsCorrection::Pointer absFilter = AbsCorrection::New();
+    absFilter->SetInput( tensors );
+    absFilter->InPlaceOn();
+    pipeline.push_back(absFilter.GetPointer() );
+    corrected = absFilter->GetOutput();
+    }
+  else if( !correction.compare( "nearest" ) )
+    {
+    typedef itk::DiffusionTensor3DNearestCorrectionFilter<TTensorImage, TTensorImage> NearestCorrection;
+    typename NearestCorrection::Pointer nearestFilter = NearestCorrection::New();
+    nearestFilter->SetInput( tensors );
+    nearestFilter->InPlaceOn();
+    pipeline.push_back(nearestFilter.GetPointer() );
+    corrected = nearestFilter->GetOutput();
+    }
+  return corrected;
+}
 
-      if( numberB0Directions == 0 )
-        {
-        B0Image = biextract->GetOutput();
-        }
-      else
-        {
-        // add it to the current B0 image
-        try
-          {
-          typedef itk::AddImageFilter<RealImageType> AddImageFilterType;
-          AddImageFilterType::Pointer addfilter = AddImageFilterType::New();
-          addfilter->SetInput1(biextract->GetOutput() );
-          addfilter->SetInput2(B0Image);
-          addfilter->Update();
-          B0Image = addfilter->GetOutput();
-          }
-        catch( itk::ExceptionObject & e )
-          {
-          std::cerr << "Error in addition for B0 computation" << std::endl;
-          std::cerr << e << std::endl;
-          }
+// Sets up the lls, nls or wls estimation of the tensors of a subject
+// with TPrecision as the precision of the computation and of the
+// tensors.  The estimators also correct the tensors.  The estimator is
+// added to pipeline.  Returns NULL for the other methods.
+template <class TPrecision>
+typename itk::Image<itk::DiffusionTensor3D<TPrecision>, DIM>::Pointer
+SetUpEstimation(const EstimationParameters & parameters, const SubjectData & data,
+                ScalarPixelType threshold, unsigned int numberOfSlabs,
+                std::vector<itk::ProcessObject::Pointer> & pipeline)
+{
+  typedef itk::DiffusionTensor3DReconstructionLinearImageFilter<ScalarPixelType, TPrecision>    LinearFilterType;
+  typedef itk::DiffusionTensor3DReconstructionNonlinearImageFilter<ScalarPixelType, TPrecision> NonlinearFilterType;
+  typedef itk::DiffusionTensor3DReconstructionWeightedImageFilter<ScalarPixelType, TPrecision>  WeightedFilterType;
+  typedef typename LinearFilterType::TensorImageType                TensorImageT;
+  typedef typename LinearFilterType::TensorPixelType                TensorPixelT;
+  typedef typename LinearFilterType::GradientDirectionContainerType GradientContainerT;
+  typedef typename LinearFilterType::GradientDirectionType          GradientT;
+  typedef typename LinearFilterType::TensorCorrectionType           TensorCorrectionType;
+
+  const bool                     VERBOSE = parameters.verbose;
+  const std::string &            method = parameters.method;
+  VectorImageType::Pointer       dwi = data.dwi;
+  LabelImageType::Pointer        estimationMask = data.estimationMask;
+  const TPrecision               b0 = static_cast<TPrecision>(data.bValue);
+
+  // The gradients and the default tensor in the precision of the
+  // estimation
+  typename GradientContainerT::Pointer gradientContainer = GradientContainerT::New();
+  for( unsigned int i = 0; i < data.gradientContainer->Size(); ++i )
+    {
+    const GradientType & g = data.gradientContainer->ElementAt(i);
+    gradientContainer->InsertElement(i, GradientT(static_cast<TPrecision>(g[0]), static_cast<TPrecision>(g[1]),
+                                                  static_cast<TPrecision>(g[2]) ) );
+    }
+  TensorPixelT defaultTensor;
+  for( unsigned int i = 0; i < 6; ++i )
+    {
+    defaultTensor[i] = static_cast<TPrecision>(parameters.defaultTensor[i]);
+    }
+  TensorCorrectionType correction = LinearFilterType::NoCorrection;
+  if( !parameters.correction.compare( "zero" ) )
+    {
+    correction = LinearFilterType::ZeroCorrection;
+    }
+  else if( !parameters.correction.compare( "abs" ) )
+    {
+    correction = LinearFilterType::AbsCorrection;
+    }
+  else if( !parameters.correction.compare( "nearest" ) )
+    {
+    correction = LinearFilterType::NearestCorrection;
+    }
 
-        }
+  typename TensorImageT::Pointer tensors;
+  //  if(vm["method"].as<EstimationType>() == LinearEstimate)
+  if( method == "lls" )
+    {
+       typename LinearFilterType::Pointer llsestimator = LinearFilterType::New();
+       llsestimator->ReleaseDataFlagOn();
+       llsestimator->SetGradientImage(gradientContainer, dwi);
+       SetEstimationMask(llsestimator.GetPointer(), estimationMask.GetPointer() );
+       llsestimator->SetBValue(b0);
+       llsestimator->SetDefaultTensor(defaultTensor);
+       llsestimator->SetThreshold(threshold);
+       llsestimator->SetVerbose( parameters.verbose ) ;
+       llsestimator->SetShiftNegativeEigenvalues( parameters.shiftNegativeEigenvalues ) ;
+       llsestimator->SetShiftNegativeEigenvaluesCoefficient( parameters.shiftNegativeEigenvaluesCoefficient ) ;
+       llsestimator->SetCorrection( correction ) ;
+       pipeline.push_back(llsestimator.GetPointer() );
+       tensors = llsestimator->GetOutput();
+    }
+  //  else if(vm["method"].as<EstimationType>() == NonlinearEstimate)
+  else if( method == "nls" )
+    {
+    typename NonlinearFilterType::Pointer estimator = NonlinearFilterType::New();
+    estimator->ReleaseDataFlagOn();
 
-      numberB0Directions++;
+    estimator->SetGradientImage(gradientContainer, dwi);
+    SetEstimationMask(estimator.GetPointer(), estimationMask.GetPointer() );
+    estimator->SetBValue(b0);
+    estimator->SetDefaultTensor(defaultTensor);
+    estimator->SetThreshold(threshold);
+    estimator->SetStep(parameters.stepSize);
+    estimator->SetMaximumNumberOfIterations(parameters.maxIterations);
+    estimator->SetVerbose( parameters.verbose ) ;
+    estimator->SetShiftNegativeEigenvalues( parameters.shiftNegativeEigenvalues ) ;
+    estimator->SetShiftNegativeEigenvaluesCoefficient( parameters.shiftNegativeEigenvaluesCoefficient ) ;
+    estimator->SetCorrection( correction ) ;
+    pipeline.push_back(estimator.GetPointer() );
+    tensors = estimator->GetOutput();
+    // The counts of a streamed update only cover its last slab
+    if( VERBOSE && numberOfSlabs == 1 )
+      {
+      estimator->Update();
+      std::cout << "Voxels where the non-linear fit did not converge (weighted estimate kept): "
+                << estimator->GetNumberOfFailedVoxels() << std::endl;
       }
     }
-
-  if( numberB0Directions == 0 )
+  // else if(vm["method"].as<EstimationType>() == WeightedEstimate)
+  else if( method == "wls" )
     {
+    typename WeightedFilterType::Pointer estimator = WeightedFilterType::New();
+    estimator->ReleaseDataFlagOn();
+
     if( VERBOSE )
       {
-      std::cout << "No B0 image, setting first gradient image as B0 image (rather random behavior though)" << std::endl;
+      std::cout << "Weighting steps: " << parameters.weightIterations << std::endl;
       }
-    biextract->SetIndex(0);
-    B0Image = biextract->GetOutput();
+
+    estimator->SetGradientImage(gradientContainer, dwi);
+    SetEstimationMask(estimator.GetPointer(), estimationMask.GetPointer() );
+    estimator->SetBValue(b0);
+    estimator->SetDefaultTensor(defaultTensor);
+    estimator->SetThreshold(threshold);
+    estimator->SetNumberOfIterations(parameters.weightIterations);
+    estimator->SetConvergenceTolerance(parameters.weightTolerance);
+    estimator->SetVerbose( parameters.verbose ) ;
+    estimator->SetShiftNegativeEigenvalues( parameters.shiftNegativeEigenvalues ) ;
+    estimator->SetShiftNegativeEigenvaluesCoefficient( parameters.shiftNegativeEigenvaluesCoefficient ) ;
+    estimator->SetCorrection( correction ) ;
+    pipeline.push_back(estimator.GetPointer() );
+    tensors = estimator->GetOutput();
     }
   else
     {
-    typedef itk::DivideImageFilter <RealImageType, RealImageType, RealImageType > DivideImageFilterType;
-    DivideImageFilterType::Pointer divideImageFilter = DivideImageFilterType::New ();
-    divideImageFilter->SetInput1(B0Image);
-    divideImageFilter->SetConstant(numberB0Directions);
-    divideImageFilter->Update();
-    B0Image = divideImageFilter->GetOutput() ;
+    return ITK_NULLPTR;
     }
+  return tensors;
+}
 
-  if( VERBOSE )
+// Computes the baseline, idwi and threshold mask of a subject and sets
+// up the estimation of its tensors
+int EstimateSubject(const SubjectFiles & files, const EstimationParameters & parameters,
+                    const SubjectData & data, SubjectOutputs & outputs)
+{
+  const bool                     VERBOSE = parameters.verbose;
+  const std::string &            method = parameters.method;
+  VectorImageType::Pointer       dwi = data.dwi;
+  GradientContainerType::Pointer gradientContainer = data.gradientContainer;
+  const double                   b0 = data.bValue;
+  LabelImageType::Pointer        estimationMask = data.estimationMask;
+
+  // Compute the average B0 image, the idwi and the histogram of the B0
+  // image for the otsu threshold in a single pass over the dwi
+  typedef itk::DiffusionWeightedBaselineImageFilter<VectorImageType, RealImageType> BaselineFilterType;
+  BaselineFilterType::Pointer baselinefilter = BaselineFilterType::New();
+  baselinefilter->SetInput(dwi);
+  baselinefilter->SetGradientDirectionContainer(gradientContainer);
+  SetEstimationMask(baselinefilter.GetPointer(), estimationMask.GetPointer() );
+  baselinefilter->SetComputeIDWI(files.IDWI != "");
+  // If we didnt specify a threshold compute it as the ostu threshold
+  // of the baseline image
+  baselinefilter->SetComputeOtsuThreshold(parameters.threshold < 0);
+  const unsigned int numberOfSlabs = ComputeNumberOfSlabs(dwi, parameters.maxMemory,
+                                                           parameters.floatPrecision && method != "ml" ?
+                                                           sizeof(TensorFloatPixelType) : sizeof(TensorPixelType) );
+  if( VERBOSE && numberOfSlabs > 1 )
     {
-    std::cout << "Number of  B0 images : " << numberB0Directions << std::endl;
+    std::cout << "Processing the dwi in " << numberOfSlabs << " slabs" << std::endl;
     }
-
-  // Output B0 image if requested
-  if( B0 != "" )
+  // Compressed dwis are decompressed whole by their reader
+  if( numberOfSlabs > 1 && !data.dwiReader->GetMapped() && !data.dwiReader->GetImageIO()->CanStreamRead() )
     {
-    try
+    std::cout << "warning " << files.dwiImage << " cannot be read slab by slab: the whole dwi is read in memory,"
+              << " beyond the memory budget.  Store it as raw encoded nrrd to stream it" << std::endl;
+    }
+  RealImageType::Pointer B0Image;
+  RealImageType::Pointer idwiImage;
+  try
+    {
+    if( numberOfSlabs == 1 )
       {
-      if( VERBOSE )
+      baselinefilter->Update();
+      B0Image = baselinefilter->GetBaselineOutput();
+      idwiImage = baselinefilter->GetIDWIOutput();
+      }
+    else
+      {
+      // Stream the dwi through the filter and assemble its outputs
+      baselinefilter->AccumulateHistogramOn();
+      baselinefilter->UpdateOutputInformation();
+      B0Image = AllocateLike<RealImageType>(baselinefilter->GetBaselineOutput() );
+      if( files.IDWI != "" )
         {
-        std::cout << "Writing B0" << std::endl;
+        idwiImage = AllocateLike<RealImageType>(baselinefilter->GetIDWIOutput() );
+        }
+      for( unsigned int slab = 0; slab < numberOfSlabs; ++slab )
+        {
+        const RealImageType::RegionType region =
+          GetSlab(B0Image->GetLargestPossibleRegion(), slab, numberOfSlabs);
+        baselinefilter->GetBaselineOutput()->SetRequestedRegion(region);
+        baselinefilter->GetBaselineOutput()->Update();
+        itk::ImageAlgorithm::Copy(baselinefilter->GetBaselineOutput(), B0Image.GetPointer(), region, region);
+        if( idwiImage.IsNotNull() )
+          {
+          itk::ImageAlgorithm::Copy(baselinefilter->GetIDWIOutput(), idwiImage.GetPointer(), region, region);
+          }
         }
-      typedef itk::ImageFileWriter<RealImageType> RealImageFileWriterType;
-      RealImageFileWriterType::Pointer realwriter = RealImageFileWriterType::New();
-      realwriter->SetInput(B0Image);
-      realwriter->SetUseCompression(true);
-      realwriter->SetFileName(B0.c_str() );
-      realwriter->Update();
       }
-    catch( itk::ExceptionObject & e )
+    }
+  catch( itk::ExceptionObject & e )
+    {
+    std::cerr << "Error in B0 computation" << std::endl;
+    std::cerr << e << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  if( VERBOSE )
+    {
+    if( baselinefilter->GetNumberOfBaselines() == 0 )
       {
-      std::cerr << "Could not write B0 file" << std::endl;
-      std::cerr << e << std::endl;
+      std::cout << "No B0 image, setting first gradient image as B0 image (rather random behavior though)" << std::endl;
+      }
+    std::cout << "Number of  B0 images : " << baselinefilter->GetNumberOfBaselines() << std::endl;
+    if( files.IDWI != "" )
+      {
+      std::cout << "Number of non B0 images : " << baselinefilter->GetNumberOfGradients() << std::endl;
       }
     }
 
-  // If we didnt specify a threshold compute it as the ostu threshold
-  // of the baseline image
-
   ScalarPixelType _threshold;
   // the ScalarPixelType is unsigned short. ModuleDescription only has
   // 'int' as a possible type, which should be wider than unsigned short, and
   //  contains its range, which is 0..ScalarPixelType.max()
   //  So it's 'safe' to initialize threshold to -1 and use that as a sentinel
   //  value indicating that no threshold was specified on the command line.
-  if( threshold >= 0 )
+  if( parameters.threshold >= 0 )
     {
-    _threshold = static_cast<ScalarPixelType>(threshold);
+    _threshold = static_cast<ScalarPixelType>(parameters.threshold);
     }
   else
     {
-#if ITK_VERSION_MAJOR < 4
-    typedef itk::OtsuThresholdImageCalculator<RealImageType>
-      OtsuThresholdCalculatorType;
-
-    OtsuThresholdCalculatorType::Pointer otsucalculator = OtsuThresholdCalculatorType::New();
-    otsucalculator->SetImage(B0Image);
-    otsucalculator->Compute();
-#else
-    typedef itk::OtsuThresholdImageFilter<RealImageType,RealImageType>
-      OtsuThresholdImageFilterType;
-
-    OtsuThresholdImageFilterType::Pointer otsucalculator = OtsuThresholdImageFilterType::New();
-    otsucalculator->SetInput(B0Image);
-    otsucalculator->Update();
-#endif
-    _threshold = static_cast<ScalarPixelType>(.9 * otsucalculator->GetThreshold() );
+    _threshold = static_cast<ScalarPixelType>(.9 * baselinefilter->GetOtsuThreshold() );
     if( VERBOSE )
       {
-      std::cout << "Otsu threshold: " << threshold << std::endl;
+      std::cout << "Otsu threshold: " << baselinefilter->GetOtsuThreshold() << std::endl;
       }
     }
 
   // Output b0 threshold mask if requested
   // BUG in original -- looked for "threshold-mask" tag in command line, when
   // it was really named B0
-  if( B0MaskOutput != "" )
+  if( files.B0MaskOutput != "" )
     {
     // Will take last B0 image in sequence
 
@@ -541,116 +960,168 @@ int main(int argc, char* argv[])
     thresholdfilter->SetLowerThreshold(_threshold);
     thresholdfilter->SetUpperThreshold(itk::NumericTraits<ScalarPixelType>::max() );
     thresholdfilter->Update();
-
-    try
-      {
-      if( VERBOSE )
-        {
-        std::cout << "Writing mask B0" << std::endl;
-        }
-      typedef itk::ImageFileWriter<LabelImageType> MaskImageFileWriterType;
-      MaskImageFileWriterType::Pointer maskwriter = MaskImageFileWriterType::New();
-      maskwriter->SetInput(thresholdfilter->GetOutput() );
-      maskwriter->SetFileName(B0MaskOutput.c_str() );
-      maskwriter->Update();
-      }
-    catch( itk::ExceptionObject & e )
-      {
-      std::cerr << "Could not write threshold mask file" << std::endl;
-      std::cerr << e << std::endl;
-      }
-
+    outputs.B0Mask = thresholdfilter->GetOutput();
     }
 
-  // Output idwi image if requested
-  if( IDWI != "" )
+  // Estimate tensors
+  if( VERBOSE )
     {
-    typedef itk::VectorIndexSelectionCastImageFilter<VectorImageType, RealImageType> VectorSelectionFilterType;
-    VectorSelectionFilterType::Pointer _biextract = VectorSelectionFilterType::New();
-    _biextract->SetInput(dwi);
-    int numberNonB0Directions = 0;
-
-    RealImageType::Pointer idwiImage;
-
-    typedef itk::LogImageFilter<RealImageType, RealImageType> LogImageFilterType;
-    for( unsigned int directionIndex = 0; directionIndex < gradientContainer->Size(); directionIndex++ )
-      {
-      // get information whether image is b0 or not
-      GradientType g = gradientContainer->GetElement(directionIndex);
-      if( g[0] != 0 || g[1] != 0 || g[2] != 0 )
-        {
-        // image is not b0 image
-        _biextract->SetIndex(directionIndex);
-
-        if( numberNonB0Directions == 0 )
-          {
-          // log of the first image and set it as current idwi image
-          try
-            {
-            LogImageFilterType::Pointer logfilter = LogImageFilterType::New();
-            logfilter->SetInput(_biextract->GetOutput() );
-            logfilter->Update();
-            idwiImage = logfilter->GetOutput();
-            }
-          catch( itk::ExceptionObject & e )
-            {
-            std::cerr << "Error in log computation" << std::endl;
-            std::cerr << e << std::endl;
-            }
+    std::cout << "Estimation method: " << method << std::endl;
+    }
+  TensorImageType::Pointer      tensors;
+  TensorFloatImageType::Pointer floatTensors;
+  if( parameters.floatPrecision && method != "ml" )
+    {
+    floatTensors = SetUpEstimation<float>(parameters, data, _threshold, numberOfSlabs, outputs.pipeline);
+    }
+  //  else if(vm["method"].as<EstimationType>() == MaximumLikelihoodEstimate)
+  else if( method == "ml" )
+    {
+    // The Rician estimator works in double: its tensors are converted
+    // to float when they are written.  It has no correction policy, its
+    // tensors are corrected by a separate filter.
+    const TensorPixelType defaultTensor = parameters.defaultTensor;
+    WLDiffusionEstimationFilterType::Pointer estimatorInit = WLDiffusionEstimationFilterType::New();
+    estimatorInit->ReleaseDataFlagOn();
 
-          }
-        else
-          {
-          // log of the image and add it to the current idwi image
-          try
-            {
-            LogImageFilterType::Pointer logfilter = LogImageFilterType::New();
-            logfilter->SetInput(_biextract->GetOutput() );
-            logfilter->Update();
-            typedef itk::AddImageFilter<RealImageType> AddImageFilterType;
-            AddImageFilterType::Pointer addfilter = AddImageFilterType::New();
-            addfilter->SetInput1(logfilter->GetOutput() );
-            addfilter->SetInput2(idwiImage);
-            addfilter->Update();
-            idwiImage = addfilter->GetOutput();
-            }
-          catch( itk::ExceptionObject & e )
-            {
-            std::cerr << "Error in log computation" << std::endl;
-            std::cerr << e << std::endl;
-            }
+    estimatorInit->SetGradientImage(gradientContainer, dwi);
+    SetEstimationMask(estimatorInit.GetPointer(), estimationMask.GetPointer() );
+    estimatorInit->SetBValue(b0);
+    estimatorInit->SetDefaultTensor(defaultTensor);
+    estimatorInit->SetThreshold(_threshold);
+    estimatorInit->SetNumberOfIterations(parameters.weightIterations);
+    estimatorInit->SetVerbose( parameters.verbose ) ;
+    estimatorInit->SetShiftNegativeEigenvalues( parameters.shiftNegativeEigenvalues ) ;
+    estimatorInit->SetShiftNegativeEigenvaluesCoefficient( parameters.shiftNegativeEigenvaluesCoefficient ) ;
+    outputs.pipeline.push_back(estimatorInit.GetPointer() );
+    TensorImageType::Pointer inittensors = estimatorInit->GetOutput();
 
-          }
+    MLDiffusionEstimationFilterType::Pointer estimator = MLDiffusionEstimationFilterType::New();
+    estimator->ReleaseDataFlagOn();
 
-        numberNonB0Directions++;
-        }
+    if( VERBOSE )
+      {
+      std::cout << "Weighting steps: " << parameters.weightIterations << std::endl;
       }
 
-    // idwiImage contains the sum of all log transformed directional images
-    // need to divide by numberNonB0Directions and compute exponential image
+    // The Rician filter normalizes its gradients in place, and the
+    // weighted estimator only reads them when the pipeline runs
+    GradientContainerType::Pointer mlGradientContainer = GradientContainerType::New();
+    for( unsigned int i = 0; i < gradientContainer->Size(); ++i )
+      {
+      mlGradientContainer->InsertElement(i, gradientContainer->ElementAt(i) );
+      }
+    estimator->SetGradientImage(mlGradientContainer, dwi);
+    SetEstimationMask(estimator.GetPointer(), estimationMask.GetPointer() );
+    estimator->SetBValue(b0);
+    estimator->SetThreshold(_threshold);
+    estimator->SetInitialTensor(inittensors);
+    estimator->SetStep(parameters.stepSize);
+    estimator->SetMaximumNumberOfIterations(parameters.maxIterations);
+    std::cout << "Start sigma: " << parameters.sigma << std::endl;
+    estimator->SetSigma(parameters.sigma);
+    if( VERBOSE && numberOfSlabs == 1 )
+      {
+      estimator->Update();
+      std::cout << "Voxels optimized: " << estimator->GetNumberOfOptimizedVoxels()
+                << ", not converged: " << estimator->GetNumberOfNonConvergedVoxels() << std::endl;
+      }
+    outputs.pipeline.push_back(estimator.GetPointer() );
+    tensors = CorrectTensors<TensorImageType>(estimator->GetOutput(), parameters.correction, outputs.pipeline);
+    }
+  else
+    {
+    tensors = SetUpEstimation<RealType>(parameters, data, _threshold, numberOfSlabs, outputs.pipeline);
+    }
+  if( tensors.IsNull() && floatTensors.IsNull() )
+    {
+    std::cerr << "Invalid estimation method"  << std::endl;
+    return EXIT_FAILURE;
+    }
 
-    if( VERBOSE )
+  // wp = D*x
+  // wv = M*x
+  // wv' = D'M*x
+
+  // The dwi may not be read yet
+  outputs.pipeline.push_back(data.dwiReader.GetPointer() );
+  outputs.B0Image = B0Image;
+  outputs.idwiImage = idwiImage;
+  outputs.tensors = tensors;
+  outputs.floatTensors = floatTensors;
+  outputs.dictionary = dwi->GetMetaDataDictionary();
+  outputs.numberOfSlabs = numberOfSlabs;
+  return EXIT_SUCCESS;
+}
+
+// Writes the outputs of a subject with the writers of
+// CreateSubjectWriters.  Only the failure to write the tensors is an
+// error.
+int WriteSubject(const SubjectFiles & files, const EstimationParameters & parameters, SubjectOutputs & outputs)
+{
+  const bool VERBOSE = parameters.verbose;
+
+  // Output B0 image if requested
+  if( files.B0 != "" )
+    {
+    try
+      {
+      if( VERBOSE )
+        {
+        std::cout << "Writing B0" << std::endl;
+        }
+      if( outputs.B0Writer.IsNull() )
+        {
+        throw itk::ExceptionObject(__FILE__, __LINE__, "No writer for " + files.B0, ITK_LOCATION);
+        }
+      RealWriterType::Pointer realwriter = outputs.B0Writer;
+      realwriter->SetInput(outputs.B0Image);
+      realwriter->SetUseCompression(true);
+      realwriter->Update();
+      }
+    catch( itk::ExceptionObject & e )
+      {
+      std::cerr << "Could not write B0 file" << std::endl;
+      std::cerr << e << std::endl;
+      }
+    }
+
+  if( files.B0MaskOutput != "" )
+    {
+    try
+      {
+      if( VERBOSE )
+        {
+        std::cout << "Writing mask B0" << std::endl;
+        }
+      if( outputs.B0MaskWriter.IsNull() )
+        {
+        throw itk::ExceptionObject(__FILE__, __LINE__, "No writer for " + files.B0MaskOutput, ITK_LOCATION);
+        }
+      MaskWriterType::Pointer maskwriter = outputs.B0MaskWriter;
+      maskwriter->SetInput(outputs.B0Mask);
+      maskwriter->Update();
+      }
+    catch( itk::ExceptionObject & e )
       {
-      std::cout << "Number of non B0 images : " << numberNonB0Directions << std::endl;
+      std::cerr << "Could not write threshold mask file" << std::endl;
+      std::cerr << e << std::endl;
       }
 
-    typedef itk::DivideImageFilter <RealImageType, RealImageType, RealImageType > DivideImageFilterType;
-    DivideImageFilterType::Pointer divideImageFilter = DivideImageFilterType::New ();
-    divideImageFilter->SetInput1(idwiImage);
-    divideImageFilter->SetConstant(numberNonB0Directions);
-    divideImageFilter->Update();
-    idwiImage = divideImageFilter->GetOutput();
-    typedef itk::ExpImageFilter<RealImageType, RealImageType> ExpFilterType;
-    ExpFilterType::Pointer expfilter = ExpFilterType::New();
-    expfilter->SetInput(idwiImage);
+    }
 
+  // Output idwi image if requested
+  if( files.IDWI != "" )
+    {
     try
       {
-      typedef itk::ImageFileWriter<RealImageType> RealImageFileWriterType;
-      RealImageFileWriterType::Pointer realwriter = RealImageFileWriterType::New();
-      realwriter->SetInput(expfilter->GetOutput() );
+      if( outputs.idwiWriter.IsNull() )
+        {
+        throw itk::ExceptionObject(__FILE__, __LINE__, "No writer for " + files.IDWI, ITK_LOCATION);
+        }
+      RealWriterType::Pointer realwriter = outputs.idwiWriter;
+      realwriter->SetInput(outputs.idwiImage);
       realwriter->SetUseCompression(true);
-      realwriter->SetFileName(IDWI.c_str() );
       realwriter->Update();
       }
     catch( itk::ExceptionObject & e )
@@ -661,179 +1132,392 @@ int main(int argc, char* argv[])
 
     }
 
-  // Estimate tensors
-  TensorImageType::Pointer tensors;
+  // Write tensor file if requested.  This runs the estimation
+  // pipeline, slab by slab when a memory budget is set.
+  try
+    {
+    if( outputs.floatTensors.IsNotNull() )
+      {
+      // Estimated in float, written as they are
+      outputs.floatTensors->SetMetaDataDictionary(outputs.dictionary) ;
+      WriteStreamed<TensorFloatImageType>(outputs.floatTensorWriter, outputs.floatTensors, outputs.numberOfSlabs) ;
+      return EXIT_SUCCESS;
+      }
+    TensorImageType::Pointer tensors = outputs.tensors;
+    tensors->SetMetaDataDictionary(outputs.dictionary) ;
+    if( !parameters.doubleDTI )
+      {
+      typedef itk::CastImageFilter< TensorImageType, TensorFloatImageType > CastDTIFilterType ;
+      CastDTIFilterType::Pointer castFilter = CastDTIFilterType::New() ;
+      castFilter->SetInput( tensors ) ;
+      WriteStreamed<TensorFloatImageType>(outputs.floatTensorWriter, castFilter->GetOutput(), outputs.numberOfSlabs) ;
+      }
+    else
+      {
+      WriteStreamed<TensorImageType>(outputs.tensorWriter, tensors, outputs.numberOfSlabs) ;
+      }
+    }
+  catch( itk::ExceptionObject e )
+    {
+    std::cerr << e << std::endl;
+    return EXIT_FAILURE;
+    }
 
-  if( VERBOSE )
+  return EXIT_SUCCESS;
+}
+
+// Reads a batch manifest: one subject per line with the columns
+//   dwi tensorOutput [brainMask [B0 [idwi [B0MaskOutput [badRegionMask]]]]]
+// separated by white space.  "-" leaves an optional column empty, and
+// empty lines and lines starting with '#' are skipped.
+bool ReadManifest(const std::string & fileName, std::vector<SubjectFiles> & subjects)
+{
+  std::ifstream manifest(fileName.c_str() );
+  if( !manifest )
     {
-    std::cout << "Estimation method: " << method << std::endl;
+    std::cerr << "Could not open batch manifest " << fileName << std::endl;
+    return false;
     }
-  TensorPixelType defaultTensor(0.0) ;
-  for( int i = 0 ; i < 6 ; i++ )
-  {
-      defaultTensor[ i ] = defaultTensorValue[ i ] ;
-  }
-  //  if(vm["method"].as<EstimationType>() == LinearEstimate)
-  if( method == "lls" )
+  std::string  line;
+  unsigned int lineNumber = 0;
+  while( std::getline(manifest, line) )
     {
-       DiffusionEstimationFilterType::Pointer llsestimator = DiffusionEstimationFilterType::New();
-       llsestimator->ReleaseDataFlagOn();
-       llsestimator->SetGradientImage(gradientContainer, dwi);
-       llsestimator->SetBValue(b0);
-       llsestimator->SetDefaultTensor(defaultTensor);
-       llsestimator->SetThreshold(_threshold);
-       llsestimator->SetVerbose( verbose ) ;
-       llsestimator->SetShiftNegativeEigenvalues( ShiftNegativeEigenvalues ) ;
-       llsestimator->SetShiftNegativeEigenvaluesCoefficient( ShiftNegativeEigenvaluesCoefficient ) ;
-       llsestimator->Update();
-       tensors = llsestimator->GetOutput();
+    ++lineNumber;
+    std::istringstream       iss(line);
+    std::vector<std::string> columns;
+    std::string              column;
+    while( iss >> column )
+      {
+      columns.push_back(column == "-" ? std::string() : column);
+      }
+    if( columns.empty() || columns[0][0] == '#' )
+      {
+      continue;
+      }
+    if( columns.size() < 2 || columns.size() > 7 || columns[0] == "" || columns[1] == "" )
+      {
+      std::cerr << fileName << ":" << lineNumber
+                << ": expected a dwi, a tensor output and at most 5 optional files" << std::endl;
+      return false;
+      }
+    columns.resize(7);
+    SubjectFiles files;
+    files.dwiImage = columns[0];
+    files.tensorOutput = columns[1];
+    files.brainMask = columns[2];
+    files.B0 = columns[3];
+    files.IDWI = columns[4];
+    files.B0MaskOutput = columns[5];
+    files.badRegionMask = columns[6];
+    subjects.push_back(files);
     }
-  //  else if(vm["method"].as<EstimationType>() == NonlinearEstimate)
-  else if( method == "nls" )
+  return true;
+}
+
+// A subject going through the stages of a batch
+struct BatchSubject
+{
+  const SubjectFiles *         files;
+  const EstimationParameters * parameters;
+  SubjectData                  data;
+  SubjectOutputs               outputs;
+  int                          status;
+};
+
+// The readers and writers of the subject, and their IO, are created
+// by the main thread before the stage threads are spawned
+ITK_THREAD_RETURN_TYPE ReadSubjectThread(void * arg)
+{
+  BatchSubject * subject = static_cast<BatchSubject *>(
+      static_cast<itk::MultiThreader::ThreadInfoStruct *>(arg)->UserData);
+  if( subject->status != EXIT_SUCCESS )
     {
-    NLDiffusionEstimationFilterType::Pointer estimator = NLDiffusionEstimationFilterType::New();
-    estimator->ReleaseDataFlagOn();
+    return ITK_THREAD_RETURN_VALUE;
+    }
+  try
+    {
+    subject->status = ReadSubject(*subject->files, *subject->parameters, subject->data);
+    }
+  catch( std::exception & e )
+    {
+    std::cerr << e.what() << std::endl;
+    subject->status = EXIT_FAILURE;
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
 
-    estimator->SetGradientImage(gradientContainer, dwi);
-    estimator->SetBValue(b0);
-    estimator->SetDefaultTensor(defaultTensor);
-    estimator->SetThreshold(_threshold);
-    estimator->SetStep(stepSize);
-    estimator->SetNumberOfThreads(1);
-    estimator->SetVerbose( verbose ) ;
-    estimator->SetShiftNegativeEigenvalues( ShiftNegativeEigenvalues ) ;
-    estimator->SetShiftNegativeEigenvaluesCoefficient( ShiftNegativeEigenvaluesCoefficient ) ;
-    estimator->Update();
-    tensors = estimator->GetOutput();
+ITK_THREAD_RETURN_TYPE WriteSubjectThread(void * arg)
+{
+  BatchSubject * subject = static_cast<BatchSubject *>(
+      static_cast<itk::MultiThreader::ThreadInfoStruct *>(arg)->UserData);
+  try
+    {
+    subject->status = WriteSubject(*subject->files, *subject->parameters, subject->outputs);
     }
-  // else if(vm["method"].as<EstimationType>() == WeightedEstimate)
-  else if( method == "wls" )
+  catch( std::exception & e )
     {
-    WLDiffusionEstimationFilterType::Pointer estimator = WLDiffusionEstimationFilterType::New();
-    estimator->ReleaseDataFlagOn();
+    std::cerr << e.what() << std::endl;
+    subject->status = EXIT_FAILURE;
+    }
+  subject->outputs = SubjectOutputs();
+  return ITK_THREAD_RETURN_VALUE;
+}
 
-    if( VERBOSE )
+// Processes the subjects as a pipeline: the dwi of the next subject is
+// read and the outputs of the previous one are written while the
+// current one is estimated.  The estimation itself uses all the
+// threads of ITK.  Subjects processed in slabs (see maxMemory) stream
+// their input and output, they are written by the estimation stage.
+int ProcessBatch(const std::vector<SubjectFiles> & subjects, const EstimationParameters & parameters)
+{
+  std::vector<BatchSubject> batch(subjects.size() );
+  for( unsigned int i = 0; i < subjects.size(); ++i )
+    {
+    batch[i].files = &subjects[i];
+    batch[i].parameters = &parameters;
+    batch[i].status = EXIT_SUCCESS;
+    }
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  int                         readThread = -1;
+  int                         writeThread = -1;
+  unsigned int                numberOfFailures = 0;
+  if( batch.empty() )
+    {
+    std::cerr << "The batch manifest lists no subject" << std::endl;
+    return EXIT_FAILURE;
+    }
+  batch[0].status = CreateSubjectReaders(*batch[0].files, batch[0].data);
+  readThread = threader->SpawnThread(ReadSubjectThread, &batch[0]);
+  for( unsigned int i = 0; i < batch.size(); ++i )
+    {
+    BatchSubject & subject = batch[i];
+    std::cout << "Subject " << i + 1 << "/" << batch.size() << ": " << subject.files->dwiImage << std::endl;
+
+    // Wait for the dwi of this subject and start reading the next one
+    threader->TerminateThread(readThread);
+    if( i + 1 < batch.size() )
       {
-      std::cout << "Weighting steps: " << weightIterations << std::endl;
+      batch[i + 1].status = CreateSubjectReaders(*batch[i + 1].files, batch[i + 1].data);
+      readThread = threader->SpawnThread(ReadSubjectThread, &batch[i + 1]);
       }
 
-    estimator->SetGradientImage(gradientContainer, dwi);
-    estimator->SetBValue(b0);
-    estimator->SetDefaultTensor(defaultTensor);
-    estimator->SetThreshold(_threshold);
-    estimator->SetNumberOfIterations(weightIterations);
-    estimator->SetVerbose( verbose ) ;
-    estimator->SetShiftNegativeEigenvalues( ShiftNegativeEigenvalues ) ;
-    estimator->SetShiftNegativeEigenvaluesCoefficient( ShiftNegativeEigenvaluesCoefficient ) ;
-    estimator->Update();
-    tensors = estimator->GetOutput();
+    bool writeNow = false;
+    if( subject.status == EXIT_SUCCESS )
+      {
+      try
+        {
+        subject.status = EstimateSubject(*subject.files, parameters, subject.data, subject.outputs);
+        if( subject.status == EXIT_SUCCESS )
+          {
+          subject.status = CreateSubjectWriters(*subject.files, parameters, subject.outputs);
+          }
+        if( subject.status == EXIT_SUCCESS && subject.outputs.numberOfSlabs == 1 )
+          {
+          // Compute the tensors here, the write stage only writes them
+          if( subject.outputs.floatTensors.IsNotNull() )
+            {
+            subject.outputs.floatTensors->Update();
+            subject.outputs.floatTensors->DisconnectPipeline();
+            }
+          else
+            {
+            subject.outputs.tensors->Update();
+            subject.outputs.tensors->DisconnectPipeline();
+            }
+          subject.outputs.pipeline.clear();
+          }
+        else
+          {
+          writeNow = subject.status == EXIT_SUCCESS;
+          }
+        }
+      catch( std::exception & e )
+        {
+        std::cerr << e.what() << std::endl;
+        subject.status = EXIT_FAILURE;
+        }
+      }
+    subject.data = SubjectData();
+
+    if( writeThread >= 0 )
+      {
+      threader->TerminateThread(writeThread);
+      writeThread = -1;
+      }
+    if( subject.status == EXIT_SUCCESS )
+      {
+      if( writeNow )
+        {
+        subject.status = WriteSubject(*subject.files, parameters, subject.outputs);
+        subject.outputs = SubjectOutputs();
+        }
+      else
+        {
+        writeThread = threader->SpawnThread(WriteSubjectThread, &subject);
+        }
+      }
     }
-  //  else if(vm["method"].as<EstimationType>() == MaximumLikelihoodEstimate)
-  else if( method == "ml" )
+  if( writeThread >= 0 )
     {
-    WLDiffusionEstimationFilterType::Pointer estimatorInit = WLDiffusionEstimationFilterType::New();
-    estimatorInit->ReleaseDataFlagOn();
+    threader->TerminateThread(writeThread);
+    }
 
-    estimatorInit->SetGradientImage(gradientContainer, dwi);
-    estimatorInit->SetBValue(b0);
-    estimatorInit->SetDefaultTensor(defaultTensor);
-    estimatorInit->SetThreshold(_threshold);
-    estimatorInit->SetNumberOfIterations(weightIterations);
-    estimatorInit->SetVerbose( verbose ) ;
-    estimatorInit->SetShiftNegativeEigenvalues( ShiftNegativeEigenvalues ) ;
-    estimatorInit->SetShiftNegativeEigenvaluesCoefficient( ShiftNegativeEigenvaluesCoefficient ) ;
-    estimatorInit->Update();
-    TensorImageType::Pointer inittensors = estimatorInit->GetOutput();
+  for( unsigned int i = 0; i < batch.size(); ++i )
+    {
+    if( batch[i].status != EXIT_SUCCESS )
+      {
+      std::cerr << "Failed: " << batch[i].files->dwiImage << std::endl;
+      ++numberOfFailures;
+      }
+    }
+  std::cout << batch.size() - numberOfFailures << " of " << batch.size() << " subjects processed" << std::endl;
+  return numberOfFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
 
-    MLDiffusionEstimationFilterType::Pointer estimator = MLDiffusionEstimationFilterType::New();
-    estimator->ReleaseDataFlagOn();
+int main(int argc, char* argv[])
+{
+  PARSE_ARGS;
+  // NRRD files are compressed and decompressed on all the cores
+  itk::ParallelNrrdImageIOFactory::RegisterOneFactory();
+  // End option reading configuration
 
-    if( VERBOSE )
+  // Display help if asked or program improperly called
+  if( batchManifest != "" )
+    {
+    if( dwiImage != "" || tensorOutput != "" )
       {
-      std::cout << "Weighting steps: " << weightIterations << std::endl;
+      std::cerr << "The DWI image and output tensor cannot be specified with a batch manifest." << std::endl;
+      return EXIT_FAILURE;
       }
-
-    estimator->SetGradientImage(gradientContainer, dwi);
-    estimator->SetBValue(b0);
-    estimator->SetThreshold(_threshold);
-    estimator->SetInitialTensor(inittensors);
-    estimator->SetStep(stepSize);
-    estimator->SetNumberOfThreads(1);
-    std::cout << "Start sigma: " << sigma << std::endl;
-    estimator->SetSigma(sigma);
-    estimator->Update();
-    tensors = estimator->GetOutput();
     }
-  else
+  else if( dwiImage == "" || tensorOutput == "" )
     {
-    std::cerr << "Invalid estimation method"  << std::endl;
+    /*   if(help == true)
+    {
+      std::cout << "Version: $Date: 2009-03-03 15:15:31 $ $Revision: 1.10 $" << std::endl;
+      std::cout << ITK_SOURCE_VERSION << std::endl;
+      return EXIT_SUCCESS;
+    }
+    else
+    {*/
+    std::cerr << "DWI image and output tensor filename needs to be specified." << std::endl;
     return EXIT_FAILURE;
+    /* }
+    */
     }
-
-  // Tensors Corrections
-  if( !correction.compare( "zero" ) )
+  if( defaultTensorValue.size() != 6 )
+  {
+      std::cerr << "Default tensor must have 6 components" << std::endl ;
+      return EXIT_FAILURE ;
+  }
+  if( stepSize < 0.0 )
     {
-    typedef itk::DiffusionTensor3DZeroCorrectionFilter<TensorImageType, TensorImageType> ZeroCorrection;
-    ZeroCorrection::Pointer zeroFilter = ZeroCorrection::New();
-    zeroFilter->SetInput( tensors );
-    zeroFilter->Update();
-    tensors = zeroFilter->GetOutput();
+//   if(vm["method"].as<EstimationType>() == NonlinearEstimate ||
+//      vm["method"].as<EstimationType>() == MaximumLikelihoodEstimate)
+    if( method == "nls" || method == "ml" )
+      {
+      std::cerr << "Step size not set for optimization method" << std::endl;
+      return EXIT_FAILURE;
+      }
     }
-  else if( !correction.compare( "abs" ) )
+  if( maxIterations <= 0 )
     {
-    typedef itk::DiffusionTensor3DAbsCorrectionFilter<TensorImageType, TensorImageType> AbsCorrection;
-    AbsCorrection::Pointer absFilter = AbsCorrection::New();
-    absFilter->SetInput( tensors );
-    absFilter->Update();
-    tensors = absFilter->GetOutput();
+    if( method == "nls" || method == "ml" )
+      {
+      std::cerr << "Maximum number of iterations must be positive" << std::endl;
+      return EXIT_FAILURE;
+      }
     }
-  else if( !correction.compare( "nearest" ) )
+  if( weightTolerance < 0.0 )
     {
-    typedef itk::DiffusionTensor3DNearestCorrectionFilter<TensorImageType, TensorImageType> NearestCorrection;
-    NearestCorrection::Pointer nearestFilter = NearestCorrection::New();
-    nearestFilter->SetInput( tensors );
-    nearestFilter->Update();
-    tensors = nearestFilter->GetOutput();
+    std::cerr << "Weight tolerance must not be negative" << std::endl;
+    return EXIT_FAILURE;
     }
+  if( sigma < 0.0 )
+    {
+    //    if(vm["method"].as<EstimationType>() == MaximumLikelihoodEstimate)
+    if( method == "ml" )
+      {
+      std::cerr << "Noise level not set for optimization method" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  if( ShiftNegativeEigenvaluesCoefficient < 1.0 || ShiftNegativeEigenvaluesCoefficient > 1.001 )
+  {
+    std::cerr << "Shift Negative Eigenvalues Coefficient must be between 1.0 and 1.001" << std::endl;
+    return EXIT_FAILURE;
+  }
 
-  // wp = D*x
-  // wv = M*x
-  // wv' = D'M*x
-
-  // Write tensor file if requested
-  try
+  if( floatPrecision && doubleDTI )
+    {
+    std::cerr << "Tensors estimated in float cannot be saved as doubles" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if( gradientSchemeCache != "" )
     {
-    if( !doubleDTI )
+    if( !itksys::SystemTools::FileIsDirectory(gradientSchemeCache.c_str() ) )
       {
-      typedef itk::DiffusionTensor3D<float> TensorFloatPixelType ;
-      typedef itk::Image<TensorFloatPixelType, DIM> TensorFloatImageType ;
-      typedef itk::CastImageFilter< TensorImageType, TensorFloatImageType > CastDTIFilterType ;
-      CastDTIFilterType::Pointer castFilter = CastDTIFilterType::New() ;
-      castFilter->SetInput( tensors ) ;
-      typedef itk::ImageFileWriter<TensorFloatImageType> TensorFileWriterType ;
-      TensorFileWriterType::Pointer tensorWriter = TensorFileWriterType::New() ;
-      tensorWriter->SetFileName(tensorOutput.c_str()) ;
-      tensors->SetMetaDataDictionary(dict) ;
-      tensorWriter->SetInput(castFilter->GetOutput()) ;
-      tensorWriter->SetUseCompression(true) ;
-      tensorWriter->Update() ;
+      std::cerr << "Gradient scheme cache " << gradientSchemeCache << " is not a directory" << std::endl;
+      return EXIT_FAILURE;
       }
-    else
+    // RealType is double: all the estimators share this registry
+    DiffusionEstimationFilterType::GradientSchemeRegistryType::GetInstance()->SetCacheDirectory(gradientSchemeCache);
+    itk::DiffusionTensor3DGradientSchemeRegistry<float>::GetInstance()->SetCacheDirectory(gradientSchemeCache);
+    }
+
+  EstimationParameters parameters;
+  parameters.method = method;
+  parameters.correction = correction;
+  parameters.threshold = threshold;
+  parameters.weightIterations = weightIterations;
+  parameters.weightTolerance = weightTolerance;
+  parameters.stepSize = stepSize;
+  parameters.maxIterations = maxIterations;
+  parameters.sigma = sigma;
+  parameters.doubleDTI = doubleDTI;
+  parameters.floatPrecision = floatPrecision;
+  parameters.maxMemory = maxMemory;
+  parameters.verbose = verbose;
+  parameters.shiftNegativeEigenvalues = ShiftNegativeEigenvalues;
+  parameters.shiftNegativeEigenvaluesCoefficient = ShiftNegativeEigenvaluesCoefficient;
+  parameters.defaultTensor = TensorPixelType(0.0);
+  for( int i = 0 ; i < 6 ; i++ )
+  {
+      parameters.defaultTensor[ i ] = defaultTensorValue[ i ] ;
+  }
+
+  if( batchManifest != "" )
+    {
+    std::vector<SubjectFiles> subjects;
+    if( !ReadManifest(batchManifest, subjects) )
       {
-      typedef itk::ImageFileWriter<TensorImageType> TensorFileWriterType ;
-      TensorFileWriterType::Pointer tensorWriter = TensorFileWriterType::New() ;
-      tensorWriter->SetFileName(tensorOutput.c_str()) ;
-      tensors->SetMetaDataDictionary(dict) ;
-      tensorWriter->SetInput(tensors) ;
-      tensorWriter->SetUseCompression(true) ;
-      tensorWriter->Update() ;
+      return EXIT_FAILURE;
       }
+#if ITK_VERSION_MAJOR == 4 && ITK_VERSION_MINOR >= 8
+    // Keep the worker threads of the filters alive across subjects
+    itk::MultiThreader::SetGlobalDefaultUseThreadPool(true);
+#endif
+    return ProcessBatch(subjects, parameters);
     }
-  catch( itk::ExceptionObject e )
+
+  SubjectFiles files;
+  files.dwiImage = dwiImage;
+  files.tensorOutput = tensorOutput;
+  files.brainMask = brainMask;
+  files.badRegionMask = badRegionMask;
+  files.B0 = B0;
+  files.IDWI = IDWI;
+  files.B0MaskOutput = B0MaskOutput;
+
+  SubjectData    data;
+  SubjectOutputs outputs;
+  if( CreateSubjectReaders(files, data) != EXIT_SUCCESS
+      || ReadSubject(files, parameters, data) != EXIT_SUCCESS
+      || EstimateSubject(files, parameters, data, outputs) != EXIT_SUCCESS
+      || CreateSubjectWriters(files, parameters, outputs) != EXIT_SUCCESS )
     {
-    std::cerr << e << std::endl;
     return EXIT_FAILURE;
     }
-
-  return EXIT_SUCCESS;
+  return WriteSubject(files, parameters, outputs);
 }
@@ -24,6 +24,9 @@
 #include <itkVersion.h>
 // Filters
 #include <itkCastImageFilter.h>
+#include <itkExtractImageFilter.h>
+#include <itkConstantPadImageFilter.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
 // IO
 #include <itkImageFileReader.h>
 
@@ -33,6 +36,9 @@
 #include "tensoroperations.h"
 #include "imageio.h"
 #include "deformationfieldio.h"
+#include "sparsetensorio.h"
+#include "itkParallelNrrdImageIOFactory.h"
+#include "itkMappedImageFileReader.h"
 
 // tensor correction headers
 #include "itkDiffusionTensor3DZeroCorrection.h"
@@ -44,13 +50,182 @@
 // Bad global variables.  TODO: remove these
 bool VERBOSE = false;
 
+// Pad an image computed in a part of the output region with zeros
+template <class TImage>
+typename TImage::Pointer padToRegion(typename TImage::Pointer image,
+                                     const typename TImage::RegionType & region)
+{
+  image->UpdateOutputInformation();
+  const typename TImage::RegionType imageRegion = image->GetLargestPossibleRegion();
+  if( imageRegion == region )
+    {
+    return image;
+    }
+
+  typedef itk::ConstantPadImageFilter<TImage, TImage> PadFilterType;
+  typename PadFilterType::Pointer pad = PadFilterType::New();
+  typename TImage::SizeType       lower;
+  typename TImage::SizeType       upper;
+  for( unsigned int i = 0; i < TImage::ImageDimension; ++i )
+    {
+    lower[i] = imageRegion.GetIndex(i) - region.GetIndex(i);
+    upper[i] = ( region.GetIndex(i) + region.GetSize(i) ) - ( imageRegion.GetIndex(i) + imageRegion.GetSize(i) );
+    }
+  pad->SetInput(image);
+  pad->SetPadLowerBound(lower);
+  pad->SetPadUpperBound(upper);
+  pad->SetConstant(itk::NumericTraits<typename TImage::PixelType>::ZeroValue() );
+  pad->Update();
+  return pad->GetOutput();
+}
+
+// Bounding box of the non-zero voxels of the mask in region.  Returns
+// false if there are none.
+bool computeMaskBoundingBox(const LabelImageType * mask,
+                            const TensorImageType::RegionType & region,
+                            TensorImageType::RegionType & boundingBox)
+{
+  TensorImageType::IndexType lower;
+  TensorImageType::IndexType upper;
+  bool                       empty = true;
+
+  itk::ImageRegionConstIteratorWithIndex<LabelImageType> it(mask, region);
+  for( ; !it.IsAtEnd(); ++it )
+    {
+    if( it.Get() == 0 )
+      {
+      continue;
+      }
+    const TensorImageType::IndexType & index = it.GetIndex();
+    for( unsigned int i = 0; i < DIM; ++i )
+      {
+      if( empty || index[i] < lower[i] )
+        {
+        lower[i] = index[i];
+        }
+      if( empty || index[i] > upper[i] )
+        {
+        upper[i] = index[i];
+        }
+      }
+    empty = false;
+    }
+  if( empty )
+    {
+    return false;
+    }
+
+  boundingBox.SetIndex(lower);
+  for( unsigned int i = 0; i < DIM; ++i )
+    {
+    boundingBox.SetSize(i, upper[i] - lower[i] + 1);
+    }
+  return true;
+}
+
+// Dense map from the map of packed tensors, or the map itself if the
+// tensors are not sparse
+template <class TImage>
+typename TImage::Pointer expandMap(TImage * map, const SparseTensorImageType * sparse)
+{
+  if( !sparse )
+    {
+    return map;
+    }
+  return sparse->Expand(map);
+}
+
+// Write the maps of the tensors whose file name is not empty, padded to
+// outputRegion.  The statistics of the labels are written to
+// statisticsFileName if it is not empty.  Returns false if they cannot
+// be written.  If sparse is set, it holds the same tensors as tensors,
+// and the maps are only computed from its foreground tensors.
+template <class T>
+bool writeScalarMaps(TensorImageType::Pointer tensors,
+                     const TensorImageType::RegionType & outputRegion,
+                     const std::string fileNames[],
+                     const std::string & statisticsFileName,
+                     const StatisticsLabelImageType * labels,
+                     const bool computeStatistics[],
+                     const std::vector<double> & percentiles,
+                     SparseTensorImageType * sparse)
+{
+  typedef typename ScalarMapsFilter<T>::Type FilterType;
+  bool computeMap[itk::TensorScalarMaps::NumberOfMaps];
+  bool computeAny = statisticsFileName != "";
+  for( unsigned int i = 0; i < itk::TensorScalarMaps::NumberOfMaps; ++i )
+    {
+    computeMap[i] = fileNames[i] != "";
+    computeAny = computeAny || computeMap[i];
+    }
+  if( !computeAny )
+    {
+    return true;
+    }
+
+  // The packed tensors carry the direction and the measurement frame of
+  // the tensors, which rotate the principal eigenvector.  Their last
+  // tensor is the background, so the expanded maps have the values of
+  // the maps of the dense tensors.
+  TensorImageType::Pointer               mapsInput = tensors;
+  StatisticsLabelImageType::ConstPointer mapsLabels = labels;
+  if( sparse )
+    {
+    mapsInput = sparse->GetPackedImage();
+    mapsInput->SetDirection(tensors->GetDirection() );
+    mapsInput->SetMetaDataDictionary(tensors->GetMetaDataDictionary() );
+    if( labels && statisticsFileName != "" )
+      {
+      mapsLabels = sparse->Pack(labels, 0);
+      }
+    }
+
+  typename FilterType::Pointer maps =
+    statisticsFileName != "" ?
+    createScalarMaps<T>(mapsInput, computeMap, mapsLabels, computeStatistics, percentiles) :
+    createScalarMaps<T>(mapsInput, computeMap);
+  if( sparse )
+    {
+    tensors->SetMetaDataDictionary(mapsInput->GetMetaDataDictionary() );
+    }
+  for( unsigned int i = 0; i < itk::TensorScalarMaps::ColorFractionalAnisotropy; ++i )
+    {
+    if( computeMap[i] )
+      {
+      typedef typename FilterType::ScalarImageType ScalarImageType;
+      writeImage(fileNames[i],
+                 padToRegion<ScalarImageType>(
+                   expandMap(maps->GetScalarOutput(static_cast<itk::TensorScalarMaps::MapType>(i) ), sparse),
+                   outputRegion) );
+      }
+    }
+  if( computeMap[itk::TensorScalarMaps::ColorFractionalAnisotropy] )
+    {
+    writeImage(fileNames[itk::TensorScalarMaps::ColorFractionalAnisotropy],
+               padToRegion<typename FilterType::ColorImageType>(expandMap(maps->GetColorFAOutput(), sparse),
+                                                                outputRegion) );
+    }
+  if( computeMap[itk::TensorScalarMaps::PrincipalEigenvector] )
+    {
+    writeImage(fileNames[itk::TensorScalarMaps::PrincipalEigenvector],
+               padToRegion<typename FilterType::VectorImageType>(
+                 expandMap(maps->GetPrincipalEigenvectorOutput(), sparse), outputRegion) );
+    }
+  if( statisticsFileName != "" )
+    {
+    return writeLabelStatistics<T>(statisticsFileName, maps);
+    }
+  return true;
+}
+
 int main(int argc, char* argv[])
 {
   PARSE_ARGS;
+  // NRRD files are compressed and decompressed on all the cores
+  itk::ParallelNrrdImageIOFactory::RegisterOneFactory();
 
   typedef itk::DiffusionTensor3D<float> TensorFloatPixelType;
   typedef itk::Image<TensorFloatPixelType, DIM> TensorFloatImageType;
-  typedef itk::ImageFileWriter<TensorFloatImageType> TensorFileWriterType;
   typedef itk::CastImageFilter< TensorImageType, TensorFloatImageType > CastDTIFilterType ;
   // If the value scale is true (default) we scal FA and MD values to
   // integer ranges.
@@ -64,18 +239,49 @@ int main(int argc, char* argv[])
 //     VERBOSE = true;
 //   }
   VERBOSE = verbose;
+  if( compressionLevel < -1 || compressionLevel > 9 )
+    {
+    std::cerr << "The compression level must be between -1 and 9" << std::endl;
+    return EXIT_FAILURE;
+    }
+  setImageCompressionLevel(compressionLevel);
+  setImageWriterThreads(writerThreads > 0 ? writerThreads : 0);
+  ImageWriterGuard writerGuard;
   // Read tensor image
-  typedef itk::ImageFileReader<TensorImageType> FileReaderType;
+  typedef itk::MappedImageFileReader<TensorImageType> FileReaderType;
   FileReaderType::Pointer dtireader = FileReaderType::New();
   if( dtiImage == "" )
     {
     std::cerr << "Missing DTI Image filename" << std::endl;
-    exit(1);
+    return EXIT_FAILURE;
     }
   dtireader->SetFileName(dtiImage.c_str() );
+  // An output written over the input would truncate its mapping
+  const std::string outputArray[] =
+    { faOutput, mdOutput, faGradientOutput, faGradientMagOutput, colorFAOutput, principalEigenvectorOutput,
+      negativeEigenvectorOutput, frobeniusNormOutput, lambda1Output, lambda2Output, lambda3Output, RDOutput,
+      rotOutput, outmask, sparseOutput, statisticsOutput, deformationOutput, chainOutput };
+  if( isWrittenOver(dtiImage, std::vector<std::string>(outputArray, outputArray
+                                                       + sizeof( outputArray ) / sizeof( outputArray[0] ) ) ) )
+    {
+    dtireader->UseMappingOff();
+    }
+  // Sparse tensor files are expanded, and their packed tensors are kept
+  // for the scalar maps
+  SparseTensorImageType::Pointer sparse;
+  TensorImageType::Pointer       input;
   try
     {
-    dtireader->Update();
+    if( isSparseTensorFile(dtiImage) )
+      {
+      sparse = readSparseTensors(dtiImage);
+      input = sparse->GetDenseImage();
+      }
+    else
+      {
+      dtireader->UpdateOutputInformation();
+      input = dtireader->GetOutput();
+      }
     }
   catch( itk::ExceptionObject & e )
     {
@@ -87,7 +293,7 @@ int main(int argc, char* argv[])
   // namic conventions defined at http://wiki.na-mic.org/Wiki/index.php/NAMIC_Wiki:DTI:Nrrd_format
   GradientListType::Pointer gradientContainer = GradientListType::New();
 
-  itk::MetaDataDictionary & dict = dtireader->GetOutput()->GetMetaDataDictionary();
+  itk::MetaDataDictionary & dict = input->GetMetaDataDictionary();
 
   std::vector<std::string> keys = dict.GetKeys();
   for( std::vector<std::string>::const_iterator it = keys.begin();
@@ -140,14 +346,99 @@ int main(int argc, char* argv[])
               << reorientation << std::endl;
     }
 
-  TensorImageType::Pointer tensors = dtireader->GetOutput();
+  // The outputs cover the ROI, or the whole image.  The tensors are
+  // only read and processed in the part of the ROI where the mask is
+  // not zero, the outputs are zero elsewhere.
+  const TensorImageType::RegionType imageRegion = input->GetLargestPossibleRegion();
+  TensorImageType::RegionType       outputRegion = imageRegion;
+  if( !roi.empty() )
+    {
+    if( roi.size() != 6 )
+      {
+      std::cerr << "The ROI must be given as 6 integers: start index then size" << std::endl;
+      return EXIT_FAILURE;
+      }
+    TensorImageType::RegionType roiRegion;
+    for( unsigned int i = 0; i < DIM; ++i )
+      {
+      roiRegion.SetIndex(i, roi[i]);
+      roiRegion.SetSize(i, roi[i + DIM] > 0 ? roi[i + DIM] : 0);
+      }
+    if( !imageRegion.IsInside(roiRegion) || roiRegion.GetNumberOfPixels() == 0 )
+      {
+      std::cerr << "The ROI " << roiRegion << " is not inside the image " << imageRegion << std::endl;
+      return EXIT_FAILURE;
+      }
+    outputRegion = roiRegion;
+    }
+
+  typedef itk::ImageFileReader<LabelImageType> MaskFileReaderType;
+  MaskFileReaderType::Pointer maskreader = MaskFileReaderType::New();
+  TensorImageType::RegionType processRegion = outputRegion;
+  if( mask != "" )
+    {
+    maskreader->SetFileName(mask.c_str() );
+    try
+      {
+      maskreader->Update();
+      }
+    catch( itk::ExceptionObject & e )
+      {
+      std::cerr << e << std::endl;
+      return EXIT_FAILURE;
+      }
+    if( !maskreader->GetOutput()->GetLargestPossibleRegion().IsInside(outputRegion) )
+      {
+      std::cerr << "The mask does not cover the tensor image" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if( !computeMaskBoundingBox(maskreader->GetOutput(), outputRegion, processRegion) )
+      {
+      std::cerr << "The mask is empty in the processed region" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  if( VERBOSE )
+    {
+    std::cout << "Processed region: " << processRegion << std::endl;
+    }
+
+  // Only the processed region is requested from the reader, which only
+  // reads that part of the file if its format can be streamed
+  TensorImageType::Pointer tensors;
+  try
+    {
+    if( processRegion == imageRegion )
+      {
+      input->Update();
+      tensors = input;
+      }
+    else
+      {
+      typedef itk::ExtractImageFilter<TensorImageType, TensorImageType> ExtractFilterType;
+      ExtractFilterType::Pointer extract = ExtractFilterType::New();
+      extract->SetInput(input);
+      extract->SetExtractionRegion(processRegion);
+      extract->SetDirectionCollapseToSubmatrix();
+      extract->Update();
+      tensors = extract->GetOutput();
+      tensors->SetMetaDataDictionary(dict);
+      input->ReleaseData();
+      }
+    }
+  catch( itk::ExceptionObject & e )
+    {
+    std::cerr << e << std::endl;
+    return EXIT_FAILURE;
+    }
 
-  // Tensors Corrections
+  // Tensors Corrections, in the buffer of the tensors that were read
   if( !correction.compare( "zero" ) )
     {
     typedef itk::DiffusionTensor3DZeroCorrectionFilter<TensorImageType, TensorImageType> ZeroCorrection;
     ZeroCorrection::Pointer zeroFilter = ZeroCorrection::New();
     zeroFilter->SetInput( tensors );
+    zeroFilter->InPlaceOn();
     zeroFilter->Update();
     tensors = zeroFilter->GetOutput();
     }
@@ -156,6 +447,7 @@ int main(int argc, char* argv[])
     typedef itk::DiffusionTensor3DAbsCorrectionFilter<TensorImageType, TensorImageType> AbsCorrection;
     AbsCorrection::Pointer absFilter = AbsCorrection::New();
     absFilter->SetInput( tensors );
+    absFilter->InPlaceOn();
     absFilter->Update();
     tensors = absFilter->GetOutput();
     }
@@ -164,6 +456,7 @@ int main(int argc, char* argv[])
     typedef itk::DiffusionTensor3DNearestCorrectionFilter<TensorImageType, TensorImageType> NearestCorrection;
     NearestCorrection::Pointer nearestFilter = NearestCorrection::New();
     nearestFilter->SetInput( tensors );
+    nearestFilter->InPlaceOn();
     nearestFilter->Update();
     tensors = nearestFilter->GetOutput();
     }
@@ -171,14 +464,12 @@ int main(int argc, char* argv[])
   //  if(vm.count("mask"))
   if( mask != "" )
     {
-    typedef itk::ImageFileReader<LabelImageType> MaskFileReaderType;
-    MaskFileReaderType::Pointer maskreader = MaskFileReaderType::New();
-    //    maskreader->SetFileName(vm["mask"].as<std::string>());
-    maskreader->SetFileName(mask.c_str() );
+    // Masked in the buffer of the tensors that were read
     typedef itk::VectorMaskImageFilter<TensorImageType, LabelImageType, TensorImageType> MaskFilterType;
     MaskFilterType::Pointer _mask = MaskFilterType::New();
     _mask->SetInput1(tensors);
     _mask->SetInput2(maskreader->GetOutput() );
+    _mask->InPlaceOn();
 
     try
       {
@@ -191,182 +482,164 @@ int main(int argc, char* argv[])
       }
 
     tensors = _mask->GetOutput();
+    tensors->SetMetaDataDictionary(dict);
     // If the outmask option is specified, the masked tensor field is saved
     if( outmask != "" )
       {
-      if( !doubleDTI )
+      try
         {
-        CastDTIFilterType::Pointer castFilter = CastDTIFilterType::New() ;
-        castFilter->SetInput( tensors ) ;
-        TensorFileWriterType::Pointer dtiwriter = TensorFileWriterType::New();
-        dtiwriter->SetFileName(outmask.c_str());
-        dtiwriter->SetInput(castFilter->GetOutput());
-        dtiwriter->SetUseCompression(true);
-        try
+        if( !doubleDTI )
           {
-          dtiwriter->Update();
+          CastDTIFilterType::Pointer castFilter = CastDTIFilterType::New() ;
+          castFilter->SetInput( padToRegion<TensorImageType>(tensors, outputRegion) ) ;
+          TensorFloatImageType::Pointer tensorFloat = castFilter->GetOutput() ;
+          writeImage( outmask, tensorFloat ) ;
           }
-          catch (itk::ExceptionObject & e)
+        else
           {
-            std::cerr << e <<std::endl;
-            return EXIT_FAILURE;
+          writeImage( outmask, padToRegion<TensorImageType>(tensors, outputRegion) ) ;
           }
         }
-      else
+      catch (itk::ExceptionObject & e)
         {
-        typedef itk::ImageFileWriter<TensorImageType> FileWriterType;
-        FileWriterType::Pointer dtiwriter = FileWriterType::New();
-        dtiwriter->SetFileName(outmask.c_str());
-        dtiwriter->SetUseCompression(true);
-        dtiwriter->SetInput(tensors);
-        try
-          {
-          dtiwriter->Update();
-          }
-        catch (itk::ExceptionObject & e)
-          {
-          std::cerr << e <<std::endl;
-          return EXIT_FAILURE;
-          }
+        std::cerr << e <<std::endl;
+        return EXIT_FAILURE;
         }
       }
     }
 
-  // sigma set in PARSE_ARGS
-  // double sigma = vm["sigma"].as<double>();
-
-  // Compute FA image
-  //  if(vm.count("fa-output"))
-  if( faOutput != "" )
+  // The foreground of the sparse tensors is the mask, or the non-zero
+  // tensors
+  if( sparseOutput != "" )
     {
-    if( scale )
+    try
       {
-      writeImage(faOutput,
-                 createFA<unsigned short>(tensors) );
+      TensorImageType::Pointer       padded = padToRegion<TensorImageType>(tensors, outputRegion);
+      SparseTensorImageType::Pointer sparseTensors = SparseTensorImageType::New();
+      if( mask != "" )
+        {
+        sparseTensors->SetImage(padded, maskreader->GetOutput() );
+        }
+      else
+        {
+        sparseTensors->SetImage(padded);
+        }
+      sparseTensors->GetMetaDataDictionary() = dict;
+      if( VERBOSE )
+        {
+        std::cout << "Sparse tensors: " << sparseTensors->GetNumberOfForegroundPixels() << " of "
+                  << outputRegion.GetNumberOfPixels() << " voxels" << std::endl;
+        }
+      writeSparseTensors(sparseOutput, sparseTensors, !doubleDTI);
       }
-    else
+    catch( itk::ExceptionObject & e )
       {
-      writeImage(faOutput,
-                 createFA<double>(tensors) );
+      std::cerr << e << std::endl;
+      return EXIT_FAILURE;
       }
     }
 
-  //  if(vm.count("fa-gradient-output"))
-  if( faGradientOutput != "" )
-    {
-    writeImage(faGradientOutput,
-               createFAGradient(tensors, sigma) );
-    }
-
-  //  if(vm.count("fa-gradmag-output"))
-  if( faGradientMagOutput != "" )
-    {
-    writeImage(faGradientMagOutput,
-               createFAGradMag(tensors, sigma) );
-    }
-
-  if( colorFAOutput != "" )
-    {
-    writeImage(colorFAOutput,
-               createColorFA(tensors) );
-    }
-
-  if( principalEigenvectorOutput != "" )
-//     vm.count("closest-dotproduct-output"))
+  // Label statistics of the scalar maps, in the processed region
+  typedef itk::ImageFileReader<StatisticsLabelImageType> StatisticsLabelReaderType;
+  StatisticsLabelReaderType::Pointer labelreader = StatisticsLabelReaderType::New();
+  bool computeStatistics[itk::TensorScalarMaps::ColorFractionalAnisotropy] = { false };
+  if( statisticsOutput != "" )
     {
-    writeImage(principalEigenvectorOutput,
-               createPrincipalEigenvector(tensors) );
-    }
-
-  //  if(vm.count("md-output"))
-  if( mdOutput != "" )
-    {
-    if( scale )
+    if( labelMap == "" )
       {
-      writeImage(mdOutput,
-                 createMD<unsigned short>(tensors) );
+      std::cerr << "Statistics requested, but no label map specified" << std::endl;
+      return EXIT_FAILURE;
       }
-    else
+    for( std::vector<std::string>::const_iterator it = statisticsScalars.begin();
+         it != statisticsScalars.end(); ++it )
       {
-      writeImage(mdOutput,
-                 createMD<double>(tensors) );
-      }
-    }
-
-  if( lambda1Output != "" )
-    {
-    if( scale )
-      {
-      writeImage(lambda1Output,
-                 createLambda<unsigned short>(tensors, Lambda1) );
+      unsigned int map = 0;
+      while( map < itk::TensorScalarMaps::ColorFractionalAnisotropy &&
+             *it != itk::TensorScalarMaps::GetMapName(static_cast<itk::TensorScalarMaps::MapType>(map) ) )
+        {
+        ++map;
+        }
+      if( map == itk::TensorScalarMaps::ColorFractionalAnisotropy )
+        {
+        std::cerr << "Unknown statistics scalar " << *it << std::endl;
+        return EXIT_FAILURE;
+        }
+      computeStatistics[map] = true;
       }
-    else
+    labelreader->SetFileName(labelMap.c_str() );
+    try
       {
-      writeImage(lambda1Output,
-                 createLambda<double>(tensors, Lambda1) );
+      labelreader->Update();
       }
-    }
-
-  if( lambda2Output != "" )
-    {
-    if( scale )
+    catch( itk::ExceptionObject & e )
       {
-      writeImage(lambda2Output,
-                 createLambda<unsigned short>(tensors, Lambda2) );
+      std::cerr << e << std::endl;
+      return EXIT_FAILURE;
       }
-    else
+    if( !labelreader->GetOutput()->GetLargestPossibleRegion().IsInside(outputRegion) )
       {
-      writeImage(lambda2Output,
-                 createLambda<double>(tensors, Lambda2) );
+      std::cerr << "The label map does not cover the tensor image" << std::endl;
+      return EXIT_FAILURE;
       }
     }
 
-  if( lambda3Output != "" )
+  // sigma set in PARSE_ARGS
+  // double sigma = vm["sigma"].as<double>();
+
+  // FA, MD, the eigenvalues, RD, Frobenius norm, color FA and
+  // principal eigenvector are all computed in a single pass
+  std::string scalarMapOutputs[itk::TensorScalarMaps::NumberOfMaps];
+  scalarMapOutputs[itk::TensorScalarMaps::FractionalAnisotropy] = faOutput;
+  scalarMapOutputs[itk::TensorScalarMaps::MeanDiffusivity] = mdOutput;
+  scalarMapOutputs[itk::TensorScalarMaps::FrobeniusNorm] = frobeniusNormOutput;
+  scalarMapOutputs[itk::TensorScalarMaps::Lambda1] = lambda1Output;
+  scalarMapOutputs[itk::TensorScalarMaps::Lambda2] = lambda2Output;
+  scalarMapOutputs[itk::TensorScalarMaps::Lambda3] = lambda3Output;
+  scalarMapOutputs[itk::TensorScalarMaps::RadialDiffusivity] = RDOutput;
+  scalarMapOutputs[itk::TensorScalarMaps::ColorFractionalAnisotropy] = colorFAOutput;
+  scalarMapOutputs[itk::TensorScalarMaps::PrincipalEigenvector] = principalEigenvectorOutput;
+  // The maps of a sparse input are computed on its packed tensors, as
+  // long as they are the processed tensors
+  SparseTensorImageType * mapsSparse =
+    sparse && processRegion == imageRegion && correction == "none" && mask == "" ? sparse.GetPointer() : ITK_NULLPTR;
+  bool scalarMapsWritten = false;
+  try
     {
-    if( scale )
-      {
-      writeImage(lambda3Output,
-                 createLambda<unsigned short>(tensors, Lambda3) );
-      }
-    else
-      {
-      writeImage(lambda3Output,
-                 createLambda<double>(tensors, Lambda3) );
-      }
+    scalarMapsWritten = scale ?
+      writeScalarMaps<unsigned short>(tensors, outputRegion, scalarMapOutputs, statisticsOutput,
+                                      labelreader->GetOutput(), computeStatistics, percentiles, mapsSparse) :
+      writeScalarMaps<double>(tensors, outputRegion, scalarMapOutputs, statisticsOutput,
+                              labelreader->GetOutput(), computeStatistics, percentiles, mapsSparse);
+    }
+  catch( itk::ExceptionObject & e )
+    {
+    std::cerr << e << std::endl;
+    return EXIT_FAILURE;
+    }
+  if( !scalarMapsWritten )
+    {
+    std::cerr << "Could not write the statistics to " << statisticsOutput << std::endl;
+    return EXIT_FAILURE;
     }
 
-  if( RDOutput != "" )
+  //  if(vm.count("fa-gradient-output"))
+  if( faGradientOutput != "" )
     {
-    if( scale )
-      {
-      writeImage(RDOutput,
-                 createRD<unsigned short>(tensors) );
-      }
-    else
-      {
-      writeImage(RDOutput,
-                 createRD<double>(tensors) );
-      }
+    writeImage(faGradientOutput,
+               padToRegion<GradientImageType>(createFAGradient(tensors, sigma), outputRegion) );
     }
 
-  if( frobeniusNormOutput != "" )
+  //  if(vm.count("fa-gradmag-output"))
+  if( faGradientMagOutput != "" )
     {
-    if( scale )
-      {
-      writeImage(frobeniusNormOutput,
-                 createFro<unsigned short>(tensors) );
-      }
-    else
-      {
-      writeImage(frobeniusNormOutput,
-                 createFro<double>(tensors) );
-      }
+    writeImage(faGradientMagOutput,
+               padToRegion<RealImageType>(createFAGradMag(tensors, sigma), outputRegion) );
     }
 
   if( negativeEigenvectorOutput != "" )
     {
     writeImage(negativeEigenvectorOutput,
-               createNegativeEigenValueLabel(tensors) );
+               padToRegion<LabelImageType>(createNegativeEigenValueLabel(tensors), outputRegion) );
     }
 
   if( rotOutput != "" )
@@ -375,23 +648,24 @@ int main(int argc, char* argv[])
     //If the input affine file is a dof file from rview
     if(dofFile != "")
       {
-      tensorImage = createROT(tensors,dofFile,0) ;
+      tensorImage = createROT(tensors, imageRegion.GetSize(), dofFile, 0);
       }
     //If the input affine file is a new dof file (output of dof2mat)
     else if(newdof_file != "")
       {
-      tensorImage = createROT(tensors, newdof_file, 1);
+      tensorImage = createROT(tensors, imageRegion.GetSize(), newdof_file, 1);
       }
     //If the input affine file is an itk compatible file
     else if(affineitk_file != "")
       {
-      tensorImage = createROT(tensors, affineitk_file, 2);
+      tensorImage = createROT(tensors, imageRegion.GetSize(), affineitk_file, 2);
       }
     else
       {
       std::cerr << "Tensor rotation requested, but dof/newdof/affineitk file not specified" << std::endl;
       return EXIT_FAILURE;
       }
+    tensorImage = padToRegion<TensorImageType>(tensorImage, outputRegion);
     if( !doubleDTI )
       {
       CastDTIFilterType::Pointer castFilter = CastDTIFilterType::New() ;
@@ -421,6 +695,13 @@ int main(int argc, char* argv[])
       }
 
     forward = readDeformationField(forwardTransformation, dftype);
+
+    // The region only applies to fields on the grid of the tensors,
+    // other fields are warped everywhere
+    const bool sameGrid = forward->GetLargestPossibleRegion() == imageRegion
+      && forward->GetOrigin() == input->GetOrigin()
+      && forward->GetSpacing() == input->GetSpacing()
+      && forward->GetDirection() == input->GetDirection();
     TensorImageType::Pointer tensorImage ;
     tensorImage = createWarp(tensors,
                forward,
@@ -430,7 +711,12 @@ int main(int argc, char* argv[])
                //vm["interpolation"].as<InterpolationType>()));
                (interpolation == "linear" ? Linear :
                (interpolation == "nearestneightbor" ? NearestNeighbor :
-               Cubic)));
+               Cubic)),
+               sameGrid ? processRegion : forward->GetLargestPossibleRegion());
+    if( sameGrid )
+      {
+      tensorImage = padToRegion<TensorImageType>(tensorImage, outputRegion);
+      }
     if( !doubleDTI )
       {
       CastDTIFilterType::Pointer castFilter = CastDTIFilterType::New() ;
@@ -444,22 +730,57 @@ int main(int argc, char* argv[])
       writeImage( deformationOutput , tensorImage ) ;
       }
     }
-
-#if 0 //
-  if( vm.count("stats") )
+  if( chainOutput != "" )
     {
-    if( !vm.count("mask") )
+    if( transformChain.empty() )
       {
-      std::cerr << "WARNING: No mask specified.  Computing whole brain statistics" << std::endl;
+      std::cerr << "Transform chain output requested, but no transform chain specified" << std::endl;
+      return EXIT_FAILURE;
       }
-    if( VERBOSE )
+    TensorImageType::Pointer tensorImage ;
+    try
       {
-      std::cout << "Computing tensor stats" << std::endl;
+      // The affine transforms and the fields are composed at each voxel,
+      // so the tensors are only interpolated once
+      const TransformChain chain = readTransformChain(transformChain, imageRegion.GetSize(),
+                                                      tensors->GetSpacing(), tensors->GetOrigin() );
+      tensorImage = createChainWarp(tensors, chain,
+                                    (reorientation == "fs" ? FiniteStrain :
+                                     PreservationPrincipalDirection),
+                                    (interpolation == "linear" ? Linear :
+                                     (interpolation == "nearestneightbor" ? NearestNeighbor :
+                                      Cubic) ) );
       }
+    catch( itk::ExceptionObject & e )
+      {
+      std::cerr << e << std::endl;
+      return EXIT_FAILURE;
+      }
+    tensorImage = padToRegion<TensorImageType>(tensorImage, outputRegion);
+    if( !doubleDTI )
+      {
+      CastDTIFilterType::Pointer castFilter = CastDTIFilterType::New() ;
+      castFilter->SetInput( tensorImage ) ;
+      castFilter->Update() ;
+      TensorFloatImageType::Pointer tensorFloat = castFilter->GetOutput() ;
+      writeImage( chainOutput , tensorFloat ) ;
+      }
+    else
+      {
+      writeImage( chainOutput , tensorImage ) ;
+      }
+    }
 
-//    TensorRegionStatistics tstat = computeTensorStatistics(tensors);
-
+  // The outputs still queued are written before exiting
+  try
+    {
+    waitForImageWriters();
     }
-#endif
+  catch( itk::ExceptionObject & e )
+    {
+    std::cerr << e << std::endl;
+    return EXIT_FAILURE;
+    }
+
   return EXIT_SUCCESS;
 }
@@ -34,7 +34,7 @@
 #include <vnl/algo/vnl_svd.h>
 #include <vnl/vnl_inverse.h>
 
-#include "itkDeformationFieldJacobianFilter.h"
+#include "itkDeformationFieldJacobianFunction.h"
 #include "itkDiffusionTensor3DReconstructionLinearImageFilter.h"
 #include "itkRicianNoiseLevelDeterminer.h"
 #include "itkExtractVolumeFilter.h"
@@ -143,10 +143,10 @@ public:
   typedef RicianNoiseLevelDeterminer<ScalarImageType, RealType> RicianNoiseLevelDeterminerType;
   typedef ExtractVolumeFilter<VectorImageType, ScalarImageType> ExtractInputVolumeFilterType;
 
-  typedef DeformationFieldJacobianFilter<DeformationImageType, MyRealType> MyJacobianFilterType;
+  typedef DeformationFieldJacobianFunction<DeformationImageType, MyRealType> MyJacobianFunctionType;
 
-  typedef typename MyJacobianFilterType::OutputImageType MyJacobianImageType;
-  typedef typename MyJacobianImageType::PixelType        MyJacobianType;
+  typedef typename MyJacobianFunctionType::OutputType MyJacobianType;
+  typedef typename MyJacobianFunctionType::Cache      MyJacobianCacheType;
 
   typedef DiffusionTensor3DReconstructionLinearImageFilter<DWIPixelType, MyRealType>
     DiffusionEstimationFilterType;
@@ -316,7 +316,7 @@ private:
   typename FileReaderType::Pointer * dwireader;
   DeformationImageType::Pointer *deformation;
   typename DiffusionEstimationFilterType::GradientDirectionContainerType::Pointer * gradientContainers;
-  typename MyJacobianFilterType::Pointer * jacobian;
+  typename MyJacobianFunctionType::Pointer * jacobian;
 
   typename ScalarFileReaderType::Pointer maskReader;
 
@@ -413,19 +413,19 @@ DWIAtlasBuilder<MyRealType, DWIPixelType>
   m_sh_basis_mat_new.fill( 0 );
   sh::generateSHBasisMatrix<MyRealType>(m_NumTerms, m_numnewgvectors, newgvectorssph, m_sh_basis_mat_new);
 
-  // and compute the Jacobians
+  // and set up the Jacobians, which are computed from the
+  // deformation fields when needed
 
-  jacobian = new typename MyJacobianFilterType::Pointer[nrOfDatasets];
+  jacobian = new typename MyJacobianFunctionType::Pointer[nrOfDatasets];
 
   if( !m_JustDoResampling )
     {
     for( unsigned int iI = 0; iI < nrOfDatasets; iI++ )
       {
-      jacobian[iI] = MyJacobianFilterType::New();
-      // Compute Jacobian of transform
+      jacobian[iI] = MyJacobianFunctionType::New();
+      // Jacobian of transform
       jacobian[iI]->SetUseImageSpacingOn();
-      jacobian[iI]->SetInput(deformation[iI]);
-      jacobian[iI]->Update();
+      jacobian[iI]->SetInputImage(deformation[iI]);
       }
     }
 
@@ -1466,6 +1466,9 @@ DWIAtlasBuilder<MyRealType, DWIPixelType>
   MyJacobianType j;
   j.SetIdentity();
 
+  // The control points of neighboring voxels are mostly the same
+  std::vector<MyJacobianCacheType> jacobianCaches(nrOfDatasets);
+
   while( !noMoreElements )
     {
 
@@ -1584,7 +1587,7 @@ DWIAtlasBuilder<MyRealType, DWIPixelType>
             }
           else
             {
-            j = jacobian[iI]->GetOutput()->GetPixel(cpi);
+            j = jacobian[iI]->EvaluateAtIndex(cpi, jacobianCaches[iI]);
             rotatedGradientDirections = rotateGradients( gradientContainers[iI], j,
                                                          transformedInformation[iI].isBaseline, iNrOfBaselines );
             }
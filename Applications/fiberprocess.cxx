@@ -19,6 +19,7 @@ PURPOSE.  See the above copyright notices for more information.
 
 // ITK includes
 #include <itkDiffusionTensor3D.h>
+#include <itkDiffusionTensor3DEigenSolver.h>
 #include <itkImageFileReader.h>
 #include <itkImageFileWriter.h>
 #include <itkTensorLinearInterpolateImageFunction.h>
@@ -290,7 +291,7 @@ int main(int argc, char* argv[])
 
       typedef itk::DiffusionTensor3D<double>::EigenValuesArrayType EigenValuesType;
       EigenValuesType eigenvalues;
-      tensor.ComputeEigenValues(eigenvalues);
+      itk::DiffusionTensor3DEigenSolver<itk::DiffusionTensor3D<double> >::ComputeEigenValues(tensor, eigenvalues);
       
       newpoint.SetRadius(0.5);
       newpoint.SetTensorMatrix(sotensor);
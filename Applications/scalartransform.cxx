@@ -34,6 +34,8 @@
 
 #include "deformationfieldio.h"
 #include "dtitypes.h"
+#include "transformchain.h"
+#include "itkTransformChainResampleImageFilter.h"
 #include "scalartransformCLP.h"
 
 typedef itk::InterpolateImageFunction<IntImageType, double> InterpolatorType;
@@ -64,7 +66,7 @@ int main(int argc, char* argv[])
 {
   PARSE_ARGS;
   if( inputImage == "" || outputImage == "" ||
-      transformation == "" || deformation == "" )
+      (transformation == "" && deformation == "" && transformChain.empty() ) )
     {
     std::cerr << "The input, output, and transformation must be specified." << std::endl;
     return EXIT_FAILURE;
@@ -90,7 +92,32 @@ int main(int argc, char* argv[])
       Cubic) );
   IntImageType::Pointer     result = ITK_NULLPTR;
   InterpolatorType::Pointer interp = createInterpolater(interpType);
-  if( transformation != "" )
+  if( !transformChain.empty() )
+    {
+    // The image is interpolated once through all the transformations
+    IntImageType::Pointer image = reader->GetOutput();
+    try
+      {
+      const TransformChain chain = readTransformChain(transformChain,
+                                                      image->GetLargestPossibleRegion().GetSize(),
+                                                      image->GetSpacing(), image->GetOrigin() );
+
+      typedef itk::TransformChainResampleImageFilter<IntImageType, IntImageType> ChainResampleFilter;
+      ChainResampleFilter::Pointer chainresampler = ChainResampleFilter::New();
+      chainresampler->SetInterpolator(interp);
+      chainresampler->SetTransformChain(&chain);
+      chainresampler->SetDefaultPixelValue(0);
+      chainresampler->SetInput(image);
+      chainresampler->Update();
+      result = chainresampler->GetOutput();
+      }
+    catch( itk::ExceptionObject & e )
+      {
+      std::cerr << e << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  else if( transformation != "" )
     {
     typedef itk::TransformFileReader TransformReader;
     TransformReader::Pointer treader = TransformReader::New();
@@ -39,6 +39,7 @@ set( LIST_ITK_COMPONENTS
   ITKVTK
   ITKTransform
   ITKIOImageBase
+  ITKZLIB
   ITKIOTransformBase
   ITKIOTransformInsightLegacy
   ITKIOTransformMatlab
@@ -0,0 +1,140 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkAffineTensorResampleImageFilter_h
+#define __itkAffineTensorResampleImageFilter_h
+
+#include <itkImageToImageFilter.h>
+#include <itkVectorInterpolateImageFunction.h>
+#include <itkMatrixOffsetTransformBase.h>
+#include <itkMatrix.h>
+#include <vnl/vnl_matrix_fixed.h>
+#include <vnl/vnl_vector_fixed.h>
+#include "itkLogEuclideanTensorImageFilter.h"
+
+namespace itk
+{
+/** \class AffineTensorResampleImageFilter
+ * \brief Resamples a tensor image through an affine transform and
+ * rotates the tensors, in a single pass.
+ *
+ * The filter computes what createROT computed with
+ * TensorRotateImageFilter, LogEuclideanTensorImageFilter,
+ * VectorResampleImageFilter and ExpEuclideanTensorImageFilter.  The
+ * transform maps the output points to the input points, and is turned
+ * once into an affine map from the output indices to the continuous
+ * indices of the input: along a row of the output, the continuous index
+ * is advanced by a constant step, without calling the transform or
+ * converting points to indices.  The log-tensors are interpolated at the
+ * continuous index and the rotation is applied to the eigenvectors of
+ * the exponential, R D R^T.
+ *
+ * Only the log-tensors of the input are stored, for the interpolator,
+ * and released after the resampling.  The output is on the grid of the
+ * input.  Points outside of the input take the default pixel value.
+ *
+ * \ingroup Multithreaded TensorObjects
+ */
+template <typename TTensorImage>
+class ITK_EXPORT AffineTensorResampleImageFilter :
+  public ImageToImageFilter<TTensorImage, TTensorImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef AffineTensorResampleImageFilter                Self;
+  typedef ImageToImageFilter<TTensorImage, TTensorImage> Superclass;
+  typedef SmartPointer<Self>                             Pointer;
+  typedef SmartPointer<const Self>                       ConstPointer;
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TTensorImage::ImageDimension);
+
+  typedef TTensorImage                            TensorImageType;
+  typedef typename TensorImageType::PixelType     TensorPixelType;
+  typedef typename TensorPixelType::ValueType     TensorValueType;
+  typedef typename TensorImageType::RegionType    OutputImageRegionType;
+  typedef MatrixOffsetTransformBase<double, 3, 3> TransformType;
+  typedef Matrix<double, 3, 3>                    RotationType;
+
+  /** The log-tensors are interpolated */
+  typedef LogEuclideanTensorImageFilter<TensorValueType>             LogFilterType;
+  typedef typename LogFilterType::OutputImageType                    LogTensorImageType;
+  typedef VectorInterpolateImageFunction<LogTensorImageType, double> InterpolatorType;
+  typedef typename InterpolatorType::ContinuousIndexType             ContinuousIndexType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Runtime information support. */
+  itkTypeMacro(AffineTensorResampleImageFilter, ImageToImageFilter);
+
+  /** Transform mapping the output points to the input points (required) */
+  itkSetConstObjectMacro(Transform, TransformType);
+  itkGetConstObjectMacro(Transform, TransformType);
+
+  /** Interpolator of the log-tensors (required) */
+  itkSetObjectMacro(Interpolator, InterpolatorType);
+  itkGetObjectMacro(Interpolator, InterpolatorType);
+
+  /** Rotation of the tensors, identity by default */
+  itkSetMacro(Rotation, RotationType);
+  itkGetConstReferenceMacro(Rotation, RotationType);
+
+  /** Tensor of the output points mapped outside of the input */
+  itkSetMacro(DefaultPixelValue, TensorPixelType);
+  itkGetConstReferenceMacro(DefaultPixelValue, TensorPixelType);
+
+protected:
+  AffineTensorResampleImageFilter();
+  virtual ~AffineTensorResampleImageFilter()
+  {
+  }
+
+  void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
+
+  /** The transform can map the output to any point of the input */
+  virtual void GenerateInputRequestedRegion() ITK_OVERRIDE;
+
+  /** Computes the log-tensors and the map from the output indices to
+   * the continuous indices of the input */
+  virtual void BeforeThreadedGenerateData() ITK_OVERRIDE;
+
+  virtual void ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread,
+                                    ThreadIdType threadId) ITK_OVERRIDE;
+
+  /** Releases the log-tensors */
+  virtual void AfterThreadedGenerateData() ITK_OVERRIDE;
+
+private:
+  AffineTensorResampleImageFilter(const Self &); // purposely not implemented
+  void operator=(const Self &);                  // purposely not implemented
+
+  typename TransformType::ConstPointer m_Transform;
+  typename InterpolatorType::Pointer   m_Interpolator;
+  typename LogTensorImageType::Pointer m_LogTensors;
+  RotationType                         m_Rotation;
+  TensorPixelType                      m_DefaultPixelValue;
+
+  /** Continuous index of the input = m_IndexMatrix * output index + m_IndexOffset */
+  vnl_matrix_fixed<double, 3, 3> m_IndexMatrix;
+  vnl_vector_fixed<double, 3>    m_IndexOffset;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkAffineTensorResampleImageFilter.txx"
+#endif
+
+#endif
@@ -0,0 +1,200 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkAffineTensorResampleImageFilter_txx
+#define __itkAffineTensorResampleImageFilter_txx
+
+#include "itkAffineTensorResampleImageFilter.h"
+#include "itkExpEuclideanTensorImageFilter.h"
+#include "itkDiffusionTensor3DEigenSolver.h"
+#include <itkImageLinearIteratorWithIndex.h>
+#include <itkProgressReporter.h>
+#include <vnl/vnl_inverse.h>
+
+namespace itk
+{
+
+template <typename TTensorImage>
+AffineTensorResampleImageFilter<TTensorImage>
+::AffineTensorResampleImageFilter()
+{
+  m_Rotation.SetIdentity();
+  m_DefaultPixelValue.Fill(NumericTraits<TensorValueType>::Zero);
+  m_IndexMatrix.set_identity();
+  m_IndexOffset.fill(0.0);
+}
+
+template <typename TTensorImage>
+void
+AffineTensorResampleImageFilter<TTensorImage>
+::PrintSelf(std::ostream& os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  os << indent << "Transform:         " << m_Transform.GetPointer() << std::endl;
+  os << indent << "Interpolator:      " << m_Interpolator.GetPointer() << std::endl;
+  os << indent << "Rotation:          " << m_Rotation << std::endl;
+  os << indent << "DefaultPixelValue: " << m_DefaultPixelValue << std::endl;
+}
+
+template <typename TTensorImage>
+void
+AffineTensorResampleImageFilter<TTensorImage>
+::GenerateInputRequestedRegion()
+{
+  Superclass::GenerateInputRequestedRegion();
+
+  TensorImageType * input = const_cast<TensorImageType *>(this->GetInput() );
+  if( input )
+    {
+    input->SetRequestedRegionToLargestPossibleRegion();
+    }
+}
+
+template <typename TTensorImage>
+void
+AffineTensorResampleImageFilter<TTensorImage>
+::BeforeThreadedGenerateData()
+{
+  if( !m_Transform )
+    {
+    itkExceptionMacro(<< "Transform not set");
+    }
+  if( !m_Interpolator )
+    {
+    itkExceptionMacro(<< "Interpolator not set");
+    }
+
+  const TensorImageType * input = this->GetInput();
+
+  typename LogFilterType::Pointer logf = LogFilterType::New();
+  logf->SetInput(input);
+  logf->SetNumberOfThreads(this->GetNumberOfThreads() );
+  logf->Update();
+  m_LogTensors = logf->GetOutput();
+  m_LogTensors->DisconnectPipeline();
+  m_Interpolator->SetInputImage(m_LogTensors);
+
+  // Index to point of the grid, shared by the input and the output
+  vnl_matrix_fixed<double, 3, 3> indexToPoint;
+  vnl_vector_fixed<double, 3>    origin;
+  for( unsigned int r = 0; r < 3; ++r )
+    {
+    for( unsigned int c = 0; c < 3; ++c )
+      {
+      indexToPoint(r, c) = input->GetDirection()(r, c) * input->GetSpacing()[c];
+      }
+    origin[r] = input->GetOrigin()[r];
+    }
+  const vnl_matrix_fixed<double, 3, 3> pointToIndex = vnl_inverse(indexToPoint);
+
+  // The transform maps p to A p + offset
+  const vnl_matrix_fixed<double, 3, 3> A = m_Transform->GetMatrix().GetVnlMatrix();
+  vnl_vector_fixed<double, 3>          offset;
+  for( unsigned int r = 0; r < 3; ++r )
+    {
+    offset[r] = m_Transform->GetOffset()[r];
+    }
+
+  m_IndexMatrix = pointToIndex * A * indexToPoint;
+  m_IndexOffset = pointToIndex * (A * origin + offset - origin);
+}
+
+template <typename TTensorImage>
+void
+AffineTensorResampleImageFilter<TTensorImage>
+::AfterThreadedGenerateData()
+{
+  m_Interpolator->SetInputImage(ITK_NULLPTR);
+  m_LogTensors = ITK_NULLPTR;
+}
+
+template <typename TTensorImage>
+void
+AffineTensorResampleImageFilter<TTensorImage>
+::ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread, ThreadIdType threadId)
+{
+  typedef typename InterpolatorType::OutputType                    LogTensorType;
+  typedef Functor::ExpEuclideanTensorFunction<LogTensorType>       ExpFunctorType;
+  typedef typename ExpFunctorType::EigenValueType                  EigenValueType;
+  typedef typename ExpFunctorType::EigenVectorType                 EigenVectorType;
+  typedef typename ExpFunctorType::OutputType                      ExpTensorType;
+  typedef DiffusionTensor3DEigenSolver<DiffusionTensor3D<double> > EigenSolverType;
+
+  TensorImageType * output = this->GetOutput();
+
+  // The rows of the eigenvector matrix are the eigenvectors: rotating
+  // them by R rotates the exponential to R D R^T
+  RotationType rotationTranspose;
+  for( unsigned int r = 0; r < 3; ++r )
+    {
+    for( unsigned int c = 0; c < 3; ++c )
+      {
+      rotationTranspose(r, c) = m_Rotation(c, r);
+      }
+    }
+
+  // Step of the continuous index along a row
+  const vnl_vector_fixed<double, 3> step = m_IndexMatrix.get_column(0);
+
+  ProgressReporter progress(this, threadId, outputRegionForThread.GetNumberOfPixels() );
+
+  ImageLinearIteratorWithIndex<TensorImageType> it(output, outputRegionForThread);
+  it.SetDirection(0);
+  for( it.GoToBegin(); !it.IsAtEnd(); it.NextLine() )
+    {
+    const typename TensorImageType::IndexType & start = it.GetIndex();
+    vnl_vector_fixed<double, 3>                 index;
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      index[d] = static_cast<double>(start[d]);
+      }
+    vnl_vector_fixed<double, 3> position = m_IndexMatrix * index + m_IndexOffset;
+
+    for( ; !it.IsAtEndOfLine(); ++it, position += step )
+      {
+      ContinuousIndexType cindex;
+      for( unsigned int d = 0; d < 3; ++d )
+        {
+        cindex[d] = position[d];
+        }
+      if( !m_Interpolator->IsInsideBuffer(cindex) )
+        {
+        it.Set(m_DefaultPixelValue);
+        }
+      else
+        {
+        const LogTensorType logtensor = m_Interpolator->EvaluateAtContinuousIndex(cindex);
+
+        EigenValueType  D;
+        EigenVectorType U;
+        EigenSolverType::ComputeEigenAnalysis(ExpFunctorType::ToTensor(logtensor), D, U);
+        const ExpTensorType tensor = ExpFunctorType::Compose(D, U * rotationTranspose);
+
+        TensorPixelType resampled;
+        for( unsigned int c = 0; c < 6; ++c )
+          {
+          resampled[c] = static_cast<TensorValueType>(tensor[c]);
+          }
+        it.Set(resampled);
+        }
+      progress.CompletedPixel();
+      }
+    }
+}
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,147 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkDeformationFieldJacobianFunction_h
+#define __itkDeformationFieldJacobianFunction_h
+
+#include <itkImageFunction.h>
+#include <itkMatrix.h>
+
+namespace itk
+{
+/** \class DeformationFieldJacobianFunction
+ * \brief Computes the jacobian of a deformation field at an index or a
+ * continuous index, from the displacements of the neighbors.
+ *
+ * The jacobian at an index is the one DeformationFieldJacobianFilter
+ * computes there: central differences, with zero flux boundaries at
+ * the edges of the buffer, scaled by the inverse of the spacing when
+ * UseImageSpacing is on.  The jacobian at a continuous index is the
+ * linear interpolation of the jacobians at the surrounding indices.
+ * Nothing is stored for the whole field, so the function replaces the
+ * jacobian images where the jacobians are only needed once or at a few
+ * locations.
+ *
+ * The Cache overloads keep the jacobians of the last indices evaluated.
+ * They are meant for loops evaluating the same indices several times,
+ * like the corners of nearby continuous indices.  A cache belongs to
+ * one thread and one field.
+ *
+ * \ingroup ImageFunctions
+ */
+template <typename TInputImage, typename TRealType = double, typename TCoordRep = double>
+class ITK_EXPORT DeformationFieldJacobianFunction :
+  public ImageFunction<TInputImage,
+                       Matrix<TRealType, TInputImage::ImageDimension, TInputImage::ImageDimension>,
+                       TCoordRep>
+{
+public:
+  /** Standard class typedefs. */
+  typedef DeformationFieldJacobianFunction Self;
+  typedef ImageFunction<TInputImage,
+                        Matrix<TRealType, TInputImage::ImageDimension, TInputImage::ImageDimension>,
+                        TCoordRep>         Superclass;
+  typedef SmartPointer<Self>               Pointer;
+  typedef SmartPointer<const Self>         ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(DeformationFieldJacobianFunction, ImageFunction);
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TInputImage::ImageDimension);
+
+  typedef typename Superclass::InputImageType      InputImageType;
+  typedef typename InputImageType::PixelType       InputPixelType;
+  typedef typename Superclass::OutputType          OutputType;
+  typedef typename Superclass::IndexType           IndexType;
+  typedef typename Superclass::ContinuousIndexType ContinuousIndexType;
+  typedef typename Superclass::PointType           PointType;
+  typedef TRealType                                RealType;
+
+  /** Jacobians of the last indices evaluated */
+  struct Cache
+    {
+    itkStaticConstMacro(Size, unsigned int, 64);
+
+    Cache()
+    {
+      for( unsigned int i = 0; i < Size; ++i )
+        {
+        valid[i] = false;
+        }
+    }
+
+    IndexType  indices[Size];
+    OutputType jacobians[Size];
+    bool       valid[Size];
+    };
+
+  /** Scale the derivatives by the inverse of the spacing (off by
+   * default, like DeformationFieldJacobianFilter) */
+  itkSetMacro(UseImageSpacing, bool);
+  itkGetConstMacro(UseImageSpacing, bool);
+  itkBooleanMacro(UseImageSpacing);
+
+  /** Jacobian at the point */
+  virtual OutputType Evaluate(const PointType & point) const ITK_OVERRIDE
+  {
+    ContinuousIndexType index;
+
+    this->GetInputImage()->TransformPhysicalPointToContinuousIndex(point, index);
+    return this->EvaluateAtContinuousIndex(index);
+  }
+
+  /** Jacobian at the index */
+  virtual OutputType EvaluateAtIndex(const IndexType & index) const ITK_OVERRIDE;
+
+  OutputType EvaluateAtIndex(const IndexType & index, Cache & cache) const;
+
+  /** Linear interpolation of the jacobians at the surrounding indices */
+  virtual OutputType EvaluateAtContinuousIndex(const ContinuousIndexType & index) const ITK_OVERRIDE
+  {
+    return this->InterpolateJacobians(index, ITK_NULLPTR);
+  }
+
+  OutputType EvaluateAtContinuousIndex(const ContinuousIndexType & index, Cache & cache) const
+  {
+    return this->InterpolateJacobians(index, &cache);
+  }
+
+protected:
+  DeformationFieldJacobianFunction();
+  ~DeformationFieldJacobianFunction()
+  {
+  }
+
+  void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
+
+  OutputType InterpolateJacobians(const ContinuousIndexType & index, Cache * cache) const;
+
+private:
+  DeformationFieldJacobianFunction(const Self &); // purposely not implemented
+  void operator=(const Self &);                   // purposely not implemented
+
+  bool m_UseImageSpacing;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkDeformationFieldJacobianFunction.txx"
+#endif
+
+#endif
@@ -0,0 +1,147 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkDeformationFieldJacobianFunction_txx
+#define __itkDeformationFieldJacobianFunction_txx
+
+#include "itkDeformationFieldJacobianFunction.h"
+#include <algorithm>
+#include <cmath>
+
+namespace itk
+{
+
+template <typename TInputImage, typename TRealType, typename TCoordRep>
+DeformationFieldJacobianFunction<TInputImage, TRealType, TCoordRep>
+::DeformationFieldJacobianFunction()
+{
+  m_UseImageSpacing = false;
+}
+
+template <typename TInputImage, typename TRealType, typename TCoordRep>
+void
+DeformationFieldJacobianFunction<TInputImage, TRealType, TCoordRep>
+::PrintSelf(std::ostream& os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "UseImageSpacing: " << m_UseImageSpacing << std::endl;
+}
+
+template <typename TInputImage, typename TRealType, typename TCoordRep>
+typename DeformationFieldJacobianFunction<TInputImage, TRealType, TCoordRep>::OutputType
+DeformationFieldJacobianFunction<TInputImage, TRealType, TCoordRep>
+::EvaluateAtIndex(const IndexType & index) const
+{
+  const InputImageType *                       field = this->GetInputImage();
+  const typename InputImageType::RegionType &  buffered = field->GetBufferedRegion();
+  const typename InputImageType::SpacingType & spacing = field->GetSpacing();
+
+  OutputType J;
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+    {
+    // Zero flux boundaries: the neighbors are clamped to the buffer
+    IndexType            next = index;
+    IndexType            previous = index;
+    const IndexValueType last = buffered.GetIndex(i) + static_cast<IndexValueType>(buffered.GetSize(i) ) - 1;
+    next[i] = std::min(index[i] + 1, last);
+    previous[i] = std::max(index[i] - 1, buffered.GetIndex(i) );
+
+    const InputPixelType & n = field->GetPixel(next);
+    const InputPixelType & p = field->GetPixel(previous);
+    const RealType         weight = m_UseImageSpacing ? 1.0 / spacing[i] : 1.0;
+    for( unsigned int j = 0; j < ImageDimension; ++j )
+      {
+      J(j, i) = weight * 0.5 * (n[j] - p[j]);
+      }
+    }
+  return J;
+}
+
+template <typename TInputImage, typename TRealType, typename TCoordRep>
+typename DeformationFieldJacobianFunction<TInputImage, TRealType, TCoordRep>::OutputType
+DeformationFieldJacobianFunction<TInputImage, TRealType, TCoordRep>
+::EvaluateAtIndex(const IndexType & index, Cache & cache) const
+{
+  SizeValueType hash = 0;
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+    {
+    hash = hash * 31 + static_cast<SizeValueType>(index[i]);
+    }
+  const unsigned int slot = static_cast<unsigned int>(hash % Cache::Size);
+  if( !cache.valid[slot] || cache.indices[slot] != index )
+    {
+    cache.indices[slot] = index;
+    cache.jacobians[slot] = this->EvaluateAtIndex(index);
+    cache.valid[slot] = true;
+    }
+  return cache.jacobians[slot];
+}
+
+template <typename TInputImage, typename TRealType, typename TCoordRep>
+typename DeformationFieldJacobianFunction<TInputImage, TRealType, TCoordRep>::OutputType
+DeformationFieldJacobianFunction<TInputImage, TRealType, TCoordRep>
+::InterpolateJacobians(const ContinuousIndexType & index, Cache * cache) const
+{
+  const typename InputImageType::RegionType & buffered = this->GetInputImage()->GetBufferedRegion();
+
+  IndexType      base;
+  IndexValueType last[ImageDimension];
+  double         distance[ImageDimension];
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+    {
+    base[i] = static_cast<IndexValueType>(std::floor(index[i]) );
+    distance[i] = index[i] - static_cast<double>(base[i]);
+    last[i] = buffered.GetIndex(i) + static_cast<IndexValueType>(buffered.GetSize(i) ) - 1;
+    }
+
+  OutputType J;
+  J.Fill(0.0);
+  for( unsigned int corner = 0; corner < (1u << ImageDimension); ++corner )
+    {
+    IndexType neighbor = base;
+    double    weight = 1.0;
+    for( unsigned int i = 0; i < ImageDimension; ++i )
+      {
+      if( corner & (1u << i) )
+        {
+        ++neighbor[i];
+        weight *= distance[i];
+        }
+      else
+        {
+        weight *= 1.0 - distance[i];
+        }
+      // The indices outside of the buffer take the jacobian of the edge
+      neighbor[i] = std::max(std::min(neighbor[i], last[i]), buffered.GetIndex(i) );
+      }
+    if( weight == 0.0 )
+      {
+      continue;
+      }
+    const OutputType jacobian = cache ? this->EvaluateAtIndex(neighbor, *cache) : this->EvaluateAtIndex(neighbor);
+    for( unsigned int r = 0; r < ImageDimension; ++r )
+      {
+      for( unsigned int c = 0; c < ImageDimension; ++c )
+        {
+        J(r, c) += weight * jacobian(r, c);
+        }
+      }
+    }
+  return J;
+}
+
+} // end namespace itk
+
+#endif
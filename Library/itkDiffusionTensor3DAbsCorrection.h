@@ -18,6 +18,7 @@
 #include "vnl/vnl_math.h"
 #include <itkMatrix.h>
 #include "itkDiffusionTensor3DExtended.h"
+#include "itkDiffusionTensor3DEigenSolver.h"
 
 namespace itk
 {
@@ -76,7 +77,7 @@ public:
     typename DiffusionTensor3DExtended<double>::EigenVectorsMatrixType eigenVectors;
     DiffusionTensor3DExtended<double> tensorDouble;
     tensorDouble = ( DiffusionTensor3DExtended<TInput> )A;
-    tensorDouble.ComputeEigenAnalysis( eigenValues, eigenVectors );
+    DiffusionTensor3DEigenSolver<DiffusionTensor3D<double> >::ComputeEigenAnalysis( tensorDouble, eigenValues, eigenVectors );
     for( int i = 0; i < 3; i++ )
       {
       mat[i][i] = ( eigenValues[i] < 0 ? -eigenValues[i] : eigenValues[i] );
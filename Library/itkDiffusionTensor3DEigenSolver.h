@@ -0,0 +1,132 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkDiffusionTensor3DEigenSolver_h_
+#define __itkDiffusionTensor3DEigenSolver_h_
+
+#include "itkDiffusionTensor3D.h"
+#include "itkIntTypes.h"
+
+namespace itk
+{
+/** \class DiffusionTensor3DEigenSolver
+ * \brief Closed-form eigen-analysis of diffusion tensors.
+ *
+ * Drop-in replacement of DiffusionTensor3D::ComputeEigenValues() and
+ * DiffusionTensor3D::ComputeEigenAnalysis(): the eigenvalues are in
+ * ascending order and the rows of the eigenvector matrix are the
+ * eigenvectors, computed in the real type of the tensor.
+ *
+ * The eigenvalues are the roots of the characteristic polynomial,
+ * obtained with the trigonometric form of Cardano's formula after the
+ * tensor has been scaled by its largest component.  The eigenvectors of
+ * the smallest and largest eigenvalues are cross products of two rows of
+ * T - lambda I, and the middle one is their cross product.  Diagonal
+ * tensors are solved exactly.  When two eigenvalues are closer than
+ * DegeneracyTolerance times their spread, the closed form loses accuracy
+ * on the pair: the eigenvector of the third, simple, eigenvalue is
+ * computed as above, and the restriction of the tensor to the plane
+ * orthogonal to it, a 2x2 symmetric matrix, is diagonalized by a single
+ * rotation.  No eigen-analysis is iterative.  The sign of the
+ * eigenvectors is arbitrary, as with the iterative solver of
+ * DiffusionTensor3D.
+ *
+ * The batch methods solve a contiguous array of tensors LaneCount at a
+ * time: the eigenvalues of a group of tensors are computed in
+ * branch-free loops over the lanes, which the compiler can vectorize,
+ * and only the lanes which need the fallback are solved one by one.
+ *
+ * TTensor is a DiffusionTensor3D.
+ */
+template <class TTensor>
+class DiffusionTensor3DEigenSolver
+{
+public:
+  typedef TTensor                                     TensorType;
+  typedef typename TensorType::RealValueType          RealType;
+  typedef typename TensorType::EigenValuesArrayType   EigenValuesArrayType;
+  typedef typename TensorType::EigenVectorsMatrixType EigenVectorsMatrixType;
+
+  /** Number of tensors solved together by the batch methods */
+  itkStaticConstMacro(LaneCount, unsigned int, 4);
+
+  static void ComputeEigenValues(const TensorType & tensor, EigenValuesArrayType & eigenValues);
+
+  static void ComputeEigenAnalysis(const TensorType & tensor, EigenValuesArrayType & eigenValues,
+                                   EigenVectorsMatrixType & eigenVectors);
+
+  /** Eigenvalues of \a count tensors */
+  static void ComputeEigenValues(const TensorType * tensors, SizeValueType count,
+                                 EigenValuesArrayType * eigenValues);
+
+  /** Eigenvalues and eigenvectors of \a count tensors */
+  static void ComputeEigenAnalysis(const TensorType * tensors, SizeValueType count,
+                                   EigenValuesArrayType * eigenValues,
+                                   EigenVectorsMatrixType * eigenVectors);
+
+  /** Components of the \a count tensors sum_k values[k] v_k v_k^T,
+   * v_k being the rows of the eigenvector matrices.  Component c (xx,
+   * xy, xz, yy, yz, zz) of tensor i is written in components[c][i]:
+   * the tensors are composed in structure-of-arrays order, in loops
+   * over the tensors which the compiler can vectorize.  The log and exp
+   * of tensors are composed from their transformed eigenvalues. */
+  static void ComposeTensors(const EigenValuesArrayType * eigenValues,
+                             const EigenVectorsMatrixType * eigenVectors,
+                             SizeValueType count, RealType * const components[6]);
+
+  /** Relative distance between two eigenvalues under which the tensor
+   * is solved in the plane orthogonal to its simple eigenvector. */
+  static RealType GetDegeneracyTolerance()
+  {
+    return 1.0e-4;
+  }
+
+private:
+  /** Eigenvalues of the lanes of a group, in units of the largest
+   * component of each tensor (scale).  solved is false for the lanes
+   * which are diagonal or near-degenerate. */
+  static void SolveLanes(const TensorType * tensors, unsigned int count,
+                         RealType scaled[6][LaneCount], RealType scale[LaneCount],
+                         RealType values[3][LaneCount], bool solved[LaneCount]);
+
+  /** Eigenvalues and eigenvectors of a diagonal tensor */
+  static void SolveDiagonal(const TensorType & tensor, EigenValuesArrayType & eigenValues,
+                            EigenVectorsMatrixType * eigenVectors);
+
+  /** Unit eigenvector of the scaled tensor for the simple eigenvalue
+   * lambda.  Returns false if T - lambda I has no two independent
+   * rows. */
+  static bool ComputeEigenVector(const RealType scaled[6], RealType lambda, RealType vector[3]);
+
+  /** Root of lane l which is the farthest from the two others */
+  static RealType SimpleEigenValue(const RealType values[3][LaneCount], unsigned int l)
+  {
+    return values[1][l] - values[0][l] < values[2][l] - values[1][l] ? values[2][l] : values[0][l];
+  }
+
+  /** Eigenvalues and eigenvectors of a scaled tensor with a double
+   * eigenvalue, or close to it.  simple is the eigenvalue which is not
+   * part of the pair.  The eigenvalues are multiplied by scale. */
+  static void SolveDegenerate(const RealType scaled[6], RealType simple, RealType scale,
+                              EigenValuesArrayType & eigenValues, EigenVectorsMatrixType * eigenVectors);
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkDiffusionTensor3DEigenSolver.txx"
+#endif
+
+#endif
@@ -0,0 +1,454 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkDiffusionTensor3DEigenSolver_txx_
+#define __itkDiffusionTensor3DEigenSolver_txx_
+
+#include "itkDiffusionTensor3DEigenSolver.h"
+#include "vnl/vnl_math.h"
+#include <algorithm>
+#include <cmath>
+
+namespace itk
+{
+
+template <class TTensor>
+void
+DiffusionTensor3DEigenSolver<TTensor>
+::SolveLanes(const TensorType * tensors, unsigned int count,
+             RealType scaled[6][LaneCount], RealType scale[LaneCount],
+             RealType values[3][LaneCount], bool solved[LaneCount])
+{
+  // Tensor components xx, xy, xz, yy, yz, zz; the missing lanes of the
+  // last group are zero tensors
+  for( unsigned int c = 0; c < 6; ++c )
+    {
+    for( unsigned int l = 0; l < LaneCount; ++l )
+      {
+      scaled[c][l] = l < count ? static_cast<RealType>(tensors[l][c]) : 0;
+      }
+    }
+
+  RealType p[LaneCount];
+  RealType phi[LaneCount];
+  RealType mean[LaneCount];
+  for( unsigned int l = 0; l < LaneCount; ++l )
+    {
+    RealType s = 0;
+    for( unsigned int c = 0; c < 6; ++c )
+      {
+      const RealType a = std::fabs(scaled[c][l]);
+      s = a > s ? a : s;
+      }
+    scale[l] = s;
+    const RealType inverse = s > 0 ? 1 / s : 0;
+    for( unsigned int c = 0; c < 6; ++c )
+      {
+      scaled[c][l] *= inverse;
+      }
+
+    // Shifted tensor K = T - mean I, p^2 = trace(K^2) / 6 and
+    // r = det(K) / (2 p^3)
+    const RealType m = ( scaled[0][l] + scaled[3][l] + scaled[5][l] ) / 3;
+    const RealType k0 = scaled[0][l] - m;
+    const RealType k3 = scaled[3][l] - m;
+    const RealType k5 = scaled[5][l] - m;
+    const RealType b1 = scaled[1][l];
+    const RealType b2 = scaled[2][l];
+    const RealType b4 = scaled[4][l];
+    const RealType offDiagonal = b1 * b1 + b2 * b2 + b4 * b4;
+    const RealType p2 = ( k0 * k0 + k3 * k3 + k5 * k5 + 2 * offDiagonal ) / 6;
+    const RealType determinant = k0 * ( k3 * k5 - b4 * b4 ) - b1 * ( b1 * k5 - b4 * b2 ) + b2 * ( b1 * b4 - k3 * b2 );
+    p[l] = std::sqrt(p2);
+    RealType r = p2 > 0 ? determinant / ( 2 * p2 * p[l] ) : 0;
+    r = r < -1 ? -1 : ( r > 1 ? 1 : r );
+    mean[l] = m;
+    phi[l] = std::acos(r) / 3;
+    solved[l] = offDiagonal > 0;
+    }
+
+  const RealType twoThirdsPi = 2 * vnl_math::pi / 3;
+  const RealType tolerance = GetDegeneracyTolerance();
+  for( unsigned int l = 0; l < LaneCount; ++l )
+    {
+    // phi is in [0, pi/3]: the first root is the largest and the second
+    // the smallest
+    const RealType largest = mean[l] + 2 * p[l] * std::cos(phi[l]);
+    const RealType smallest = mean[l] + 2 * p[l] * std::cos(phi[l] + twoThirdsPi);
+    const RealType middle = 3 * mean[l] - largest - smallest;
+    values[0][l] = smallest;
+    values[1][l] = middle;
+    values[2][l] = largest;
+    const RealType gap = std::min(middle - smallest, largest - middle);
+    solved[l] = solved[l] && gap > tolerance * p[l];
+    }
+}
+
+template <class TTensor>
+void
+DiffusionTensor3DEigenSolver<TTensor>
+::SolveDiagonal(const TensorType & tensor, EigenValuesArrayType & eigenValues,
+                EigenVectorsMatrixType * eigenVectors)
+{
+  const RealType diagonal[3] = { tensor[0], tensor[3], tensor[5] };
+  unsigned int   order[3] = { 0, 1, 2 };
+  // Stable sort of the three diagonal elements
+  for( unsigned int i = 1; i < 3; ++i )
+    {
+    for( unsigned int j = i; j > 0 && diagonal[order[j]] < diagonal[order[j - 1]]; --j )
+      {
+      std::swap(order[j], order[j - 1]);
+      }
+    }
+  for( unsigned int i = 0; i < 3; ++i )
+    {
+    eigenValues[i] = diagonal[order[i]];
+    }
+  if( eigenVectors )
+    {
+    eigenVectors->Fill(0);
+    for( unsigned int i = 0; i < 3; ++i )
+      {
+      ( *eigenVectors )(i, order[i]) = 1;
+      }
+    }
+}
+
+template <class TTensor>
+bool
+DiffusionTensor3DEigenSolver<TTensor>
+::ComputeEigenVector(const RealType scaled[6], RealType lambda, RealType vector[3])
+{
+  // Rows of T - lambda I
+  const RealType rows[3][3] = {
+      { scaled[0] - lambda, scaled[1], scaled[2] },
+      { scaled[1], scaled[3] - lambda, scaled[4] },
+      { scaled[2], scaled[4], scaled[5] - lambda }
+    };
+  // The eigenvector is orthogonal to all the rows: take the largest of
+  // their cross products
+  RealType best = 0;
+  for( unsigned int i = 0; i < 2; ++i )
+    {
+    for( unsigned int j = i + 1; j < 3; ++j )
+      {
+      const RealType c[3] = {
+        rows[i][1] * rows[j][2] - rows[i][2] * rows[j][1],
+        rows[i][2] * rows[j][0] - rows[i][0] * rows[j][2],
+        rows[i][0] * rows[j][1] - rows[i][1] * rows[j][0]
+      };
+      const RealType norm2 = c[0] * c[0] + c[1] * c[1] + c[2] * c[2];
+      if( norm2 > best )
+        {
+        best = norm2;
+        std::copy(c, c + 3, vector);
+        }
+      }
+    }
+  if( !( best > 0 ) || !vnl_math_isfinite(best) )
+    {
+    return false;
+    }
+  const RealType inverse = 1 / std::sqrt(best);
+  for( unsigned int i = 0; i < 3; ++i )
+    {
+    vector[i] *= inverse;
+    }
+  return true;
+}
+
+template <class TTensor>
+void
+DiffusionTensor3DEigenSolver<TTensor>
+::SolveDegenerate(const RealType scaled[6], RealType simple, RealType scale,
+                  EigenValuesArrayType & eigenValues, EigenVectorsMatrixType * eigenVectors)
+{
+  // The simple eigenvalue is well separated from the pair: its root and
+  // its eigenvector are accurate.  If T - simple I has rank one, its
+  // largest row is the eigenvector; if it is null, the tensor is
+  // isotropic and any axis is.
+  RealType u[3] = { 1, 0, 0 };
+  if( !ComputeEigenVector(scaled, simple, u) )
+    {
+    const RealType rows[3][3] = {
+        { scaled[0] - simple, scaled[1], scaled[2] },
+        { scaled[1], scaled[3] - simple, scaled[4] },
+        { scaled[2], scaled[4], scaled[5] - simple }
+      };
+    RealType best = 0;
+    for( unsigned int i = 0; i < 3; ++i )
+      {
+      const RealType norm2 = rows[i][0] * rows[i][0] + rows[i][1] * rows[i][1] + rows[i][2] * rows[i][2];
+      if( norm2 > best && vnl_math_isfinite(norm2) )
+        {
+        best = norm2;
+        const RealType inverse = 1 / std::sqrt(norm2);
+        for( unsigned int j = 0; j < 3; ++j )
+          {
+          u[j] = rows[i][j] * inverse;
+          }
+        }
+      }
+    }
+
+  // Orthonormal basis (a, b) of the plane orthogonal to u: a is the
+  // cross product of u with the axis it is the least aligned with
+  unsigned int axis = 0;
+  for( unsigned int i = 1; i < 3; ++i )
+    {
+    if( std::fabs(u[i]) < std::fabs(u[axis]) )
+      {
+      axis = i;
+      }
+    }
+  RealType e[3] = { 0, 0, 0 };
+  e[axis] = 1;
+  RealType a[3] = { u[1] * e[2] - u[2] * e[1], u[2] * e[0] - u[0] * e[2], u[0] * e[1] - u[1] * e[0] };
+  const RealType inverse = 1 / std::sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+  for( unsigned int i = 0; i < 3; ++i )
+    {
+    a[i] *= inverse;
+    }
+  const RealType b[3] = { u[1] * a[2] - u[2] * a[1], u[2] * a[0] - u[0] * a[2], u[0] * a[1] - u[1] * a[0] };
+
+  // T a, T b and the restriction of T to the plane
+  const RealType Ta[3] = {
+    scaled[0] * a[0] + scaled[1] * a[1] + scaled[2] * a[2],
+    scaled[1] * a[0] + scaled[3] * a[1] + scaled[4] * a[2],
+    scaled[2] * a[0] + scaled[4] * a[1] + scaled[5] * a[2]
+  };
+  const RealType Tb[3] = {
+    scaled[0] * b[0] + scaled[1] * b[1] + scaled[2] * b[2],
+    scaled[1] * b[0] + scaled[3] * b[1] + scaled[4] * b[2],
+    scaled[2] * b[0] + scaled[4] * b[1] + scaled[5] * b[2]
+  };
+  const RealType Tu[3] = {
+    scaled[0] * u[0] + scaled[1] * u[1] + scaled[2] * u[2],
+    scaled[1] * u[0] + scaled[3] * u[1] + scaled[4] * u[2],
+    scaled[2] * u[0] + scaled[4] * u[1] + scaled[5] * u[2]
+  };
+  const RealType aa = a[0] * Ta[0] + a[1] * Ta[1] + a[2] * Ta[2];
+  const RealType ab = a[0] * Tb[0] + a[1] * Tb[1] + a[2] * Tb[2];
+  const RealType bb = b[0] * Tb[0] + b[1] * Tb[1] + b[2] * Tb[2];
+  const RealType uu = u[0] * Tu[0] + u[1] * Tu[1] + u[2] * Tu[2];
+
+  // The rotation by theta, tan(2 theta) = 2 ab / (aa - bb), diagonalizes
+  // the 2x2 matrix: (c, s) has the eigenvalue center + radius and
+  // (-s, c) the eigenvalue center - radius
+  const RealType center = ( aa + bb ) / 2;
+  const RealType half = ( aa - bb ) / 2;
+  const RealType radius = std::sqrt(half * half + ab * ab);
+  const RealType theta = std::atan2(ab, half) / 2;
+  const RealType c = std::cos(theta);
+  const RealType s = std::sin(theta);
+
+  RealType values[3] = { center - radius, center + radius, uu };
+  RealType vectors[3][3];
+  for( unsigned int i = 0; i < 3; ++i )
+    {
+    vectors[0][i] = c * b[i] - s * a[i];
+    vectors[1][i] = c * a[i] + s * b[i];
+    vectors[2][i] = u[i];
+    }
+  // Insert the simple eigenvalue in the ascending order
+  for( unsigned int j = 2; j > 0 && values[j] < values[j - 1]; --j )
+    {
+    std::swap(values[j], values[j - 1]);
+    for( unsigned int i = 0; i < 3; ++i )
+      {
+      std::swap(vectors[j][i], vectors[j - 1][i]);
+      }
+    }
+  for( unsigned int k = 0; k < 3; ++k )
+    {
+    eigenValues[k] = values[k] * scale;
+    if( eigenVectors )
+      {
+      for( unsigned int i = 0; i < 3; ++i )
+        {
+        ( *eigenVectors )(k, i) = vectors[k][i];
+        }
+      }
+    }
+}
+
+template <class TTensor>
+void
+DiffusionTensor3DEigenSolver<TTensor>
+::ComputeEigenValues(const TensorType * tensors, SizeValueType count,
+                     EigenValuesArrayType * eigenValues)
+{
+  RealType scaled[6][LaneCount];
+  RealType scale[LaneCount];
+  RealType values[3][LaneCount];
+  bool     solved[LaneCount];
+  for( SizeValueType first = 0; first < count; first += LaneCount )
+    {
+    const unsigned int lanes = static_cast<unsigned int>(std::min<SizeValueType>(LaneCount, count - first) );
+    SolveLanes(tensors + first, lanes, scaled, scale, values, solved);
+    for( unsigned int l = 0; l < lanes; ++l )
+      {
+      const TensorType &     tensor = tensors[first + l];
+      EigenValuesArrayType & e = eigenValues[first + l];
+      if( solved[l] )
+        {
+        for( unsigned int i = 0; i < 3; ++i )
+          {
+          e[i] = values[i][l] * scale[l];
+          }
+        }
+      else if( tensor[1] == 0 && tensor[2] == 0 && tensor[4] == 0 )
+        {
+        SolveDiagonal(tensor, e, ITK_NULLPTR);
+        }
+      else
+        {
+        const RealType t[6] = { scaled[0][l], scaled[1][l], scaled[2][l], scaled[3][l], scaled[4][l], scaled[5][l] };
+        SolveDegenerate(t, SimpleEigenValue(values, l), scale[l], e, ITK_NULLPTR);
+        }
+      }
+    }
+}
+
+template <class TTensor>
+void
+DiffusionTensor3DEigenSolver<TTensor>
+::ComputeEigenAnalysis(const TensorType * tensors, SizeValueType count,
+                       EigenValuesArrayType * eigenValues,
+                       EigenVectorsMatrixType * eigenVectors)
+{
+  RealType scaled[6][LaneCount];
+  RealType scale[LaneCount];
+  RealType values[3][LaneCount];
+  bool     solved[LaneCount];
+  for( SizeValueType first = 0; first < count; first += LaneCount )
+    {
+    const unsigned int lanes = static_cast<unsigned int>(std::min<SizeValueType>(LaneCount, count - first) );
+    SolveLanes(tensors + first, lanes, scaled, scale, values, solved);
+    for( unsigned int l = 0; l < lanes; ++l )
+      {
+      const TensorType &       tensor = tensors[first + l];
+      EigenValuesArrayType &   e = eigenValues[first + l];
+      EigenVectorsMatrixType & v = eigenVectors[first + l];
+      const RealType           t[6] = { scaled[0][l], scaled[1][l], scaled[2][l], scaled[3][l], scaled[4][l], scaled[5][l] };
+      if( solved[l] )
+        {
+        RealType v0[3];
+        RealType v2[3];
+        if( ComputeEigenVector(t, values[0][l], v0) && ComputeEigenVector(t, values[2][l], v2) )
+          {
+          // Remove the rounding error of v2 along v0, then v1 = v2 x v0
+          // completes an orthonormal basis
+          const RealType dot = v2[0] * v0[0] + v2[1] * v0[1] + v2[2] * v0[2];
+          for( unsigned int i = 0; i < 3; ++i )
+            {
+            v2[i] -= dot * v0[i];
+            }
+          const RealType inverse = 1 / std::sqrt(v2[0] * v2[0] + v2[1] * v2[1] + v2[2] * v2[2]);
+          for( unsigned int i = 0; i < 3; ++i )
+            {
+            v2[i] *= inverse;
+            }
+          const RealType v1[3] = {
+            v2[1] * v0[2] - v2[2] * v0[1],
+            v2[2] * v0[0] - v2[0] * v0[2],
+            v2[0] * v0[1] - v2[1] * v0[0]
+          };
+          for( unsigned int i = 0; i < 3; ++i )
+            {
+            e[i] = values[i][l] * scale[l];
+            v(0, i) = v0[i];
+            v(1, i) = v1[i];
+            v(2, i) = v2[i];
+            }
+          continue;
+          }
+        }
+      if( tensor[1] == 0 && tensor[2] == 0 && tensor[4] == 0 )
+        {
+        SolveDiagonal(tensor, e, &v);
+        }
+      else
+        {
+        SolveDegenerate(t, SimpleEigenValue(values, l), scale[l], e, &v);
+        }
+      }
+    }
+}
+
+template <class TTensor>
+void
+DiffusionTensor3DEigenSolver<TTensor>
+::ComputeEigenValues(const TensorType & tensor, EigenValuesArrayType & eigenValues)
+{
+  ComputeEigenValues(&tensor, 1, &eigenValues);
+}
+
+template <class TTensor>
+void
+DiffusionTensor3DEigenSolver<TTensor>
+::ComputeEigenAnalysis(const TensorType & tensor, EigenValuesArrayType & eigenValues,
+                       EigenVectorsMatrixType & eigenVectors)
+{
+  ComputeEigenAnalysis(&tensor, 1, &eigenValues, &eigenVectors);
+}
+
+template <class TTensor>
+void
+DiffusionTensor3DEigenSolver<TTensor>
+::ComposeTensors(const EigenValuesArrayType * eigenValues, const EigenVectorsMatrixType * eigenVectors,
+                 SizeValueType count, RealType * const components[6])
+{
+  // Row and column of the components
+  const unsigned int rows[6] = { 0, 0, 0, 1, 1, 2 };
+  const unsigned int columns[6] = { 0, 1, 2, 1, 2, 2 };
+  const unsigned int BlockSize = 64;
+
+  RealType values[3][BlockSize];
+  RealType vectors[9][BlockSize];
+  for( SizeValueType start = 0; start < count; start += BlockSize )
+    {
+    const unsigned int n = static_cast<unsigned int>(std::min<SizeValueType>(BlockSize, count - start) );
+    for( unsigned int i = 0; i < n; ++i )
+      {
+      for( unsigned int k = 0; k < 3; ++k )
+        {
+        values[k][i] = eigenValues[start + i][k];
+        for( unsigned int j = 0; j < 3; ++j )
+          {
+          vectors[3 * k + j][i] = eigenVectors[start + i](k, j);
+          }
+        }
+      }
+    for( unsigned int c = 0; c < 6; ++c )
+      {
+      const RealType * v0r = vectors[rows[c]];
+      const RealType * v0c = vectors[columns[c]];
+      const RealType * v1r = vectors[3 + rows[c]];
+      const RealType * v1c = vectors[3 + columns[c]];
+      const RealType * v2r = vectors[6 + rows[c]];
+      const RealType * v2c = vectors[6 + columns[c]];
+      RealType *       out = components[c] + start;
+      for( unsigned int i = 0; i < n; ++i )
+        {
+        out[i] = values[0][i] * v0r[i] * v0c[i] + values[1][i] * v1r[i] * v1c[i] + values[2][i] * v2r[i] * v2c[i];
+        }
+      }
+    }
+}
+
+} // end namespace itk
+
+#endif
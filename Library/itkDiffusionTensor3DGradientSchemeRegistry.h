@@ -0,0 +1,269 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkDiffusionTensor3DGradientSchemeRegistry_h_
+#define __itkDiffusionTensor3DGradientSchemeRegistry_h_
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkVectorContainer.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkIntTypes.h"
+#include "vnl/vnl_matrix.h"
+#include "vnl/vnl_vector_fixed.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace itk
+{
+/** \class DiffusionTensor3DGradientScheme
+ * \brief Matrices of the tensor models of one gradient table.
+ *
+ * Everything the tensor estimators derive from the gradient directions
+ * and the b-value alone:
+ * \li the b-matrix of the log-linear model (n x 7, see
+ * DiffusionTensor3DReconstructionImageFilterBase) with its
+ * pseudo-inverse and the transpose of the pseudo-inverse,
+ * \li the indices of the baseline and of the gradient components,
+ * \li the matrix of the gradient components of the Rician model (ng x
+ * 6, without the b-value) with its pseudo-inverse and the design
+ * matrix -b times that matrix.
+ *
+ * Schemes are built and shared by
+ * DiffusionTensor3DGradientSchemeRegistry and are never modified
+ * afterwards.
+ */
+template <class TPrecision>
+class ITK_EXPORT DiffusionTensor3DGradientScheme : public LightObject
+{
+public:
+  typedef DiffusionTensor3DGradientScheme Self;
+  typedef LightObject                     Superclass;
+  typedef SmartPointer<Self>              Pointer;
+  typedef SmartPointer<const Self>        ConstPointer;
+
+  itkNewMacro(Self);
+  itkTypeMacro(DiffusionTensor3DGradientScheme, LightObject);
+
+  typedef vnl_vector_fixed<TPrecision, 3>                       GradientDirectionType;
+  typedef VectorContainer<unsigned int, GradientDirectionType> GradientDirectionContainerType;
+  typedef vnl_matrix<TPrecision>                                MatrixType;
+  typedef std::vector<unsigned int>                             IndexListType;
+
+  TPrecision GetBValue() const
+  {
+    return m_BValue;
+  }
+
+  const std::vector<GradientDirectionType> & GetGradientDirections() const
+  {
+    return m_GradientDirections;
+  }
+
+  const MatrixType & GetBMatrix() const
+  {
+    return m_BMatrix;
+  }
+
+  const MatrixType & GetTensorBasis() const
+  {
+    return m_TensorBasis;
+  }
+
+  const MatrixType & GetTensorBasisTranspose() const
+  {
+    return m_TensorBasisTranspose;
+  }
+
+  const IndexListType & GetBaselineIndices() const
+  {
+    return m_BaselineIndices;
+  }
+
+  const IndexListType & GetGradientIndices() const
+  {
+    return m_GradientIndices;
+  }
+
+  const MatrixType & GetGradientMatrix() const
+  {
+    return m_GradientMatrix;
+  }
+
+  const MatrixType & GetGradientTensorBasis() const
+  {
+    return m_GradientTensorBasis;
+  }
+
+  const MatrixType & GetDesignMatrix() const
+  {
+    return m_DesignMatrix;
+  }
+
+  /** True if the scheme was built for exactly these directions and
+   * b-value. */
+  bool Matches(const GradientDirectionContainerType * directions, TPrecision bValue) const;
+
+  /** Fill the matrices that do not need a decomposition. */
+  void Initialize(const GradientDirectionContainerType * directions, TPrecision bValue);
+
+  /** Compute the pseudo-inverses with an SVD. */
+  void ComputePseudoInverses();
+
+  /** Pseudo-inverse of \a matrix computed in double. */
+  static MatrixType PseudoInverse(const MatrixType & matrix);
+
+  /** Binary cache file: the directions and b-value, then the two
+   * pseudo-inverses.  The other matrices are rebuilt by Initialize().
+   * The file is in the byte order of the machine which wrote it. */
+  bool Write(const std::string & fileName) const;
+
+  /** Read the pseudo-inverses of an initialized scheme.  Returns false
+   * if the file is missing, truncated or was written for another
+   * gradient table. */
+  bool Read(const std::string & fileName);
+
+protected:
+  DiffusionTensor3DGradientScheme() : m_BValue(0)
+  {
+  }
+
+  virtual ~DiffusionTensor3DGradientScheme()
+  {
+  }
+
+private:
+  DiffusionTensor3DGradientScheme(const Self &); // purposely not implemented
+  void operator=(const Self &);                  // purposely not implemented
+
+  TPrecision                         m_BValue;
+  std::vector<GradientDirectionType> m_GradientDirections;
+
+  MatrixType m_BMatrix;
+  MatrixType m_TensorBasis;
+  MatrixType m_TensorBasisTranspose;
+
+  IndexListType m_BaselineIndices;
+  IndexListType m_GradientIndices;
+
+  MatrixType m_GradientMatrix;
+  MatrixType m_GradientTensorBasis;
+  MatrixType m_DesignMatrix;
+};
+
+/** \class DiffusionTensor3DGradientSchemeRegistry
+ * \brief Shares the gradient schemes of identical gradient tables.
+ *
+ * Schemes are looked up by a hash of the b-value and of the gradient
+ * directions, and then compared exactly, so a hash collision only
+ * costs a comparison.  A scheme is built the first time its gradient
+ * table is requested and kept for the lifetime of the registry.  When
+ * processing many subjects acquired with the same protocol, only the
+ * first one pays for the SVDs.
+ *
+ * When a cache directory is set, schemes missing from memory are first
+ * looked for in that directory, and new schemes are written to it, so
+ * that the decompositions are also reused across processes.  The
+ * directory must exist.  Failing to write to it is not an error.
+ *
+ * The tensor reconstruction filters use the global registry returned
+ * by GetInstance() unless another one is set on them.  GetInstance()
+ * and GetScheme() can be called from several threads.
+ */
+template <class TPrecision>
+class ITK_EXPORT DiffusionTensor3DGradientSchemeRegistry : public Object
+{
+public:
+  typedef DiffusionTensor3DGradientSchemeRegistry Self;
+  typedef Object                                  Superclass;
+  typedef SmartPointer<Self>                      Pointer;
+  typedef SmartPointer<const Self>                ConstPointer;
+
+  itkNewMacro(Self);
+  itkTypeMacro(DiffusionTensor3DGradientSchemeRegistry, Object);
+
+  typedef DiffusionTensor3DGradientScheme<TPrecision>                SchemeType;
+  typedef typename SchemeType::GradientDirectionContainerType        GradientDirectionContainerType;
+
+  /** The registry shared by default by all the filters of a process. */
+  static Self * GetInstance();
+
+  /** Directory of the on-disk cache, empty (the default) to keep the
+   * schemes in memory only. */
+  itkSetStringMacro(CacheDirectory);
+  itkGetStringMacro(CacheDirectory);
+
+  /** Return the scheme of \a directions and \a bValue, building it (or
+   * reading it from the cache directory) if it was never requested. */
+  typename SchemeType::ConstPointer GetScheme(const GradientDirectionContainerType * directions,
+                                              TPrecision bValue);
+
+  /** Hash of a gradient table used as the key of the registry and in
+   * the names of the cache files. */
+  static uint64_t ComputeKey(const GradientDirectionContainerType * directions, TPrecision bValue);
+
+  /** Forget all the schemes kept in memory. */
+  void Clear();
+
+  SizeValueType GetNumberOfSchemes() const;
+
+  /** Number of requests answered from memory, from the cache
+   * directory, and by computing the scheme. */
+  itkGetConstMacro(NumberOfHits, SizeValueType);
+  itkGetConstMacro(NumberOfCacheFileHits, SizeValueType);
+  itkGetConstMacro(NumberOfMisses, SizeValueType);
+
+protected:
+  DiffusionTensor3DGradientSchemeRegistry();
+  virtual ~DiffusionTensor3DGradientSchemeRegistry()
+  {
+  }
+
+  virtual void PrintSelf(std::ostream & os, Indent indent) const ITK_OVERRIDE;
+
+  std::string GetCacheFileName(uint64_t key) const;
+
+private:
+  DiffusionTensor3DGradientSchemeRegistry(const Self &); // purposely not implemented
+  void operator=(const Self &);                          // purposely not implemented
+
+  typedef std::multimap<uint64_t, typename SchemeType::ConstPointer> SchemeMapType;
+
+  /** Scheme of the table in memory, or NULL. Must be called with the
+   * lock held. */
+  const SchemeType * FindScheme(uint64_t key, const GradientDirectionContainerType * directions,
+                                TPrecision bValue) const;
+
+  /** Serializes the creation of the global registry.  A static member
+   * is constructed before main, before any thread is started. */
+  static SimpleFastMutexLock m_InstanceLock;
+
+  SchemeMapType               m_Schemes;
+  mutable SimpleFastMutexLock m_Lock;
+  std::string                 m_CacheDirectory;
+
+  SizeValueType m_NumberOfHits;
+  SizeValueType m_NumberOfCacheFileHits;
+  SizeValueType m_NumberOfMisses;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkDiffusionTensor3DGradientSchemeRegistry.txx"
+#endif
+
+#endif
@@ -0,0 +1,457 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkDiffusionTensor3DGradientSchemeRegistry_txx
+#define __itkDiffusionTensor3DGradientSchemeRegistry_txx
+
+#include "itkDiffusionTensor3DGradientSchemeRegistry.h"
+#include "vnl/algo/vnl_svd.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#if defined( _WIN32 )
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace itk
+{
+
+namespace
+{
+// 64-bit FNV-1a hash, continued from \a hash
+inline uint64_t HashBytes(const void * data, size_t size, uint64_t hash)
+{
+  const unsigned char * bytes = static_cast<const unsigned char *>(data);
+  for( size_t i = 0; i < size; ++i )
+    {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+    }
+  return hash;
+}
+
+const uint64_t HashOffsetBasis = 14695981039346656037ULL;
+const char     SchemeFileMagic[8] = { 'D', 'T', 'I', 'G', 'S', 'C', 'H', '1' };
+
+inline long CurrentProcessId()
+{
+#if defined( _WIN32 )
+  return _getpid();
+#else
+  return getpid();
+#endif
+}
+}
+
+template <class TPrecision>
+bool
+DiffusionTensor3DGradientScheme<TPrecision>
+::Matches(const GradientDirectionContainerType * directions, TPrecision bValue) const
+{
+  if( bValue != m_BValue || directions->Size() != m_GradientDirections.size() )
+    {
+    return false;
+    }
+  for( unsigned int i = 0; i < m_GradientDirections.size(); ++i )
+    {
+    if( directions->ElementAt(i) != m_GradientDirections[i] )
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+template <class TPrecision>
+void
+DiffusionTensor3DGradientScheme<TPrecision>
+::Initialize(const GradientDirectionContainerType * directions, TPrecision bValue)
+{
+  const unsigned int n = directions->Size();
+  m_BValue = bValue;
+  m_GradientDirections.resize(n);
+  m_BaselineIndices.clear();
+  m_GradientIndices.clear();
+  for( unsigned int m = 0; m < n; ++m )
+    {
+    m_GradientDirections[m] = directions->ElementAt(m);
+    if( m_GradientDirections[m].one_norm() > 0.0 )
+      {
+      m_GradientIndices.push_back(m);
+      }
+    else
+      {
+      m_BaselineIndices.push_back(m);
+      }
+    }
+
+  // Same expressions as the filters used to evaluate, so that the
+  // matrices do not depend on whether they come from the registry.
+  m_BMatrix.set_size(n, 7);
+  for( unsigned int m = 0; m < n; ++m )
+    {
+    const GradientDirectionType & g = m_GradientDirections[m];
+    m_BMatrix[m][0] =     -bValue * g[0] * g[0];
+    m_BMatrix[m][1] = 2 * -bValue * g[0] * g[1];
+    m_BMatrix[m][2] = 2 * -bValue * g[0] * g[2];
+    m_BMatrix[m][3] =     -bValue * g[1] * g[1];
+    m_BMatrix[m][4] = 2 * -bValue * g[1] * g[2];
+    m_BMatrix[m][5] =     -bValue * g[2] * g[2];
+    m_BMatrix[m][6] = 1;
+    }
+
+  const unsigned int ng = m_GradientIndices.size();
+  m_GradientMatrix.set_size(ng, 6);
+  for( unsigned int m = 0; m < ng; ++m )
+    {
+    const GradientDirectionType & g = m_GradientDirections[m_GradientIndices[m]];
+    m_GradientMatrix[m][0] =     g[0] * g[0];
+    m_GradientMatrix[m][1] = 2 * g[0] * g[1];
+    m_GradientMatrix[m][2] = 2 * g[0] * g[2];
+    m_GradientMatrix[m][3] =     g[1] * g[1];
+    m_GradientMatrix[m][4] = 2 * g[1] * g[2];
+    m_GradientMatrix[m][5] =     g[2] * g[2];
+    }
+  m_DesignMatrix = -bValue * m_GradientMatrix;
+
+  m_TensorBasis.clear();
+  m_TensorBasisTranspose.clear();
+  m_GradientTensorBasis.clear();
+}
+
+template <class TPrecision>
+void
+DiffusionTensor3DGradientScheme<TPrecision>
+::ComputePseudoInverses()
+{
+  if( m_BMatrix.rows() > 0 )
+    {
+    m_TensorBasis = PseudoInverse(m_BMatrix);
+    m_TensorBasisTranspose = m_TensorBasis.transpose();
+    }
+  if( m_GradientMatrix.rows() > 0 )
+    {
+    m_GradientTensorBasis = PseudoInverse(m_GradientMatrix);
+    }
+}
+
+template <class TPrecision>
+typename DiffusionTensor3DGradientScheme<TPrecision>::MatrixType
+DiffusionTensor3DGradientScheme<TPrecision>
+::PseudoInverse(const MatrixType & matrix)
+{
+  // The decomposition is always computed in double, and only its
+  // result is rounded to the precision of the scheme.
+  vnl_matrix<double> M(matrix.rows(), matrix.cols() );
+  for( unsigned int i = 0; i < M.rows(); ++i )
+    {
+    for( unsigned int j = 0; j < M.cols(); ++j )
+      {
+      M(i, j) = matrix(i, j);
+      }
+    }
+  const vnl_matrix<double> P = vnl_svd<double>(M).pinverse();
+  MatrixType               inverse(P.rows(), P.cols() );
+  for( unsigned int i = 0; i < P.rows(); ++i )
+    {
+    for( unsigned int j = 0; j < P.cols(); ++j )
+      {
+      inverse(i, j) = static_cast<TPrecision>(P(i, j) );
+      }
+    }
+  return inverse;
+}
+
+template <class TPrecision>
+bool
+DiffusionTensor3DGradientScheme<TPrecision>
+::Write(const std::string & fileName) const
+{
+  std::ofstream file(fileName.c_str(), std::ios::out | std::ios::binary);
+  if( !file )
+    {
+    return false;
+    }
+  const uint32_t precision = sizeof(TPrecision);
+  const uint32_t n = m_GradientDirections.size();
+  file.write(SchemeFileMagic, sizeof(SchemeFileMagic) );
+  file.write(reinterpret_cast<const char *>(&precision), sizeof(precision) );
+  file.write(reinterpret_cast<const char *>(&n), sizeof(n) );
+  file.write(reinterpret_cast<const char *>(&m_BValue), sizeof(m_BValue) );
+  for( unsigned int m = 0; m < n; ++m )
+    {
+    file.write(reinterpret_cast<const char *>(m_GradientDirections[m].data_block() ), 3 * sizeof(TPrecision) );
+    }
+
+  // The pseudo-inverses are followed by a hash of their bytes so that a
+  // partially written file is never used.
+  const size_t basisSize = m_TensorBasis.size() * sizeof(TPrecision);
+  const size_t gradientBasisSize = m_GradientTensorBasis.size() * sizeof(TPrecision);
+  uint64_t     check = HashBytes(m_TensorBasis.data_block(), basisSize, HashOffsetBasis);
+  check = HashBytes(m_GradientTensorBasis.data_block(), gradientBasisSize, check);
+  file.write(reinterpret_cast<const char *>(m_TensorBasis.data_block() ), basisSize);
+  file.write(reinterpret_cast<const char *>(m_GradientTensorBasis.data_block() ), gradientBasisSize);
+  file.write(reinterpret_cast<const char *>(&check), sizeof(check) );
+  return file.good();
+}
+
+template <class TPrecision>
+bool
+DiffusionTensor3DGradientScheme<TPrecision>
+::Read(const std::string & fileName)
+{
+  std::ifstream file(fileName.c_str(), std::ios::in | std::ios::binary);
+  if( !file )
+    {
+    return false;
+    }
+  char     magic[sizeof(SchemeFileMagic)];
+  uint32_t precision = 0;
+  uint32_t n = 0;
+  file.read(magic, sizeof(magic) );
+  file.read(reinterpret_cast<char *>(&precision), sizeof(precision) );
+  file.read(reinterpret_cast<char *>(&n), sizeof(n) );
+  if( !file || !std::equal(magic, magic + sizeof(magic), SchemeFileMagic)
+      || precision != sizeof(TPrecision) || n != m_GradientDirections.size() )
+    {
+    return false;
+    }
+  TPrecision bValue;
+  file.read(reinterpret_cast<char *>(&bValue), sizeof(bValue) );
+  if( !file || bValue != m_BValue )
+    {
+    return false;
+    }
+  for( unsigned int m = 0; m < n; ++m )
+    {
+    GradientDirectionType g;
+    file.read(reinterpret_cast<char *>(g.data_block() ), 3 * sizeof(TPrecision) );
+    if( !file || g != m_GradientDirections[m] )
+      {
+      return false;
+      }
+    }
+
+  MatrixType tensorBasis(7, n);
+  MatrixType gradientTensorBasis(6, m_GradientIndices.size() );
+  uint64_t   check = 0;
+  file.read(reinterpret_cast<char *>(tensorBasis.data_block() ), tensorBasis.size() * sizeof(TPrecision) );
+  file.read(reinterpret_cast<char *>(gradientTensorBasis.data_block() ),
+            gradientTensorBasis.size() * sizeof(TPrecision) );
+  file.read(reinterpret_cast<char *>(&check), sizeof(check) );
+  if( !file )
+    {
+    return false;
+    }
+  uint64_t expected = HashBytes(tensorBasis.data_block(), tensorBasis.size() * sizeof(TPrecision),
+                                HashOffsetBasis);
+  expected = HashBytes(gradientTensorBasis.data_block(), gradientTensorBasis.size() * sizeof(TPrecision),
+                       expected);
+  if( check != expected )
+    {
+    return false;
+    }
+
+  m_TensorBasis = tensorBasis;
+  m_TensorBasisTranspose = m_TensorBasis.transpose();
+  m_GradientTensorBasis = gradientTensorBasis;
+  return true;
+}
+
+template <class TPrecision>
+SimpleFastMutexLock DiffusionTensor3DGradientSchemeRegistry<TPrecision>::m_InstanceLock;
+
+template <class TPrecision>
+DiffusionTensor3DGradientSchemeRegistry<TPrecision>
+::DiffusionTensor3DGradientSchemeRegistry() :
+  m_NumberOfHits(0),
+  m_NumberOfCacheFileHits(0),
+  m_NumberOfMisses(0)
+{
+}
+
+template <class TPrecision>
+DiffusionTensor3DGradientSchemeRegistry<TPrecision> *
+DiffusionTensor3DGradientSchemeRegistry<TPrecision>
+::GetInstance()
+{
+  // Created by the first filter which computes its tensor basis.  The
+  // filters of pipelines updated on different threads can get there at
+  // the same time.
+  m_InstanceLock.Lock();
+  static Pointer instance;
+  if( instance.IsNull() )
+    {
+    instance = Self::New();
+    }
+  Self * registry = instance.GetPointer();
+  m_InstanceLock.Unlock();
+  return registry;
+}
+
+template <class TPrecision>
+uint64_t
+DiffusionTensor3DGradientSchemeRegistry<TPrecision>
+::ComputeKey(const GradientDirectionContainerType * directions, TPrecision bValue)
+{
+  const uint32_t n = directions->Size();
+  uint64_t       key = HashBytes(&n, sizeof(n), HashOffsetBasis);
+  key = HashBytes(&bValue, sizeof(bValue), key);
+  for( unsigned int m = 0; m < n; ++m )
+    {
+    key = HashBytes(directions->ElementAt(m).data_block(), 3 * sizeof(TPrecision), key);
+    }
+  return key;
+}
+
+template <class TPrecision>
+const typename DiffusionTensor3DGradientSchemeRegistry<TPrecision>::SchemeType *
+DiffusionTensor3DGradientSchemeRegistry<TPrecision>
+::FindScheme(uint64_t key, const GradientDirectionContainerType * directions, TPrecision bValue) const
+{
+  typedef typename SchemeMapType::const_iterator IteratorType;
+  const std::pair<IteratorType, IteratorType> range = m_Schemes.equal_range(key);
+  for( IteratorType it = range.first; it != range.second; ++it )
+    {
+    if( it->second->Matches(directions, bValue) )
+      {
+      return it->second.GetPointer();
+      }
+    }
+  return ITK_NULLPTR;
+}
+
+template <class TPrecision>
+std::string
+DiffusionTensor3DGradientSchemeRegistry<TPrecision>
+::GetCacheFileName(uint64_t key) const
+{
+  std::ostringstream name;
+  name << m_CacheDirectory << "/gradientscheme_" << std::hex << std::setw(16) << std::setfill('0') << key
+       << std::dec << "_" << sizeof(TPrecision) << ".bin";
+  return name.str();
+}
+
+template <class TPrecision>
+typename DiffusionTensor3DGradientSchemeRegistry<TPrecision>::SchemeType::ConstPointer
+DiffusionTensor3DGradientSchemeRegistry<TPrecision>
+::GetScheme(const GradientDirectionContainerType * directions, TPrecision bValue)
+{
+  if( directions == ITK_NULLPTR )
+    {
+    itkExceptionMacro(<< "Gradient directions not set");
+    }
+  const uint64_t key = ComputeKey(directions, bValue);
+
+  m_Lock.Lock();
+  typename SchemeType::ConstPointer scheme = this->FindScheme(key, directions, bValue);
+  if( scheme.IsNotNull() )
+    {
+    ++m_NumberOfHits;
+    }
+  const std::string cacheDirectory = m_CacheDirectory;
+  m_Lock.Unlock();
+  if( scheme.IsNotNull() )
+    {
+    return scheme;
+    }
+
+  // Built outside of the lock: the SVDs are the expensive part.  If
+  // another thread builds the same scheme meanwhile, its copy is kept.
+  typename SchemeType::Pointer newScheme = SchemeType::New();
+  newScheme->Initialize(directions, bValue);
+  const std::string fileName = cacheDirectory.empty() ? std::string() : this->GetCacheFileName(key);
+  const bool        fromFile = !fileName.empty() && newScheme->Read(fileName);
+  if( !fromFile )
+    {
+    newScheme->ComputePseudoInverses();
+    if( !fileName.empty() )
+      {
+      // Written under a temporary name then renamed, so that other
+      // processes never read a file being written.  The name is unique
+      // to the process and, within it, to the scheme being built.
+      std::ostringstream temporaryName;
+      temporaryName << fileName << "." << CurrentProcessId() << "." << std::hex
+                    << reinterpret_cast<size_t>(newScheme.GetPointer() ) << ".tmp";
+      if( newScheme->Write(temporaryName.str() ) )
+        {
+        std::remove(fileName.c_str() );
+        std::rename(temporaryName.str().c_str(), fileName.c_str() );
+        }
+      std::remove(temporaryName.str().c_str() );
+      }
+    }
+
+  m_Lock.Lock();
+  scheme = this->FindScheme(key, directions, bValue);
+  if( scheme.IsNull() )
+    {
+    m_Schemes.insert(std::make_pair(key, typename SchemeType::ConstPointer(newScheme.GetPointer() ) ) );
+    scheme = newScheme.GetPointer();
+    }
+  if( fromFile )
+    {
+    ++m_NumberOfCacheFileHits;
+    }
+  else
+    {
+    ++m_NumberOfMisses;
+    }
+  m_Lock.Unlock();
+  return scheme;
+}
+
+template <class TPrecision>
+void
+DiffusionTensor3DGradientSchemeRegistry<TPrecision>
+::Clear()
+{
+  m_Lock.Lock();
+  m_Schemes.clear();
+  m_Lock.Unlock();
+}
+
+template <class TPrecision>
+SizeValueType
+DiffusionTensor3DGradientSchemeRegistry<TPrecision>
+::GetNumberOfSchemes() const
+{
+  m_Lock.Lock();
+  const SizeValueType size = m_Schemes.size();
+  m_Lock.Unlock();
+  return size;
+}
+
+template <class TPrecision>
+void
+DiffusionTensor3DGradientSchemeRegistry<TPrecision>
+::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "CacheDirectory: " << m_CacheDirectory << std::endl;
+  os << indent << "NumberOfSchemes: " << this->GetNumberOfSchemes() << std::endl;
+  os << indent << "NumberOfHits: " << m_NumberOfHits << std::endl;
+  os << indent << "NumberOfCacheFileHits: " << m_NumberOfCacheFileHits << std::endl;
+  os << indent << "NumberOfMisses: " << m_NumberOfMisses << std::endl;
+}
+
+} // end namespace itk
+
+#endif
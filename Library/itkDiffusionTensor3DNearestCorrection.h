@@ -18,6 +18,7 @@
 #include "vnl/vnl_math.h"
 #include <itkMatrix.h>
 #include "itkDiffusionTensor3DExtended.h"
+#include "itkDiffusionTensor3DEigenSolver.h"
 
 namespace itk
 {
@@ -82,7 +83,7 @@ public:
 
     typename DiffusionTensor3DExtended<double>::EigenValuesArrayType eigenValues;
     typename DiffusionTensor3DExtended<double>::EigenVectorsMatrixType eigenVectors;
-    tensorDouble.ComputeEigenAnalysis( eigenValues, eigenVectors );
+    DiffusionTensor3DEigenSolver<DiffusionTensor3D<double> >::ComputeEigenAnalysis( tensorDouble, eigenValues, eigenVectors );
     for( int i = 0; i < 3; i++ )
       {
       mat[i][i] = sqrt(eigenValues[i]);
@@ -91,7 +92,7 @@ public:
     H = eigenVectors * mat * eigenVectors.GetInverse();
     mat = (B + H) / 2;
     tensorDouble.SetTensorFromMatrix( mat );
-    tensorDouble.ComputeEigenAnalysis( eigenValues, eigenVectors );  // sometimes very small negative eigenvalues
+    DiffusionTensor3DEigenSolver<DiffusionTensor3D<double> >::ComputeEigenAnalysis( tensorDouble, eigenValues, eigenVectors );  // sometimes very small negative eigenvalues
                                                                      // appear; we suppress them
     mat.Fill(0);
     for( int i = 0; i < 3; i++ )
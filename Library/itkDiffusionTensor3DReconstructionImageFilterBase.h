@@ -22,8 +22,13 @@
 #include "itkDiffusionTensor3D.h"
 #include "vnl/vnl_matrix.h"
 #include "vnl/vnl_vector.h"
+#include "vnl/vnl_matrix_fixed.h"
+#include "vnl/vnl_vector_fixed.h"
 #include "itkVectorContainer.h"
 #include "itkVectorImage.h"
+#include "itkMultiThreader.h"
+#include "itkDiffusionTensor3DGradientSchemeRegistry.h"
+#include <vector>
 #if (ITK_VERSION_MAJOR < 4)
 typedef int ThreadIdType;
 #else
@@ -173,6 +178,23 @@ public:
     return m_GradientDirectionContainer->ElementAt( idx + 1 );
   }
 
+  /** Registry sharing the b-matrix and its pseudo-inverse between the
+   * filters which use the same gradient directions and b-value.  The
+   * global registry is used by default. */
+  typedef DiffusionTensor3DGradientSchemeRegistry<TTensorPrecision> GradientSchemeRegistryType;
+  typedef typename GradientSchemeRegistryType::SchemeType           GradientSchemeType;
+  itkSetObjectMacro( GradientSchemeRegistry, GradientSchemeRegistryType );
+  itkGetObjectMacro( GradientSchemeRegistry, GradientSchemeRegistryType );
+
+  /** Mask of the voxels where tensors are estimated.  When a mask is
+   * set only its non-zero voxels are fitted: they are gathered in a
+   * list of offsets which is split evenly among the threads.  The other
+   * voxels get the default tensor (and a baseline of 1, the
+   * estimate of a zero signal). */
+  typedef Image<unsigned char, 3> MaskImageType;
+  virtual void SetMaskImage(const MaskImageType * mask);
+  virtual const MaskImageType * GetMaskImage() const;
+
   /** Threshold on the reference image data. The output tensor will be the default
    * tensor for pixels in the reference image that have a value less than this
    * threshold. */
@@ -202,6 +224,26 @@ public:
   itkSetMacro( ShiftNegativeEigenvaluesCoefficient, double );
   itkGetMacro( ShiftNegativeEigenvaluesCoefficient, double );
 
+  /** Correction of the output tensors which are not positive
+  * semi-definite, as done by DiffusionTensor3DZeroCorrectionFilter,
+  * DiffusionTensor3DAbsCorrectionFilter and
+  * DiffusionTensor3DNearestCorrectionFilter.  The correction is applied
+  * to each tensor as it is estimated, after the shift of the negative
+  * eigenvalues, and reuses the eigen-analysis of the shift.  For a
+  * symmetric tensor the nearest positive semi-definite tensor is
+  * obtained by zeroing its negative eigenvalues, so NearestCorrection
+  * gives the tensors of ZeroCorrection.  The default is NoCorrection.
+  */
+  typedef enum { NoCorrection, ZeroCorrection, AbsCorrection, NearestCorrection } TensorCorrectionType;
+  itkSetMacro( Correction, TensorCorrectionType );
+  itkGetConstMacro( Correction, TensorCorrectionType );
+
+  /** Number of voxels whose signals are gathered into one contiguous
+  * buffer before being handed to EstimateTensors(). The default is 256.
+  */
+  itkSetMacro( SlabSize, unsigned int );
+  itkGetMacro( SlabSize, unsigned int );
+
   /**
    * The BValue \f$ (s/mm^2) \f$ value used in normalizing the tensors to
    * physically meaningful units.  See equation (24) of the first reference for
@@ -253,9 +295,20 @@ protected:
 
   virtual void BeforeThreadedGenerateData() ITK_OVERRIDE;
 
+  /** Without a mask the usual region-based threading is used.  With a
+   * mask the foreground voxels are listed and each thread estimates an
+   * equal share of them. */
+  virtual void GenerateData() ITK_OVERRIDE;
+
   virtual void ThreadedGenerateData( const
                                      OutputImageRegionType &outputRegionForThread, ThreadIdType) ITK_OVERRIDE;
 
+  /** Estimate the tensors of the share \a threadId of the foreground
+   * voxels out of \a numberOfThreads. */
+  void ThreadedGenerateForeground(ThreadIdType threadId, ThreadIdType numberOfThreads);
+
+  static ITK_THREAD_RETURN_TYPE ForegroundThreaderCallback(void * arg);
+
   /** Derived classes should override this method to estimate the
   tensor from the diffusion weighted signal.  The gradient directions,
   b-matrix and inverse of b-matrix are available as class members.
@@ -267,9 +320,81 @@ protected:
   virtual vnl_vector<TTensorPrecision>
   EstimateTensor(const vnl_vector<TTensorPrecision>& S) const = 0;
 
+  /** Estimate the tensors of a slab of voxels at once.  \a signals
+  holds the diffusion weighted signals of \a numberOfVoxels voxels
+  stored one voxel after the other (m_NumberOfGradientDirections
+  values per voxel).  The 7 estimated values of each voxel (see
+  EstimateTensor()) are written contiguously in \a estimates.  \a
+  workspace is scratch storage of the calling thread for
+  numberOfVoxels * m_NumberOfGradientDirections values, such as the
+  log-signals, allocated once per thread rather than once per slab.
+  The default implementation calls EstimateTensor() for every voxel;
+  derived classes can override it to amortize the work over the slab.*/
+  virtual void EstimateTensors(const TTensorPrecision * signals,
+                               unsigned int numberOfVoxels,
+                               TTensorPrecision * estimates,
+                               TTensorPrecision * workspace) const;
+
+  /** Build the output tensor from the 7 estimated values of a voxel.
+  The default tensor is returned if the estimated S_0 is below the
+  threshold, and the tensor is then corrected, see CorrectTensor(). */
+  TensorPixelType ComputeOutputTensor(const TTensorPrecision * estimate) const;
+
+  /** Shift the negative eigenvalues of \a tensor and apply the
+  correction, if requested.  The tensor is eigen-decomposed at most
+  once. */
+  TensorPixelType CorrectTensor(const TensorPixelType & tensor) const;
+
   /** Holds the tensor basis coefficients G_k */
   typedef vnl_matrix<TTensorPrecision> TensorBasisMatrixType;
 
+  /** The 7 estimated values of a voxel and the matrices of the
+   * corresponding normal equations.  The normal equations are
+   * accumulated and solved in the real type of the precision (double
+   * for float tensors): their condition number is too large for float. */
+  typedef typename NumericTraits<TTensorPrecision>::RealType AccumulateType;
+  typedef vnl_vector_fixed<TTensorPrecision, 7>            EstimateVectorType;
+  typedef vnl_vector_fixed<AccumulateType, 7>              NormalVectorType;
+  typedef vnl_matrix_fixed<AccumulateType, 7, 7>           NormalMatrixType;
+
+  /** Solves A x = b for a symmetric positive definite A with a
+   * Cholesky factorization A = L L^T computed in place.  A is
+   * overwritten by its factor and b by the solution.  Each squared
+   * pivot L_jj^2 is taken relative to A_jj, which makes it independent
+   * of the scaling of the unknowns; the first is 1 and none is larger.
+   * Returns false, without solving, if the ratio of the smallest to the
+   * largest of them is not above \a minimumPivotRatio: the matrix is
+   * then not positive definite or too ill-conditioned for the
+   * factorization. */
+  static bool CholeskySolve(NormalMatrixType & A, NormalVectorType & b,
+                            AccumulateType minimumPivotRatio);
+
+  /** Natural logarithm of \a count signals, zero signals are mapped
+   * to zero.  The logarithm is evaluated in the precision of the
+   * filter. */
+  static void ComputeLogSignals(const TTensorPrecision * signals, unsigned int count,
+                                TTensorPrecision * logSignals);
+
+  /** Linear least-squares estimate of one voxel: m_TensorBasis times
+   * the log-signals. */
+  void LinearLeastSquaresEstimate(const TTensorPrecision * logSignals,
+                                  EstimateVectorType & estimate) const;
+
+  /** One reweighting step of the weighted least-squares fit of the
+   * log-signals.  The weights are the squared signals predicted by \a
+   * previous.  The 7x7 normal equations are accumulated directly from
+   * m_BMatrix and solved with CholeskySolve(), or with an SVD if the
+   * smallest relative squared pivot of the factorization is below the
+   * square root of the machine precision.  Returns false
+   * if the solution is not finite. */
+  bool WeightedLeastSquaresStep(const TTensorPrecision * logSignals,
+                                const EstimateVectorType & previous,
+                                EstimateVectorType & estimate) const;
+
+  /** Scheme of the current gradient directions, set by
+   * ComputeTensorBasis() */
+  typename GradientSchemeType::ConstPointer m_GradientScheme;
+
   /** Matrix encoding of gradient directions and b-values.  This is
    * the matrix multiplied by the tensor and T2 signal which gives the
    * diffusion weighted signal. */
@@ -305,9 +430,22 @@ protected:
   /** Shifts negative eigen values coefficient */
   double m_ShiftNegativeEigenvaluesCoefficient ;
 
+  /** Correction of the tensors which are not positive semi-definite */
+  TensorCorrectionType m_Correction ;
+
+  /** Number of voxels estimated together by EstimateTensors() */
+  unsigned int m_SlabSize ;
+
 private:
+  typename GradientSchemeRegistryType::Pointer m_GradientSchemeRegistry;
+
   /** Whether the baseline signal should be estimated and saved */
   bool m_EstimateBaseline;
+
+  /** Offsets of the foreground voxels in the input and output buffers,
+   * only filled while a masked update runs */
+  std::vector<OffsetValueType> m_ForegroundInputOffsets;
+  std::vector<OffsetValueType> m_ForegroundOutputOffsets;
 };
 
 }
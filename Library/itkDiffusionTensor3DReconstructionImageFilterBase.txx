@@ -25,6 +25,14 @@
 #include "itkImageRegionIterator.h"
 #include "itkArray.h"
 #include "vnl/vnl_vector.h"
+#include "vnl/vnl_math.h"
+#include "vnl/algo/vnl_svd.h"
+#include "itkDiffusionTensor3DExtended.h"
+#include "itkDiffusionTensor3DEigenSolver.h"
+#include "define.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 
 #ifdef WIN32
@@ -48,12 +56,16 @@ DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
   m_NumberOfGradientDirections = 0;
   m_Threshold = NumericTraits<GradientPixelType>::min();
   m_GradientDirectionContainer = ITK_NULLPTR;
+  m_GradientSchemeRegistry = GradientSchemeRegistryType::GetInstance();
   m_BValue = 1.0;
   m_EstimateBaseline = false;
   TensorPixelType tensor(0.0) ;
   m_DefaultTensor = tensor ;
   m_Verbose = false ;
   m_ShiftNegativeEigenvaluesCoefficient = 1.0 ;
+  m_ShiftNegativeEigenvalues = false ;
+  m_Correction = NoCorrection ;
+  m_SlabSize = 256 ;
 }
 
 template <class TGradientImagePixelType, class TTensorPrecision>
@@ -107,6 +119,159 @@ void DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
   this->ComputeTensorBasis();
 }
 
+template <class TGradientImagePixelType, class TTensorPrecision>
+void DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
+                                                    TTensorPrecision>
+::SetMaskImage(const MaskImageType * mask)
+{
+  this->ProcessObject::SetNthInput(1, const_cast<MaskImageType *>(mask) );
+}
+
+template <class TGradientImagePixelType, class TTensorPrecision>
+const typename DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
+                                                              TTensorPrecision>::MaskImageType
+* DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
+                                                 TTensorPrecision>
+::GetMaskImage() const
+{
+  return static_cast<const MaskImageType *>(this->ProcessObject::GetInput(1) );
+}
+
+template <class TGradientImagePixelType, class TTensorPrecision>
+void DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
+                                                    TTensorPrecision>
+::GenerateData()
+{
+  const MaskImageType * mask = this->GetMaskImage();
+  if( mask == ITK_NULLPTR )
+    {
+    Superclass::GenerateData();
+    return;
+    }
+
+  this->AllocateOutputs();
+  this->BeforeThreadedGenerateData();
+
+  // List the foreground voxels and set the background ones to the
+  // default tensor
+  OutputImageType *            outputImage = this->GetOutput();
+  const GradientImagesType *   gradientImage = this->GetInput();
+  const OutputImageRegionType  region = outputImage->GetRequestedRegion();
+
+  ImageRegionConstIteratorWithIndex<MaskImageType> mit(mask, region);
+  ImageRegionIterator<OutputImageType>             oit(outputImage, region);
+  typedef ImageRegionIterator<ScalarImageType> ScalarIteratorType;
+  ScalarIteratorType bit;
+  if( m_EstimateBaseline )
+    {
+    bit = ScalarIteratorType(static_cast<ScalarImageType *>(this->ProcessObject::GetOutput(1) ), region);
+    }
+
+  m_ForegroundInputOffsets.clear();
+  m_ForegroundOutputOffsets.clear();
+  const TensorPixelType backgroundTensor = this->CorrectTensor(m_DefaultTensor);
+  for( ; !mit.IsAtEnd(); ++mit, ++oit )
+    {
+    if( mit.Get() != 0 )
+      {
+      m_ForegroundInputOffsets.push_back(gradientImage->ComputeOffset(mit.GetIndex() ) );
+      m_ForegroundOutputOffsets.push_back(outputImage->ComputeOffset(mit.GetIndex() ) );
+      }
+    else
+      {
+      oit.Set(backgroundTensor);
+      if( m_EstimateBaseline )
+        {
+        // Baseline estimated from a zeroed signal, exp(0), as when the
+        // dwi itself was masked
+        bit.Set(NumericTraits<GradientPixelType>::OneValue() );
+        }
+      }
+    if( m_EstimateBaseline )
+      {
+      ++bit;
+      }
+    }
+  if( m_Verbose )
+    {
+    std::cout << "Foreground voxels: " << m_ForegroundInputOffsets.size() << std::endl;
+    }
+
+  MultiThreader * threader = this->GetMultiThreader();
+  threader->SetNumberOfThreads(this->GetNumberOfThreads() );
+  threader->SetSingleMethod(Self::ForegroundThreaderCallback, this);
+  threader->SingleMethodExecute();
+
+  std::vector<OffsetValueType>().swap(m_ForegroundInputOffsets);
+  std::vector<OffsetValueType>().swap(m_ForegroundOutputOffsets);
+
+  this->AfterThreadedGenerateData();
+}
+
+template <class TGradientImagePixelType, class TTensorPrecision>
+ITK_THREAD_RETURN_TYPE
+DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
+                                               TTensorPrecision>
+::ForegroundThreaderCallback(void * arg)
+{
+  MultiThreader::ThreadInfoStruct * info = static_cast<MultiThreader::ThreadInfoStruct *>(arg);
+  Self *                            filter = static_cast<Self *>(info->UserData);
+
+  filter->ThreadedGenerateForeground(info->ThreadID, info->NumberOfThreads);
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TGradientImagePixelType, class TTensorPrecision>
+void DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
+                                                    TTensorPrecision>
+::ThreadedGenerateForeground(ThreadIdType threadId, ThreadIdType numberOfThreads)
+{
+  const SizeValueType numberOfForegroundVoxels = m_ForegroundInputOffsets.size();
+  const SizeValueType first = numberOfForegroundVoxels * threadId / numberOfThreads;
+  const SizeValueType last = numberOfForegroundVoxels * ( threadId + 1 ) / numberOfThreads;
+
+  const GradientPixelType * dwi = this->GetInput()->GetBufferPointer();
+  TensorPixelType *         tensors = this->GetOutput()->GetBufferPointer();
+  GradientPixelType *       baseline = ITK_NULLPTR;
+  if( m_EstimateBaseline )
+    {
+    baseline = static_cast<ScalarImageType *>(this->ProcessObject::GetOutput(1) )->GetBufferPointer();
+    }
+
+  const unsigned int ng = m_NumberOfGradientDirections;
+  const unsigned int slabSize = m_SlabSize > 0 ? m_SlabSize : 1;
+  std::vector<TTensorPrecision> signals(slabSize * ng);
+  std::vector<TTensorPrecision> estimates(slabSize * 7);
+  std::vector<TTensorPrecision> workspace(slabSize * ng);
+  for( SizeValueType begin = first; begin < last; begin += slabSize )
+    {
+    const unsigned int numberOfVoxels =
+      static_cast<unsigned int>(std::min<SizeValueType>(slabSize, last - begin) );
+    for( unsigned int v = 0; v < numberOfVoxels; ++v )
+      {
+      const GradientPixelType * g = dwi + m_ForegroundInputOffsets[begin + v] * ng;
+      TTensorPrecision *        S = &signals[v * ng];
+      for( unsigned int i = 0; i < ng; ++i )
+        {
+        S[i] = g[i];
+        }
+      }
+
+    this->EstimateTensors(&signals[0], numberOfVoxels, &estimates[0], &workspace[0]);
+
+    for( unsigned int v = 0; v < numberOfVoxels; ++v )
+      {
+      const TTensorPrecision * D = &estimates[v * 7];
+      const OffsetValueType    offset = m_ForegroundOutputOffsets[begin + v];
+      tensors[offset] = this->ComputeOutputTensor(D);
+      if( baseline )
+        {
+        baseline[offset] = static_cast<GradientPixelType>(round(exp(D[6]) ) );
+        }
+      }
+    }
+}
+
 template <class TGradientImagePixelType, class TTensorPrecision>
 void DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType, TTensorPrecision>
 ::ThreadedGenerateData(const OutputImageRegionType& outputRegionForThread, ThreadIdType)
@@ -142,97 +307,303 @@ void DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType, TTe
     bit.GoToBegin();
     }
 
-  vnl_vector<TTensorPrecision> B(m_NumberOfGradientDirections);
-  vnl_vector<TTensorPrecision> D(7);
+  const unsigned int ng = m_NumberOfGradientDirections;
+  const unsigned int slabSize = m_SlabSize > 0 ? m_SlabSize : 1;
+  std::vector<TTensorPrecision> signals(slabSize * ng);
+  std::vector<TTensorPrecision> estimates(slabSize * 7);
+  std::vector<TTensorPrecision> workspace(slabSize * ng);
 
   while( !git.IsAtEnd() )
     {
-    GradientVectorType gv = git.Get();
-    for( unsigned int i = 0; i < m_NumberOfGradientDirections; ++i )
+    // Gather the signals of the next slab of voxels in a contiguous buffer
+    unsigned int numberOfVoxels = 0;
+    for( ; numberOfVoxels < slabSize && !git.IsAtEnd(); ++numberOfVoxels, ++git )
       {
-      B[i] = gv[i];
+      GradientVectorType gv = git.Get();
+      TTensorPrecision * S = &signals[numberOfVoxels * ng];
+      for( unsigned int i = 0; i < ng; ++i )
+        {
+        S[i] = gv[i];
+        }
       }
+
+    this->EstimateTensors(&signals[0], numberOfVoxels, &estimates[0], &workspace[0]);
+
+    for( unsigned int v = 0; v < numberOfVoxels; ++v )
+      {
+      const TTensorPrecision * D = &estimates[v * 7];
+      oit.Set( this->ComputeOutputTensor(D) );
+      ++oit; // Output (reconstructed tensor image) iterator
+      if( m_EstimateBaseline )
+        {
+        bit.Set(static_cast<GradientPixelType>(round(exp(D[6]) ) ) );
+        ++bit;
+        }
+      }
+    }
+}
+
+template <class TGradientImagePixelType, class TTensorPrecision>
+void DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
+                                                    TTensorPrecision>
+::EstimateTensors(const TTensorPrecision * signals,
+                  unsigned int numberOfVoxels,
+                  TTensorPrecision * estimates,
+                  TTensorPrecision *) const
+{
+  const unsigned int ng = m_NumberOfGradientDirections;
+
+  vnl_vector<TTensorPrecision> B(ng);
+  vnl_vector<TTensorPrecision> D(7);
+  for( unsigned int v = 0; v < numberOfVoxels; ++v )
+    {
+    B.copy_in(signals + v * ng);
     D = EstimateTensor(B);
-    TensorPixelType tensor = m_DefaultTensor ;
-    // First we need to estimate the S_0 then compare it to the threshold
-    // D[6] is the estimated S_0
-    if( exp(D[6]) >= m_Threshold )
+    std::copy(D.begin(), D.end(), estimates + v * 7);
+    }
+}
+
+template <class TGradientImagePixelType, class TTensorPrecision>
+typename DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
+                                                        TTensorPrecision>::TensorPixelType
+DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
+                                               TTensorPrecision>
+::ComputeOutputTensor(const TTensorPrecision * D) const
+{
+  TensorPixelType tensor = m_DefaultTensor ;
+  // First we need to estimate the S_0 then compare it to the threshold
+  // D[6] is the estimated S_0
+  if( exp(D[6]) >= m_Threshold )
+    {
+    // Copy all elements except the estimated S_0 (last element of D)
+    std::copy(D, D + 6, tensor.Begin() );
+
+    }
+  return this->CorrectTensor(tensor);
+}
+
+template <class TGradientImagePixelType, class TTensorPrecision>
+typename DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
+                                                        TTensorPrecision>::TensorPixelType
+DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
+                                               TTensorPrecision>
+::CorrectTensor(const TensorPixelType & input) const
+{
+  if( !m_ShiftNegativeEigenvalues && m_Correction == NoCorrection )
+    {
+    return input;
+    }
+
+  // Like the correction filters, the eigen-analysis is done in double
+  TensorPixelType                   tensor = input;
+  DiffusionTensor3DExtended<double> tensorDouble = ( DiffusionTensor3DExtended<TTensorPrecision> )tensor;
+  typename DiffusionTensor3DExtended<double>::EigenValuesArrayType   eigenValues;
+  typename DiffusionTensor3DExtended<double>::EigenVectorsMatrixType eigenVectors;
+  DiffusionTensor3DEigenSolver<DiffusionTensor3D<double> >::ComputeEigenAnalysis( tensorDouble, eigenValues, eigenVectors );
+  if( m_ShiftNegativeEigenvalues && eigenValues[ 0 ] <= 0 ) //eigenvalues are in ascending order
+    {
+    // This is equivalent to adding the shift to the eigenvalues, the
+    // eigenvectors are unchanged
+    const TTensorPrecision shift =
+      static_cast<TTensorPrecision>(-eigenValues[ 0 ] * m_ShiftNegativeEigenvaluesCoefficient) ;
+    for( int i = 0 ; i < 3 ; i++ )
       {
-      // Copy all elements except the estimated S_0 (last element of D)
-      std::copy(D.begin(), D.end() - 1, tensor.Begin() );
+      tensor( i , i ) += shift ;
+      eigenValues[ i ] += shift ;
+      }
+    }
+  if( m_Correction == NoCorrection )
+    {
+    return tensor;
+    }
 
+  Matrix<double, 3, 3> mat;
+  mat.Fill( 0 );
+  bool corrected = false;
+  for( int i = 0; i < 3; i++ )
+    {
+    if( m_Correction == AbsCorrection )
+      {
+      mat[i][i] = ( eigenValues[i] < 0 ? -eigenValues[i] : eigenValues[i] );
       }
-    if( m_ShiftNegativeEigenvalues )
+    else
+      {
+      mat[i][i] = ( eigenValues[i] <= 0 ? ZERO : eigenValues[i] );
+      }
+    corrected = corrected || mat[i][i] != eigenValues[i];
+    }
+  if( corrected )
     {
-      typename DiffusionTensor3D<TTensorPrecision>::EigenValuesArrayType eigenValues ;
-      typename DiffusionTensor3D<TTensorPrecision>::EigenVectorsMatrixType eigenVectors ;
-      tensor.ComputeEigenAnalysis( eigenValues, eigenVectors ) ;
-      if( eigenValues[ 0 ] <= 0 ) //eigenvalues are in ascending order
+    // The rows of eigenVectors are the eigenvectors
+    tensorDouble.SetTensorFromMatrix<double>( eigenVectors.GetTranspose() * mat * eigenVectors );
+    for( int i = 0; i < 6; i++ )
       {
-        Matrix<TTensorPrecision, 3, 3> eigenValueMatrix ;
-        TTensorPrecision shift = -eigenValues[ 0 ] * static_cast<TTensorPrecision>(m_ShiftNegativeEigenvaluesCoefficient) ;
-        for( int i = 0 ; i < 3 ; i++ )
+      tensor[i] = static_cast<TTensorPrecision>( tensorDouble[i] );
+      }
+    }
+  return tensor;
+}
+
+template <class TGradientImagePixelType, class TTensorPrecision>
+bool DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
+                                                    TTensorPrecision>
+::CholeskySolve(NormalMatrixType & A, NormalVectorType & b, AccumulateType minimumPivotRatio)
+{
+  // A = L L^T, L is stored in the lower triangle of A.  The relative
+  // squared pivots L_jj^2 / A_jj are at most 1, the first one is 1, so
+  // the ratio of the smallest to the largest is checked pivot by pivot.
+  for( unsigned int j = 0; j < 7; ++j )
+    {
+    AccumulateType d = A(j, j);
+    for( unsigned int k = 0; k < j; ++k )
+      {
+      d -= A(j, k) * A(j, k);
+      }
+    // The negated test also rejects NaNs
+    if( !( d > minimumPivotRatio * A(j, j) ) )
+      {
+      return false;
+      }
+    d = sqrt(d);
+    A(j, j) = d;
+    for( unsigned int i = j + 1; i < 7; ++i )
+      {
+      AccumulateType s = A(i, j);
+      for( unsigned int k = 0; k < j; ++k )
         {
-          tensor( i , i ) += shift ;
+        s -= A(i, k) * A(j, k);
         }
-/*      for( int i = 0 ; i < 3 ; i++ )//This is equivalent to adding directly the shift to the diagonal terms
+      A(i, j) = s / d;
+      }
+    }
+  // L y = b
+  for( unsigned int i = 0; i < 7; ++i )
+    {
+    AccumulateType s = b[i];
+    for( unsigned int k = 0; k < i; ++k )
+      {
+      s -= A(i, k) * b[k];
+      }
+    b[i] = s / A(i, i);
+    }
+  // L^T x = y
+  for( int i = 6; i >= 0; --i )
+    {
+    AccumulateType s = b[i];
+    for( unsigned int k = i + 1; k < 7; ++k )
+      {
+      s -= A(k, i) * b[k];
+      }
+    b[i] = s / A(i, i);
+    }
+  return true;
+}
+
+template <class TGradientImagePixelType, class TTensorPrecision>
+bool DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
+                                                    TTensorPrecision>
+::WeightedLeastSquaresStep(const TTensorPrecision * logSignals,
+                           const EstimateVectorType & previous,
+                           EstimateVectorType & estimate) const
+{
+  NormalMatrixType A;
+  NormalVectorType rhs;
+  A.fill(0);
+  rhs.fill(0);
+  for( unsigned int i = 0; i < m_NumberOfGradientDirections; ++i )
+    {
+    const TTensorPrecision * X = m_BMatrix[i];
+    TTensorPrecision         phi = 0;
+    for( unsigned int j = 0; j < 7; ++j )
+      {
+      phi += X[j] * previous[j];
+      }
+    phi = std::exp(phi);
+    const AccumulateType w = phi * phi;
+    for( unsigned int j = 0; j < 7; ++j )
+      {
+      const AccumulateType wx = w * X[j];
+      for( unsigned int k = 0; k <= j; ++k )
         {
-          eigenValueMatrix[ i ][ i ] = eigenValues[ i ] + shift ;
+        A(j, k) += wx * X[k];
         }
-        Matrix<TTensorPrecision, 3, 3> matrix ;
-        eigenVectors = eigenVectors.GetTranspose();
-        matrix = eigenVectors * eigenValueMatrix * eigenVectors.GetInverse();
-        for( int i = 0; i < 3; i++ )
-        {
-          for( int j = i; j < 3; j++ )
-          {
-            tensor( i, j ) = matrix[ i ][ j ] ;
-          }
-        }*/
+      rhs[j] += wx * logSignals[i];
       }
     }
-    oit.Set( tensor );
-    ++oit; // Output (reconstructed tensor image) iterator
-    ++git; // Gradient  image iterator
-    if( m_EstimateBaseline )
+  for( unsigned int j = 0; j < 7; ++j )
+    {
+    for( unsigned int k = 0; k < j; ++k )
       {
-      bit.Set(static_cast<GradientPixelType>(round(exp(D[6]) ) ) );
-      ++bit;
+      A(k, j) = A(j, k);
       }
-
     }
+  // Below this ratio of pivots the solution of the factorization loses
+  // more than half of the digits of the accumulation, the SVD is used
+  const AccumulateType minimumPivotRatio = std::sqrt(NumericTraits<AccumulateType>::epsilon() );
+  NormalMatrixType     factor(A);
+  NormalVectorType     solution(rhs);
+  if( !CholeskySolve(factor, solution, minimumPivotRatio) )
+    {
+    const vnl_matrix<AccumulateType> M(A.data_block(), 7, 7);
+    const vnl_vector<AccumulateType> b(rhs.data_block(), 7);
+    solution.copy_in(vnl_svd<AccumulateType>(M).solve(b).data_block() );
+    }
+  for( unsigned int j = 0; j < 7; ++j )
+    {
+    estimate[j] = static_cast<TTensorPrecision>(solution[j]);
+    if( !vnl_math_isfinite(estimate[j]) )
+      {
+      return false;
+      }
+    }
+  return true;
 }
 
 template <class TGradientImagePixelType, class TTensorPrecision>
 void DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
                                                     TTensorPrecision>
-::ComputeTensorBasis()
+::ComputeLogSignals(const TTensorPrecision * signals, unsigned int count,
+                    TTensorPrecision * logSignals)
 {
-  if( m_NumberOfGradientDirections < 7 )
+  for( unsigned int i = 0; i < count; ++i )
     {
-    itkExceptionMacro( << "Not enough gradient directions supplied. Need to supply at least 6" );
+    logSignals[i] = signals[i] == 0 ? 0 : std::log(signals[i]);
     }
+}
 
-  m_BMatrix.set_size(m_NumberOfGradientDirections, 7);
-  for( unsigned int m = 0; m < m_NumberOfGradientDirections; m++ )
+template <class TGradientImagePixelType, class TTensorPrecision>
+void DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
+                                                    TTensorPrecision>
+::LinearLeastSquaresEstimate(const TTensorPrecision * logSignals,
+                             EstimateVectorType & estimate) const
+{
+  for( unsigned int j = 0; j < 7; ++j )
     {
-    m_BMatrix[m][0] =     -m_BValue * m_GradientDirectionContainer->ElementAt(m)[0]
-      * m_GradientDirectionContainer->ElementAt(m)[0];
-    m_BMatrix[m][1] = 2 * -m_BValue * m_GradientDirectionContainer->ElementAt(m)[0]
-      * m_GradientDirectionContainer->ElementAt(m)[1];
-    m_BMatrix[m][2] = 2 * -m_BValue * m_GradientDirectionContainer->ElementAt(m)[0]
-      * m_GradientDirectionContainer->ElementAt(m)[2];
-    m_BMatrix[m][3] =     -m_BValue * m_GradientDirectionContainer->ElementAt(m)[1]
-      * m_GradientDirectionContainer->ElementAt(m)[1];
-    m_BMatrix[m][4] = 2 * -m_BValue * m_GradientDirectionContainer->ElementAt(m)[1]
-      * m_GradientDirectionContainer->ElementAt(m)[2];
-    m_BMatrix[m][5] =     -m_BValue * m_GradientDirectionContainer->ElementAt(m)[2]
-      * m_GradientDirectionContainer->ElementAt(m)[2];
-    m_BMatrix[m][6] = 1;
+    const TTensorPrecision * G = m_TensorBasis[j];
+    TTensorPrecision         d = 0;
+    for( unsigned int i = 0; i < m_NumberOfGradientDirections; ++i )
+      {
+      d += G[i] * logSignals[i];
+      }
+    estimate[j] = d;
     }
+}
 
-  m_TensorBasis = vnl_svd<TTensorPrecision>(m_BMatrix).pinverse();
+template <class TGradientImagePixelType, class TTensorPrecision>
+void DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
+                                                    TTensorPrecision>
+::ComputeTensorBasis()
+{
+  if( m_NumberOfGradientDirections < 7 )
+    {
+    itkExceptionMacro( << "Not enough gradient directions supplied. Need to supply at least 6" );
+    }
 
+  // The b-matrix only depends on the gradient table, its pseudo-inverse
+  // is computed once per table and shared through the registry.
+  m_GradientScheme = m_GradientSchemeRegistry->GetScheme(m_GradientDirectionContainer, m_BValue);
+  m_BMatrix = m_GradientScheme->GetBMatrix();
+  m_TensorBasis = m_GradientScheme->GetTensorBasis();
 }
 
 template <class TGradientImagePixelType, class TTensorPrecision>
@@ -280,6 +651,9 @@ void DiffusionTensor3DReconstructionImageFilterBase<TGradientImagePixelType,
      << m_NumberOfGradientDirections << std::endl;
   os << indent << "Threshold for reference B0 image: " << m_Threshold << std::endl;
   os << indent << "BValue: " << m_BValue << std::endl;
+  os << indent << "Correction: " << m_Correction << std::endl;
+  os << indent << "SlabSize: " << m_SlabSize << std::endl;
+  os << indent << "GradientSchemeRegistry: " << m_GradientSchemeRegistry.GetPointer() << std::endl;
 }
 
 }
@@ -28,6 +28,11 @@ namespace itk
  * DiffusionTensor3DReconstructionImageFilterBase to implement a
  * least-squares tensor estimation.
  *
+ * The log-signals of a whole slab of voxels (see SetSlabSize()) are
+ * gathered in a contiguous matrix which is multiplied by the tensor
+ * basis in a single cache-blocked matrix product, instead of one
+ * matrix-vector product per voxel.
+ *
  * \par References:
  * \li<a href="http://lmi.bwh.harvard.edu/papers/pdfs/2002/westinMEDIA02.pdf">[1]</a>
  * <em>C.F.Westin, S.E.Maier, H.Mamata, A.Nabavi, F.A.Jolesz, R.Kikinis,
@@ -81,6 +86,23 @@ protected:
   virtual vnl_vector<TTensorPrecision>
   EstimateTensor(const vnl_vector<TTensorPrecision>& S) const ITK_OVERRIDE;
 
+  virtual void EstimateTensors(const TTensorPrecision * signals,
+                               unsigned int numberOfVoxels,
+                               TTensorPrecision * estimates,
+                               TTensorPrecision * workspace) const ITK_OVERRIDE;
+
+  virtual void ComputeTensorBasis() ITK_OVERRIDE;
+
+  /** Block sizes of the slab matrix product.  A block of the
+   * transposed tensor basis (DirectionBlockSize x 7) stays in the L1
+   * cache while it is applied to VoxelBlockSize voxels. */
+  itkStaticConstMacro(VoxelBlockSize, unsigned int, 64);
+  itkStaticConstMacro(DirectionBlockSize, unsigned int, 128);
+
+  /** Transpose of m_TensorBasis, so that the 7 coefficients of one
+   * gradient direction are contiguous in memory */
+  typename Superclass::TensorBasisMatrixType m_TensorBasisTranspose;
+
 };
 
 }
@@ -15,6 +15,9 @@
      PURPOSE.  See the above copyright notices for more information.
 
 =========================================================================*/
+#include <algorithm>
+#include <cmath>
+
 namespace itk
 {
 
@@ -33,11 +36,67 @@ DiffusionTensor3DReconstructionLinearImageFilter<TGradientImagePixelType,
       }
     else
       {
-      B[i] = log(S[i]);
+      B[i] = std::log(S[i]);
       }
     }
 
   return this->m_TensorBasis * B;
 }
 
+template <class TGradientImagePixelType, class TTensorPrecision>
+void
+DiffusionTensor3DReconstructionLinearImageFilter<TGradientImagePixelType,
+                                                 TTensorPrecision>
+::ComputeTensorBasis()
+{
+  Superclass::ComputeTensorBasis();
+  m_TensorBasisTranspose = this->m_GradientScheme->GetTensorBasisTranspose();
+}
+
+template <class TGradientImagePixelType, class TTensorPrecision>
+void
+DiffusionTensor3DReconstructionLinearImageFilter<TGradientImagePixelType,
+                                                 TTensorPrecision>
+::EstimateTensors(const TTensorPrecision * signals,
+                  unsigned int numberOfVoxels,
+                  TTensorPrecision * estimates,
+                  TTensorPrecision * workspace) const
+{
+  const unsigned int ng = this->m_NumberOfGradientDirections;
+
+  TTensorPrecision * logSignals = workspace;
+  Superclass::ComputeLogSignals(signals, numberOfVoxels * ng, logSignals);
+
+  // estimates (numberOfVoxels x 7) = logSignals (numberOfVoxels x ng) *
+  // m_TensorBasisTranspose (ng x 7).  The directions are accumulated in
+  // increasing order for every voxel, like the matrix-vector product of
+  // EstimateTensor().
+  const TTensorPrecision * basis = m_TensorBasisTranspose.data_block();
+  std::fill(estimates, estimates + numberOfVoxels * 7, TTensorPrecision(0) );
+  for( unsigned int v0 = 0; v0 < numberOfVoxels; v0 += VoxelBlockSize )
+    {
+    const unsigned int v1 = std::min(v0 + VoxelBlockSize, numberOfVoxels);
+    for( unsigned int k0 = 0; k0 < ng; k0 += DirectionBlockSize )
+      {
+      const unsigned int k1 = std::min(k0 + DirectionBlockSize, ng);
+      for( unsigned int v = v0; v < v1; ++v )
+        {
+        const TTensorPrecision * L = &logSignals[v * ng];
+        TTensorPrecision *       D = estimates + v * 7;
+        TTensorPrecision         acc[7];
+        std::copy(D, D + 7, acc);
+        for( unsigned int k = k0; k < k1; ++k )
+          {
+          const TTensorPrecision * G = basis + k * 7;
+          for( unsigned int j = 0; j < 7; ++j )
+            {
+            acc[j] += L[k] * G[j];
+            }
+          }
+        std::copy(acc, acc + 7, D);
+        }
+      }
+    }
+}
+
 }
@@ -20,7 +20,7 @@
 #define __itkDiffusionTensor3DReconstructionNonlinearImageFilter_h_
 
 #include "itkDiffusionTensor3DReconstructionImageFilterBase.h"
-#include "vnl/vnl_least_squares_function.h"
+#include "itkSimpleFastMutexLock.h"
 
 namespace itk
 {
@@ -31,6 +31,12 @@ namespace itk
  * non-linear least-squares tensor estimation.  This requires an
  * optimization and this implementation uses levenberg-marquardt.
  *
+ * The optimizer is implemented in this class with the analytic
+ * Jacobian of the exponential model and fixed-size 7x7 normal
+ * equations, so the filter is reentrant and runs multithreaded.  It is
+ * initialized with a weighted least-squares estimate, which is also
+ * the result for voxels where the fit does not converge.
+ *
  * \note
  * This work is part of the National Alliance for Medical image Computing
  * (NAMIC), funded by the National Institutes of Health through the NIH Roadmap
@@ -74,18 +80,50 @@ public:
   /** Get step size for optimizer for non-linear fit.  A
   levenburg-Marquadt optimizer is used.  The default is 1.0e-10. */
   itkGetMacro( Step, double );
+
+  /** Maximum number of levenberg-marquardt iterations per voxel.  The
+  default is 100. */
+  itkSetMacro( MaximumNumberOfIterations, unsigned int );
+  itkGetMacro( MaximumNumberOfIterations, unsigned int );
+
+  /** Number of voxels of the last update for which the non-linear fit
+  failed and the weighted least-squares estimate was kept. */
+  itkGetConstMacro( NumberOfFailedVoxels, unsigned long );
 protected:
-  DiffusionTensor3DReconstructionNonlinearImageFilter() : m_Step(1.0e-10)
+  DiffusionTensor3DReconstructionNonlinearImageFilter() : m_Step(1.0e-10),
+    m_MaximumNumberOfIterations(100),
+    m_NumberOfFailedVoxels(0)
   {
   };
   virtual ~DiffusionTensor3DReconstructionNonlinearImageFilter()
   {
   };
 
+  virtual void BeforeThreadedGenerateData() ITK_OVERRIDE;
+
   virtual vnl_vector<TTensorPrecision>
   EstimateTensor(const vnl_vector<TTensorPrecision>& S) const ITK_OVERRIDE;
 
+  virtual void EstimateTensors(const TTensorPrecision * signals,
+                               unsigned int numberOfVoxels,
+                               TTensorPrecision * estimates,
+                               TTensorPrecision * workspace) const ITK_OVERRIDE;
+
+  typedef typename Superclass::EstimateVectorType EstimateVectorType;
+  typedef typename Superclass::NormalMatrixType   NormalMatrixType;
+  typedef typename Superclass::NormalVectorType   NormalVectorType;
+  typedef typename Superclass::AccumulateType     AccumulateType;
+
+  /** Levenberg-marquardt fit of the signals S of one voxel starting
+  from x.  Returns false if it did not converge. */
+  bool FitExponentialModel(const TTensorPrecision * S, EstimateVectorType & x) const;
+
   double m_Step;
+
+  unsigned int m_MaximumNumberOfIterations;
+
+  mutable unsigned long       m_NumberOfFailedVoxels;
+  mutable SimpleFastMutexLock m_NumberOfFailedVoxelsLock;
 };
 
 }
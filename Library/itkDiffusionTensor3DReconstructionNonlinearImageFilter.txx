@@ -15,42 +15,22 @@
      PURPOSE.  See the above copyright notices for more information.
 
 =========================================================================*/
-#include <vnl/algo/vnl_levenberg_marquardt.h>
+#include "vnl/vnl_math.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 namespace itk
 {
 
-namespace Functor
-{
-template <class TTensorPrecision>
-class ExponentialLeastSquaresFunction : public vnl_least_squares_function
+template <class TGradientImagePixelType, class TTensorPrecision>
+void
+DiffusionTensor3DReconstructionNonlinearImageFilter<TGradientImagePixelType,
+                                                    TTensorPrecision>
+::BeforeThreadedGenerateData()
 {
-public:
-  ExponentialLeastSquaresFunction(unsigned int                   number_of_residuals,
-                                  const vnl_matrix<TTensorPrecision>* design_matrix,
-                                  const vnl_vector<TTensorPrecision>* signal) :
-    vnl_least_squares_function(7, number_of_residuals, no_gradient),
-    m_Design_Matrix(design_matrix),
-    m_Signal(signal)
-  {
-  }
-
-  void f(const vnl_vector<double> & x,
-         vnl_vector<double> & fx) ITK_OVERRIDE
-  {
-    vnl_vector<double> predictedsignal(n_);
-    predictedsignal = (*m_Design_Matrix) * x;
-    for( unsigned int i = 0; i < n_; ++i )
-      {
-      predictedsignal[i] = exp(predictedsignal[i]);
-      fx[i] = (*m_Signal)[i] - predictedsignal[i];
-      }
-  }
-
-private:
-  const vnl_matrix<TTensorPrecision>* m_Design_Matrix;
-  const vnl_vector<TTensorPrecision>* m_Signal;
-};
+  Superclass::BeforeThreadedGenerateData();
+  m_NumberOfFailedVoxels = 0;
 }
 
 template <class TGradientImagePixelType, class TTensorPrecision>
@@ -59,43 +39,185 @@ DiffusionTensor3DReconstructionNonlinearImageFilter<TGradientImagePixelType,
                                                     TTensorPrecision>
 ::EstimateTensor(const vnl_vector<TTensorPrecision>& S) const
 {
-  vnl_vector<TTensorPrecision> B(this->m_NumberOfGradientDirections);
-  for( unsigned int i = 0; i < S.size(); ++i )
+  vnl_vector<TTensorPrecision> estimate(7);
+  vnl_vector<TTensorPrecision> workspace(S.size() );
+  this->EstimateTensors(S.data_block(), 1, estimate.data_block(), workspace.data_block() );
+  return estimate;
+}
+
+template <class TGradientImagePixelType, class TTensorPrecision>
+void
+DiffusionTensor3DReconstructionNonlinearImageFilter<TGradientImagePixelType,
+                                                    TTensorPrecision>
+::EstimateTensors(const TTensorPrecision * signals,
+                  unsigned int numberOfVoxels,
+                  TTensorPrecision * estimates,
+                  TTensorPrecision * workspace) const
+{
+  const unsigned int ng = this->m_NumberOfGradientDirections;
+
+  Superclass::ComputeLogSignals(signals, numberOfVoxels * ng, workspace);
+  unsigned long numberOfFailedVoxels = 0;
+  for( unsigned int v = 0; v < numberOfVoxels; ++v )
     {
-    if( S[i] == 0 )
+    const TTensorPrecision * S = signals + v * ng;
+    const TTensorPrecision * B = workspace + v * ng;
+
+    // Weighted least-squares initialization
+    EstimateVectorType lls;
+    this->LinearLeastSquaresEstimate(B, lls);
+    EstimateVectorType wls;
+    if( !this->WeightedLeastSquaresStep(B, lls, wls) )
       {
-      B[i] = 0;
+      wls = lls;
       }
-    else
+
+    EstimateVectorType estimate(wls);
+    // The output is the default tensor below the threshold, there is
+    // no need to refine those voxels.
+    if( exp(wls[6]) >= this->m_Threshold )
       {
-      B[i] = log(S[i]);
+      if( !this->FitExponentialModel(S, estimate) )
+        {
+        estimate = wls;
+        ++numberOfFailedVoxels;
+        }
       }
+    estimate.copy_out(estimates + v * 7);
     }
 
-  vnl_vector<TTensorPrecision> estimate(this->m_TensorBasis * B);
-
-  typedef Functor::ExponentialLeastSquaresFunction<TTensorPrecision> FittingFunctionType;
-
-  unsigned int        ng = this->m_NumberOfGradientDirections;
-  FittingFunctionType lsqf(ng,
-                           &this->m_BMatrix,
-                           &S);
-
-  // Levenberg-Marquardt is optimal for functions
-  // which are sum of squared residuals
-  vnl_levenberg_marquardt optimizer(lsqf);
-  optimizer.set_x_tolerance(m_Step);
-  optimizer.set_f_tolerance(1.0e-6);
-  if( this->m_Verbose )
-  {
-    std::cout << this->m_BMatrix.size() << std::endl;
-  }
-  if( !optimizer.minimize(estimate) )
+  if( numberOfFailedVoxels > 0 )
     {
-    throw itk::ExceptionObject("Error in non-linear tensor estimation");
+    m_NumberOfFailedVoxelsLock.Lock();
+    m_NumberOfFailedVoxels += numberOfFailedVoxels;
+    m_NumberOfFailedVoxelsLock.Unlock();
     }
+}
 
-  return estimate;
+template <class TGradientImagePixelType, class TTensorPrecision>
+bool
+DiffusionTensor3DReconstructionNonlinearImageFilter<TGradientImagePixelType,
+                                                    TTensorPrecision>
+::FitExponentialModel(const TTensorPrecision * S, EstimateVectorType & x) const
+{
+  // Minimizes F(x) = sum_i (S_i - exp(X_i x))^2 where X_i is the i-th row
+  // of m_BMatrix.  The Jacobian of the residuals is J_ij = -exp(X_i x) X_ij.
+  // Marquardt damping: (J^T J + mu diag(J^T J)) h = -J^T r
+  const unsigned int     ng = this->m_NumberOfGradientDirections;
+  const TTensorPrecision xtol = static_cast<TTensorPrecision>(m_Step);
+  const AccumulateType   ftol = 1.0e-6;
+
+  NormalMatrixType A;
+  NormalVectorType g;
+  AccumulateType   cost = 0;
+  AccumulateType   mu = 1.0e-3;
+  AccumulateType   nu = 2;
+  bool             updateJacobian = true;
+  for( unsigned int iter = 0; iter < m_MaximumNumberOfIterations; ++iter )
+    {
+    if( updateJacobian )
+      {
+      A.fill(0);
+      g.fill(0);
+      cost = 0;
+      for( unsigned int i = 0; i < ng; ++i )
+        {
+        const TTensorPrecision * X = this->m_BMatrix[i];
+        TTensorPrecision         p = 0;
+        for( unsigned int j = 0; j < 7; ++j )
+          {
+          p += X[j] * x[j];
+          }
+        const TTensorPrecision predicted = std::exp(p);
+        const TTensorPrecision r = S[i] - predicted;
+        cost += r * r;
+        for( unsigned int j = 0; j < 7; ++j )
+          {
+          const TTensorPrecision Jj = predicted * X[j];
+          g[j] -= Jj * r;
+          for( unsigned int k = 0; k <= j; ++k )
+            {
+            A(j, k) += Jj * predicted * X[k];
+            }
+          }
+        }
+      for( unsigned int j = 0; j < 7; ++j )
+        {
+        for( unsigned int k = 0; k < j; ++k )
+          {
+          A(k, j) = A(j, k);
+          }
+        }
+      if( !vnl_math_isfinite(cost) )
+        {
+        return false;
+        }
+      updateJacobian = false;
+      }
+
+    NormalMatrixType M(A);
+    for( unsigned int j = 0; j < 7; ++j )
+      {
+      M(j, j) += mu * A(j, j);
+      }
+    NormalVectorType h(-g);
+    if( !Superclass::CholeskySolve(M, h, NumericTraits<AccumulateType>::epsilon() ) )
+      {
+      mu *= nu;
+      nu *= 2;
+      continue;
+      }
+
+    if( h.two_norm() <= xtol * (x.two_norm() + xtol) )
+      {
+      return true;
+      }
+
+    EstimateVectorType xnew;
+    for( unsigned int j = 0; j < 7; ++j )
+      {
+      xnew[j] = static_cast<TTensorPrecision>(x[j] + h[j]);
+      }
+    AccumulateType newcost = 0;
+    for( unsigned int i = 0; i < ng; ++i )
+      {
+      const TTensorPrecision * X = this->m_BMatrix[i];
+      TTensorPrecision         p = 0;
+      for( unsigned int j = 0; j < 7; ++j )
+        {
+        p += X[j] * xnew[j];
+        }
+      const TTensorPrecision r = S[i] - std::exp(p);
+      newcost += r * r;
+      }
+
+    // Ratio of the actual to the predicted decrease of the cost
+    AccumulateType predictedDecrease = 0;
+    for( unsigned int j = 0; j < 7; ++j )
+      {
+      predictedDecrease += h[j] * (mu * A(j, j) * h[j] - g[j]);
+      }
+    const AccumulateType rho = (cost - newcost) / predictedDecrease;
+    if( vnl_math_isfinite(newcost) && rho > 0 )
+      {
+      const bool converged = (cost - newcost) <= ftol * cost;
+      x = xnew;
+      if( converged )
+        {
+        return true;
+        }
+      const AccumulateType t = 2 * rho - 1;
+      mu *= std::max(AccumulateType(1.0 / 3.0), 1 - t * t * t);
+      nu = 2;
+      updateJacobian = true;
+      }
+    else
+      {
+      mu *= nu;
+      nu *= 2;
+      }
+    }
+  return false;
 }
 
 }
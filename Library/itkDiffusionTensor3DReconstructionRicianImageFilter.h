@@ -26,21 +26,30 @@
 #include "itkVectorContainer.h"
 #include "itkVectorImage.h"
 #include "itkSingleValuedCostFunction.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkDiffusionTensor3DGradientSchemeRegistry.h"
 #if (ITK_VERSION_MAJOR < 4)
 typedef int ThreadIdType;
 #else
 #include "itkIntTypes.h"
 #endif
 
-#include "vnl/vnl_cost_function.h"
-
 #include "cephes/cephes.h"
-#include <iomanip>
-#include <iostream>
 
 namespace itk
 {
 
+/** \class RicianLikelihood
+ * \brief Negative log-likelihood of the diffusion weighted signals of
+ * one voxel under a Rician noise model.
+ *
+ * The signal model is A_i = S0 exp(X_i D) where X_i is the i-th row of
+ * the design matrix and D the 6 unique tensor elements.  The
+ * derivative is computed in closed form using
+ * d/dz log(I0(z)) = I1(z) / I0(z) = i1e(z) / i0e(z).
+ *
+ * The design matrix is not copied, it must outlive the cost function.
+ */
 template <class TSignalType>
 class RicianLikelihood : public SingleValuedCostFunction
 {
@@ -52,135 +61,27 @@ public:
   itkNewMacro(Self);
   typedef typename Superclass::ParametersType ParametersType;
   typedef typename Superclass::DerivativeType DerivativeType;
+  typedef typename Superclass::MeasureType    MeasureType;
 
-  virtual typename Superclass::MeasureType GetValue(const ParametersType & D) const ITK_OVERRIDE
+  virtual MeasureType GetValue(const ParametersType & D) const ITK_OVERRIDE
   {
-    const double       s2 = m_Sigma * m_Sigma;
-    const unsigned int ns = m_Signal.size();
-
-    vnl_vector<double> attenuation(ns);
-    attenuation = m_Design_Matrix * D;
-    for( unsigned int i = 0; i < ns; ++i )
-      {
-      attenuation[i] = exp(attenuation[i]);
-      }
-    vnl_vector<double> A = m_S0 * attenuation;
-    // int ierr;
-
-    vnl_vector<double> loglhood(ns);
-    double             sumloglhood = 0.0;
-    // std::cout << "s: " << m_Signal << std::endl;
-    // std::cout << "A: " << A << std::endl;
-//    std::cout << "s0: " << m_S0 << std::endl;
-    for( unsigned int i = 0; i < ns; ++i )
-      {
-//      std::cout << "s2: " << s2 << std::endl;
-//      std::cout << "I0: " << besseli0(m_Signal[i]*A[i]/s2,0,&ierr) << std::endl;
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //
-      //                                                                                                      Correction
-      // factor
-//      loglhood[i] = log(m_Signal[i]) - log(s2) - (m_Signal[i]*m_Signal[i] + A[i]*A[i])/(2*s2) +
-// log(besseli0(m_Signal[i]*A[i]/s2,1,&ierr)) + m_Signal[i]*A[i]/s2 ;
-#if 0   // amos fortan bessel
-      loglhood[i] =
-        -(m_Signal[i] * m_Signal[i] + A[i]
-          * A[i]) / (2 * s2) + log(besseli0(m_Signal[i] * A[i] / s2, 1, &ierr) ) + m_Signal[i] * A[i] / s2;
-#else   // cephes c bessel
-      loglhood[i] =
-        -(m_Signal[i] * m_Signal[i] + A[i]
-          * A[i]) / (2 * s2) + log(i0e(m_Signal[i] * A[i] / s2) ) + m_Signal[i] * A[i] / s2;
-#endif
-//       std::cout << "[" << std::setw(2) << i << "]: " << std::setw(13) << m_Signal[i]
-//                 << std::setw(13) << A[i]
-//                 << std::setw(13) << loglhood[i]
-//                 << std::endl;
-      sumloglhood += loglhood[i];
-      }
+    MeasureType value;
 
-//    std::cout << std::endl << "D: " << D << std::endl;
-//    std::cout << "logl: " << -sumloglhood << std::endl;
-    return -sumloglhood;
+    this->Evaluate(D, value, ITK_NULLPTR);
+    return value;
   }
 
   virtual void GetDerivative(const ParametersType & D, DerivativeType & gradient) const ITK_OVERRIDE
   {
-//    std::cout << "D: "<< D << std::endl;
-//    std::cout << "f(D): "<< this->GetValue(D) << std::endl;
-    const double gs = 1.0e-10;
+    MeasureType value;
 
-    // const double f = this->GetValue(D);
-
-    Array<double> hi(6);
-    Array<double> lo(6);
-    for( unsigned int j = 0; j < 6; ++j )
-      {
-      Array<double> hid(D);
-      Array<double> lod(D);
-      hid[j] = hid[j] + gs;
-      lod[j] = lod[j] - gs;
-
-      hi[j] = this->GetValue(hid);
-      lo[j] = this->GetValue(lod);
-      gradient[j] = (hi[j] - lo[j]) / (2 * gs);
-      }
+    this->Evaluate(D, value, &gradient);
+  }
 
-//    std::cout << "fdg: " << gradient << std::endl;
-
-//     const double s2 = m_Sigma * m_Sigma;
-//     const unsigned int ns = m_Signal.size();
-//     const vnl_matrix<double> X = m_Design_Matrix;
-
-//     vnl_vector<double> attenuation(ns);
-//     attenuation = m_Design_Matrix * D;
-//     for(unsigned int i = 0; i < ns; ++i)
-//       attenuation[i] = exp(attenuation[i]);
-//     vnl_vector<double> A = m_S0*attenuation;
-//     int ierr;
-
-//     gradient.fill(0.0);
-//     for(unsigned int j = 0; j < 6; ++j)
-//       {
-//         for(unsigned int i = 0; i < ns; ++i)
-//         {
-//         double besselarg = m_Signal[i] * m_S0 * exp(X(i,j) * D[j]) / s2;
-//         gradient[j] += -(m_S0*m_S0 * X(i,j) * exp(2*X(i,j) * D[j]))/s2 + (X(i,j) * exp(X(i,j) * D[j]) * m_S0 *
-// m_Signal[i])/s2 *
-//                          besseli1(besselarg,1,&ierr) / besseli0(besselarg,1,&ierr);
-//         }
-//       }
-//     gradient = -gradient;
-//     std::cout << "g: " << gradient << std::endl;
+  virtual void GetValueAndDerivative(const ParametersType & D, MeasureType & value,
+                                     DerivativeType & gradient) const ITK_OVERRIDE
+  {
+    this->Evaluate(D, value, &gradient);
   }
 
   virtual unsigned int GetNumberOfParameters() const ITK_OVERRIDE
@@ -188,7 +89,11 @@ public:
     return 6;
   }
 
-  itkSetMacro(Design_Matrix, vnl_matrix<double> );
+  void SetDesign_Matrix(const vnl_matrix<double> * designMatrix)
+  {
+    m_Design_Matrix = designMatrix;
+  }
+
   itkSetMacro(S0, double);
   itkSetMacro(Sigma, double);
 
@@ -209,10 +114,53 @@ public:
   }
 
 protected:
-  vnl_matrix<double> m_Design_Matrix;
-  double             m_S0;
-  double             m_Sigma;
-  vnl_vector<double> m_Signal;
+  RicianLikelihood() : m_Design_Matrix(ITK_NULLPTR), m_S0(0.0), m_Sigma(1.0)
+  {
+  }
+
+  /** Computes the negative log-likelihood and, if gradient is not
+   * null, its derivative with respect to the 6 tensor elements. */
+  void Evaluate(const ParametersType & D, MeasureType & value, DerivativeType * gradient) const
+  {
+    const double             s2 = m_Sigma * m_Sigma;
+    const unsigned int       ns = m_Signal.size();
+    const vnl_matrix<double> & X = *m_Design_Matrix;
+
+    if( gradient )
+      {
+      gradient->SetSize(6);
+      gradient->Fill(0.0);
+      }
+    double sumloglhood = 0.0;
+    for( unsigned int i = 0; i < ns; ++i )
+      {
+      double attenuation = 0.0;
+      for( unsigned int j = 0; j < 6; ++j )
+        {
+        attenuation += X(i, j) * D[j];
+        }
+      const double A = m_S0 * exp(attenuation);
+      const double z = m_Signal[i] * A / s2;
+      const double i0z = i0e(z);
+      // log(I0(z)) = log(i0e(z)) + z
+      sumloglhood += -(m_Signal[i] * m_Signal[i] + A * A) / (2 * s2) + log(i0z) + z;
+      if( gradient )
+        {
+        // d(loglhood)/dD_j = (-A / s2 + m_Signal[i] / s2 * I1(z) / I0(z)) * A * X_ij
+        const double dA = (-A + m_Signal[i] * i1e(z) / i0z) / s2 * A;
+        for( unsigned int j = 0; j < 6; ++j )
+          {
+          (*gradient)[j] -= dA * X(i, j);
+          }
+        }
+      }
+    value = -sumloglhood;
+  }
+
+  const vnl_matrix<double> * m_Design_Matrix;
+  double                     m_S0;
+  double                     m_Sigma;
+  vnl_vector<double>         m_Signal;
 
 };
 
@@ -292,6 +240,26 @@ public:
   /** Set method to set initial tensor image got by linear estimation **/
   void SetInitialTensor( TensorImageType *image);
 
+  /** Registry sharing the gradient matrix and its pseudo-inverse
+   * between filters, the global registry by default. */
+  typedef DiffusionTensor3DGradientSchemeRegistry<double> GradientSchemeRegistryType;
+  typedef GradientSchemeRegistryType::SchemeType          GradientSchemeType;
+  itkSetObjectMacro( GradientSchemeRegistry, GradientSchemeRegistryType );
+  itkGetObjectMacro( GradientSchemeRegistry, GradientSchemeRegistryType );
+
+  /** Optional mask: the voxels where it is zero keep the initial
+   * tensor. */
+  typedef Image<unsigned char, 3> MaskImageType;
+  void SetMaskImage( const MaskImageType *mask )
+  {
+    this->ProcessObject::SetNthInput( 2, const_cast<MaskImageType *>(mask) );
+  }
+
+  const MaskImageType * GetMaskImage() const
+  {
+    return static_cast<const MaskImageType *>(this->ProcessObject::GetInput(2) );
+  }
+
   /** Set method to set the reference image. */
   void SetReferenceImage( ReferenceImageType *referenceImage )
   {
@@ -319,6 +287,18 @@ public:
     m_Sigma = _sigma;
   }
 
+  /** Maximum number of gradient descent iterations per voxel.  The
+   * default is 100. */
+  itkSetMacro( MaximumNumberOfIterations, unsigned int );
+  itkGetMacro( MaximumNumberOfIterations, unsigned int );
+
+  /** Convergence report of the last update: number of voxels that were
+   * optimized, and number of those where the optimizer stopped before
+   * converging (iteration cap reached or optimization error).  The
+   * initial tensor is kept when the optimization throws an error. */
+  itkGetConstMacro( NumberOfOptimizedVoxels, unsigned long );
+  itkGetConstMacro( NumberOfNonConvergedVoxels, unsigned long );
+
   /** Get reference image */
   virtual ReferenceImageType * GetReferenceImage()
   {
@@ -401,6 +381,9 @@ protected:
     } GradientImageTypeEnumeration;
 private:
 
+  GradientSchemeRegistryType::Pointer   m_GradientSchemeRegistry;
+  GradientSchemeType::ConstPointer      m_GradientScheme;
+
   /* Tensor basis coeffs */
   TensorBasisMatrixType m_TensorBasis;
 
@@ -430,6 +413,15 @@ private:
   /** Sigma **/
   TTensorType m_Sigma;
 
+  /** Design matrix of the signal model, -BValue * m_BMatrix */
+  vnl_matrix<double> m_DesignMatrix;
+
+  unsigned int m_MaximumNumberOfIterations;
+
+  unsigned long       m_NumberOfOptimizedVoxels;
+  unsigned long       m_NumberOfNonConvergedVoxels;
+  SimpleFastMutexLock m_ConvergenceReportLock;
+
   // these constants are not used and non-integral static const
   // variables in-line in classes is a gnu extension, not standard C++
   // static const double EPS = 1e-10;
@@ -23,12 +23,8 @@
 #include "itkArray.h"
 #include "vnl/vnl_vector.h"
 #include "itkDiffusionTensor3DReconstructionRicianImageFilter.h"
-#include "vnl/algo/vnl_lbfgs.h"
-#include "vnl/algo/vnl_powell.h"
-#include "vnl/algo/vnl_conjugate_gradient.h"
-#include "itkLBFGSBOptimizer.h"
 #include "itkRegularStepGradientDescentOptimizer.h"
-// #include "itkRegularStepGradientDescentOptimizer.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -47,8 +43,12 @@ DiffusionTensor3DReconstructionRicianImageFilter<TReferenceImagePixelType,
   m_Threshold = NumericTraits<ReferencePixelType>::min();
   m_GradientImageTypeEnumeration = Else;
   m_GradientDirectionContainer = ITK_NULLPTR;
+  m_GradientSchemeRegistry = GradientSchemeRegistryType::GetInstance();
   m_TensorBasis.set_identity();
   m_BValue = 1.0;
+  m_MaximumNumberOfIterations = 100;
+  m_NumberOfOptimizedVoxels = 0;
+  m_NumberOfNonConvergedVoxels = 0;
 }
 
 template <class TReferenceImagePixelType,
@@ -85,12 +85,11 @@ void DiffusionTensor3DReconstructionRicianImageFilter<TReferenceImagePixelType,
     }
 
   this->ComputeTensorBasis();
+
+  m_NumberOfOptimizedVoxels = 0;
+  m_NumberOfNonConvergedVoxels = 0;
 }
 
-// POTENTIAL WARNING:
-//
-// Until we fix netlib svd routines, we will need to set the number of thread
-// to 1.
 template <class TReferenceImagePixelType,
           class TGradientImagePixelType, class TTensorType>
 void DiffusionTensor3DReconstructionRicianImageFilter<TReferenceImagePixelType,
@@ -104,9 +103,6 @@ void DiffusionTensor3DReconstructionRicianImageFilter<TReferenceImagePixelType,
   ImageRegionIterator<OutputImageType> oit(outputImage, outputRegionForThread);
   oit.GoToBegin();
 
-  vnl_vector<double> B(m_NumberOfGradientDirections);
-  vnl_vector<double> D(6);
-
   // Two cases here .
   // 1. If the Gradients have been specified in multiple images, we will create
   // 'n' iterators for each of the gradient images and solve the Stejskal-Tanner
@@ -138,30 +134,60 @@ void DiffusionTensor3DReconstructionRicianImageFilter<TReferenceImagePixelType,
     TensorIteratorType tit(initialTensorImagePointer, outputRegionForThread );
     tit.GoToBegin();
 
-    // Compute the indicies of the baseline images and gradient images
-    std::vector<unsigned int> baselineind; // contains the indicies of
-                                           // the baseline images
-    std::vector<unsigned int> gradientind; // contains the indicies of
-                                           // the gradient images
-    for( GradientDirectionContainerType::ConstIterator gdcit = this->m_GradientDirectionContainer->Begin();
-         gdcit != this->m_GradientDirectionContainer->End(); ++gdcit )
+    // Indicies of the baseline images and gradient images
+    const std::vector<unsigned int> & baselineind = m_GradientScheme->GetBaselineIndices();
+    const std::vector<unsigned int> & gradientind = m_GradientScheme->GetGradientIndices();
+
+    typedef ImageRegionConstIterator<MaskImageType> MaskIteratorType;
+    const MaskImageType * mask = this->GetMaskImage();
+    MaskIteratorType      mit;
+    if( mask )
       {
-      if( gdcit.Value().one_norm() <= 0.0 )
-        {
-        baselineind.push_back(gdcit.Index() );
-        }
-      else
-        {
-        gradientind.push_back(gdcit.Index() );
-        }
+      mit = MaskIteratorType(mask, outputRegionForThread);
       }
 
     TensorType tensor(0.0);
 
-//    while( !git.IsAtEnd() )
+    // The cost function and the optimizer are reused for all the voxels
+    // of the region
+    typedef RicianLikelihood<ReferencePixelType> FittingFunctionType;
+    typename FittingFunctionType::Pointer loglikelihood = FittingFunctionType::New();
+    loglikelihood->SetDesign_Matrix(&m_DesignMatrix);
+    loglikelihood->SetSigma(m_Sigma);
+
+    typedef RegularStepGradientDescentOptimizer OptimizerType;
+    OptimizerType::Pointer optimizer = OptimizerType::New();
+    optimizer->SetCostFunction(loglikelihood);
+    optimizer->MinimizeOn();
+    optimizer->SetMaximumStepLength(1.0e-4);
+    optimizer->SetMinimumStepLength(1.0e-15);
+    optimizer->SetRelaxationFactor(.2);
+    optimizer->SetNumberOfIterations(m_MaximumNumberOfIterations);
+
+    const unsigned int             ng = this->m_NumberOfGradientDirections;
+    vnl_vector<ReferencePixelType> s(ng);
+    Array<double>                  vnlt(6);
+
+    unsigned long numberOfOptimizedVoxels = 0;
+    unsigned long numberOfNonConvergedVoxels = 0;
+
     while( !git.IsAtEnd() && !tit.IsAtEnd() )
       {
 
+      if( mask )
+        {
+        const bool foreground = mit.Get() != 0;
+        ++mit;
+        if( !foreground )
+          {
+          oit.Set( tit.Get() );
+          ++oit;
+          ++git;
+          ++tit;
+          continue;
+          }
+        }
+
       GradientVectorType b = git.Get();
 
       typename NumericTraits<ReferencePixelType>::AccumulateType b0 = NumericTraits<ReferencePixelType>::ZeroValue();
@@ -172,86 +198,52 @@ void DiffusionTensor3DReconstructionRicianImageFilter<TReferenceImagePixelType,
         }
       b0 /= this->m_NumberOfBaselineImages;
 
-      // TensorType tensor(0.0);
       tensor = tit.Get();
 
       if( (b0 != 0) && (b0 >= m_Threshold) )
         {
-
-        const unsigned int             ng = this->m_NumberOfGradientDirections;
-        vnl_vector<ReferencePixelType> s(ng);
-
-//         std::cout << "b: " << b << std::endl;
-        std::cout << "ind: " << tit.GetIndex() << std::endl;
         // B is the value corresponding to the gradient direction
-        for( unsigned int i = 0; i < m_NumberOfGradientDirections; i++ )
+        for( unsigned int i = 0; i < ng; i++ )
           {
           s[i] = b[gradientind[i]];
           }
 
-        typedef RicianLikelihood<ReferencePixelType> FittingFunctionType;
-
-        typename FittingFunctionType::Pointer loglikelihood = FittingFunctionType::New();
-
         loglikelihood->SetS0(b0);
-        loglikelihood->SetDesign_Matrix(-m_BValue * m_BMatrix);
-        loglikelihood->SetSigma(m_Sigma);
         loglikelihood->SetSignal(s);
 
-        Array<long int> bounds(6);
-        bounds.Fill(0);
-
-        Array<double> lbounds(6);
-        lbounds.Fill(-1);
-//         lbounds[0] = lbounds[3] = lbounds[5] = 0.0;
-
-        Array<double> hbounds(6);
-        hbounds.Fill(1);
-
-        Array<double> vnlt(tensor.GetDataPointer(), 6);
-
-//         std::cout << "init: " << vnlt << std::endl;
-//         typedef LBFGSBOptimizer OptimizerType;
-        typedef RegularStepGradientDescentOptimizer OptimizerType;
-        OptimizerType::Pointer optimizer = OptimizerType::New();
-        optimizer->SetCostFunction(loglikelihood);
+        std::copy(tensor.Begin(), tensor.End(), vnlt.begin() );
         optimizer->SetInitialPosition(vnlt);
-//          optimizer->SetBoundSelection(bounds);
-//          optimizer->SetLowerBound(lbounds);
-//          optimizer->SetUpperBound(hbounds);
-        optimizer->MinimizeOn();
-//         optimizer->SetCostFunctionConvergenceFactor(1.0e7);
-        optimizer->SetMaximumStepLength(1.0e-4);
-        optimizer->SetMinimumStepLength(1.0e-15);
-        optimizer->SetRelaxationFactor(.2);
-
-//         optimizer->SetLearningRate(1.0e-8);
-//         optimizer->DebugOn();
-//         std::cout << "Initial Cost: "<< loglikelihood->GetValue(vnlt) << std::endl;
 
+        ++numberOfOptimizedVoxels;
         try
           {
           optimizer->StartOptimization();
           vnlt = optimizer->GetCurrentPosition();
+          if( optimizer->GetStopCondition() == OptimizerType::MaximumNumberOfIterations )
+            {
+            ++numberOfNonConvergedVoxels;
+            }
           }
-        catch( itk::ExceptionObject & e )
+        catch( itk::ExceptionObject & )
           {
-          std::cerr << e << std::endl;
+          // keep the initial tensor
+          ++numberOfNonConvergedVoxels;
           }
 
-//         std::cout << "min: " << vnlt << std::endl;
-//         std::cout << "Final Cost: "<< optimizer->GetValue() << std::endl;
-
         std::copy(vnlt.begin(), vnlt.end(), tensor.Begin() );
 
         }
 
       oit.Set( tensor );
-      //  oit.Set( tensor / m_BValue);
       ++oit; // Output (reconstructed tensor image) iterator
       ++git; // Gradient  image iterator
       ++tit; // initial tensor, add by Ran
       }
+
+    m_ConvergenceReportLock.Lock();
+    m_NumberOfOptimizedVoxels += numberOfOptimizedVoxels;
+    m_NumberOfNonConvergedVoxels += numberOfNonConvergedVoxels;
+    m_ConvergenceReportLock.Unlock();
     }
 
 }
@@ -267,36 +259,12 @@ void DiffusionTensor3DReconstructionRicianImageFilter<TReferenceImagePixelType,
     itkExceptionMacro( << "Not enough gradient directions supplied. Need to supply at least 6" );
     }
 
-  // This is only important if we are using a vector image.  For
-  // images added one at a time, this is not needed but doesn't hurt.
-  std::vector<unsigned int> gradientind;
-  for( GradientDirectionContainerType::ConstIterator gdcit = this->m_GradientDirectionContainer->Begin();
-       gdcit != this->m_GradientDirectionContainer->End(); ++gdcit )
-    {
-    if( gdcit.Value().one_norm() > 0.0 )
-      {
-      gradientind.push_back(gdcit.Index() );
-      }
-    }
-
-  m_BMatrix.set_size( m_NumberOfGradientDirections, 6 );
-  for( unsigned int m = 0; m < m_NumberOfGradientDirections; m++ )
-    {
-    m_BMatrix[m][0] =     m_GradientDirectionContainer->ElementAt(gradientind[m])[0]
-      * m_GradientDirectionContainer->ElementAt(gradientind[m])[0];
-    m_BMatrix[m][1] = 2 * m_GradientDirectionContainer->ElementAt(gradientind[m])[0]
-      * m_GradientDirectionContainer->ElementAt(gradientind[m])[1];
-    m_BMatrix[m][2] = 2 * m_GradientDirectionContainer->ElementAt(gradientind[m])[0]
-      * m_GradientDirectionContainer->ElementAt(gradientind[m])[2];
-    m_BMatrix[m][3] =     m_GradientDirectionContainer->ElementAt(gradientind[m])[1]
-      * m_GradientDirectionContainer->ElementAt(gradientind[m])[1];
-    m_BMatrix[m][4] = 2 * m_GradientDirectionContainer->ElementAt(gradientind[m])[1]
-      * m_GradientDirectionContainer->ElementAt(gradientind[m])[2];
-    m_BMatrix[m][5] =     m_GradientDirectionContainer->ElementAt(gradientind[m])[2]
-      * m_GradientDirectionContainer->ElementAt(gradientind[m])[2];
-    }
-
-  m_TensorBasis = vnl_svd<double>(m_BMatrix).pinverse();
+  // The gradient directions were normalized by SetGradientImage(), the
+  // scheme of the normalized directions is shared through the registry.
+  m_GradientScheme = m_GradientSchemeRegistry->GetScheme(m_GradientDirectionContainer, m_BValue);
+  m_BMatrix = m_GradientScheme->GetGradientMatrix();
+  m_TensorBasis = m_GradientScheme->GetGradientTensorBasis();
+  m_DesignMatrix = m_GradientScheme->GetDesignMatrix();
 }
 
 template <class TReferenceImagePixelType,
@@ -384,6 +352,9 @@ void DiffusionTensor3DReconstructionRicianImageFilter<TReferenceImagePixelType,
      << m_NumberOfBaselineImages << std::endl;
   os << indent << "Threshold for reference B0 image: " << m_Threshold << std::endl;
   os << indent << "BValue: " << m_BValue << std::endl;
+  os << indent << "MaximumNumberOfIterations: " << m_MaximumNumberOfIterations << std::endl;
+  os << indent << "NumberOfOptimizedVoxels: " << m_NumberOfOptimizedVoxels << std::endl;
+  os << indent << "NumberOfNonConvergedVoxels: " << m_NumberOfNonConvergedVoxels << std::endl;
   if( this->m_GradientImageTypeEnumeration == GradientIsInManyImages )
     {
     os << indent << "Gradient images haven been supplied " << std::endl;
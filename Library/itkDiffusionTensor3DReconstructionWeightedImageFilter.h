@@ -79,20 +79,39 @@ public:
    * recommmended number is 1.  */
   itkSetMacro( NumberOfIterations, unsigned int );
   itkGetMacro( NumberOfIterations, unsigned int );
+
+  /** Stop reweighting a voxel when the estimate changes by less than
+   * this fraction of its norm.  The default of 0 always runs
+   * NumberOfIterations iterations. */
+  itkSetMacro( ConvergenceTolerance, double );
+  itkGetMacro( ConvergenceTolerance, double );
+
+  typedef typename Superclass::EstimateVectorType EstimateVectorType;
 protected:
   DiffusionTensor3DReconstructionWeightedImageFilter();
   virtual ~DiffusionTensor3DReconstructionWeightedImageFilter()
   {
   };
 
+  void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
+
   virtual vnl_vector<TTensorPrecision>
   EstimateTensor(const vnl_vector<TTensorPrecision>& S) const ITK_OVERRIDE;
 
+  /** The normal equations of each reweighting step are accumulated in
+   * fixed-size storage, so no memory is allocated per voxel. */
+  virtual void EstimateTensors(const TTensorPrecision * signals,
+                               unsigned int numberOfVoxels,
+                               TTensorPrecision * estimates,
+                               TTensorPrecision * workspace) const ITK_OVERRIDE;
+
 private:
   /** Number of reweighting iterations to use.  The default and
    * recommmended number is 1.  */
   unsigned int m_NumberOfIterations;
 
+  double m_ConvergenceTolerance;
+
 };
 
 }
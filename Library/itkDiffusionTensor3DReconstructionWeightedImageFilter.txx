@@ -22,7 +22,8 @@
 #include "itkImageRegionConstIteratorWithIndex.h"
 #include "itkImageRegionIterator.h"
 #include "vnl/vnl_vector.h"
-#include "vnl/algo/vnl_svd.h"
+#include <algorithm>
+#include <vector>
 
 namespace itk
 {
@@ -31,7 +32,9 @@ template <class TGradientImagePixelType,
           class TTensorPrecision>
 DiffusionTensor3DReconstructionWeightedImageFilter<TGradientImagePixelType,
                                                    TTensorPrecision>
-::DiffusionTensor3DReconstructionWeightedImageFilter() :  m_NumberOfIterations(1)
+::DiffusionTensor3DReconstructionWeightedImageFilter() :
+  m_NumberOfIterations(1),
+  m_ConvergenceTolerance(0.0)
 {
 }
 
@@ -41,39 +44,59 @@ DiffusionTensor3DReconstructionWeightedImageFilter<TGradientImagePixelType,
                                                    TTensorPrecision>
 ::EstimateTensor(const vnl_vector<TTensorPrecision>& S) const
 {
-  // setup log signals
-  vnl_vector<TTensorPrecision> B(this->m_NumberOfGradientDirections);
-  for( unsigned int i = 0; i < S.size(); ++i )
-    {
-    if( S[i] == 0 )
-      {
-      B[i] = 0;
-      }
-    else
-      {
-      B[i] = log(S[i]);
-      }
-    }
+  vnl_vector<TTensorPrecision> estimate(7);
+  vnl_vector<TTensorPrecision> workspace(S.size() );
+  this->EstimateTensors(S.data_block(), 1, estimate.data_block(), workspace.data_block() );
+  return estimate;
+}
+
+template <class TGradientImagePixelType, class TTensorPrecision>
+void
+DiffusionTensor3DReconstructionWeightedImageFilter<TGradientImagePixelType,
+                                                   TTensorPrecision>
+::EstimateTensors(const TTensorPrecision * signals,
+                  unsigned int numberOfVoxels,
+                  TTensorPrecision * estimates,
+                  TTensorPrecision * workspace) const
+{
+  const unsigned int ng = this->m_NumberOfGradientDirections;
+  const double       tol2 = m_ConvergenceTolerance * m_ConvergenceTolerance;
 
-  vnl_vector<double> prevestimate = this->m_TensorBasis * B;
-  for( unsigned int iter = 0; iter < this->m_NumberOfIterations; ++iter )
+  Superclass::ComputeLogSignals(signals, numberOfVoxels * ng, workspace);
+  for( unsigned int v = 0; v < numberOfVoxels; ++v )
     {
-    vnl_vector<double> phi(this->m_NumberOfGradientDirections);
-    phi = this->m_BMatrix * prevestimate;
-    for( unsigned int i = 0; i < this->m_NumberOfGradientDirections; ++i )
+    const TTensorPrecision * B = workspace + v * ng;
+
+    EstimateVectorType prevestimate;
+    this->LinearLeastSquaresEstimate(B, prevestimate);
+    for( unsigned int iter = 0; iter < m_NumberOfIterations; ++iter )
       {
-      phi[i] = exp(phi[i]);
-      phi[i] *= phi[i];
+      EstimateVectorType estimate;
+      if( !this->WeightedLeastSquaresStep(B, prevestimate, estimate) )
+        {
+        break;
+        }
+      const double change = ( estimate - prevestimate ).squared_magnitude();
+      prevestimate = estimate;
+      if( change <= tol2 * estimate.squared_magnitude() )
+        {
+        break;
+        }
       }
 
-    vnl_diag_matrix<double> W2(phi);
-
-    prevestimate =
-      vnl_svd<double>(this->m_BMatrix.transpose() * W2 * this->m_BMatrix).solve(this->m_BMatrix.transpose() * W2 * B);
-
+    std::copy(prevestimate.begin(), prevestimate.end(), estimates + v * 7);
     }
+}
 
-  return prevestimate;
+template <class TGradientImagePixelType, class TTensorPrecision>
+void
+DiffusionTensor3DReconstructionWeightedImageFilter<TGradientImagePixelType,
+                                                   TTensorPrecision>
+::PrintSelf(std::ostream& os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfIterations: " << m_NumberOfIterations << std::endl;
+  os << indent << "ConvergenceTolerance: " << m_ConvergenceTolerance << std::endl;
 }
 
 }
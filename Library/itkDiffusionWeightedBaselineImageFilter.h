@@ -0,0 +1,190 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkDiffusionWeightedBaselineImageFilter.h,v $
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.5 $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkDiffusionWeightedBaselineImageFilter_h
+#define __itkDiffusionWeightedBaselineImageFilter_h
+
+#include <itkImageToImageFilter.h>
+#include <itkImage.h>
+#include <itkVectorContainer.h>
+#include <itkSimpleFastMutexLock.h>
+#include <vnl/vnl_vector_fixed.h>
+#include <vector>
+
+namespace itk
+{
+
+/** \class DiffusionWeightedBaselineImageFilter
+ * \brief Computes the average baseline image and the isotropic DWI
+ * of a diffusion weighted image in a single pass.
+ *
+ * The components of the input VectorImage whose gradient direction is
+ * zero are baselines.  Output 0 is their average.  If there is no
+ * baseline the first component is used instead.  Output 1 is the
+ * geometric mean of the remaining components (the IDWI), it is only
+ * allocated when ComputeIDWI is on.
+ *
+ * An optional mask restricts both outputs to its non-zero voxels.
+ *
+ * When ComputeOtsuThreshold is on, the threads also count the values
+ * of the baseline average.  The counts are binned the same way as
+ * OtsuThresholdImageFilter bins the baseline image, so GetOtsuThreshold()
+ * returns the same threshold without another pass over the data.  This
+ * requires an integer input pixel type.  The counts are kept in a
+ * single array: each thread buffers a few thousand sums and adds them
+ * to it under a lock.
+ *
+ * \ingroup Multithreaded
+ */
+template <typename TInputImage, typename TOutputImage>
+class ITK_EXPORT DiffusionWeightedBaselineImageFilter :
+  public ImageToImageFilter<TInputImage, TOutputImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef DiffusionWeightedBaselineImageFilter                Self;
+  typedef ImageToImageFilter<TInputImage, TOutputImage>       Superclass;
+  typedef SmartPointer<Self>                                  Pointer;
+  typedef SmartPointer<const Self>                            ConstPointer;
+
+  typedef TInputImage                                         InputImageType;
+  typedef typename InputImageType::InternalPixelType          InputValueType;
+  typedef TOutputImage                                        OutputImageType;
+  typedef typename OutputImageType::PixelType                 OutputPixelType;
+  typedef typename OutputImageType::RegionType                OutputImageRegionType;
+
+  typedef vnl_vector_fixed<double, 3>                         GradientDirectionType;
+  typedef VectorContainer<unsigned int, GradientDirectionType> GradientDirectionContainerType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Runtime information support. */
+  itkTypeMacro(DiffusionWeightedBaselineImageFilter, ImageToImageFilter);
+
+  /** Gradient direction of every component of the input. */
+  itkSetConstObjectMacro(GradientDirectionContainer, GradientDirectionContainerType);
+  itkGetConstObjectMacro(GradientDirectionContainer, GradientDirectionContainerType);
+
+  /** Optional mask.  Voxels where it is zero are treated as if all
+   * their signals were zero. */
+  typedef Image<unsigned char, OutputImageType::ImageDimension> MaskImageType;
+  void SetMaskImage(const MaskImageType * mask)
+  {
+    this->ProcessObject::SetNthInput(1, const_cast<MaskImageType *>(mask) );
+  }
+
+  const MaskImageType * GetMaskImage() const
+  {
+    return static_cast<const MaskImageType *>(this->ProcessObject::GetInput(1) );
+  }
+
+  itkSetMacro(ComputeIDWI, bool);
+  itkGetConstMacro(ComputeIDWI, bool);
+  itkBooleanMacro(ComputeIDWI);
+
+  itkSetMacro(ComputeOtsuThreshold, bool);
+  itkGetConstMacro(ComputeOtsuThreshold, bool);
+  itkBooleanMacro(ComputeOtsuThreshold);
+
+  /** Number of histogram bins used for the Otsu threshold.  The
+   * default of 256 is the one of OtsuThresholdImageFilter. */
+  itkSetMacro(NumberOfHistogramBins, unsigned int);
+  itkGetConstMacro(NumberOfHistogramBins, unsigned int);
+
+  /** When on, the counts of successive updates are added, so that the
+   * Otsu threshold covers all the regions streamed through the filter
+   * since the last ResetHistogram(). */
+  itkSetMacro(AccumulateHistogram, bool);
+  itkGetConstMacro(AccumulateHistogram, bool);
+  itkBooleanMacro(AccumulateHistogram);
+
+  void ResetHistogram()
+  {
+    m_HistogramCounts.clear();
+  }
+
+  /** Otsu threshold of the baseline average, valid after an update
+   * with ComputeOtsuThreshold on. */
+  itkGetConstMacro(OtsuThreshold, double);
+
+  /** Number of components averaged in the baseline and IDWI
+   * outputs. */
+  itkGetConstMacro(NumberOfBaselines, unsigned int);
+  itkGetConstMacro(NumberOfGradients, unsigned int);
+
+  OutputImageType * GetBaselineOutput()
+  {
+    return this->GetOutput(0);
+  }
+
+  OutputImageType * GetIDWIOutput()
+  {
+    return this->GetOutput(1);
+  }
+
+protected:
+  DiffusionWeightedBaselineImageFilter();
+  virtual ~DiffusionWeightedBaselineImageFilter()
+  {
+  };
+
+  void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
+
+  /** The IDWI output is only allocated when it is computed. */
+  virtual void AllocateOutputs() ITK_OVERRIDE;
+
+  virtual void BeforeThreadedGenerateData() ITK_OVERRIDE;
+
+  virtual void ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread,
+                                    ThreadIdType threadId) ITK_OVERRIDE;
+
+  virtual void AfterThreadedGenerateData() ITK_OVERRIDE;
+
+  /** Counts the sums in the histogram and clears them */
+  void AddSums(std::vector<SizeValueType> & sums);
+
+private:
+  DiffusionWeightedBaselineImageFilter(const Self &); // purposely not implemented
+  void operator=(const Self &);                       // purposely not implemented
+
+  typename GradientDirectionContainerType::ConstPointer m_GradientDirectionContainer;
+
+  bool         m_ComputeIDWI;
+  bool         m_ComputeOtsuThreshold;
+  bool         m_AccumulateHistogram;
+  unsigned int m_NumberOfHistogramBins;
+  double       m_OtsuThreshold;
+
+  /** Components averaged in each output. */
+  std::vector<unsigned int> m_Baselines;
+  std::vector<unsigned int> m_Gradients;
+  unsigned int              m_NumberOfBaselines;
+  unsigned int              m_NumberOfGradients;
+
+  /** Counts of the sums of the baseline components, indexed by the
+   * sum, for all the threads (and updates, see AccumulateHistogram) */
+  std::vector<SizeValueType> m_HistogramCounts;
+  SimpleFastMutexLock        m_HistogramLock;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkDiffusionWeightedBaselineImageFilter.txx"
+#endif
+
+#endif
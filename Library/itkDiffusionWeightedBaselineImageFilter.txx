@@ -0,0 +1,306 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $RCSfile: itkDiffusionWeightedBaselineImageFilter.txx,v $
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.5 $
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+  See ITKCopyright.txt or http://www.itk.org/HTML/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkDiffusionWeightedBaselineImageFilter_txx
+#define __itkDiffusionWeightedBaselineImageFilter_txx
+
+#include "itkDiffusionWeightedBaselineImageFilter.h"
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIterator.h>
+#include <itkHistogram.h>
+#include <itkOtsuThresholdCalculator.h>
+#include <itkNumericTraits.h>
+#include <cmath>
+
+namespace itk
+{
+
+template <typename TInputImage, typename TOutputImage>
+DiffusionWeightedBaselineImageFilter<TInputImage, TOutputImage>
+::DiffusionWeightedBaselineImageFilter() :
+  m_ComputeIDWI(true),
+  m_ComputeOtsuThreshold(false),
+  m_AccumulateHistogram(false),
+  m_NumberOfHistogramBins(256),
+  m_OtsuThreshold(0.0),
+  m_NumberOfBaselines(0),
+  m_NumberOfGradients(0)
+{
+  this->SetNumberOfRequiredOutputs(2);
+  this->SetNthOutput(1, this->MakeOutput(1) );
+}
+
+template <typename TInputImage, typename TOutputImage>
+void
+DiffusionWeightedBaselineImageFilter<TInputImage, TOutputImage>
+::AllocateOutputs()
+{
+  OutputImageType * baseline = this->GetOutput(0);
+  baseline->SetBufferedRegion(baseline->GetRequestedRegion() );
+  baseline->Allocate();
+  if( m_ComputeIDWI )
+    {
+    OutputImageType * idwi = this->GetOutput(1);
+    idwi->SetBufferedRegion(idwi->GetRequestedRegion() );
+    idwi->Allocate();
+    }
+}
+
+template <typename TInputImage, typename TOutputImage>
+void
+DiffusionWeightedBaselineImageFilter<TInputImage, TOutputImage>
+::BeforeThreadedGenerateData()
+{
+  if( m_GradientDirectionContainer.IsNull() )
+    {
+    itkExceptionMacro(<< "Gradient directions not set");
+    }
+  const unsigned int numberOfComponents = this->GetInput()->GetNumberOfComponentsPerPixel();
+  if( m_GradientDirectionContainer->Size() != numberOfComponents )
+    {
+    itkExceptionMacro(<< "Number of gradient directions (" << m_GradientDirectionContainer->Size()
+                      << ") does not match the number of image components (" << numberOfComponents << ")");
+    }
+
+  m_Baselines.clear();
+  m_Gradients.clear();
+  for( unsigned int i = 0; i < numberOfComponents; ++i )
+    {
+    const GradientDirectionType & g = m_GradientDirectionContainer->ElementAt(i);
+    if( g[0] == 0 && g[1] == 0 && g[2] == 0 )
+      {
+      m_Baselines.push_back(i);
+      }
+    else
+      {
+      m_Gradients.push_back(i);
+      }
+    }
+  m_NumberOfBaselines = m_Baselines.size();
+  m_NumberOfGradients = m_Gradients.size();
+  if( m_Baselines.empty() )
+    {
+    m_Baselines.push_back(0);
+    }
+
+  if( m_ComputeOtsuThreshold )
+    {
+    if( !NumericTraits<InputValueType>::is_integer || NumericTraits<InputValueType>::is_signed
+        || sizeof(InputValueType) > 2 )
+      {
+      itkExceptionMacro(<< "The Otsu threshold requires an unsigned integer pixel type of at most 16 bits");
+      }
+    const SizeValueType maximumSum =
+      static_cast<SizeValueType>(NumericTraits<InputValueType>::max() ) * m_Baselines.size();
+    if( !m_AccumulateHistogram || m_HistogramCounts.size() != maximumSum + 1 )
+      {
+      m_HistogramCounts.assign(maximumSum + 1, 0);
+      }
+    }
+}
+
+template <typename TInputImage, typename TOutputImage>
+void
+DiffusionWeightedBaselineImageFilter<TInputImage, TOutputImage>
+::AddSums(std::vector<SizeValueType> & sums)
+{
+  m_HistogramLock.Lock();
+  for( typename std::vector<SizeValueType>::const_iterator s = sums.begin(); s != sums.end(); ++s )
+    {
+    ++m_HistogramCounts[*s];
+    }
+  m_HistogramLock.Unlock();
+  sums.clear();
+}
+
+template <typename TInputImage, typename TOutputImage>
+void
+DiffusionWeightedBaselineImageFilter<TInputImage, TOutputImage>
+::ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread,
+                       ThreadIdType itkNotUsed(threadId) )
+{
+  typedef ImageRegionConstIterator<InputImageType> InputIteratorType;
+  typedef ImageRegionIterator<OutputImageType>     OutputIteratorType;
+
+  InputIteratorType  it(this->GetInput(), outputRegionForThread);
+  OutputIteratorType bit(this->GetOutput(0), outputRegionForThread);
+  OutputIteratorType iit;
+  if( m_ComputeIDWI )
+    {
+    iit = OutputIteratorType(this->GetOutput(1), outputRegionForThread);
+    }
+
+  typedef ImageRegionConstIterator<MaskImageType> MaskIteratorType;
+  MaskIteratorType mit;
+  const MaskImageType * mask = this->GetMaskImage();
+  if( mask )
+    {
+    mit = MaskIteratorType(mask, outputRegionForThread);
+    }
+
+  const unsigned int nb = m_Baselines.size();
+  const unsigned int ng = m_Gradients.size();
+
+  // Sums of the baselines not yet counted in the histogram
+  const SizeValueType        sumBufferSize = 4096;
+  std::vector<SizeValueType> sums;
+  if( m_ComputeOtsuThreshold )
+    {
+    sums.reserve(sumBufferSize);
+    }
+  for( ; !it.IsAtEnd(); ++it, ++bit )
+    {
+    if( mask )
+      {
+      const bool foreground = mit.Get() != 0;
+      ++mit;
+      if( !foreground )
+        {
+        bit.Set(NumericTraits<OutputPixelType>::ZeroValue() );
+        if( m_ComputeOtsuThreshold )
+          {
+          sums.push_back(0);
+          if( sums.size() == sumBufferSize )
+            {
+            this->AddSums(sums);
+            }
+          }
+        if( m_ComputeIDWI )
+          {
+          iit.Set(NumericTraits<OutputPixelType>::ZeroValue() );
+          ++iit;
+          }
+        continue;
+        }
+      }
+
+    const typename InputImageType::PixelType S = it.Get();
+
+    // The baselines are integers, so their sum is exact in any order
+    SizeValueType sum = 0;
+    double        b0 = 0;
+    for( unsigned int i = 0; i < nb; ++i )
+      {
+      b0 += S[m_Baselines[i]];
+      sum += static_cast<SizeValueType>(S[m_Baselines[i]]);
+      }
+    bit.Set(static_cast<OutputPixelType>(b0 / nb) );
+    if( m_ComputeOtsuThreshold )
+      {
+      sums.push_back(sum);
+      if( sums.size() == sumBufferSize )
+        {
+        this->AddSums(sums);
+        }
+      }
+
+    if( m_ComputeIDWI )
+      {
+      double logsum = 0;
+      for( unsigned int i = 0; i < ng; ++i )
+        {
+        logsum += std::log(static_cast<double>(S[m_Gradients[i]]) );
+        }
+      iit.Set(static_cast<OutputPixelType>(std::exp(logsum / ng) ) );
+      ++iit;
+      }
+    }
+  if( !sums.empty() )
+    {
+    this->AddSums(sums);
+    }
+}
+
+template <typename TInputImage, typename TOutputImage>
+void
+DiffusionWeightedBaselineImageFilter<TInputImage, TOutputImage>
+::AfterThreadedGenerateData()
+{
+  if( !m_ComputeOtsuThreshold )
+    {
+    return;
+    }
+
+  const std::vector<SizeValueType> & counts = m_HistogramCounts;
+
+  SizeValueType minimumSum = 0;
+  while( minimumSum + 1 < counts.size() && counts[minimumSum] == 0 )
+    {
+    ++minimumSum;
+    }
+  SizeValueType maximumSum = counts.size() - 1;
+  while( maximumSum > minimumSum && counts[maximumSum] == 0 )
+    {
+    --maximumSum;
+    }
+
+  // Same bins as the ImageToHistogramFilter used by
+  // OtsuThresholdImageFilter: the range of the data, with the
+  // maximum raised by a hundredth of a bin so that it is included.
+  const double nb = m_Baselines.size();
+  const double minimum = minimumSum / nb;
+  const double maximum = maximumSum / nb;
+
+  typedef Statistics::Histogram<double> HistogramType;
+  typename HistogramType::Pointer histogram = HistogramType::New();
+  histogram->SetMeasurementVectorSize(1);
+  typename HistogramType::SizeType size(1);
+  size.Fill(m_NumberOfHistogramBins);
+  typename HistogramType::MeasurementVectorType lower(1);
+  typename HistogramType::MeasurementVectorType upper(1);
+  lower[0] = minimum;
+  upper[0] = maximum + ( ( maximum - minimum ) / m_NumberOfHistogramBins ) / 100.0;
+  histogram->SetClipBinsAtEnds(true);
+  histogram->Initialize(size, lower, upper);
+
+  typename HistogramType::MeasurementVectorType measurement(1);
+  typename HistogramType::IndexType             index(1);
+  for( SizeValueType s = minimumSum; s <= maximumSum; ++s )
+    {
+    if( counts[s] == 0 )
+      {
+      continue;
+      }
+    measurement[0] = s / nb;
+    if( histogram->GetIndex(measurement, index) )
+      {
+      histogram->IncreaseFrequencyOfIndex(index, counts[s]);
+      }
+    }
+
+  typedef OtsuThresholdCalculator<HistogramType, double> CalculatorType;
+  typename CalculatorType::Pointer calculator = CalculatorType::New();
+  calculator->SetInput(histogram);
+  calculator->Update();
+  m_OtsuThreshold = calculator->GetThreshold();
+}
+
+template <typename TInputImage, typename TOutputImage>
+void
+DiffusionWeightedBaselineImageFilter<TInputImage, TOutputImage>
+::PrintSelf(std::ostream& os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "ComputeIDWI: " << m_ComputeIDWI << std::endl;
+  os << indent << "ComputeOtsuThreshold: " << m_ComputeOtsuThreshold << std::endl;
+  os << indent << "AccumulateHistogram: " << m_AccumulateHistogram << std::endl;
+  os << indent << "NumberOfHistogramBins: " << m_NumberOfHistogramBins << std::endl;
+  os << indent << "OtsuThreshold: " << m_OtsuThreshold << std::endl;
+}
+
+} // end namespace itk
+
+#endif
@@ -20,6 +20,9 @@
 #include <itkUnaryFunctorImageFilter.h>
 #include <vnl/vnl_double_3x3.h>
 #include <itkDiffusionTensor3D.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIterator.h>
+#include "itkDiffusionTensor3DEigenSolver.h"
 
 namespace itk
 {
@@ -48,6 +51,16 @@ public:
   }
 
   OutputType operator()( const TInput & x )
+  {
+    EigenValueType  D;
+    EigenVectorType U;
+
+    DiffusionTensor3DEigenSolver<DiffusionTensor3D<double> >::ComputeEigenAnalysis(ToTensor(x), D, U);
+    return Compose(D, U);
+  }
+
+  /** Symmetric matrix whose unique elements are the log-vector x */
+  static DiffusionTensor3D<double> ToTensor( const TInput & x )
   {
     DiffusionTensor3D<double> tensor;
     for( int i = 0; i < 6; ++i )
@@ -57,12 +70,13 @@ public:
     tensor[1] /= sqrt(2.0);
     tensor[2] /= sqrt(2.0);
     tensor[4] /= sqrt(2.0);
+    return tensor;
+  }
 
-    EigenValueType  D;
-    EigenVectorType U;
-
-    tensor.ComputeEigenAnalysis(D, U);
-
+  /** Exponential of the symmetric matrix of eigenvalues D and
+   * eigenvectors U */
+  static OutputType Compose( const EigenValueType & D, const EigenVectorType & U )
+  {
     vnl_matrix_fixed<double, 3, 3> m;
     m.fill(0);
     m(0, 0) = exp(D[0]);
@@ -123,6 +137,9 @@ public:
   /** Method for creation through the object factory. */
   itkNewMacro(Self);
 
+  typedef typename OutputImageType::RegionType OutputImageRegionType;
+  typedef typename OutputImageType::PixelType  OutputPixelType;
+
   /** Print internal ivars */
   void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE
   {
@@ -136,6 +153,51 @@ protected:
   virtual ~ExpEuclideanTensorImageFilter()
   {
   };
+
+  /** The eigen-analyses of a block of pixels are computed together */
+  virtual void ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread,
+                                    ThreadIdType) ITK_OVERRIDE
+  {
+    typedef Functor::ExpEuclideanTensorFunction<Vector<T, 6> >  FunctorType;
+    typedef DiffusionTensor3DEigenSolver<DiffusionTensor3D<double> > SolverType;
+    const unsigned int BlockSize = 64;
+
+    DiffusionTensor3D<double>                        tensors[BlockSize];
+    typename FunctorType::EigenValueType             D[BlockSize];
+    typename FunctorType::EigenVectorType            U[BlockSize];
+    // The exponentials are composed in structure-of-arrays order
+    double   planes[6][BlockSize];
+    double * components[6] = { planes[0], planes[1], planes[2], planes[3], planes[4], planes[5] };
+    ImageRegionConstIterator<InputImageType> it(this->GetInput(), outputRegionForThread);
+    ImageRegionIterator<OutputImageType>     oit(this->GetOutput(), outputRegionForThread);
+    while( !it.IsAtEnd() )
+      {
+      unsigned int count = 0;
+      for( ; count < BlockSize && !it.IsAtEnd(); ++count, ++it )
+        {
+        tensors[count] = FunctorType::ToTensor(it.Get() );
+        }
+      SolverType::ComputeEigenAnalysis(tensors, count, D, U);
+      for( unsigned int i = 0; i < count; ++i )
+        {
+        for( unsigned int k = 0; k < 3; ++k )
+          {
+          D[i][k] = exp(D[i][k]);
+          }
+        }
+      SolverType::ComposeTensors(D, U, count, components);
+      for( unsigned int i = 0; i < count; ++i, ++oit )
+        {
+        OutputPixelType op;
+        for( unsigned int c = 0; c < 6; ++c )
+          {
+          op[c] = planes[c][i];
+          }
+        oit.Set(op);
+        }
+      }
+  }
+
 private:
   ExpEuclideanTensorImageFilter(const Self &); // purposely not implemented
   void operator=(const Self &);                // purposely not implemented
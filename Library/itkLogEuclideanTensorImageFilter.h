@@ -20,6 +20,9 @@
 #include <itkUnaryFunctorImageFilter.h>
 #include <vnl/vnl_double_3x3.h>
 #include <itkDiffusionTensor3D.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIterator.h>
+#include "itkDiffusionTensor3DEigenSolver.h"
 
 namespace itk
 {
@@ -52,8 +55,13 @@ public:
     EigenValueType  D;
     EigenVectorType U;
 
-    x.ComputeEigenAnalysis(D, U);
+    DiffusionTensor3DEigenSolver<TInput>::ComputeEigenAnalysis(x, D, U);
+    return Compose(D, U);
+  }
 
+  /** Logarithm of the tensor of eigenvalues D and eigenvectors U */
+  static OutputType Compose( const EigenValueType & D, const EigenVectorType & U )
+  {
     vnl_matrix_fixed<RealValueType, 3, 3> m;
     m.fill(0);
     m(0, 0) = D[0] > 0 ? log(D[0]) : -10;
@@ -111,6 +119,9 @@ public:
   /** Method for creation through the object factory. */
   itkNewMacro(Self);
 
+  typedef typename OutputImageType::RegionType OutputImageRegionType;
+  typedef typename OutputImageType::PixelType  OutputPixelType;
+
   /** Print internal ivars */
   void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE
   {
@@ -124,6 +135,55 @@ protected:
   virtual ~LogEuclideanTensorImageFilter()
   {
   };
+
+  /** The eigen-analyses of a block of pixels are computed together */
+  virtual void ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread,
+                                    ThreadIdType) ITK_OVERRIDE
+  {
+    typedef Functor::LogEuclideanTensorFunction<DiffusionTensor3D<T> > FunctorType;
+    typedef DiffusionTensor3DEigenSolver<DiffusionTensor3D<T> >        SolverType;
+    const unsigned int BlockSize = 64;
+
+    DiffusionTensor3D<T>                  tensors[BlockSize];
+    typename FunctorType::EigenValueType  D[BlockSize];
+    typename FunctorType::EigenVectorType U[BlockSize];
+    // The logarithms are composed in structure-of-arrays order
+    typename FunctorType::RealValueType   planes[6][BlockSize];
+    typename FunctorType::RealValueType * components[6] =
+      { planes[0], planes[1], planes[2], planes[3], planes[4], planes[5] };
+    const typename FunctorType::RealValueType sqrt2 = sqrt(2.0);
+    ImageRegionConstIterator<InputImageType> it(this->GetInput(), outputRegionForThread);
+    ImageRegionIterator<OutputImageType>     oit(this->GetOutput(), outputRegionForThread);
+    while( !it.IsAtEnd() )
+      {
+      unsigned int count = 0;
+      for( ; count < BlockSize && !it.IsAtEnd(); ++count, ++it )
+        {
+        tensors[count] = it.Get();
+        }
+      SolverType::ComputeEigenAnalysis(tensors, count, D, U);
+      for( unsigned int i = 0; i < count; ++i )
+        {
+        for( unsigned int k = 0; k < 3; ++k )
+          {
+          D[i][k] = D[i][k] > 0 ? log(D[i][k]) : -10;
+          }
+        }
+      SolverType::ComposeTensors(D, U, count, components);
+      for( unsigned int i = 0; i < count; ++i, ++oit )
+        {
+        OutputPixelType op;
+        op[0] = planes[0][i];
+        op[1] = planes[1][i] * sqrt2;
+        op[2] = planes[2][i] * sqrt2;
+        op[3] = planes[3][i];
+        op[4] = planes[4][i] * sqrt2;
+        op[5] = planes[5][i];
+        oit.Set(op);
+        }
+      }
+  }
+
 private:
   LogEuclideanTensorImageFilter(const Self &); // purposely not implemented
   void operator=(const Self &);                // purposely not implemented
@@ -0,0 +1,89 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkPlanesToTensorImageFilter_h
+#define __itkPlanesToTensorImageFilter_h
+
+#include <itkImageToImageFilter.h>
+
+namespace itk
+{
+/** \class PlanesToTensorImageFilter
+ * \brief Interleaves the six planes of the components of tensors into
+ * a tensor image.
+ *
+ * Inverse of TensorToPlanesImageFilter: input i is the plane of
+ * component i (xx, xy, xz, yy, yz, zz).  The planes can be the outputs
+ * of per-component filters run on the planes of a tensor image.
+ *
+ * \ingroup Multithreaded TensorObjects
+ */
+template <typename TPlaneImage, typename TOutputImage>
+class ITK_EXPORT PlanesToTensorImageFilter :
+  public ImageToImageFilter<TPlaneImage, TOutputImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef PlanesToTensorImageFilter                     Self;
+  typedef ImageToImageFilter<TPlaneImage, TOutputImage> Superclass;
+  typedef SmartPointer<Self>                            Pointer;
+  typedef SmartPointer<const Self>                      ConstPointer;
+
+  typedef TPlaneImage                           PlaneImageType;
+  typedef typename PlaneImageType::PixelType    PlanePixelType;
+  typedef TOutputImage                          OutputImageType;
+  typedef typename OutputImageType::PixelType   OutputPixelType;
+  typedef typename OutputPixelType::ValueType   OutputComponentType;
+  typedef typename OutputImageType::RegionType  OutputImageRegionType;
+
+  itkStaticConstMacro(NumberOfPlanes, unsigned int, 6);
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Runtime information support. */
+  itkTypeMacro(PlanesToTensorImageFilter, ImageToImageFilter);
+
+  /** Plane of component i of the tensors */
+  void SetPlane(unsigned int i, const PlaneImageType * plane)
+  {
+    this->SetNthInput(i, const_cast<PlaneImageType *>(plane) );
+  }
+
+protected:
+  PlanesToTensorImageFilter()
+  {
+    this->SetNumberOfRequiredInputs(NumberOfPlanes);
+  }
+
+  virtual ~PlanesToTensorImageFilter()
+  {
+  }
+
+  virtual void ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread,
+                                    ThreadIdType threadId) ITK_OVERRIDE;
+
+private:
+  PlanesToTensorImageFilter(const Self &); // purposely not implemented
+  void operator=(const Self &);            // purposely not implemented
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkPlanesToTensorImageFilter.txx"
+#endif
+
+#endif
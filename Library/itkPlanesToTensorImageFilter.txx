@@ -0,0 +1,58 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkPlanesToTensorImageFilter_txx
+#define __itkPlanesToTensorImageFilter_txx
+
+#include "itkPlanesToTensorImageFilter.h"
+#include <itkImageRegionConstIteratorWithIndex.h>
+
+namespace itk
+{
+
+template <typename TPlaneImage, typename TOutputImage>
+void
+PlanesToTensorImageFilter<TPlaneImage, TOutputImage>
+::ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread, ThreadIdType)
+{
+  const PlaneImageType * planes[NumberOfPlanes];
+  for( unsigned int c = 0; c < NumberOfPlanes; ++c )
+    {
+    planes[c] = this->GetInput(c);
+    }
+  OutputImageType *   output = this->GetOutput();
+  const SizeValueType length = outputRegionForThread.GetSize(0);
+
+  // One line at a time: the planes are read contiguously
+  OutputImageRegionType lines = outputRegionForThread;
+  lines.SetSize(0, 1);
+  for( ImageRegionConstIteratorWithIndex<OutputImageType> it(output, lines); !it.IsAtEnd(); ++it )
+    {
+    const typename OutputImageType::IndexType & index = it.GetIndex();
+    OutputPixelType *                           out = output->GetBufferPointer() + output->ComputeOffset(index);
+    for( unsigned int c = 0; c < NumberOfPlanes; ++c )
+      {
+      const PlanePixelType * in = planes[c]->GetBufferPointer() + planes[c]->ComputeOffset(index);
+      for( SizeValueType x = 0; x < length; ++x )
+        {
+        out[x][c] = static_cast<OutputComponentType>(in[x]);
+        }
+      }
+    }
+}
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,260 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkSparseTensorImage_h
+#define __itkSparseTensorImage_h
+
+#include <itkObject.h>
+#include <itkObjectFactory.h>
+#include <itkImage.h>
+#include <itkDiffusionTensor3D.h>
+#include <itkMetaDataDictionary.h>
+#include <vector>
+
+namespace itk
+{
+/** \class SparseTensorImage
+ * \brief Tensor image storing only the tensors of its foreground.
+ *
+ * The foreground voxels are a list of runs of consecutive voxels of the
+ * region, in the order of the buffer of an image (x first).  Their
+ * tensors are packed, in the same order, in the "packed image": an
+ * image of size (N + 1) x 1 x 1, N being the number of foreground
+ * voxels, whose last pixel is the background tensor.
+ *
+ * Pixel-wise filters can run on the packed image directly: the FA of
+ * the packed image, expanded with Expand(), is the FA of the dense
+ * image, the last pixel giving the value of the background.  Pack()
+ * packs any image of the region, a mask or a label map for instance,
+ * with the same runs.
+ */
+template <typename TComponent, unsigned int VDimension = 3>
+class SparseTensorImage : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef SparseTensorImage        Self;
+  typedef Object                   Superclass;
+  typedef SmartPointer<Self>       Pointer;
+  typedef SmartPointer<const Self> ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(SparseTensorImage, Object);
+
+  itkStaticConstMacro(ImageDimension, unsigned int, VDimension);
+
+  typedef TComponent                              ComponentType;
+  typedef DiffusionTensor3D<TComponent>           TensorType;
+  typedef Image<TensorType, VDimension>           TensorImageType;
+  typedef TensorImageType                         PackedImageType;
+  typedef typename TensorImageType::RegionType    RegionType;
+  typedef typename TensorImageType::IndexType     IndexType;
+  typedef typename TensorImageType::SizeType      SizeType;
+  typedef typename TensorImageType::SpacingType   SpacingType;
+  typedef typename TensorImageType::PointType     PointType;
+  typedef typename TensorImageType::DirectionType DirectionType;
+
+  /** Consecutive foreground voxels.  Offset is the position of the
+   * first one in the region, x first. */
+  struct Run
+  {
+    SizeValueType Offset;
+    SizeValueType Length;
+  };
+  typedef std::vector<Run> RunListType;
+
+  /** Iterates over the foreground voxels and their tensors */
+  class ConstIterator
+  {
+public:
+    ConstIterator(const Self * image) :
+      m_Image(image),
+      m_Run(0),
+      m_InRun(0),
+      m_PackedOffset(0)
+    {
+      this->SkipEmptyRuns();
+    }
+
+    bool IsAtEnd() const
+    {
+      return m_Run >= m_Image->GetRuns().size();
+    }
+
+    ConstIterator & operator++()
+    {
+      ++m_PackedOffset;
+      if( ++m_InRun == m_Image->GetRuns()[m_Run].Length )
+        {
+        ++m_Run;
+        m_InRun = 0;
+        this->SkipEmptyRuns();
+        }
+      return *this;
+    }
+
+    /** Position of the voxel in the packed image */
+    SizeValueType GetPackedOffset() const
+    {
+      return m_PackedOffset;
+    }
+
+    IndexType GetIndex() const
+    {
+      return m_Image->ComputeIndex(m_Image->GetRuns()[m_Run].Offset + m_InRun);
+    }
+
+    const TensorType & Get() const
+    {
+      return m_Image->GetPackedImage()->GetBufferPointer()[m_PackedOffset];
+    }
+
+private:
+    void SkipEmptyRuns()
+    {
+      while( !this->IsAtEnd() && m_Image->GetRuns()[m_Run].Length == 0 )
+        {
+        ++m_Run;
+        }
+    }
+
+    const Self *  m_Image;
+    SizeValueType m_Run;
+    SizeValueType m_InRun;
+    SizeValueType m_PackedOffset;
+  };
+
+  /** Grid of the dense image */
+  itkSetMacro(Spacing, SpacingType);
+  itkGetConstReferenceMacro(Spacing, SpacingType);
+  itkSetMacro(Origin, PointType);
+  itkGetConstReferenceMacro(Origin, PointType);
+  itkSetMacro(Direction, DirectionType);
+  itkGetConstReferenceMacro(Direction, DirectionType);
+  itkGetConstReferenceMacro(Region, RegionType);
+
+  /** Tensor of the voxels which are not in the foreground.  Zero by
+   * default. */
+  itkGetConstReferenceMacro(BackgroundTensor, TensorType);
+
+  MetaDataDictionary & GetMetaDataDictionary()
+  {
+    return m_MetaDataDictionary;
+  }
+
+  const MetaDataDictionary & GetMetaDataDictionary() const
+  {
+    return m_MetaDataDictionary;
+  }
+
+  /** Stores the buffered region of a dense image.  The foreground is
+   * the voxels whose tensor is not the background tensor. */
+  void SetImage(const TensorImageType * image, const TensorType & background);
+
+  void SetImage(const TensorImageType * image)
+  {
+    this->SetImage(image, TensorType(NumericTraits<TComponent>::Zero) );
+  }
+
+  /** Stores the buffered region of a dense image.  The foreground is
+   * the voxels where the mask, on the grid of the image, is not zero. */
+  template <typename TMaskImage>
+  void SetImage(const TensorImageType * image, const TMaskImage * mask,
+                const TensorType & background = TensorType(NumericTraits<TComponent>::Zero) );
+
+  /** Defines the foreground of a region, and allocates the packed image,
+   * whose tensors are then set by the caller.  The runs must be sorted,
+   * disjoint and in the region. */
+  void Allocate(const RegionType & region, const RunListType & runs, const TensorType & background);
+
+  const RunListType & GetRuns() const
+  {
+    return m_Runs;
+  }
+
+  SizeValueType GetNumberOfForegroundPixels() const
+  {
+    return m_NumberOfForegroundPixels;
+  }
+
+  /** Foreground tensors followed by the background tensor */
+  PackedImageType * GetPackedImage()
+  {
+    return m_PackedImage;
+  }
+
+  const PackedImageType * GetPackedImage() const
+  {
+    return m_PackedImage;
+  }
+
+  /** Index of a position of the region, x first */
+  IndexType ComputeIndex(SizeValueType offset) const;
+
+  /** Packs the foreground of an image whose buffer covers the region.
+   * The last pixel of the packed image is the background value. */
+  template <typename TImage>
+  typename Image<typename TImage::PixelType, VDimension>::Pointer
+  Pack(const TImage * image, const typename TImage::PixelType & background) const;
+
+  /** Dense image of the region from a packed image.  The voxels out of
+   * the foreground have the value of the last pixel of the packed
+   * image. */
+  template <typename TPixel>
+  typename Image<TPixel, VDimension>::Pointer
+  Expand(const Image<TPixel, VDimension> * packed) const;
+
+  /** Dense tensor image, with the meta-data dictionary */
+  typename TensorImageType::Pointer GetDenseImage() const;
+
+protected:
+  SparseTensorImage();
+  ~SparseTensorImage()
+  {
+  }
+
+  void PrintSelf(std::ostream & os, Indent indent) const ITK_OVERRIDE;
+
+private:
+  SparseTensorImage(const Self &); // purposely not implemented
+  void operator=(const Self &);    // purposely not implemented
+
+  /** Appends a voxel of the region to the runs */
+  void AddForegroundPixel(SizeValueType offset);
+
+  void SetInformation(const TensorImageType * image);
+
+  SpacingType        m_Spacing;
+  PointType          m_Origin;
+  DirectionType      m_Direction;
+  RegionType         m_Region;
+  TensorType         m_BackgroundTensor;
+  MetaDataDictionary m_MetaDataDictionary;
+
+  RunListType                       m_Runs;
+  SizeValueType                     m_NumberOfForegroundPixels;
+  typename PackedImageType::Pointer m_PackedImage;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkSparseTensorImage.txx"
+#endif
+
+#endif
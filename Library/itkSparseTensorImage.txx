@@ -0,0 +1,273 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkSparseTensorImage_txx
+#define __itkSparseTensorImage_txx
+
+#include "itkSparseTensorImage.h"
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIterator.h>
+
+namespace itk
+{
+
+template <typename TComponent, unsigned int VDimension>
+SparseTensorImage<TComponent, VDimension>
+::SparseTensorImage() :
+  m_BackgroundTensor(NumericTraits<TComponent>::Zero),
+  m_NumberOfForegroundPixels(0)
+{
+  m_Spacing.Fill(1.0);
+  m_Origin.Fill(0.0);
+  m_Direction.SetIdentity();
+  this->Allocate(m_Region, RunListType(), m_BackgroundTensor);
+}
+
+template <typename TComponent, unsigned int VDimension>
+void
+SparseTensorImage<TComponent, VDimension>
+::AddForegroundPixel(SizeValueType offset)
+{
+  if( !m_Runs.empty() && m_Runs.back().Offset + m_Runs.back().Length == offset )
+    {
+    ++m_Runs.back().Length;
+    }
+  else
+    {
+    Run run;
+    run.Offset = offset;
+    run.Length = 1;
+    m_Runs.push_back(run);
+    }
+  ++m_NumberOfForegroundPixels;
+}
+
+template <typename TComponent, unsigned int VDimension>
+void
+SparseTensorImage<TComponent, VDimension>
+::SetInformation(const TensorImageType * image)
+{
+  m_Spacing = image->GetSpacing();
+  m_Origin = image->GetOrigin();
+  m_Direction = image->GetDirection();
+  m_Region = image->GetBufferedRegion();
+  m_MetaDataDictionary = image->GetMetaDataDictionary();
+  m_Runs.clear();
+  m_NumberOfForegroundPixels = 0;
+}
+
+template <typename TComponent, unsigned int VDimension>
+void
+SparseTensorImage<TComponent, VDimension>
+::SetImage(const TensorImageType * image, const TensorType & background)
+{
+  this->SetInformation(image);
+  SizeValueType offset = 0;
+  for( ImageRegionConstIterator<TensorImageType> it(image, m_Region); !it.IsAtEnd(); ++it, ++offset )
+    {
+    if( it.Get() != background )
+      {
+      this->AddForegroundPixel(offset);
+      }
+    }
+  m_BackgroundTensor = background;
+  m_PackedImage = this->Pack(image, background);
+  this->Modified();
+}
+
+template <typename TComponent, unsigned int VDimension>
+template <typename TMaskImage>
+void
+SparseTensorImage<TComponent, VDimension>
+::SetImage(const TensorImageType * image, const TMaskImage * mask, const TensorType & background)
+{
+  this->SetInformation(image);
+  if( !mask->GetBufferedRegion().IsInside(m_Region) )
+    {
+    itkExceptionMacro(<< "The mask does not cover the region " << m_Region);
+    }
+  SizeValueType offset = 0;
+  for( ImageRegionConstIterator<TMaskImage> it(mask, m_Region); !it.IsAtEnd(); ++it, ++offset )
+    {
+    if( it.Get() != NumericTraits<typename TMaskImage::PixelType>::Zero )
+      {
+      this->AddForegroundPixel(offset);
+      }
+    }
+  m_BackgroundTensor = background;
+  m_PackedImage = this->Pack(image, background);
+  this->Modified();
+}
+
+template <typename TComponent, unsigned int VDimension>
+void
+SparseTensorImage<TComponent, VDimension>
+::Allocate(const RegionType & region, const RunListType & runs, const TensorType & background)
+{
+  const SizeValueType numberOfPixels = region.GetNumberOfPixels();
+  SizeValueType       end = 0;
+  SizeValueType       count = 0;
+  for( typename RunListType::const_iterator it = runs.begin(); it != runs.end(); ++it )
+    {
+    if( it->Offset < end || it->Length > numberOfPixels || it->Offset > numberOfPixels - it->Length )
+      {
+      itkExceptionMacro(<< "The runs are not sorted, disjoint and in the region " << region);
+      }
+    end = it->Offset + it->Length;
+    count += it->Length;
+    }
+  m_Region = region;
+  m_Runs = runs;
+  m_NumberOfForegroundPixels = count;
+  m_BackgroundTensor = background;
+
+  typename PackedImageType::RegionType packedRegion;
+  packedRegion.SetSize(0, count + 1);
+  for( unsigned int i = 1; i < VDimension; ++i )
+    {
+    packedRegion.SetSize(i, 1);
+    }
+  m_PackedImage = PackedImageType::New();
+  m_PackedImage->SetRegions(packedRegion);
+  m_PackedImage->Allocate();
+  m_PackedImage->GetBufferPointer()[count] = background;
+  this->Modified();
+}
+
+template <typename TComponent, unsigned int VDimension>
+typename SparseTensorImage<TComponent, VDimension>::IndexType
+SparseTensorImage<TComponent, VDimension>
+::ComputeIndex(SizeValueType offset) const
+{
+  IndexType index;
+  for( unsigned int i = 0; i < VDimension; ++i )
+    {
+    const SizeValueType size = m_Region.GetSize(i);
+    index[i] = m_Region.GetIndex(i) + static_cast<IndexValueType>(offset % size);
+    offset /= size;
+    }
+  return index;
+}
+
+template <typename TComponent, unsigned int VDimension>
+template <typename TImage>
+typename Image<typename TImage::PixelType, VDimension>::Pointer
+SparseTensorImage<TComponent, VDimension>
+::Pack(const TImage * image, const typename TImage::PixelType & background) const
+{
+  typedef Image<typename TImage::PixelType, VDimension> OutputImageType;
+  if( !image->GetBufferedRegion().IsInside(m_Region) )
+    {
+    itkExceptionMacro(<< "The image does not cover the region " << m_Region);
+    }
+
+  typename OutputImageType::RegionType packedRegion;
+  packedRegion.SetSize(0, m_NumberOfForegroundPixels + 1);
+  for( unsigned int i = 1; i < VDimension; ++i )
+    {
+    packedRegion.SetSize(i, 1);
+    }
+  typename OutputImageType::Pointer packed = OutputImageType::New();
+  packed->SetRegions(packedRegion);
+  packed->Allocate();
+
+  // The runs are visited in the order of the iterator
+  typename TImage::PixelType *             out = packed->GetBufferPointer();
+  ImageRegionConstIterator<TImage>         it(image, m_Region);
+  SizeValueType                            offset = 0;
+  for( typename RunListType::const_iterator run = m_Runs.begin(); run != m_Runs.end(); ++run )
+    {
+    for( ; offset < run->Offset; ++offset )
+      {
+      ++it;
+      }
+    for( SizeValueType k = 0; k < run->Length; ++k, ++offset, ++it )
+      {
+      *out++ = it.Get();
+      }
+    }
+  *out = background;
+  return packed;
+}
+
+template <typename TComponent, unsigned int VDimension>
+template <typename TPixel>
+typename Image<TPixel, VDimension>::Pointer
+SparseTensorImage<TComponent, VDimension>
+::Expand(const Image<TPixel, VDimension> * packed) const
+{
+  typedef Image<TPixel, VDimension> OutputImageType;
+  if( packed->GetBufferedRegion().GetNumberOfPixels() != m_NumberOfForegroundPixels + 1 )
+    {
+    itkExceptionMacro(<< "The packed image does not have " << m_NumberOfForegroundPixels + 1 << " pixels");
+    }
+
+  typename OutputImageType::Pointer output = OutputImageType::New();
+  output->SetRegions(m_Region);
+  output->SetSpacing(m_Spacing);
+  output->SetOrigin(m_Origin);
+  output->SetDirection(m_Direction);
+  output->Allocate();
+
+  const TPixel *                         in = packed->GetBufferPointer();
+  const TPixel                           background = in[m_NumberOfForegroundPixels];
+  ImageRegionIterator<OutputImageType>   it(output, m_Region);
+  SizeValueType                          offset = 0;
+  for( typename RunListType::const_iterator run = m_Runs.begin(); run != m_Runs.end(); ++run )
+    {
+    for( ; offset < run->Offset; ++offset, ++it )
+      {
+      it.Set(background);
+      }
+    for( SizeValueType k = 0; k < run->Length; ++k, ++offset, ++it )
+      {
+      it.Set(*in++);
+      }
+    }
+  for( ; !it.IsAtEnd(); ++it )
+    {
+    it.Set(background);
+    }
+  return output;
+}
+
+template <typename TComponent, unsigned int VDimension>
+typename SparseTensorImage<TComponent, VDimension>::TensorImageType::Pointer
+SparseTensorImage<TComponent, VDimension>
+::GetDenseImage() const
+{
+  typename TensorImageType::Pointer dense = this->Expand(m_PackedImage.GetPointer() );
+  dense->SetMetaDataDictionary(m_MetaDataDictionary);
+  return dense;
+}
+
+template <typename TComponent, unsigned int VDimension>
+void
+SparseTensorImage<TComponent, VDimension>
+::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Spacing: " << m_Spacing << std::endl;
+  os << indent << "Origin: " << m_Origin << std::endl;
+  os << indent << "Direction: " << m_Direction << std::endl;
+  os << indent << "Region: " << m_Region << std::endl;
+  os << indent << "BackgroundTensor: " << m_BackgroundTensor << std::endl;
+  os << indent << "NumberOfRuns: " << m_Runs.size() << std::endl;
+  os << indent << "NumberOfForegroundPixels: " << m_NumberOfForegroundPixels << std::endl;
+}
+
+} // end namespace itk
+
+#endif
@@ -19,6 +19,7 @@
 
 #include "itkUnaryFunctorImageFilter.h"
 #include "itkRGBPixel.h"
+#include "itkDiffusionTensor3DEigenSolver.h"
 
 namespace itk
 {
@@ -58,20 +59,25 @@ public:
 
   PixelType operator()( const TInput & x )
   {
-    RealValueType fa = x.GetFractionalAnisotropy();
+    EigenVectorsType mat;
+    EigenValuesType  e;
+
+    DiffusionTensor3DEigenSolver<TInput>::ComputeEigenAnalysis(x, e, mat);
+    return ComputeColor(x.GetFractionalAnisotropy(), e, mat);
+  }
 
+  /** Color of a tensor of fractional anisotropy fa, eigenvalues e and
+   * eigenvectors mat */
+  static PixelType ComputeColor( RealValueType fa, const EigenValuesType & e, const EigenVectorsType & mat )
+  {
     // Clamp FA
     if( fa > 1.0 )
       {
       fa = 1.0;
       }
 
-    PixelType        color;
-    EigenVectorsType mat;
-    EigenValuesType  e;
-    RealValueType    ev1[3];
-
-    x.ComputeEigenAnalysis(e, mat);
+    PixelType     color;
+    RealValueType ev1[3];
 
     if( e[1] > e[0] && e[1] > e[2] )
       {
@@ -1,5 +1,5 @@
 #include <itkGradientRecursiveGaussianImageFilter.h>
-#include <itkNthElementImageAdaptor.h>
+#include "itkTensorToPlanesImageFilter.h"
 
 // const double eps = 1e-16;
 template <typename T>
@@ -9,29 +9,28 @@ void TensorFAGradientImageFilter<T>::GenerateData()
 //  outputImage->SetRequrestedRegion(inputImage
   this->AllocateOutputs();
 
-  typedef NthElementImageAdaptor<InputImageType, T> ElementAdaptorType;
-  typedef typename ElementAdaptorType::Pointer      ElementAdaptorPointer;
+  typedef Image<T, 3>                                                  ComponentImageType;
+  typedef TensorToPlanesImageFilter<InputImageType, ComponentImageType> PlanesFilterType;
 
   typedef OutputImageType ComponentGradientImageType;
 
-  typedef itk::GradientRecursiveGaussianImageFilter<ElementAdaptorType,
+  typedef itk::GradientRecursiveGaussianImageFilter<ComponentImageType,
                                                     ComponentGradientImageType>
     TensorComponentGradientType;
   typedef typename TensorComponentGradientType::Pointer TensorComponentGradientPointer;
 
-  std::vector<ElementAdaptorPointer>          componentadaptors(6);
   std::vector<TensorComponentGradientPointer> componentgradientfilters(6);
 
+  // The components are split once into contiguous planes, which the
+  // gradient filters read directly
   const typename InputImageType::Pointer input(const_cast<InputImageType *>(this->GetInput() ) );
+  typename PlanesFilterType::Pointer     planes = PlanesFilterType::New();
+  planes->SetInput(input);
+  planes->Update();
   for( int i = 0; i < 6; ++i )
     {
-    componentadaptors[i] = ElementAdaptorType::New();
-    componentadaptors[i]->SetImage(input);
-    componentadaptors[i]->SelectNthElement(i);
-    componentadaptors[i]->Update();
-
     componentgradientfilters[i] = TensorComponentGradientType::New();
-    componentgradientfilters[i]->SetInput(componentadaptors[i]);
+    componentgradientfilters[i]->SetInput(planes->GetPlane(i) );
     componentgradientfilters[i]->SetSigma(m_Sigma);
     componentgradientfilters[i]->Update();
 
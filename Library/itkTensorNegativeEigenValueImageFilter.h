@@ -18,6 +18,7 @@
 #define __itkTensorNegativeEigenValueImageFilter_h
 
 #include "itkUnaryFunctorImageFilter.h"
+#include "itkDiffusionTensor3DEigenSolver.h"
 
 namespace itk
 {
@@ -61,7 +62,7 @@ public:
 
     typedef typename TInput::EigenValuesArrayType EigenValuesType;
     EigenValuesType e;
-    x.ComputeEigenValues(e);
+    DiffusionTensor3DEigenSolver<TInput>::ComputeEigenValues(x, e);
     if( e[0] <= 0 || e[1] <= 0 || e[2] <= 0 )
       {
       return 1;
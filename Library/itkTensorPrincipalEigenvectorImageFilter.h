@@ -19,8 +19,7 @@
 
 #include "itkUnaryFunctorImageFilter.h"
 #include "itkCovariantVector.h"
-#include <vnl/vnl_double_3.h>
-#include <vnl/algo/vnl_symmetric_eigensystem.h>
+#include "itkDiffusionTensor3DEigenSolver.h"
 
 namespace itk
 {
@@ -59,47 +58,18 @@ public:
 
   PixelType operator()( const TInput & x ) const
   {
-    double lambdas[3];
-
-    vnl_symmetric_eigensystem_compute_eigenvals(x[0], x[1], x[2],
-                                                x[3], x[4],
-                                                x[5],
-                                                lambdas[0],
-                                                lambdas[1],
-                                                lambdas[2]);
-
-    // Substract eigenvalue * I from x
-    TInput y(x);
-    y[0] -= lambdas[2];
-    y[3] -= lambdas[2];
-    y[5] -= lambdas[2];
-
-    // const double epsilon = 1.0e-16;
-    // Largest eigenvalue is distinct
-    //      if(lambdas[2] - lambdas[1] >= 0)
-    //      {
-    // Cross-product of any two rows of y
-    const vnl_double_3 a(y[0], y[1], y[2]);
-    const vnl_double_3 b(y[1], y[3], y[4]);
-    const vnl_double_3 c(y[2], y[4], y[5]);
-    // Find two largest magnitude vectors as one
-    // row may have been nulled by the substraction
-    const vnl_double_3 evec = (vnl_cross_3d(a, b)
-                               + vnl_cross_3d(a, c)
-                               + vnl_cross_3d(b, c) ).normalize();
-
-    return PixelType(evec.data_block() );
-    //      }
-    // Largest two are duplicated but distinct from smallest
-//       else if(lambdas[1] - lambdas[0] > epsilon)
-//       {
-//       }
-    // Space is isotropic
-    //     else
-    //     {
-    //       throw itk::ExceptionObject("Tracked into region with undefined largest eigenvector");
-    //     }
-
+    EigenValuesType  lambdas;
+    EigenVectorsType evecs;
+
+    DiffusionTensor3DEigenSolver<TInput>::ComputeEigenAnalysis(x, lambdas, evecs);
+
+    // Eigenvectors are the rows, the largest eigenvalue is the last one
+    PixelType evec;
+    for( unsigned int i = 0; i < 3; ++i )
+      {
+      evec[i] = static_cast<VectorPixelValueType>(evecs(2, i) );
+      }
+    return evec;
   }
 
 };
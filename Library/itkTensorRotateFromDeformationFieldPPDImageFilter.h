@@ -18,6 +18,7 @@
 #define __itkTensorRotateFromDeformationFieldPPDImageFilter_h
 
 #include "itkBinaryFunctorImageFilter.h"
+#include "itkDiffusionTensor3DEigenSolver.h"
 #include <vnl/algo/vnl_qr.h>
 #include <vnl/vnl_quaternion.h>
 #include <vnl/vnl_vector.h>
@@ -76,7 +77,7 @@ public:
     EigenVectorsType mat;
     EigenValuesType  e;
 
-    x.ComputeEigenAnalysis(e, mat);
+    DiffusionTensor3DEigenSolver<TInput1>::ComputeEigenAnalysis(x, e, mat);
 
     typedef vnl_vector_fixed<TransformPrecision, 3> VnlVectorType;
     VnlVectorType ev1, ev2, ev3;
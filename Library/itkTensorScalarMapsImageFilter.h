@@ -0,0 +1,287 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkTensorScalarMapsImageFilter_h
+#define __itkTensorScalarMapsImageFilter_h
+
+#include <itkImageToImageFilter.h>
+#include <itkImage.h>
+#include <itkRGBPixel.h>
+#include <itkCovariantVector.h>
+#include <itkMatrix.h>
+#include <map>
+#include <vector>
+
+namespace itk
+{
+
+namespace TensorScalarMaps
+{
+/** Maps computed by TensorScalarMapsImageFilter, and indices of its
+ * outputs.  Lambda1 is the largest eigenvalue. */
+enum MapType
+  {
+  FractionalAnisotropy = 0,
+  MeanDiffusivity,
+  FrobeniusNorm,
+  Lambda1,
+  Lambda2,
+  Lambda3,
+  RadialDiffusivity,
+  ColorFractionalAnisotropy,
+  PrincipalEigenvector,
+  NumberOfMaps
+  };
+
+/** Short name of a map, as used in the statistics tables */
+inline const char * GetMapName(MapType map)
+{
+  static const char * const names[NumberOfMaps] =
+    { "fa", "md", "fro", "lambda1", "lambda2", "lambda3", "rd", "colorfa", "pd" };
+  return names[map];
+}
+}
+
+/** \class TensorScalarMapsImageFilter
+ * \brief Computes several maps of a tensor image in a single pass.
+ *
+ * Each requested map is an output of the filter; the maps that are not
+ * requested are neither computed nor allocated.  The tensors of a
+ * region are decomposed once, in blocks, with
+ * DiffusionTensor3DEigenSolver, and every requested map is filled from
+ * that decomposition.  This is what TensorFractionalAnisotropyImageFilter,
+ * TensorMeanDiffusivityImageFilter, TensorFrobeniusNormImageFilter,
+ * SymmetricEigenAnalysisImageFilter, TensorColorFAImageFilter and
+ * TensorPrincipalEigenvectorImageFilter compute, but without reading the
+ * tensors and decomposing them once per map.
+ *
+ * The scalar maps (FA to RD) are of type TScalarImage.  They are
+ * multiplied by FractionalAnisotropyScale (FA) or DiffusivityScale (the
+ * others) and converted as ShiftScaleImageFilter does: values out of the
+ * range of the output pixel type are clamped and the others truncated.
+ * The color FA is an RGB image of unsigned char, and the principal
+ * eigenvector, rotated by PrincipalEigenvectorRotation, an image of
+ * covariant vectors.
+ *
+ * When a label image is set, the filter also summarizes the scalar maps
+ * selected with SetComputeStatistics() in every non-zero label, from
+ * the unscaled values: count, mean, standard deviation, minimum,
+ * maximum and percentiles.  It also computes the Log-Euclidean and the
+ * affine-invariant mean tensors of the positive definite tensors of the
+ * label.  Zero tensors (the background) are ignored.  The threads fill
+ * their own accumulators, which are merged once all the regions are
+ * processed.  The percentiles and the affine-invariant mean need all
+ * the values of a label, so the accumulators keep them.
+ *
+ * \ingroup Multithreaded TensorObjects
+ */
+template <typename TInputImage, typename TScalarImage>
+class ITK_EXPORT TensorScalarMapsImageFilter :
+  public ImageToImageFilter<TInputImage, TScalarImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef TensorScalarMapsImageFilter                   Self;
+  typedef ImageToImageFilter<TInputImage, TScalarImage> Superclass;
+  typedef SmartPointer<Self>                            Pointer;
+  typedef SmartPointer<const Self>                      ConstPointer;
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TScalarImage::ImageDimension);
+
+  typedef TInputImage                             InputImageType;
+  typedef typename InputImageType::PixelType      InputPixelType;
+  typedef typename InputPixelType::RealValueType  RealValueType;
+  typedef TScalarImage                            ScalarImageType;
+  typedef typename ScalarImageType::PixelType     ScalarPixelType;
+  typedef typename ScalarImageType::RegionType    OutputImageRegionType;
+  typedef Image<RGBPixel<unsigned char>, itkGetStaticConstMacro(ImageDimension)>          ColorImageType;
+  typedef Image<CovariantVector<RealValueType, 3>, itkGetStaticConstMacro(ImageDimension)> VectorImageType;
+  typedef Matrix<RealValueType, 3, 3>            RotationMatrixType;
+  typedef TensorScalarMaps::MapType              MapType;
+  typedef Image<unsigned int, itkGetStaticConstMacro(ImageDimension)> LabelImageType;
+  typedef typename LabelImageType::PixelType                          LabelPixelType;
+
+  /** Summary of a scalar map in a label.  Percentiles are in the order
+   * of GetPercentiles(). */
+  struct ScalarStatistics
+  {
+    RealValueType              Mean;
+    RealValueType              StandardDeviation;
+    RealValueType              Minimum;
+    RealValueType              Maximum;
+    std::vector<RealValueType> Percentiles;
+  };
+
+  /** Statistics of a label.  Only the scalar maps selected with
+   * SetComputeStatistics() are filled.  TensorCount is the number of
+   * positive definite tensors averaged in the mean tensors. */
+  struct LabelStatistics
+  {
+    SizeValueType    Count;
+    ScalarStatistics Scalars[TensorScalarMaps::ColorFractionalAnisotropy];
+    SizeValueType    TensorCount;
+    InputPixelType   LogEuclideanMean;
+    InputPixelType   AffineInvariantMean;
+  };
+  typedef std::map<LabelPixelType, LabelStatistics> LabelStatisticsMapType;
+
+  typedef typename Superclass::DataObjectPointerArraySizeType DataObjectPointerArraySizeType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Runtime information support. */
+  itkTypeMacro(TensorScalarMapsImageFilter, ImageToImageFilter);
+
+  /** Select the maps to compute.  None is by default. */
+  void SetComputeMap(MapType map, bool compute);
+
+  bool GetComputeMap(MapType map) const
+  {
+    return m_ComputeMap[map];
+  }
+
+  /** Label image of the statistics, on the grid of the input.  The
+   * statistics are only computed when it is set. */
+  void SetLabelImage(const LabelImageType * labels)
+  {
+    this->ProcessObject::SetNthInput(1, const_cast<LabelImageType *>(labels) );
+  }
+
+  const LabelImageType * GetLabelImage() const
+  {
+    return static_cast<const LabelImageType *>(this->ProcessObject::GetInput(1) );
+  }
+
+  /** Select the scalar maps (FractionalAnisotropy to
+   * RadialDiffusivity) summarized in the labels.  They do not need to
+   * be computed as outputs. */
+  void SetComputeStatistics(MapType map, bool compute);
+
+  bool GetComputeStatistics(MapType map) const
+  {
+    return m_ComputeStatistics[map];
+  }
+
+  /** Percentiles of the scalar statistics, between 0 and 100.  The
+   * default is 5, 25, 50, 75 and 95. */
+  void SetPercentiles(const std::vector<double> & percentiles)
+  {
+    m_Percentiles = percentiles;
+    this->Modified();
+  }
+
+  const std::vector<double> & GetPercentiles() const
+  {
+    return m_Percentiles;
+  }
+
+  /** Statistics of the labels found in the last update */
+  const LabelStatisticsMapType & GetLabelStatistics() const
+  {
+    return m_LabelStatistics;
+  }
+
+  itkSetMacro(FractionalAnisotropyScale, RealValueType);
+  itkGetConstMacro(FractionalAnisotropyScale, RealValueType);
+
+  itkSetMacro(DiffusivityScale, RealValueType);
+  itkGetConstMacro(DiffusivityScale, RealValueType);
+
+  /** Rotation applied to the principal eigenvector, for instance to
+   * bring it from the measurement frame to the image frame.  Identity
+   * by default. */
+  itkSetMacro(PrincipalEigenvectorRotation, RotationMatrixType);
+  itkGetConstReferenceMacro(PrincipalEigenvectorRotation, RotationMatrixType);
+
+  /** Output of a scalar map, FractionalAnisotropy to RadialDiffusivity */
+  ScalarImageType * GetScalarOutput(MapType map)
+  {
+    return dynamic_cast<ScalarImageType *>(this->ProcessObject::GetOutput(map) );
+  }
+
+  ColorImageType * GetColorFAOutput()
+  {
+    return dynamic_cast<ColorImageType *>(this->ProcessObject::GetOutput(TensorScalarMaps::ColorFractionalAnisotropy) );
+  }
+
+  VectorImageType * GetPrincipalEigenvectorOutput()
+  {
+    return dynamic_cast<VectorImageType *>(this->ProcessObject::GetOutput(TensorScalarMaps::PrincipalEigenvector) );
+  }
+
+  /** Creates the outputs of the color FA and principal eigenvector */
+  virtual DataObject::Pointer MakeOutput(DataObjectPointerArraySizeType idx) ITK_OVERRIDE;
+  using Superclass::MakeOutput;
+
+protected:
+  TensorScalarMapsImageFilter();
+  virtual ~TensorScalarMapsImageFilter()
+  {
+  };
+
+  void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
+
+  /** Only the requested maps are allocated. */
+  virtual void AllocateOutputs() ITK_OVERRIDE;
+
+  virtual void BeforeThreadedGenerateData() ITK_OVERRIDE;
+
+  virtual void ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread,
+                                    ThreadIdType threadId) ITK_OVERRIDE;
+
+  /** Merges the accumulators of the threads into the statistics */
+  virtual void AfterThreadedGenerateData() ITK_OVERRIDE;
+
+  /** Scale and convert a value as ShiftScaleImageFilter does. */
+  static ScalarPixelType ConvertScalar(RealValueType value, RealValueType scale);
+
+private:
+  TensorScalarMapsImageFilter(const Self &); // purposely not implemented
+  void operator=(const Self &);              // purposely not implemented
+
+  /** Values of a label gathered by one thread */
+  struct LabelAccumulator
+  {
+    LabelAccumulator() : Count(0), TensorCount(0), LogSum(0.0)
+    {
+    }
+
+    SizeValueType               Count;
+    std::vector<RealValueType>  Values[TensorScalarMaps::ColorFractionalAnisotropy];
+    SizeValueType               TensorCount;
+    InputPixelType              LogSum;
+    std::vector<InputPixelType> Tensors;
+  };
+  typedef std::map<LabelPixelType, LabelAccumulator> LabelAccumulatorMapType;
+
+  bool               m_ComputeMap[TensorScalarMaps::NumberOfMaps];
+  bool               m_ComputeStatistics[TensorScalarMaps::ColorFractionalAnisotropy];
+  RealValueType      m_FractionalAnisotropyScale;
+  RealValueType      m_DiffusivityScale;
+  RotationMatrixType m_PrincipalEigenvectorRotation;
+
+  std::vector<double>                  m_Percentiles;
+  std::vector<LabelAccumulatorMapType> m_ThreadAccumulators;
+  LabelStatisticsMapType               m_LabelStatistics;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkTensorScalarMapsImageFilter.txx"
+#endif
+
+#endif
@@ -0,0 +1,532 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkTensorScalarMapsImageFilter_txx
+#define __itkTensorScalarMapsImageFilter_txx
+
+#include "itkTensorScalarMapsImageFilter.h"
+#include "itkDiffusionTensor3DEigenSolver.h"
+#include "itkTensorColorFAImageFilter.h"
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIterator.h>
+#include <itkNumericTraits.h>
+#include <itkVectorContainer.h>
+#include "SymmetricSpaceTensorGeometry.h"
+#include "TensorStatistics.h"
+#include <algorithm>
+#include <cmath>
+
+namespace itk
+{
+
+template <typename TInputImage, typename TScalarImage>
+TensorScalarMapsImageFilter<TInputImage, TScalarImage>
+::TensorScalarMapsImageFilter() :
+  m_FractionalAnisotropyScale(1.0),
+  m_DiffusivityScale(1.0)
+{
+  for( unsigned int i = 0; i < TensorScalarMaps::NumberOfMaps; ++i )
+    {
+    m_ComputeMap[i] = false;
+    }
+  for( unsigned int i = 0; i < TensorScalarMaps::ColorFractionalAnisotropy; ++i )
+    {
+    m_ComputeStatistics[i] = false;
+    }
+  m_PrincipalEigenvectorRotation.SetIdentity();
+  const double percentiles[5] = { 5, 25, 50, 75, 95 };
+  m_Percentiles.assign(percentiles, percentiles + 5);
+
+  this->SetNumberOfRequiredOutputs(TensorScalarMaps::NumberOfMaps);
+  for( unsigned int i = 1; i < TensorScalarMaps::NumberOfMaps; ++i )
+    {
+    this->SetNthOutput(i, this->MakeOutput(i) );
+    }
+}
+
+template <typename TInputImage, typename TScalarImage>
+DataObject::Pointer
+TensorScalarMapsImageFilter<TInputImage, TScalarImage>
+::MakeOutput(DataObjectPointerArraySizeType idx)
+{
+  switch( idx )
+    {
+    case TensorScalarMaps::ColorFractionalAnisotropy:
+      return ColorImageType::New().GetPointer();
+    case TensorScalarMaps::PrincipalEigenvector:
+      return VectorImageType::New().GetPointer();
+    default:
+      return ScalarImageType::New().GetPointer();
+    }
+}
+
+template <typename TInputImage, typename TScalarImage>
+void
+TensorScalarMapsImageFilter<TInputImage, TScalarImage>
+::SetComputeMap(MapType map, bool compute)
+{
+  if( m_ComputeMap[map] != compute )
+    {
+    m_ComputeMap[map] = compute;
+    this->Modified();
+    }
+}
+
+template <typename TInputImage, typename TScalarImage>
+void
+TensorScalarMapsImageFilter<TInputImage, TScalarImage>
+::SetComputeStatistics(MapType map, bool compute)
+{
+  if( map >= TensorScalarMaps::ColorFractionalAnisotropy )
+    {
+    itkExceptionMacro(<< "Statistics are only computed for scalar maps");
+    }
+  if( m_ComputeStatistics[map] != compute )
+    {
+    m_ComputeStatistics[map] = compute;
+    this->Modified();
+    }
+}
+
+template <typename TInputImage, typename TScalarImage>
+void
+TensorScalarMapsImageFilter<TInputImage, TScalarImage>
+::AllocateOutputs()
+{
+  for( unsigned int i = 0; i < TensorScalarMaps::NumberOfMaps; ++i )
+    {
+    if( !m_ComputeMap[i] )
+      {
+      continue;
+      }
+    ImageBase<ImageDimension> * output =
+      static_cast<ImageBase<ImageDimension> *>(this->ProcessObject::GetOutput(i) );
+    output->SetBufferedRegion(output->GetRequestedRegion() );
+    output->Allocate();
+    }
+}
+
+template <typename TInputImage, typename TScalarImage>
+typename TensorScalarMapsImageFilter<TInputImage, TScalarImage>::ScalarPixelType
+TensorScalarMapsImageFilter<TInputImage, TScalarImage>
+::ConvertScalar(RealValueType value, RealValueType scale)
+{
+  value *= scale;
+  if( value < NumericTraits<ScalarPixelType>::NonpositiveMin() )
+    {
+    return NumericTraits<ScalarPixelType>::NonpositiveMin();
+    }
+  if( value > NumericTraits<ScalarPixelType>::max() )
+    {
+    return NumericTraits<ScalarPixelType>::max();
+    }
+  return static_cast<ScalarPixelType>(value);
+}
+
+template <typename TInputImage, typename TScalarImage>
+void
+TensorScalarMapsImageFilter<TInputImage, TScalarImage>
+::BeforeThreadedGenerateData()
+{
+  m_LabelStatistics.clear();
+  m_ThreadAccumulators.clear();
+  if( this->GetLabelImage() )
+    {
+    m_ThreadAccumulators.resize(this->GetNumberOfThreads() );
+    }
+}
+
+template <typename TInputImage, typename TScalarImage>
+void
+TensorScalarMapsImageFilter<TInputImage, TScalarImage>
+::ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread,
+                       ThreadIdType threadId)
+{
+  typedef DiffusionTensor3DEigenSolver<InputPixelType>                  SolverType;
+  typedef typename InputPixelType::EigenValuesArrayType                  EigenValuesArrayType;
+  typedef typename InputPixelType::EigenVectorsMatrixType                EigenVectorsMatrixType;
+  typedef Functor::TensorColorFAFunction<InputPixelType, unsigned char> ColorFunctorType;
+  typedef ImageRegionIterator<ScalarImageType>                           ScalarIteratorType;
+  const unsigned int BlockSize = 64;
+
+  const unsigned int numberOfScalarMaps = TensorScalarMaps::ColorFractionalAnisotropy;
+  const LabelImageType * labelImage = this->GetLabelImage();
+  bool               computeValue[numberOfScalarMaps];
+  ScalarIteratorType scalarIts[numberOfScalarMaps];
+  for( unsigned int i = 0; i < numberOfScalarMaps; ++i )
+    {
+    computeValue[i] = m_ComputeMap[i] || ( labelImage && m_ComputeStatistics[i] );
+    if( m_ComputeMap[i] )
+      {
+      scalarIts[i] = ScalarIteratorType(this->GetScalarOutput(static_cast<MapType>(i) ), outputRegionForThread);
+      }
+    }
+  const bool computeColor = m_ComputeMap[TensorScalarMaps::ColorFractionalAnisotropy];
+  const bool computeVector = m_ComputeMap[TensorScalarMaps::PrincipalEigenvector];
+  ImageRegionIterator<ColorImageType>  cit;
+  ImageRegionIterator<VectorImageType> vit;
+  if( computeColor )
+    {
+    cit = ImageRegionIterator<ColorImageType>(this->GetColorFAOutput(), outputRegionForThread);
+    }
+  if( computeVector )
+    {
+    vit = ImageRegionIterator<VectorImageType>(this->GetPrincipalEigenvectorOutput(), outputRegionForThread);
+    }
+
+  // The mean tensors average the logarithms of the tensors
+  const bool needEigenVectors = computeColor || computeVector || labelImage;
+  const bool needEigenValues = needEigenVectors
+    || computeValue[TensorScalarMaps::Lambda1] || computeValue[TensorScalarMaps::Lambda2]
+    || computeValue[TensorScalarMaps::Lambda3] || computeValue[TensorScalarMaps::RadialDiffusivity];
+
+  const bool computeFA = computeValue[TensorScalarMaps::FractionalAnisotropy] || computeColor;
+  const bool computeBlockValue[TensorScalarMaps::Lambda1] =
+    { computeFA, computeValue[TensorScalarMaps::MeanDiffusivity], computeValue[TensorScalarMaps::FrobeniusNorm] };
+
+  InputPixelType         tensors[BlockSize];
+  RealValueType          planes[6][BlockSize];
+  RealValueType          blockValues[TensorScalarMaps::Lambda1][BlockSize];
+  LabelPixelType         labels[BlockSize];
+  EigenValuesArrayType   e[BlockSize];
+  EigenVectorsMatrixType v[BlockSize];
+  ImageRegionConstIterator<InputImageType> it(this->GetInput(), outputRegionForThread);
+  ImageRegionConstIterator<LabelImageType> lit;
+  if( labelImage )
+    {
+    lit = ImageRegionConstIterator<LabelImageType>(labelImage, outputRegionForThread);
+    }
+  while( !it.IsAtEnd() )
+    {
+    unsigned int count = 0;
+    for( ; count < BlockSize && !it.IsAtEnd(); ++count, ++it )
+      {
+      tensors[count] = it.Get();
+      if( labelImage )
+        {
+        labels[count] = lit.Get();
+        ++lit;
+        }
+      }
+    if( needEigenVectors )
+      {
+      SolverType::ComputeEigenAnalysis(tensors, count, e, v);
+      }
+    else if( needEigenValues )
+      {
+      SolverType::ComputeEigenValues(tensors, count, e);
+      }
+
+    // FA, MD and the Frobenius norm only need the components: they are
+    // computed over the block from the planes of the components, in
+    // loops which vectorize across the voxels.  The operations are
+    // those of DiffusionTensor3D, in the same order.
+    if( computeBlockValue[0] || computeBlockValue[1] || computeBlockValue[2] )
+      {
+      for( unsigned int c = 0; c < 6; ++c )
+        {
+        for( unsigned int i = 0; i < count; ++i )
+          {
+          planes[c][i] = tensors[i][c];
+          }
+        }
+      }
+    if( computeFA )
+      {
+      RealValueType * fa = blockValues[TensorScalarMaps::FractionalAnisotropy];
+      for( unsigned int i = 0; i < count; ++i )
+        {
+        const RealValueType isp = planes[0][i] * planes[0][i] + planes[3][i] * planes[3][i]
+          + planes[5][i] * planes[5][i]
+          + 2.0 * ( planes[1][i] * planes[1][i] + planes[2][i] * planes[2][i] + planes[4][i] * planes[4][i] );
+        const RealValueType trace = planes[0][i] + planes[3][i] + planes[5][i];
+        // The anisotropy of isotropic tensors can be rounded below zero
+        const RealValueType anisotropy = std::max<RealValueType>(3.0 * isp - trace * trace, 0.0);
+        fa[i] = isp > 0.0 ? static_cast<RealValueType>(std::sqrt(anisotropy / ( 2.0 * ( isp > 0.0 ? isp : 1.0 ) ) ) ) :
+          0.0;
+        }
+      }
+    if( computeValue[TensorScalarMaps::MeanDiffusivity] )
+      {
+      RealValueType * md = blockValues[TensorScalarMaps::MeanDiffusivity];
+      for( unsigned int i = 0; i < count; ++i )
+        {
+        md[i] = ( planes[0][i] + planes[3][i] + planes[5][i] ) / 3.0;
+        }
+      }
+    if( computeValue[TensorScalarMaps::FrobeniusNorm] )
+      {
+      RealValueType * fro = blockValues[TensorScalarMaps::FrobeniusNorm];
+      for( unsigned int i = 0; i < count; ++i )
+        {
+        fro[i] = std::sqrt(planes[0][i] * planes[0][i] + 2 * planes[1][i] * planes[1][i]
+                           + 2 * planes[2][i] * planes[2][i] + planes[3][i] * planes[3][i]
+                           + 2 * planes[4][i] * planes[4][i] + planes[5][i] * planes[5][i]);
+        }
+      }
+
+    for( unsigned int i = 0; i < count; ++i )
+      {
+      const InputPixelType & x = tensors[i];
+      RealValueType          values[numberOfScalarMaps];
+      for( unsigned int map = 0; map < TensorScalarMaps::Lambda1; ++map )
+        {
+        if( computeBlockValue[map] )
+          {
+          values[map] = blockValues[map][i];
+          }
+        }
+      // Eigenvalues are in ascending order, lambda1 is the largest
+      if( needEigenValues )
+        {
+        values[TensorScalarMaps::Lambda1] = e[i][2];
+        values[TensorScalarMaps::Lambda2] = e[i][1];
+        values[TensorScalarMaps::Lambda3] = e[i][0];
+        values[TensorScalarMaps::RadialDiffusivity] = ( e[i][0] + e[i][1] ) * 0.5;
+        }
+
+      for( unsigned int map = 0; map < numberOfScalarMaps; ++map )
+        {
+        if( m_ComputeMap[map] )
+          {
+          scalarIts[map].Set(ConvertScalar(values[map], map == TensorScalarMaps::FractionalAnisotropy ?
+                                           m_FractionalAnisotropyScale : m_DiffusivityScale) );
+          ++scalarIts[map];
+          }
+        }
+      if( computeColor )
+        {
+        cit.Set(ColorFunctorType::ComputeColor(values[TensorScalarMaps::FractionalAnisotropy], e[i], v[i]) );
+        ++cit;
+        }
+      if( computeVector )
+        {
+        // Eigenvectors are the rows, the largest eigenvalue is the last
+        typename VectorImageType::PixelType evec;
+        for( unsigned int r = 0; r < 3; ++r )
+          {
+          evec[r] = 0;
+          for( unsigned int c = 0; c < 3; ++c )
+            {
+            evec[r] += m_PrincipalEigenvectorRotation(r, c) * v[i](2, c);
+            }
+          }
+        vit.Set(evec);
+        ++vit;
+        }
+
+      if( !labelImage || labels[i] == 0 ||
+          ( x[0] == 0 && x[1] == 0 && x[2] == 0 && x[3] == 0 && x[4] == 0 && x[5] == 0 ) )
+        {
+        continue;
+        }
+      LabelAccumulator & accumulator = m_ThreadAccumulators[threadId][labels[i]];
+      ++accumulator.Count;
+      for( unsigned int map = 0; map < numberOfScalarMaps; ++map )
+        {
+        if( m_ComputeStatistics[map] )
+          {
+          accumulator.Values[map].push_back(values[map]);
+          }
+        }
+      if( e[i][0] > 0 )
+        {
+        // log(T) = V^T log(D) V, the rows of V are the eigenvectors
+        for( unsigned int r = 0; r < 3; ++r )
+          {
+          for( unsigned int c = r; c < 3; ++c )
+            {
+            RealValueType l = 0;
+            for( unsigned int k = 0; k < 3; ++k )
+              {
+              l += std::log(e[i][k]) * v[i](k, r) * v[i](k, c);
+              }
+            accumulator.LogSum(r, c) += l;
+            }
+          }
+        ++accumulator.TensorCount;
+        accumulator.Tensors.push_back(x);
+        }
+      }
+    }
+}
+
+template <typename TInputImage, typename TScalarImage>
+void
+TensorScalarMapsImageFilter<TInputImage, TScalarImage>
+::AfterThreadedGenerateData()
+{
+  if( m_ThreadAccumulators.empty() )
+    {
+    return;
+    }
+
+  // Merge the accumulators of the threads in the first one
+  LabelAccumulatorMapType & merged = m_ThreadAccumulators[0];
+  for( unsigned int t = 1; t < m_ThreadAccumulators.size(); ++t )
+    {
+    for( typename LabelAccumulatorMapType::iterator it = m_ThreadAccumulators[t].begin();
+         it != m_ThreadAccumulators[t].end(); ++it )
+      {
+      LabelAccumulator & accumulator = merged[it->first];
+      accumulator.Count += it->second.Count;
+      for( unsigned int map = 0; map < TensorScalarMaps::ColorFractionalAnisotropy; ++map )
+        {
+        accumulator.Values[map].insert(accumulator.Values[map].end(),
+                                       it->second.Values[map].begin(), it->second.Values[map].end() );
+        }
+      accumulator.TensorCount += it->second.TensorCount;
+      accumulator.LogSum += it->second.LogSum;
+      accumulator.Tensors.insert(accumulator.Tensors.end(), it->second.Tensors.begin(), it->second.Tensors.end() );
+      }
+    m_ThreadAccumulators[t].clear();
+    }
+
+  typedef DiffusionTensor3D<RealValueType>                             RealTensorType;
+  typedef DiffusionTensor3DEigenSolver<InputPixelType>                 SolverType;
+  typedef SymmetricSpaceTensorGeometry<RealValueType>                  GeometryType;
+  typedef TensorStatistics<RealValueType>                              TensorStatisticsType;
+  typedef typename TensorStatisticsType::TensorListType                TensorListType;
+  GeometryType         geometry;
+  TensorStatisticsType tensorStatistics(&geometry);
+
+  for( typename LabelAccumulatorMapType::iterator it = merged.begin(); it != merged.end(); ++it )
+    {
+    LabelAccumulator & accumulator = it->second;
+    LabelStatistics &  statistics = m_LabelStatistics[it->first];
+    statistics.Count = accumulator.Count;
+    for( unsigned int map = 0; map < TensorScalarMaps::ColorFractionalAnisotropy; ++map )
+      {
+      if( !m_ComputeStatistics[map] )
+        {
+        continue;
+        }
+      std::vector<RealValueType> & values = accumulator.Values[map];
+      ScalarStatistics &           scalar = statistics.Scalars[map];
+      const SizeValueType          n = values.size();
+      std::sort(values.begin(), values.end() );
+
+      RealValueType sum = 0;
+      for( SizeValueType k = 0; k < n; ++k )
+        {
+        sum += values[k];
+        }
+      scalar.Mean = sum / n;
+      RealValueType squares = 0;
+      for( SizeValueType k = 0; k < n; ++k )
+        {
+        squares += ( values[k] - scalar.Mean ) * ( values[k] - scalar.Mean );
+        }
+      scalar.StandardDeviation = n > 1 ? std::sqrt(squares / ( n - 1 ) ) : 0;
+      scalar.Minimum = values.front();
+      scalar.Maximum = values.back();
+
+      // Linear interpolation between the closest ranks
+      scalar.Percentiles.resize(m_Percentiles.size() );
+      for( unsigned int p = 0; p < m_Percentiles.size(); ++p )
+        {
+        const double  rank = std::min(std::max(m_Percentiles[p], 0.0), 100.0) / 100.0 * ( n - 1 );
+        SizeValueType lower = static_cast<SizeValueType>(rank);
+        if( lower >= n - 1 )
+          {
+          scalar.Percentiles[p] = values.back();
+          continue;
+          }
+        scalar.Percentiles[p] = values[lower] + ( rank - lower ) * ( values[lower + 1] - values[lower] );
+        }
+      std::vector<RealValueType>().swap(values);
+      }
+
+    statistics.TensorCount = accumulator.TensorCount;
+    statistics.LogEuclideanMean.Fill(0);
+    statistics.AffineInvariantMean.Fill(0);
+    if( accumulator.TensorCount == 0 )
+      {
+      continue;
+      }
+
+    // Log-Euclidean mean: exponential of the mean of the logarithms
+    const InputPixelType meanLog = accumulator.LogSum / static_cast<RealValueType>(accumulator.TensorCount);
+    typename InputPixelType::EigenValuesArrayType   e;
+    typename InputPixelType::EigenVectorsMatrixType v;
+    SolverType::ComputeEigenAnalysis(meanLog, e, v);
+    for( unsigned int r = 0; r < 3; ++r )
+      {
+      for( unsigned int c = r; c < 3; ++c )
+        {
+        RealValueType value = 0;
+        for( unsigned int k = 0; k < 3; ++k )
+          {
+          value += std::exp(e[k]) * v(k, r) * v(k, c);
+          }
+        statistics.LogEuclideanMean(r, c) = value;
+        }
+      }
+
+    // Affine-invariant (Riemannian) mean
+    typename TensorListType::Pointer tensorList = TensorListType::New();
+    tensorList->Reserve(accumulator.Tensors.size() );
+    for( SizeValueType k = 0; k < accumulator.Tensors.size(); ++k )
+      {
+      RealTensorType tensor;
+      for( unsigned int c = 0; c < 6; ++c )
+        {
+        tensor[c] = accumulator.Tensors[k][c];
+        }
+      tensorList->SetElement(k, tensor);
+      }
+    std::vector<InputPixelType>().swap(accumulator.Tensors);
+    RealTensorType mean;
+    tensorStatistics.ComputeMean(tensorList, mean);
+    for( unsigned int c = 0; c < 6; ++c )
+      {
+      statistics.AffineInvariantMean[c] = mean[c];
+      }
+    }
+  m_ThreadAccumulators.clear();
+}
+
+template <typename TInputImage, typename TScalarImage>
+void
+TensorScalarMapsImageFilter<TInputImage, TScalarImage>
+::PrintSelf(std::ostream& os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "ComputeMap:";
+  for( unsigned int i = 0; i < TensorScalarMaps::NumberOfMaps; ++i )
+    {
+    os << " " << m_ComputeMap[i];
+    }
+  os << std::endl;
+  os << indent << "FractionalAnisotropyScale: " << m_FractionalAnisotropyScale << std::endl;
+  os << indent << "DiffusivityScale: " << m_DiffusivityScale << std::endl;
+  os << indent << "PrincipalEigenvectorRotation: " << m_PrincipalEigenvectorRotation << std::endl;
+  os << indent << "ComputeStatistics:";
+  for( unsigned int i = 0; i < TensorScalarMaps::ColorFractionalAnisotropy; ++i )
+    {
+    os << " " << m_ComputeStatistics[i];
+    }
+  os << std::endl;
+  os << indent << "Percentiles:";
+  for( unsigned int i = 0; i < m_Percentiles.size(); ++i )
+    {
+    os << " " << m_Percentiles[i];
+    }
+  os << std::endl;
+}
+
+} // end namespace itk
+
+#endif
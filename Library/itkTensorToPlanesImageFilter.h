@@ -0,0 +1,88 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkTensorToPlanesImageFilter_h
+#define __itkTensorToPlanesImageFilter_h
+
+#include <itkImageToImageFilter.h>
+
+namespace itk
+{
+/** \class TensorToPlanesImageFilter
+ * \brief Splits a tensor image into the six planes of its components.
+ *
+ * Output i is the image of component i of the tensors (xx, xy, xz, yy,
+ * yz, zz), contiguous in memory.  This structure-of-arrays layout is
+ * what per-component filters (smoothing, gradients) read, without an
+ * NthElementImageAdaptor striding through the tensors, and what lets
+ * the loops over the voxels vectorize.  The six planes are filled in a
+ * single pass over the tensors, line by line.
+ *
+ * PlanesToTensorImageFilter interleaves the planes back.
+ *
+ * \ingroup Multithreaded TensorObjects
+ */
+template <typename TInputImage, typename TPlaneImage>
+class ITK_EXPORT TensorToPlanesImageFilter :
+  public ImageToImageFilter<TInputImage, TPlaneImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef TensorToPlanesImageFilter                    Self;
+  typedef ImageToImageFilter<TInputImage, TPlaneImage> Superclass;
+  typedef SmartPointer<Self>                           Pointer;
+  typedef SmartPointer<const Self>                     ConstPointer;
+
+  typedef TInputImage                          InputImageType;
+  typedef typename InputImageType::PixelType   InputPixelType;
+  typedef TPlaneImage                          PlaneImageType;
+  typedef typename PlaneImageType::PixelType   PlanePixelType;
+  typedef typename PlaneImageType::RegionType  OutputImageRegionType;
+
+  itkStaticConstMacro(NumberOfPlanes, unsigned int, 6);
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Runtime information support. */
+  itkTypeMacro(TensorToPlanesImageFilter, ImageToImageFilter);
+
+  /** Plane of component i of the tensors */
+  PlaneImageType * GetPlane(unsigned int i)
+  {
+    return this->GetOutput(i);
+  }
+
+protected:
+  TensorToPlanesImageFilter();
+  virtual ~TensorToPlanesImageFilter()
+  {
+  }
+
+  virtual void ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread,
+                                    ThreadIdType threadId) ITK_OVERRIDE;
+
+private:
+  TensorToPlanesImageFilter(const Self &); // purposely not implemented
+  void operator=(const Self &);            // purposely not implemented
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkTensorToPlanesImageFilter.txx"
+#endif
+
+#endif
@@ -0,0 +1,69 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkTensorToPlanesImageFilter_txx
+#define __itkTensorToPlanesImageFilter_txx
+
+#include "itkTensorToPlanesImageFilter.h"
+#include <itkImageRegionConstIteratorWithIndex.h>
+
+namespace itk
+{
+
+template <typename TInputImage, typename TPlaneImage>
+TensorToPlanesImageFilter<TInputImage, TPlaneImage>
+::TensorToPlanesImageFilter()
+{
+  this->SetNumberOfRequiredOutputs(NumberOfPlanes);
+  for( unsigned int i = 1; i < NumberOfPlanes; ++i )
+    {
+    this->SetNthOutput(i, this->MakeOutput(i) );
+    }
+}
+
+template <typename TInputImage, typename TPlaneImage>
+void
+TensorToPlanesImageFilter<TInputImage, TPlaneImage>
+::ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread, ThreadIdType)
+{
+  const InputImageType * input = this->GetInput();
+  PlaneImageType *       planes[NumberOfPlanes];
+  for( unsigned int c = 0; c < NumberOfPlanes; ++c )
+    {
+    planes[c] = this->GetOutput(c);
+    }
+  const SizeValueType length = outputRegionForThread.GetSize(0);
+
+  // One line at a time: the planes are written contiguously
+  OutputImageRegionType lines = outputRegionForThread;
+  lines.SetSize(0, 1);
+  for( ImageRegionConstIteratorWithIndex<InputImageType> it(input, lines); !it.IsAtEnd(); ++it )
+    {
+    const typename InputImageType::IndexType & index = it.GetIndex();
+    const InputPixelType *                     in = input->GetBufferPointer() + input->ComputeOffset(index);
+    for( unsigned int c = 0; c < NumberOfPlanes; ++c )
+      {
+      PlanePixelType * out = planes[c]->GetBufferPointer() + planes[c]->ComputeOffset(index);
+      for( SizeValueType x = 0; x < length; ++x )
+        {
+        out[x] = static_cast<PlanePixelType>(in[x][c]);
+        }
+      }
+    }
+}
+
+} // end namespace itk
+
+#endif
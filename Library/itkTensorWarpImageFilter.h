@@ -0,0 +1,173 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkTensorWarpImageFilter_h
+#define __itkTensorWarpImageFilter_h
+
+#include <itkImageToImageFilter.h>
+#include <itkVectorInterpolateImageFunction.h>
+#include <itkMatrix.h>
+#include "itkLogEuclideanTensorImageFilter.h"
+#include "itkDeformationFieldJacobianFunction.h"
+#include "itkTensorRotateFromDeformationFieldImageFilter.h"
+
+namespace itk
+{
+/** \class TensorWarpImageFilter
+ * \brief Warps a tensor image with a displacement field and reorients
+ * the tensors in a single pass.
+ *
+ * For each output voxel the filter samples the displacement, interpolates
+ * the log-tensors at the displaced point, takes the exponential, computes
+ * the jacobian of the displacement field from the neighboring
+ * displacements and reorients the tensor with TReorientationFunctor
+ * (TensorRotateFromDeformationFieldFunction or
+ * TensorRotateFromDeformationFieldPPDFunction).  This computes what the
+ * pipeline WarpVectorImageFilter, ExpEuclideanTensorImageFilter,
+ * DeformationFieldJacobianFilter and TensorRotateFromDeformationField
+ * computes, without the intermediate volumes: only the log-tensors of
+ * the input are stored, for the interpolator, and released after the
+ * warp.
+ *
+ * The output is on the grid of the displacement field (index i of the
+ * output is displaced by pixel i of the field), with the output spacing,
+ * origin and direction, like WarpVectorImageFilter.  The jacobian is
+ * evaluated by DeformationFieldJacobianFunction, in index space like
+ * DeformationFieldJacobianFilter does by default.
+ * Points outside of the input tensors give null tensors.
+ *
+ * \ingroup Multithreaded TensorObjects
+ */
+template <typename TTensorImage, typename TDisplacementField,
+          typename TReorientationFunctor =
+            Functor::TensorRotateFromDeformationFieldFunction<typename TTensorImage::PixelType,
+                                                              Matrix<double, 3, 3>,
+                                                              typename TTensorImage::PixelType> >
+class ITK_EXPORT TensorWarpImageFilter :
+  public ImageToImageFilter<TTensorImage, TTensorImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef TensorWarpImageFilter                          Self;
+  typedef ImageToImageFilter<TTensorImage, TTensorImage> Superclass;
+  typedef SmartPointer<Self>                             Pointer;
+  typedef SmartPointer<const Self>                       ConstPointer;
+
+  typedef TTensorImage                              TensorImageType;
+  typedef typename TensorImageType::PixelType       TensorPixelType;
+  typedef typename TensorPixelType::ValueType       TensorValueType;
+  typedef typename TensorImageType::RegionType      OutputImageRegionType;
+  typedef typename TensorImageType::IndexType       IndexType;
+  typedef typename TensorImageType::SpacingType     SpacingType;
+  typedef typename TensorImageType::PointType       PointType;
+  typedef typename TensorImageType::DirectionType   DirectionType;
+  typedef TDisplacementField                        DisplacementFieldType;
+  typedef typename DisplacementFieldType::PixelType DisplacementType;
+  typedef TReorientationFunctor                     ReorientationFunctorType;
+
+  /** The log-tensors are interpolated */
+  typedef LogEuclideanTensorImageFilter<TensorValueType>             LogFilterType;
+  typedef typename LogFilterType::OutputImageType                    LogTensorImageType;
+  typedef VectorInterpolateImageFunction<LogTensorImageType, double> InterpolatorType;
+
+  /** Jacobian of the displacement field */
+  typedef DeformationFieldJacobianFunction<DisplacementFieldType, double> JacobianFunctionType;
+  typedef typename JacobianFunctionType::OutputType                      JacobianType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Runtime information support. */
+  itkTypeMacro(TensorWarpImageFilter, ImageToImageFilter);
+
+  /** Displacement field (second input) */
+  void SetDisplacementField(const DisplacementFieldType * field)
+  {
+    this->SetNthInput(1, const_cast<DisplacementFieldType *>(field) );
+  }
+
+  const DisplacementFieldType * GetDisplacementField() const
+  {
+    return static_cast<const DisplacementFieldType *>(this->ProcessObject::GetInput(1) );
+  }
+
+  /** Interpolator of the log-tensors (required) */
+  itkSetObjectMacro(Interpolator, InterpolatorType);
+  itkGetObjectMacro(Interpolator, InterpolatorType);
+
+  /** Region of the output, a region of the displacement field.  The
+   * largest region of the field when empty. */
+  itkSetMacro(OutputRegion, OutputImageRegionType);
+  itkGetConstReferenceMacro(OutputRegion, OutputImageRegionType);
+
+  itkSetMacro(OutputSpacing, SpacingType);
+  itkGetConstReferenceMacro(OutputSpacing, SpacingType);
+
+  itkSetMacro(OutputOrigin, PointType);
+  itkGetConstReferenceMacro(OutputOrigin, PointType);
+
+  itkSetMacro(OutputDirection, DirectionType);
+  itkGetConstReferenceMacro(OutputDirection, DirectionType);
+
+protected:
+  TensorWarpImageFilter();
+  virtual ~TensorWarpImageFilter()
+  {
+  }
+
+  void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
+
+  /** The output is on the grid of the displacement field */
+  virtual void GenerateOutputInformation() ITK_OVERRIDE;
+
+  /** The whole tensor image is requested, and the displacements of the
+   * output region and of their neighbors */
+  virtual void GenerateInputRequestedRegion() ITK_OVERRIDE;
+
+  /** The tensors and the displacement field are on different grids */
+  virtual void VerifyInputInformation() ITK_OVERRIDE
+  {
+  }
+
+  /** Computes the log-tensors and connects the interpolator and the
+   * jacobian function */
+  virtual void BeforeThreadedGenerateData() ITK_OVERRIDE;
+
+  virtual void ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread,
+                                    ThreadIdType threadId) ITK_OVERRIDE;
+
+  /** Releases the log-tensors */
+  virtual void AfterThreadedGenerateData() ITK_OVERRIDE;
+
+private:
+  TensorWarpImageFilter(const Self &); // purposely not implemented
+  void operator=(const Self &);        // purposely not implemented
+
+  typename InterpolatorType::Pointer     m_Interpolator;
+  typename JacobianFunctionType::Pointer m_JacobianFunction;
+  typename LogTensorImageType::Pointer   m_LogTensors;
+  OutputImageRegionType                  m_OutputRegion;
+  SpacingType                            m_OutputSpacing;
+  PointType                              m_OutputOrigin;
+  DirectionType                          m_OutputDirection;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkTensorWarpImageFilter.txx"
+#endif
+
+#endif
@@ -0,0 +1,180 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkTensorWarpImageFilter_txx
+#define __itkTensorWarpImageFilter_txx
+
+#include "itkTensorWarpImageFilter.h"
+#include "itkExpEuclideanTensorImageFilter.h"
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkProgressReporter.h>
+
+namespace itk
+{
+
+template <typename TTensorImage, typename TDisplacementField, typename TReorientationFunctor>
+TensorWarpImageFilter<TTensorImage, TDisplacementField, TReorientationFunctor>
+::TensorWarpImageFilter()
+{
+  this->SetNumberOfRequiredInputs(2);
+  m_OutputSpacing.Fill(1.0);
+  m_OutputOrigin.Fill(0.0);
+  m_OutputDirection.SetIdentity();
+  m_JacobianFunction = JacobianFunctionType::New();
+}
+
+template <typename TTensorImage, typename TDisplacementField, typename TReorientationFunctor>
+void
+TensorWarpImageFilter<TTensorImage, TDisplacementField, TReorientationFunctor>
+::PrintSelf(std::ostream& os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  os << indent << "OutputRegion:    " << m_OutputRegion << std::endl;
+  os << indent << "OutputSpacing:   " << m_OutputSpacing << std::endl;
+  os << indent << "OutputOrigin:    " << m_OutputOrigin << std::endl;
+  os << indent << "OutputDirection: " << m_OutputDirection << std::endl;
+  os << indent << "Interpolator:    " << m_Interpolator.GetPointer() << std::endl;
+}
+
+template <typename TTensorImage, typename TDisplacementField, typename TReorientationFunctor>
+void
+TensorWarpImageFilter<TTensorImage, TDisplacementField, TReorientationFunctor>
+::GenerateOutputInformation()
+{
+  Superclass::GenerateOutputInformation();
+
+  TensorImageType *             output = this->GetOutput();
+  const DisplacementFieldType * field = this->GetDisplacementField();
+  if( !output || !field )
+    {
+    return;
+    }
+
+  output->SetSpacing(m_OutputSpacing);
+  output->SetOrigin(m_OutputOrigin);
+  output->SetDirection(m_OutputDirection);
+  if( m_OutputRegion.GetNumberOfPixels() > 0 )
+    {
+    output->SetLargestPossibleRegion(m_OutputRegion);
+    }
+  else
+    {
+    output->SetLargestPossibleRegion(field->GetLargestPossibleRegion() );
+    }
+}
+
+template <typename TTensorImage, typename TDisplacementField, typename TReorientationFunctor>
+void
+TensorWarpImageFilter<TTensorImage, TDisplacementField, TReorientationFunctor>
+::GenerateInputRequestedRegion()
+{
+  Superclass::GenerateInputRequestedRegion();
+
+  TensorImageType *       input = const_cast<TensorImageType *>(this->GetInput() );
+  DisplacementFieldType * field = const_cast<DisplacementFieldType *>(this->GetDisplacementField() );
+  if( input )
+    {
+    input->SetRequestedRegionToLargestPossibleRegion();
+    }
+  if( field )
+    {
+    // The jacobian needs the neighbors of the output region
+    typename DisplacementFieldType::RegionType fieldRegion = this->GetOutput()->GetRequestedRegion();
+    fieldRegion.PadByRadius(1);
+    fieldRegion.Crop(field->GetLargestPossibleRegion() );
+    field->SetRequestedRegion(fieldRegion);
+    }
+}
+
+template <typename TTensorImage, typename TDisplacementField, typename TReorientationFunctor>
+void
+TensorWarpImageFilter<TTensorImage, TDisplacementField, TReorientationFunctor>
+::BeforeThreadedGenerateData()
+{
+  if( !m_Interpolator )
+    {
+    itkExceptionMacro(<< "Interpolator not set");
+    }
+
+  typename LogFilterType::Pointer logf = LogFilterType::New();
+  logf->SetInput(this->GetInput() );
+  logf->SetNumberOfThreads(this->GetNumberOfThreads() );
+  logf->Update();
+  m_LogTensors = logf->GetOutput();
+  m_LogTensors->DisconnectPipeline();
+
+  m_Interpolator->SetInputImage(m_LogTensors);
+  m_JacobianFunction->SetInputImage(this->GetDisplacementField() );
+}
+
+template <typename TTensorImage, typename TDisplacementField, typename TReorientationFunctor>
+void
+TensorWarpImageFilter<TTensorImage, TDisplacementField, TReorientationFunctor>
+::AfterThreadedGenerateData()
+{
+  m_Interpolator->SetInputImage(ITK_NULLPTR);
+  m_JacobianFunction->SetInputImage(ITK_NULLPTR);
+  m_LogTensors = ITK_NULLPTR;
+}
+
+template <typename TTensorImage, typename TDisplacementField, typename TReorientationFunctor>
+void
+TensorWarpImageFilter<TTensorImage, TDisplacementField, TReorientationFunctor>
+::ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread, ThreadIdType threadId)
+{
+  typedef typename InterpolatorType::OutputType             LogTensorType;
+  typedef Functor::ExpEuclideanTensorFunction<LogTensorType> ExpFunctorType;
+
+  TensorImageType *             output = this->GetOutput();
+  const DisplacementFieldType * field = this->GetDisplacementField();
+  ExpFunctorType                exponential;
+  ReorientationFunctorType      reorient;
+  const TensorPixelType         zero(NumericTraits<TensorValueType>::Zero);
+
+  ProgressReporter progress(this, threadId, outputRegionForThread.GetNumberOfPixels() );
+  for( ImageRegionIteratorWithIndex<TensorImageType> it(output, outputRegionForThread); !it.IsAtEnd(); ++it )
+    {
+    const IndexType & index = it.GetIndex();
+    PointType         point;
+    output->TransformIndexToPhysicalPoint(index, point);
+    const DisplacementType & displacement = field->GetPixel(index);
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      point[d] += displacement[d];
+      }
+
+    if( !m_Interpolator->IsInsideBuffer(point) )
+      {
+      it.Set(zero);
+      }
+    else
+      {
+      const typename ExpFunctorType::OutputType tensor = exponential(m_Interpolator->Evaluate(point) );
+
+      TensorPixelType warped;
+      for( unsigned int c = 0; c < 6; ++c )
+        {
+        warped[c] = static_cast<TensorValueType>(tensor[c]);
+        }
+      it.Set(reorient(warped, m_JacobianFunction->EvaluateAtIndex(index) ) );
+      }
+    progress.CompletedPixel();
+    }
+}
+
+} // end namespace itk
+
+#endif
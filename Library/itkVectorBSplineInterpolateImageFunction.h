@@ -18,8 +18,7 @@
 #define __itkVectorBSplineInterpolateImageFunction_h
 
 #include "itkVectorInterpolateImageFunction.h"
-#include "itkBSplineInterpolateImageFunction.h"
-#include "itkVectorIndexSelectionCastImageFilter.h"
+#include "itkMultiThreader.h"
 
 namespace itk
 {
@@ -28,9 +27,18 @@ namespace itk
  * \class VectorBSplineInterpolateImageFunction
  * \brief BSplinely interpolate a vector image at specified positions.
  *
- * VectorBSplineInterpolateImageFunction linearly interpolates a vector
- * image intensity non-integer pixel position. This class is templated
- * over the input image type and the coordinate representation type.
+ * VectorBSplineInterpolateImageFunction interpolates a vector image
+ * with cubic B-splines at non-integer pixel positions. This class is
+ * templated over the input image type and the coordinate representation
+ * type.
+ *
+ * The B-spline coefficients of all the components are stored in a
+ * single interleaved image, computed by a multithreaded recursive
+ * prefilter when the input is set.  Each evaluation computes the
+ * weights and the support of the spline once and applies them to all
+ * the components.  The results are those of
+ * BSplineInterpolateImageFunction (spline order 3, mirror boundaries)
+ * applied to each component.
  *
  * This function works for N-dimensional images.
  *
@@ -80,17 +88,14 @@ public:
   /** Output type is Vector<double,Dimension> */
   typedef typename Superclass::OutputType OutputType;
 
-  /** component extractor type */
-  typedef typename PixelType::ComponentType                                       ComponentType;
-  typedef Image<ComponentType, ImageDimension>                                    ComponentImageType;
-  typedef VectorIndexSelectionCastImageFilter<InputImageType, ComponentImageType> ComponentAdaptorType;
-  typedef typename ComponentAdaptorType::Pointer                                  ComponentAdaptorPointer;
+  /** Interleaved coefficients of the components */
+  typedef Vector<TCoefficientType, itkGetStaticConstMacro(Dimension)> CoefficientPixelType;
+  typedef Image<CoefficientPixelType, itkGetStaticConstMacro(ImageDimension)>
+    CoefficientImageType;
 
-  /** component interpolator type */
-  typedef BSplineInterpolateImageFunction<ComponentImageType, TCoordRep,
-                                          TCoefficientType> ComponentInterpolateFunctionType;
-  typedef typename ComponentInterpolateFunctionType::Pointer
-                                                            ComponentInterpolateFunctionPointer;
+  /** Number of threads of the prefilter */
+  itkSetMacro(NumberOfThreads, ThreadIdType);
+  itkGetConstMacro(NumberOfThreads, ThreadIdType);
 
   /** Set the input image.  This must be set by the user. */
   virtual void SetInputImage(const TInputImage * inputData) ITK_OVERRIDE;
@@ -105,6 +110,14 @@ public:
    * calling the method. */
   virtual OutputType EvaluateAtContinuousIndex(const ContinuousIndexType & index ) const ITK_OVERRIDE;
 
+  /** Evaluate the function at count ContinuousIndex positions.  The
+   * positions must lie within the image buffer. */
+  void EvaluateAtContinuousIndices(const ContinuousIndexType * indices, SizeValueType count,
+                                   OutputType * values) const;
+
+  /** Get the coefficients of the spline */
+  itkGetConstObjectMacro(Coefficients, CoefficientImageType);
+
 protected:
   VectorBSplineInterpolateImageFunction();
   ~VectorBSplineInterpolateImageFunction()
@@ -116,11 +129,28 @@ private:
   VectorBSplineInterpolateImageFunction(const Self &); // purposely not implemented
   void operator=(const Self &);                        // purposely not implemented
 
-  /** Number of neighbors used in the interpolation */
-  static const unsigned long m_Neighbors;
+  /** Spline order (cubic) and number of coefficients in the support
+   * along each dimension */
+  itkStaticConstMacro(SplineOrder, unsigned int, 3);
+  itkStaticConstMacro(SupportSize, unsigned int, 4);
+
+  /** The lines of the coefficients along one dimension are filtered in
+   * parallel */
+  struct PrefilterJob
+    {
+    CoefficientImageType * coefficients;
+    unsigned int dimension;
+    };
+
+  static ITK_THREAD_RETURN_TYPE PrefilterThreaderCallback(void * arg);
+
+  /** Causal and anti-causal filters of the lines firstLine to lastLine
+   * of the coefficients along dimension */
+  static void PrefilterLines(CoefficientImageType * coefficients, unsigned int dimension,
+                             SizeValueType firstLine, SizeValueType lastLine);
 
-  std::vector<ComponentAdaptorPointer>             m_ComponentAdaptors;
-  std::vector<ComponentInterpolateFunctionPointer> m_ComponentInterpolators;
+  ThreadIdType                           m_NumberOfThreads;
+  typename CoefficientImageType::Pointer m_Coefficients;
 
 };
 
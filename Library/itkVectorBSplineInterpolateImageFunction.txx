@@ -18,20 +18,16 @@
 #define __itkVectorBSplineInterpolateImageFunction_txx
 
 #include "itkVectorBSplineInterpolateImageFunction.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIterator.h"
 
 #include "vnl/vnl_math.h"
+#include <cmath>
+#include <vector>
 
 namespace itk
 {
 
-/**
- * Define the number of neighbors
- */
-template <class TInputImage, class TCoordRep, class TCoefficientType>
-const unsigned long
-VectorBSplineInterpolateImageFunction<TInputImage, TCoordRep, TCoefficientType>
-::m_Neighbors = 1 << TInputImage::ImageDimension;
-
 /**
  * Constructor
  */
@@ -39,13 +35,7 @@ template <class TInputImage, class TCoordRep, class TCoefficientType>
 VectorBSplineInterpolateImageFunction<TInputImage, TCoordRep, TCoefficientType>
 ::VectorBSplineInterpolateImageFunction()
 {
-  m_ComponentInterpolators.resize(Dimension);
-  m_ComponentAdaptors.resize(Dimension);
-  for( unsigned int i = 0; i < Dimension; i++ )
-    {
-    m_ComponentInterpolators[i] = ComponentInterpolateFunctionType::New();
-    m_ComponentAdaptors[i] = ComponentAdaptorType::New();
-    }
+  m_NumberOfThreads = MultiThreader::GetGlobalDefaultNumberOfThreads();
 }
 
 /**
@@ -58,6 +48,7 @@ VectorBSplineInterpolateImageFunction<TInputImage, TCoordRep, TCoefficientType>
 {
   os << "Vector BSpline" << std::endl;
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfThreads: " << m_NumberOfThreads << std::endl;
 }
 
 template <class TImageType, class TCoordRep, class TCoefficientType>
@@ -68,16 +59,148 @@ VectorBSplineInterpolateImageFunction<TImageType, TCoordRep, TCoefficientType>
   // Call super class input set
   this->VectorInterpolateImageFunction<TImageType, TCoordRep>::SetInputImage(inputData);
 
-  if( inputData )
+  if( !inputData )
+    {
+    m_Coefficients = ITK_NULLPTR;
+    return;
+    }
+
+  // The coefficients start as a copy of the image
+  m_Coefficients = CoefficientImageType::New();
+  m_Coefficients->CopyInformation(inputData);
+  m_Coefficients->SetRegions(inputData->GetBufferedRegion() );
+  m_Coefficients->Allocate();
+
+  ImageRegionConstIterator<TImageType>     it(inputData, inputData->GetBufferedRegion() );
+  ImageRegionIterator<CoefficientImageType> cit(m_Coefficients, m_Coefficients->GetBufferedRegion() );
+  for( ; !it.IsAtEnd(); ++it, ++cit )
+    {
+    const PixelType &      value = it.Get();
+    CoefficientPixelType & coefficient = cit.Value();
+    for( unsigned int j = 0; j < Dimension; ++j )
+      {
+      coefficient[j] = static_cast<TCoefficientType>(value[j]);
+      }
+    }
+
+  // Separable prefilter: the lines along each dimension in turn
+  MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads(m_NumberOfThreads);
+  PrefilterJob job;
+  job.coefficients = m_Coefficients;
+  for( unsigned int n = 0; n < ImageDimension; ++n )
     {
-    // data is now stored in m_Image
-    for( unsigned int i = 0; i < Dimension; i++ )
+    if( m_Coefficients->GetBufferedRegion().GetSize(n) > 1 )
+      {
+      job.dimension = n;
+      threader->SetSingleMethod(Self::PrefilterThreaderCallback, &job);
+      threader->SingleMethodExecute();
+      }
+    }
+}
+
+template <class TInputImage, class TCoordRep, class TCoefficientType>
+ITK_THREAD_RETURN_TYPE
+VectorBSplineInterpolateImageFunction<TInputImage, TCoordRep, TCoefficientType>
+::PrefilterThreaderCallback(void * arg)
+{
+  MultiThreader::ThreadInfoStruct * info = static_cast<MultiThreader::ThreadInfoStruct *>(arg);
+  const PrefilterJob *              job = static_cast<PrefilterJob *>(info->UserData);
+
+  const typename CoefficientImageType::SizeType & size = job->coefficients->GetBufferedRegion().GetSize();
+  const SizeValueType numberOfLines = job->coefficients->GetBufferedRegion().GetNumberOfPixels()
+    / size[job->dimension];
+  PrefilterLines(job->coefficients, job->dimension,
+                 numberOfLines * info->ThreadID / info->NumberOfThreads,
+                 numberOfLines * ( info->ThreadID + 1 ) / info->NumberOfThreads);
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+/**
+ * Recursive filters of Unser et al. for the cubic B-spline, with the
+ * initial coefficients and tolerance of BSplineDecompositionImageFilter
+ */
+template <class TInputImage, class TCoordRep, class TCoefficientType>
+void
+VectorBSplineInterpolateImageFunction<TInputImage, TCoordRep, TCoefficientType>
+::PrefilterLines(CoefficientImageType * coefficients, unsigned int dimension,
+                 SizeValueType firstLine, SizeValueType lastLine)
+{
+  const double z = std::sqrt(3.0) - 2.0;
+  const double gain = (1.0 - z) * (1.0 - 1.0 / z);
+  const double tolerance = 1e-10;
+
+  const typename CoefficientImageType::SizeType & size = coefficients->GetBufferedRegion().GetSize();
+  const OffsetValueType *                         offsetTable = coefficients->GetOffsetTable();
+  const SizeValueType                             length = size[dimension];
+  const OffsetValueType                           stride = offsetTable[dimension];
+  const SizeValueType                             horizon =
+    std::min<SizeValueType>(length, static_cast<SizeValueType>(std::ceil(std::log(tolerance)
+                                                                         / std::log(std::fabs(z) ) ) ) );
+
+  CoefficientPixelType *            buffer = coefficients->GetBufferPointer();
+  std::vector<CoefficientPixelType> line(length);
+  for( SizeValueType l = firstLine; l < lastLine; ++l )
+    {
+    // First coefficient of line l
+    SizeValueType   rest = l;
+    OffsetValueType offset = 0;
+    for( unsigned int n = 0; n < ImageDimension; ++n )
+      {
+      if( n != dimension )
+        {
+        offset += static_cast<OffsetValueType>(rest % size[n]) * offsetTable[n];
+        rest /= size[n];
+        }
+      }
+    CoefficientPixelType * c = buffer + offset;
+    for( SizeValueType i = 0; i < length; ++i )
+      {
+      line[i] = c[i * stride] * gain;
+      }
+
+    // Causal filter
+    CoefficientPixelType sum = line[0];
+    if( horizon < length )
+      {
+      double zn = z;
+      for( SizeValueType i = 1; i < horizon; ++i )
+        {
+        sum += line[i] * zn;
+        zn *= z;
+        }
+      }
+    else
+      {
+      const double iz = 1.0 / z;
+      double       zn = z;
+      double       z2n = std::pow(z, static_cast<double>(length - 1) );
+      sum += line[length - 1] * z2n;
+      z2n *= z2n * iz;
+      for( SizeValueType i = 1; i + 1 < length; ++i )
+        {
+        sum += line[i] * (zn + z2n);
+        zn *= z;
+        z2n *= iz;
+        }
+      sum /= (1.0 - zn * zn);
+      }
+    line[0] = sum;
+    for( SizeValueType i = 1; i < length; ++i )
       {
-      m_ComponentAdaptors[i]->SetInput(inputData);
-      m_ComponentAdaptors[i]->SetIndex(i);
-      m_ComponentAdaptors[i]->Update();
+      line[i] += line[i - 1] * z;
+      }
+
+    // Anti-causal filter
+    line[length - 1] = (line[length - 2] * z + line[length - 1]) * (z / (z * z - 1.0) );
+    for( SizeValueType i = length - 1; i > 0; --i )
+      {
+      line[i - 1] = (line[i] - line[i - 1]) * z;
+      }
 
-      m_ComponentInterpolators[i]->SetInputImage(m_ComponentAdaptors[i]->GetOutput() );
+    for( SizeValueType i = 0; i < length; ++i )
+      {
+      c[i * stride] = line[i];
       }
     }
 }
@@ -92,16 +215,95 @@ VectorBSplineInterpolateImageFunction<TInputImage, TCoordRep, TCoefficientType>
 ::EvaluateAtContinuousIndex(
   const ContinuousIndexType& index) const
 {
-  OutputType output;
+  const typename CoefficientImageType::RegionType & region = m_Coefficients->GetBufferedRegion();
+  const OffsetValueType *                           offsetTable = m_Coefficients->GetOffsetTable();
+
+  // Weights and offsets of the support along each dimension, the same
+  // for all the components
+  double          weights[ImageDimension][SupportSize];
+  OffsetValueType offsets[ImageDimension][SupportSize];
+  for( unsigned int n = 0; n < ImageDimension; ++n )
+    {
+    const IndexValueType first = static_cast<IndexValueType>(std::floor(index[n]) ) - SplineOrder / 2;
+    const double         w = index[n] - static_cast<double>(first + 1);
+    weights[n][3] = w * w * w / 6.0;
+    weights[n][0] = 1.0 / 6.0 + 0.5 * w * (w - 1.0) - weights[n][3];
+    weights[n][2] = w + weights[n][0] - 2.0 * weights[n][3];
+    weights[n][1] = 1.0 - weights[n][0] - weights[n][2] - weights[n][3];
+
+    // Mirror boundary conditions
+    const IndexValueType length = static_cast<IndexValueType>(region.GetSize(n) );
+    const IndexValueType period = 2 * length - 2;
+    for( unsigned int k = 0; k < SupportSize; ++k )
+      {
+      IndexValueType i = first + k - region.GetIndex(n);
+      if( length == 1 )
+        {
+        i = 0;
+        }
+      else
+        {
+        i = (i < 0 ? -i : i) % period;
+        if( i >= length )
+          {
+          i = period - i;
+          }
+        }
+      offsets[n][k] = i * offsetTable[n];
+      }
+    }
 
-  output.Fill(0.0);
-  for( unsigned int i = 0; i < Dimension; i++ )
+  TCoefficientType sum[Dimension];
+  for( unsigned int j = 0; j < Dimension; ++j )
     {
-    output[i] = m_ComponentInterpolators[i]->EvaluateAtContinuousIndex(index);
+    sum[j] = 0;
+    }
+
+  const CoefficientPixelType * buffer = m_Coefficients->GetBufferPointer();
+  unsigned int                 numberOfPoints = 1;
+  for( unsigned int n = 0; n < ImageDimension; ++n )
+    {
+    numberOfPoints *= SupportSize;
+    }
+  for( unsigned int p = 0; p < numberOfPoints; ++p )
+    {
+    double          w = 1.0;
+    OffsetValueType offset = 0;
+    unsigned int    q = p;
+    for( unsigned int n = 0; n < ImageDimension; ++n )
+      {
+      const unsigned int k = q % SupportSize;
+      q /= SupportSize;
+      w *= weights[n][k];
+      offset += offsets[n][k];
+      }
+    const CoefficientPixelType & coefficient = buffer[offset];
+    for( unsigned int j = 0; j < Dimension; ++j )
+      {
+      sum[j] += w * coefficient[j];
+      }
+    }
+
+  OutputType output;
+  for( unsigned int j = 0; j < Dimension; ++j )
+    {
+    output[j] = sum[j];
     }
   return output;
 }
 
+template <class TInputImage, class TCoordRep, class TCoefficientType>
+void
+VectorBSplineInterpolateImageFunction<TInputImage, TCoordRep, TCoefficientType>
+::EvaluateAtContinuousIndices(const ContinuousIndexType * indices, SizeValueType count,
+                              OutputType * values) const
+{
+  for( SizeValueType i = 0; i < count; ++i )
+    {
+    values[i] = this->EvaluateAtContinuousIndex(indices[i]);
+    }
+}
+
 } // end namespace itk
 
 #endif
@@ -16,6 +16,7 @@
 #include <vtkFloatArray.h>
 
 #include "fiberio.h"
+#include "itkDiffusionTensor3DEigenSolver.h"
 
 // hide function to this compilation unit
 namespace
@@ -232,8 +233,9 @@ GroupType::Pointer readFiberFile(const std::string & filename)
       throw itk::ExceptionObject("Unknown file format for fibers");
       }
 
-    typedef  itk::SymmetricSecondRankTensor<double, 3> ITKTensorType;
-    typedef  ITKTensorType::EigenValuesArrayType       LambdaArrayType;
+    typedef  itk::DiffusionTensor3D<double>                   ITKTensorType;
+    typedef  ITKTensorType::EigenValuesArrayType              LambdaArrayType;
+    typedef  itk::DiffusionTensor3DEigenSolver<ITKTensorType> EigenSolverType;
 
     // Iterate over VTK data
     const int nfib = fibdata->GetNumberOfCells();
@@ -286,7 +288,7 @@ GroupType::Pointer readFiberFile(const std::string & filename)
 	  LambdaArrayType lambdas;
 	  
 	  // Need to do do eigenanalysis of the tensor
-	  itktensor.ComputeEigenValues(lambdas);
+	  EigenSolverType::ComputeEigenValues(itktensor, lambdas);
 	  
 	  // FIXME: We should not be repeating this code here.  The code
 	  // for all these computations should be re-factored into a
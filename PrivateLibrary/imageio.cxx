@@ -0,0 +1,239 @@
+#include "imageio.h"
+
+#include <itkMultiThreader.h>
+#include <itkMutexLock.h>
+#include <itkConditionVariable.h>
+#include <itksys/SystemTools.hxx>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+// Writers run by a pool of threads, in the order they were queued
+class ImageWriterQueue
+{
+public:
+  ImageWriterQueue() :
+    m_NumberOfThreads(0),
+    m_Pending(0),
+    m_Stopping(false),
+    m_Failed(false)
+  {
+    m_Threader = itk::MultiThreader::New();
+    m_JobQueued = itk::ConditionVariable::New();
+    m_JobDone = itk::ConditionVariable::New();
+  }
+
+  // The writers are waited for by ImageWriterGuard in main(): the
+  // threads are only stopped here, the images still queued are dropped
+  ~ImageWriterQueue()
+  {
+    this->StopThreads();
+  }
+
+  void SetNumberOfThreads(unsigned int threads)
+  {
+    if( threads != m_NumberOfThreads )
+      {
+      this->Wait();
+      this->StopThreads();
+      m_NumberOfThreads = threads;
+      }
+  }
+
+  unsigned int GetNumberOfThreads() const
+  {
+    return m_NumberOfThreads;
+  }
+
+  void Push(itk::ProcessObject * writer)
+  {
+    if( m_Threads.empty() )
+      {
+      for( unsigned int i = 0; i < m_NumberOfThreads; ++i )
+        {
+        m_Threads.push_back(m_Threader->SpawnThread(WriterThread, this) );
+        }
+      }
+    m_Mutex.Lock();
+    m_Jobs.push_back(writer);
+    ++m_Pending;
+    m_JobQueued->Signal();
+    m_Mutex.Unlock();
+  }
+
+  void Wait()
+  {
+    m_Mutex.Lock();
+    while( m_Pending > 0 )
+      {
+      m_JobDone->Wait(&m_Mutex);
+      }
+    const bool                failed = m_Failed;
+    const itk::ExceptionObject error = m_Error;
+    m_Failed = false;
+    m_Mutex.Unlock();
+    if( failed )
+      {
+      throw error;
+      }
+  }
+
+  // Stops the threads once the writers they are running are done
+  void StopThreads()
+  {
+    m_Mutex.Lock();
+    m_Stopping = true;
+    m_JobQueued->Broadcast();
+    m_Mutex.Unlock();
+    for( unsigned int i = 0; i < m_Threads.size(); ++i )
+      {
+      m_Threader->TerminateThread(m_Threads[i]);
+      }
+    m_Threads.clear();
+    m_Jobs.clear();
+    m_Pending = 0;
+    m_Stopping = false;
+  }
+
+private:
+  static ITK_THREAD_RETURN_TYPE WriterThread(void * arg)
+  {
+    ImageWriterQueue * queue =
+      static_cast<ImageWriterQueue *>(static_cast<itk::MultiThreader::ThreadInfoStruct *>(arg)->UserData);
+    queue->m_Mutex.Lock();
+    for( ;; )
+      {
+      while( queue->m_Jobs.empty() && !queue->m_Stopping )
+        {
+        queue->m_JobQueued->Wait(&queue->m_Mutex);
+        }
+      if( queue->m_Stopping )
+        {
+        break;
+        }
+      itk::ProcessObject::Pointer writer = queue->m_Jobs.front();
+      queue->m_Jobs.pop_front();
+      queue->m_Mutex.Unlock();
+
+      bool                 failed = false;
+      itk::ExceptionObject error;
+      try
+        {
+        writer->Update();
+        }
+      catch( itk::ExceptionObject & e )
+        {
+        failed = true;
+        error = e;
+        }
+      catch( std::exception & e )
+        {
+        failed = true;
+        error = itk::ExceptionObject(__FILE__, __LINE__, e.what() );
+        }
+      // The image is released before the writer is reported as done
+      writer = ITK_NULLPTR;
+
+      queue->m_Mutex.Lock();
+      if( failed && !queue->m_Failed )
+        {
+        queue->m_Failed = true;
+        queue->m_Error = error;
+        }
+      --queue->m_Pending;
+      queue->m_JobDone->Broadcast();
+      }
+    queue->m_Mutex.Unlock();
+    return ITK_THREAD_RETURN_VALUE;
+  }
+
+  unsigned int                            m_NumberOfThreads;
+  itk::MultiThreader::Pointer             m_Threader;
+  std::vector<itk::ThreadIdType>          m_Threads;
+  std::deque<itk::ProcessObject::Pointer> m_Jobs;
+  unsigned int                            m_Pending;
+  bool                                    m_Stopping;
+  itk::SimpleMutexLock                    m_Mutex;
+  itk::ConditionVariable::Pointer         m_JobQueued;
+  itk::ConditionVariable::Pointer         m_JobDone;
+  bool                                    m_Failed;
+  itk::ExceptionObject                    m_Error;
+};
+
+ImageWriterQueue & getImageWriterQueue()
+{
+  static ImageWriterQueue queue;
+
+  return queue;
+}
+
+int imageCompressionLevel = -1;
+
+}
+
+void setImageCompressionLevel(int level)
+{
+  imageCompressionLevel = level;
+}
+
+int getImageCompressionLevel()
+{
+  return imageCompressionLevel;
+}
+
+void setImageWriterThreads(unsigned int threads)
+{
+  getImageWriterQueue().SetNumberOfThreads(threads);
+}
+
+unsigned int getImageWriterThreads()
+{
+  return getImageWriterQueue().GetNumberOfThreads();
+}
+
+void waitForImageWriters()
+{
+  getImageWriterQueue().Wait();
+}
+
+void queueImageWriter(itk::ProcessObject * writer)
+{
+  getImageWriterQueue().Push(writer);
+}
+
+bool isWrittenOver(const std::string & input, const std::vector<std::string> & outputs)
+{
+  const std::string path = itksys::SystemTools::CollapseFullPath(input.c_str() );
+  for( unsigned int i = 0; i < outputs.size(); ++i )
+    {
+    if( outputs[i].empty() )
+      {
+      continue;
+      }
+    // SameFile also finds the links to the input
+    if( itksys::SystemTools::CollapseFullPath(outputs[i].c_str() ) == path
+        || ( itksys::SystemTools::FileExists(outputs[i].c_str() )
+             && itksys::SystemTools::SameFile(input.c_str(), outputs[i].c_str() ) ) )
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+ImageWriterGuard::~ImageWriterGuard()
+{
+  try
+    {
+    getImageWriterQueue().Wait();
+    }
+  catch( itk::ExceptionObject & e )
+    {
+    std::cerr << e << std::endl;
+    }
+  getImageWriterQueue().StopThreads();
+}
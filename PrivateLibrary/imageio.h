@@ -19,7 +19,56 @@
 #define IMAGEIO_H
 
 #include <string>
+#include <vector>
 #include <itkSmartPointer.h>
+#include <itkProcessObject.h>
+
+// Compression of the images written by writeImage(): 0 disables it, 1
+// to 9 select the zlib level and -1 (default) uses the default level of
+// the image format.  Only 0 is honored by the other formats than NRRD,
+// whose IOs do not expose the zlib level.
+void setImageCompressionLevel(int level);
+
+int getImageCompressionLevel();
+
+// Number of background threads writing the images of writeImage().
+// With 0 (default) the images are written before writeImage() returns.
+// Otherwise writeImage() only computes the image, which is then
+// compressed and written while the program goes on; the image must not
+// be modified until it is written.
+void setImageWriterThreads(unsigned int threads);
+
+unsigned int getImageWriterThreads();
+
+// Wait until the queued images are written.  Throws the first error of
+// the writer threads.
+void waitForImageWriters();
+
+// Queue an image writer, whose input is not connected to a pipeline
+void queueImageWriter(itk::ProcessObject * writer);
+
+// Declared at the start of main(): waits for the queued images and
+// joins the writer threads on every return path, before the static
+// objects are destroyed.  The errors are then only printed, call
+// waitForImageWriters() first to report them.  exit() skips it.
+class ImageWriterGuard
+{
+public:
+  ImageWriterGuard()
+  {
+  }
+
+  ~ImageWriterGuard();
+
+private:
+  ImageWriterGuard(const ImageWriterGuard &); // purposely not implemented
+  void operator=(const ImageWriterGuard &);   // purposely not implemented
+};
+
+// True if one of the outputs is the input file.  An input which is
+// mapped in memory must then be read instead, since writing the output
+// truncates the file while it is mapped.
+bool isWrittenOver(const std::string & input, const std::vector<std::string> & outputs);
 
 template <typename TImage>
 void writeImage(const std::string & filename, itk::SmartPointer<TImage> image);
@@ -18,6 +18,8 @@
 
 #include "imageio.h"
 #include <itkImageFileWriter.h>
+#include <itkImageIOFactory.h>
+#include "itkParallelNrrdImageIO.h"
 
 template <typename TImage>
 void writeImage(const std::string & filename,
@@ -25,9 +27,37 @@ void writeImage(const std::string & filename,
 {
   typedef itk::ImageFileWriter<TImage> ImageWriterType;
   typename ImageWriterType::Pointer writer = ImageWriterType::New();
-  writer->SetUseCompression(true);
-  writer->SetInput(image);
+  writer->SetUseCompression(getImageCompressionLevel() != 0);
   writer->SetFileName(filename.c_str() );
-  writer->Update();
 
+  // The IO is created here, for the compression level and since the
+  // object factories are not thread safe
+  itk::ImageIOBase::Pointer io =
+    itk::ImageIOFactory::CreateImageIO(filename.c_str(), itk::ImageIOFactory::WriteMode);
+  if( io.IsNull() )
+    {
+    throw itk::ImageFileWriterException(__FILE__, __LINE__,
+                                        ( "Could not create IO object for file " + filename ).c_str() );
+    }
+  itk::ParallelNrrdImageIO * nrrdio = dynamic_cast<itk::ParallelNrrdImageIO *>(io.GetPointer() );
+  if( nrrdio && getImageCompressionLevel() > 0 )
+    {
+    nrrdio->SetCompressionLevel(getImageCompressionLevel() );
+    }
+  writer->SetImageIO(io);
+  if( getImageWriterThreads() == 0 )
+    {
+    writer->SetInput(image);
+    writer->Update();
+    return;
+    }
+
+  // The image is computed here.  The writer threads get a copy which
+  // shares its buffer but not its pipeline.
+  image->Update();
+  typename TImage::Pointer written = TImage::New();
+  written->Graft(image);
+  written->SetMetaDataDictionary(image->GetMetaDataDictionary() );
+  writer->SetInput(written);
+  queueImageWriter(writer);
 }
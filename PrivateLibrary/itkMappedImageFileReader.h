@@ -0,0 +1,219 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkMappedImageFileReader_h
+#define __itkMappedImageFileReader_h
+
+#include <itkImageSource.h>
+#include <itkImageFileReader.h>
+#include <itkImportImageContainer.h>
+#include <itkImageIOBase.h>
+#include <itkNrrdImageIO.h>
+#include "itkMemoryMappedFile.h"
+#include <string>
+
+namespace itk
+{
+/** \class MappedImportImageContainer
+ * \brief Pixel container pointing in a memory mapped file, which stays
+ * mapped as long as the container exists.
+ */
+template <typename TElementIdentifier, typename TElement>
+class MappedImportImageContainer :
+  public ImportImageContainer<TElementIdentifier, TElement>
+{
+public:
+  /** Standard class typedefs. */
+  typedef MappedImportImageContainer                       Self;
+  typedef ImportImageContainer<TElementIdentifier, TElement> Superclass;
+  typedef SmartPointer<Self>                               Pointer;
+  typedef SmartPointer<const Self>                         ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MappedImportImageContainer, ImportImageContainer);
+
+  /** Point the container to the whole mapping of the file */
+  void SetMappedFile(MemoryMappedFile * file)
+  {
+    m_MappedFile = file;
+    this->SetImportPointer(static_cast<TElement *>(file->GetPointer() ),
+                           static_cast<TElementIdentifier>(file->GetLength() / sizeof( TElement ) ), false);
+  }
+
+protected:
+  MappedImportImageContainer()
+  {
+  }
+
+  ~MappedImportImageContainer()
+  {
+  }
+
+private:
+  MappedImportImageContainer(const Self &); // purposely not implemented
+  void operator=(const Self &);             // purposely not implemented
+
+  MemoryMappedFile::Pointer m_MappedFile;
+};
+
+/** \class MappedImageFileReader
+ * \brief Reads uncompressed NRRD files without copying them.
+ *
+ * When the data of a NRRD file is raw (encoding raw, attached or in a
+ * single detached data file) and in the byte order of the machine, the
+ * file is mapped in memory instead of read:
+ * - if the components of the file have the type of the components of
+ *   the output, and are aligned in the file, the output buffer is the
+ *   mapping itself.  The pages are
+ *   shared with the page cache, so tools reading the same volume one
+ *   after the other only load it once, and nothing is read before it is
+ *   used.  The mapping is copy-on-write, so the output can be modified,
+ *   by in-place filters for instance, without changing the file.
+ * - otherwise the requested region of the output is converted from the
+ *   mapping, on all the threads, and only the pages of that region are
+ *   read.
+ *
+ * The other files, the files whose component axis is not the first or
+ * does not hold the components of the pixels, and the files of masked
+ * kinds, whose mask component NrrdImageIO does not count, are read
+ * with ImageFileReader.  The output then has the number
+ * of components of the file, as with ImageFileReader.  So are all the
+ * files when UseMapping is off.
+ *
+ * A private mapping is not a snapshot of the file: the pages which have
+ * not been read yet are read from the file as it is when they are
+ * first accessed.  If the file is truncated while it is mapped, by a
+ * writer overwriting it for instance, accessing the pages past its new
+ * end raises SIGBUS, and the pages within it have the new content.
+ * Turn UseMapping off when an output of the program may be written to
+ * the input file.
+ *
+ * TOutputImage is an Image or a VectorImage.
+ */
+template <typename TOutputImage>
+class MappedImageFileReader : public ImageSource<TOutputImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef MappedImageFileReader      Self;
+  typedef ImageSource<TOutputImage>  Superclass;
+  typedef SmartPointer<Self>         Pointer;
+  typedef SmartPointer<const Self>   ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MappedImageFileReader, ImageSource);
+
+  typedef TOutputImage                                    OutputImageType;
+  typedef typename OutputImageType::PixelType             OutputPixelType;
+  typedef typename OutputImageType::InternalPixelType     InternalPixelType;
+  typedef typename NumericTraits<OutputPixelType>::ValueType OutputComponentType;
+  typedef typename OutputImageType::RegionType            OutputImageRegionType;
+  typedef typename OutputImageType::PixelContainer        PixelContainerType;
+  typedef MappedImportImageContainer<typename PixelContainerType::ElementIdentifier,
+                                     typename PixelContainerType::Element> MappedPixelContainerType;
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TOutputImage::ImageDimension);
+
+  itkSetStringMacro(FileName);
+  itkGetStringMacro(FileName);
+
+  /** Map the files which can be mapped.  On by default. */
+  itkSetMacro(UseMapping, bool);
+  itkGetConstMacro(UseMapping, bool);
+  itkBooleanMacro(UseMapping);
+
+  /** True if the file is mapped, false if it is read with
+   * ImageFileReader.  Valid after UpdateOutputInformation(). */
+  itkGetConstMacro(Mapped, bool);
+
+  /** True if the output buffer is the mapping of the file */
+  itkGetConstMacro(ZeroCopy, bool);
+
+  /** IO of the files read with ImageFileReader, created by the reader
+   * if not set.  The object factories are not thread safe: set it when
+   * the reader is updated on another thread. */
+  void SetImageIO(ImageIOBase * io)
+  {
+    m_Reader->SetImageIO(io);
+    this->Modified();
+  }
+
+  ImageIOBase * GetImageIO()
+  {
+    return m_Reader->GetImageIO();
+  }
+
+protected:
+  MappedImageFileReader();
+  ~MappedImageFileReader()
+  {
+  }
+
+  void PrintSelf(std::ostream & os, Indent indent) const ITK_OVERRIDE;
+
+  virtual void GenerateOutputInformation() ITK_OVERRIDE;
+
+  /** The mapped output is the whole image */
+  virtual void EnlargeOutputRequestedRegion(DataObject *output) ITK_OVERRIDE;
+
+  virtual void GenerateData() ITK_OVERRIDE;
+
+  /** Converts a region from the mapping */
+  virtual void ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread,
+                                    ThreadIdType threadId) ITK_OVERRIDE;
+
+private:
+  MappedImageFileReader(const Self &); // purposely not implemented
+  void operator=(const Self &);        // purposely not implemented
+
+  /** Reads the header with NrrdImageIO and finds the raw data.  Returns
+   * false if the file cannot be mapped. */
+  bool ReadMappedInformation();
+
+  template <typename TFileComponent>
+  void ConvertRegion(const OutputImageRegionType & region);
+
+  std::string m_FileName;
+  bool        m_UseMapping;
+  bool        m_Mapped;
+  bool        m_ZeroCopy;
+
+  std::string                   m_DataFileName;
+  SizeValueType                 m_DataOffset;
+  SizeValueType                 m_DataLength;
+  ImageIOBase::IOComponentType  m_FileComponentType;
+  unsigned int                  m_NumberOfComponents;
+  MemoryMappedFile::Pointer     m_MappedFile;
+
+  /** Created with the reader, for the same reason as the IO of m_Reader */
+  NrrdImageIO::Pointer m_HeaderIO;
+  NrrdImageIO::Pointer m_OutputPixelIO;
+
+  typename ImageFileReader<TOutputImage>::Pointer m_Reader;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkMappedImageFileReader.txx"
+#endif
+
+#endif
@@ -0,0 +1,421 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkMappedImageFileReader_txx
+#define __itkMappedImageFileReader_txx
+
+#include "itkMappedImageFileReader.h"
+#include <itkByteSwapper.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
+#include <itksys/SystemTools.hxx>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace itk
+{
+
+template <typename TOutputImage>
+MappedImageFileReader<TOutputImage>
+::MappedImageFileReader() :
+  m_UseMapping(true),
+  m_Mapped(false),
+  m_ZeroCopy(false),
+  m_DataOffset(0),
+  m_DataLength(0),
+  m_FileComponentType(ImageIOBase::UNKNOWNCOMPONENTTYPE),
+  m_NumberOfComponents(1)
+{
+  m_Reader = ImageFileReader<TOutputImage>::New();
+  m_HeaderIO = NrrdImageIO::New();
+  m_OutputPixelIO = NrrdImageIO::New();
+  m_OutputPixelIO->SetPixelTypeInfo(static_cast<const OutputPixelType *>(ITK_NULLPTR) );
+}
+
+template <typename TOutputImage>
+bool
+MappedImageFileReader<TOutputImage>
+::ReadMappedInformation()
+{
+  NrrdImageIO * io = m_HeaderIO;
+  if( !io->CanReadFile(m_FileName.c_str() ) )
+    {
+    return false;
+    }
+  io->SetFileName(m_FileName);
+  io->ReadImageInformation();
+  if( io->GetNumberOfDimensions() != ImageDimension )
+    {
+    return false;
+    }
+
+  // Components of the output pixels
+  const NrrdImageIO * pixelTypes = m_OutputPixelIO;
+  const bool variableLength = pixelTypes->GetPixelType() == ImageIOBase::VARIABLELENGTHVECTOR;
+  m_NumberOfComponents = io->GetNumberOfComponents();
+  if( !variableLength && m_NumberOfComponents != pixelTypes->GetNumberOfComponents() )
+    {
+    return false;
+    }
+  m_FileComponentType = io->GetComponentType();
+  switch( m_FileComponentType )
+    {
+    case ImageIOBase::UCHAR:
+    case ImageIOBase::CHAR:
+    case ImageIOBase::USHORT:
+    case ImageIOBase::SHORT:
+    case ImageIOBase::UINT:
+    case ImageIOBase::INT:
+    case ImageIOBase::ULONG:
+    case ImageIOBase::LONG:
+    case ImageIOBase::FLOAT:
+    case ImageIOBase::DOUBLE:
+      break;
+    default:
+      return false;
+    }
+
+  // Fields of the header which locate the data.  The field names are
+  // compared without their spaces.
+  std::ifstream header(m_FileName.c_str(), std::ios::in | std::ios::binary);
+  std::string   line;
+  std::string   encoding;
+  std::string   dataFile;
+  std::string   endian;
+  std::string   kinds;
+  std::string   sizes;
+  long          byteSkip = 0;
+  long          lineSkip = 0;
+  bool          componentAxisFirst = m_NumberOfComponents == 1;
+  bool          endOfHeader = false;
+  std::getline(header, line); // magic
+  while( std::getline(header, line) )
+    {
+    if( line.empty() || line == "\r" )
+      {
+      endOfHeader = true;
+      break;
+      }
+    const std::string::size_type colon = line.find(':');
+    if( line[0] == '#' || colon == std::string::npos || line.compare(colon, 2, ":=") == 0 )
+      {
+      continue;
+      }
+    std::string field;
+    for( std::string::size_type i = 0; i < colon; ++i )
+      {
+      if( !isspace(static_cast<unsigned char>(line[i]) ) )
+        {
+        field += static_cast<char>(tolower(static_cast<unsigned char>(line[i]) ) );
+        }
+      }
+    const std::string::size_type start = line.find_first_not_of(" \t", colon + 1);
+    const std::string::size_type end = line.find_last_not_of(" \t\r");
+    const std::string            value = start == std::string::npos ? "" : line.substr(start, end - start + 1);
+    if( field == "encoding" )
+      {
+      encoding = value;
+      }
+    else if( field == "datafile" )
+      {
+      dataFile = value;
+      }
+    else if( field == "endian" )
+      {
+      endian = value;
+      }
+    else if( field == "byteskip" )
+      {
+      byteSkip = atol(value.c_str() );
+      }
+    else if( field == "lineskip" )
+      {
+      lineSkip = atol(value.c_str() );
+      }
+    else if( field == "kinds" )
+      {
+      kinds = value;
+      }
+    else if( field == "sizes" )
+      {
+      sizes = value;
+      }
+    else if( field == "spacedirections" && m_NumberOfComponents > 1 )
+      {
+      componentAxisFirst = value.compare(0, 4, "none") == 0;
+      }
+    }
+  // The masked kinds have a confidence component that NrrdImageIO does
+  // not count, and the file must have one axis of components, sized as
+  // the components of the pixels
+  std::transform(kinds.begin(), kinds.end(), kinds.begin(), ::tolower);
+  if( kinds.find("masked") != std::string::npos )
+    {
+    return false;
+    }
+  std::istringstream         sizeValues(sizes);
+  std::vector<SizeValueType> axisSizes;
+  SizeValueType              axisSize;
+  while( sizeValues >> axisSize )
+    {
+    axisSizes.push_back(axisSize);
+    }
+  if( axisSizes.size() != ImageDimension + ( m_NumberOfComponents > 1 ? 1 : 0 )
+      || ( m_NumberOfComponents > 1 && axisSizes[0] != m_NumberOfComponents ) )
+    {
+    return false;
+    }
+
+  // Detached headers may end without an empty line
+  if( ( !endOfHeader && dataFile.empty() ) || encoding != "raw" || lineSkip != 0 || byteSkip < -1 || !componentAxisFirst
+      || dataFile.find_first_of(" %") != std::string::npos
+      || ( io->GetComponentSize() > 1 && endian != ( ByteSwapper<int>::SystemIsLittleEndian() ? "little" : "big" ) ) )
+    {
+    return false;
+    }
+
+  m_DataLength = static_cast<SizeValueType>(io->GetImageSizeInBytes() );
+  if( dataFile.empty() )
+    {
+    m_DataFileName = m_FileName;
+    m_DataOffset = static_cast<SizeValueType>(header.tellg() );
+    }
+  else
+    {
+    // Relative to the directory of the header
+    m_DataFileName = itksys::SystemTools::CollapseFullPath(dataFile.c_str(),
+                                                            itksys::SystemTools::GetFilenamePath(m_FileName).c_str() );
+    m_DataOffset = 0;
+    }
+  const SizeValueType fileLength = static_cast<SizeValueType>(itksys::SystemTools::FileLength(m_DataFileName.c_str() ) );
+  if( byteSkip == -1 )
+    {
+    // The data is at the end of the file
+    if( fileLength < m_DataLength )
+      {
+      return false;
+      }
+    m_DataOffset = fileLength - m_DataLength;
+    }
+  else
+    {
+    m_DataOffset += byteSkip;
+    }
+  if( m_DataLength == 0 || fileLength < m_DataOffset + m_DataLength )
+    {
+    return false;
+    }
+  // The data of an attached header is not always aligned on its
+  // components, and is then converted
+  m_ZeroCopy = m_FileComponentType == pixelTypes->GetComponentType()
+    && m_DataOffset % io->GetComponentSize() == 0;
+
+  // Same information as ImageFileReader
+  OutputImageType *                 output = this->GetOutput();
+  typename OutputImageType::SpacingType   spacing;
+  typename OutputImageType::PointType     origin;
+  typename OutputImageType::DirectionType direction;
+  OutputImageRegionType                   region;
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+    {
+    spacing[i] = io->GetSpacing(i);
+    origin[i] = io->GetOrigin(i);
+    const std::vector<double> axis = io->GetDirection(i);
+    for( unsigned int j = 0; j < ImageDimension; ++j )
+      {
+      direction[j][i] = axis[j];
+      }
+    region.SetIndex(i, 0);
+    region.SetSize(i, io->GetDimensions(i) );
+    }
+  output->SetSpacing(spacing);
+  output->SetOrigin(origin);
+  output->SetDirection(direction);
+  output->SetLargestPossibleRegion(region);
+  output->SetNumberOfComponentsPerPixel(m_NumberOfComponents);
+  output->SetMetaDataDictionary(io->GetMetaDataDictionary() );
+  return true;
+}
+
+template <typename TOutputImage>
+void
+MappedImageFileReader<TOutputImage>
+::GenerateOutputInformation()
+{
+  if( m_FileName.empty() )
+    {
+    itkExceptionMacro(<< "No file name specified");
+    }
+  m_ZeroCopy = false;
+  m_Mapped = m_UseMapping && this->ReadMappedInformation();
+  if( m_Mapped )
+    {
+    return;
+    }
+
+  m_ZeroCopy = false;
+  m_Reader->SetFileName(m_FileName);
+  m_Reader->UpdateOutputInformation();
+  OutputImageType * output = this->GetOutput();
+  output->CopyInformation(m_Reader->GetOutput() );
+  output->SetMetaDataDictionary(m_Reader->GetOutput()->GetMetaDataDictionary() );
+}
+
+template <typename TOutputImage>
+void
+MappedImageFileReader<TOutputImage>
+::EnlargeOutputRequestedRegion(DataObject *output)
+{
+  if( m_Mapped && m_ZeroCopy )
+    {
+    output->SetRequestedRegionToLargestPossibleRegion();
+    }
+}
+
+template <typename TOutputImage>
+void
+MappedImageFileReader<TOutputImage>
+::GenerateData()
+{
+  OutputImageType * output = this->GetOutput();
+  if( !m_Mapped )
+    {
+    m_Reader->GetOutput()->SetRequestedRegion(output->GetRequestedRegion() );
+    m_Reader->Update();
+    this->GraftOutput(m_Reader->GetOutput() );
+    return;
+    }
+
+  m_MappedFile = MemoryMappedFile::New();
+  m_MappedFile->Map(m_DataFileName, m_DataOffset, m_DataLength);
+  if( m_ZeroCopy )
+    {
+    typename MappedPixelContainerType::Pointer container = MappedPixelContainerType::New();
+    container->SetMappedFile(m_MappedFile);
+    output->SetBufferedRegion(output->GetLargestPossibleRegion() );
+    output->SetPixelContainer(container);
+    }
+  else
+    {
+    // A new buffer, in case the previous one was a mapping
+    output->SetPixelContainer(PixelContainerType::New() );
+    Superclass::GenerateData();
+    }
+  m_MappedFile = ITK_NULLPTR;
+}
+
+template <typename TOutputImage>
+template <typename TFileComponent>
+void
+MappedImageFileReader<TOutputImage>
+::ConvertRegion(const OutputImageRegionType & region)
+{
+  OutputImageType *             output = this->GetOutput();
+  const OutputImageRegionType & largest = output->GetLargestPossibleRegion();
+  const char *                  file = static_cast<const char *>(m_MappedFile->GetPointer() );
+  OutputComponentType *         buffer = reinterpret_cast<OutputComponentType *>(output->GetBufferPointer() );
+  const SizeValueType           lineLength = region.GetSize(0) * m_NumberOfComponents;
+
+  // One line of the region at a time
+  OutputImageRegionType lines = region;
+  lines.SetSize(0, 1);
+  for( ImageRegionConstIteratorWithIndex<OutputImageType> it(output, lines); !it.IsAtEnd(); ++it )
+    {
+    const typename OutputImageType::IndexType & index = it.GetIndex();
+    SizeValueType fileOffset = 0;
+    SizeValueType stride = 1;
+    for( unsigned int i = 0; i < ImageDimension; ++i )
+      {
+      fileOffset += ( index[i] - largest.GetIndex(i) ) * stride;
+      stride *= largest.GetSize(i);
+      }
+    const char *          in = file + fileOffset * m_NumberOfComponents * sizeof( TFileComponent );
+    OutputComponentType * out = buffer + output->ComputeOffset(index) * m_NumberOfComponents;
+    for( SizeValueType c = 0; c < lineLength; ++c, in += sizeof( TFileComponent ) )
+      {
+      // Possibly unaligned
+      TFileComponent value;
+      memcpy(&value, in, sizeof( TFileComponent ) );
+      out[c] = static_cast<OutputComponentType>(value);
+      }
+    }
+}
+
+template <typename TOutputImage>
+void
+MappedImageFileReader<TOutputImage>
+::ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread, ThreadIdType)
+{
+  switch( m_FileComponentType )
+    {
+    case ImageIOBase::UCHAR:
+      this->ConvertRegion<unsigned char>(outputRegionForThread);
+      break;
+    case ImageIOBase::CHAR:
+      this->ConvertRegion<char>(outputRegionForThread);
+      break;
+    case ImageIOBase::USHORT:
+      this->ConvertRegion<unsigned short>(outputRegionForThread);
+      break;
+    case ImageIOBase::SHORT:
+      this->ConvertRegion<short>(outputRegionForThread);
+      break;
+    case ImageIOBase::UINT:
+      this->ConvertRegion<unsigned int>(outputRegionForThread);
+      break;
+    case ImageIOBase::INT:
+      this->ConvertRegion<int>(outputRegionForThread);
+      break;
+    case ImageIOBase::ULONG:
+      this->ConvertRegion<unsigned long>(outputRegionForThread);
+      break;
+    case ImageIOBase::LONG:
+      this->ConvertRegion<long>(outputRegionForThread);
+      break;
+    case ImageIOBase::FLOAT:
+      this->ConvertRegion<float>(outputRegionForThread);
+      break;
+    case ImageIOBase::DOUBLE:
+      this->ConvertRegion<double>(outputRegionForThread);
+      break;
+    default:
+      break;
+    }
+}
+
+template <typename TOutputImage>
+void
+MappedImageFileReader<TOutputImage>
+::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "FileName: " << m_FileName << std::endl;
+  os << indent << "UseMapping: " << m_UseMapping << std::endl;
+  os << indent << "Mapped: " << m_Mapped << std::endl;
+  os << indent << "ZeroCopy: " << m_ZeroCopy << std::endl;
+  if( m_Mapped )
+    {
+    os << indent << "DataFileName: " << m_DataFileName << std::endl;
+    os << indent << "DataOffset: " << m_DataOffset << std::endl;
+    }
+}
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,115 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkMemoryMappedFile.h"
+#include <itkMacro.h>
+
+#if defined( _WIN32 )
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace itk
+{
+
+MemoryMappedFile::MemoryMappedFile() :
+  m_Mapping(ITK_NULLPTR),
+  m_MappingLength(0),
+  m_Data(ITK_NULLPTR),
+  m_Length(0)
+{
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+  this->Unmap();
+}
+
+void
+MemoryMappedFile::Map(const std::string & fileName, SizeValueType offset, SizeValueType length)
+{
+  this->Unmap();
+  if( length == 0 )
+    {
+    itkGenericExceptionMacro(<< "Cannot map 0 bytes of " << fileName);
+    }
+
+#if defined( _WIN32 )
+  SYSTEM_INFO system;
+  GetSystemInfo(&system);
+  const SizeValueType delta = offset % system.dwAllocationGranularity;
+  const SizeValueType start = offset - delta;
+  HANDLE              file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, ITK_NULLPTR,
+                                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, ITK_NULLPTR);
+  if( file == INVALID_HANDLE_VALUE )
+    {
+    itkGenericExceptionMacro(<< "Cannot open " << fileName);
+    }
+  HANDLE mapping = CreateFileMappingA(file, ITK_NULLPTR, PAGE_WRITECOPY, 0, 0, ITK_NULLPTR);
+  CloseHandle(file);
+  if( mapping == ITK_NULLPTR )
+    {
+    itkGenericExceptionMacro(<< "Cannot map " << fileName);
+    }
+  m_Mapping = MapViewOfFile(mapping, FILE_MAP_COPY, static_cast<DWORD>( (unsigned long long)start >> 32 ),
+                            static_cast<DWORD>(start & 0xFFFFFFFF), static_cast<SIZE_T>(length + delta) );
+  CloseHandle(mapping);
+  if( m_Mapping == ITK_NULLPTR )
+    {
+    itkGenericExceptionMacro(<< "Cannot map " << length << " bytes of " << fileName << " at offset " << offset);
+    }
+#else
+  const SizeValueType delta = offset % static_cast<SizeValueType>(sysconf(_SC_PAGESIZE) );
+  const SizeValueType start = offset - delta;
+  const int           file = open(fileName.c_str(), O_RDONLY);
+  if( file < 0 )
+    {
+    itkGenericExceptionMacro(<< "Cannot open " << fileName);
+    }
+  void * mapping = mmap(ITK_NULLPTR, length + delta, PROT_READ | PROT_WRITE, MAP_PRIVATE, file,
+                        static_cast<off_t>(start) );
+  close(file);
+  if( mapping == MAP_FAILED )
+    {
+    itkGenericExceptionMacro(<< "Cannot map " << length << " bytes of " << fileName << " at offset " << offset);
+    }
+  m_Mapping = mapping;
+#endif
+  m_MappingLength = length + delta;
+  m_Data = static_cast<char *>(m_Mapping) + delta;
+  m_Length = length;
+}
+
+void
+MemoryMappedFile::Unmap()
+{
+  if( m_Mapping )
+    {
+#if defined( _WIN32 )
+    UnmapViewOfFile(m_Mapping);
+#else
+    munmap(m_Mapping, m_MappingLength);
+#endif
+    }
+  m_Mapping = ITK_NULLPTR;
+  m_MappingLength = 0;
+  m_Data = ITK_NULLPTR;
+  m_Length = 0;
+}
+
+} // end namespace itk
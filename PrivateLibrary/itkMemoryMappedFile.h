@@ -0,0 +1,83 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkMemoryMappedFile_h
+#define __itkMemoryMappedFile_h
+
+#include <itkLightObject.h>
+#include <itkObjectFactory.h>
+#include <itkIntTypes.h>
+#include <string>
+
+namespace itk
+{
+/** \class MemoryMappedFile
+ * \brief Maps a part of a file in memory, until destruction.
+ *
+ * The mapping is copy-on-write: the pages are shared with the page
+ * cache, and with the other processes mapping the file, until they are
+ * written to.  Writes are private to the process and never reach the
+ * file.
+ */
+class MemoryMappedFile : public LightObject
+{
+public:
+  /** Standard class typedefs. */
+  typedef MemoryMappedFile         Self;
+  typedef LightObject              Superclass;
+  typedef SmartPointer<Self>       Pointer;
+  typedef SmartPointer<const Self> ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MemoryMappedFile, LightObject);
+
+  /** Map length bytes of the file, from offset.  Throws an
+   * ExceptionObject on failure. */
+  void Map(const std::string & fileName, SizeValueType offset, SizeValueType length);
+
+  void Unmap();
+
+  /** First mapped byte, at offset in the file */
+  void * GetPointer() const
+  {
+    return m_Data;
+  }
+
+  SizeValueType GetLength() const
+  {
+    return m_Length;
+  }
+
+protected:
+  MemoryMappedFile();
+  ~MemoryMappedFile();
+
+private:
+  MemoryMappedFile(const Self &);  // purposely not implemented
+  void operator=(const Self &);    // purposely not implemented
+
+  /** Start of the mapping, aligned on the allocation granularity */
+  void *        m_Mapping;
+  SizeValueType m_MappingLength;
+  char *        m_Data;
+  SizeValueType m_Length;
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,653 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkParallelNrrdImageIO.h"
+
+#include <itkByteSwapper.h>
+#include <itkMetaDataObject.h>
+#include "itk_zlib.h"
+#include "itk_NrrdIO.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <locale>
+#include <sstream>
+
+namespace itk
+{
+
+namespace
+{
+bool SystemIsLittleEndian()
+{
+  return ByteSwapper<int>::SystemIsLittleEndian();
+}
+
+// Value of a number of the dictionary
+template <typename T>
+bool NumberToString(const MetaDataObjectBase * object, std::string & value)
+{
+  const MetaDataObject<T> * number = dynamic_cast<const MetaDataObject<T> *>(object);
+  if( !number )
+    {
+    return false;
+    }
+  std::ostringstream os;
+  os.imbue(std::locale::classic() );
+  os.precision(17);
+  os << +number->GetMetaDataObjectValue();
+  value = os.str();
+  return true;
+}
+
+// Values of a vector of numbers of the dictionary, separated by spaces
+template <typename T>
+bool VectorToString(const MetaDataObjectBase * object, std::string & value)
+{
+  const MetaDataObject<std::vector<T> > * vector = dynamic_cast<const MetaDataObject<std::vector<T> > *>(object);
+  if( !vector )
+    {
+    return false;
+    }
+  std::ostringstream os;
+  os.imbue(std::locale::classic() );
+  os.precision(17);
+  const std::vector<T> & numbers = vector->GetMetaDataObjectValue();
+  for( typename std::vector<T>::size_type i = 0; i < numbers.size(); ++i )
+    {
+    os << ( i ? " " : "" ) << +numbers[i];
+    }
+  value = os.str();
+  return true;
+}
+
+// Value of a key/value pair of the header: the strings, and the numbers
+// and vectors of numbers the filters store in the dictionary
+bool MetaDataToString(const MetaDataObjectBase * object, std::string & value)
+{
+  const MetaDataObject<std::string> * text = dynamic_cast<const MetaDataObject<std::string> *>(object);
+  if( text )
+    {
+    value = text->GetMetaDataObjectValue();
+    return true;
+    }
+  return NumberToString<double>(object, value) || NumberToString<float>(object, value)
+         || NumberToString<int>(object, value) || NumberToString<unsigned int>(object, value)
+         || NumberToString<long>(object, value) || NumberToString<unsigned long>(object, value)
+         || NumberToString<short>(object, value) || NumberToString<unsigned short>(object, value)
+         || NumberToString<char>(object, value) || NumberToString<unsigned char>(object, value)
+         || NumberToString<bool>(object, value) || VectorToString<double>(object, value)
+         || VectorToString<float>(object, value) || VectorToString<int>(object, value)
+         || VectorToString<unsigned int>(object, value);
+}
+
+// True if field is the name of a per-axis field of teem followed by
+// [axis], axis being a domain axis of the image.  Sets axis to the
+// axis of the nrrd.
+bool AxisField(const std::string & field, int which, const Nrrd * nrrd, unsigned int baseDim, unsigned int & axis)
+{
+  const std::string name = airEnumStr(nrrdField, which);
+  return field.compare(0, name.size(), name) == 0
+         && sscanf(field.c_str() + name.size(), "[%u]", &axis) == 1
+         && ( axis += baseDim ) < nrrd->dim;
+}
+
+// Sets the fields of the header that NrrdImageIO stores in the
+// dictionary, with the NRRD_ prefix, as NrrdImageIO::Write does.  The
+// other keys are key/value pairs.
+void SetNrrdFields(const MetaDataDictionary & dict, Nrrd * nrrd, unsigned int baseDim)
+{
+  const std::string prefix = "NRRD_";
+
+  for( MetaDataDictionary::ConstIterator it = dict.Begin(); it != dict.End(); ++it )
+    {
+    const std::string & key = it->first;
+    std::string         value;
+    if( key == ParallelNrrdImageIO::GetChunksKey() )
+      {
+      continue;
+      }
+    if( key.compare(0, prefix.size(), prefix) != 0 )
+      {
+      if( MetaDataToString(it->second, value) )
+        {
+        nrrdKeyValueAdd(nrrd, key.c_str(), value.c_str() );
+        }
+      continue;
+      }
+
+    const std::string field = key.substr(prefix.size() );
+    unsigned int      axis;
+    double            number;
+    if( AxisField(field, nrrdField_thicknesses, nrrd, baseDim, axis) )
+      {
+      if( ExposeMetaData<double>(dict, key, number) )
+        {
+        nrrd->axis[axis].thickness = number;
+        }
+      }
+    else if( AxisField(field, nrrdField_centers, nrrd, baseDim, axis) )
+      {
+      if( ExposeMetaData<std::string>(dict, key, value) )
+        {
+        nrrd->axis[axis].center = airEnumVal(nrrdCenter, value.c_str() );
+        }
+      }
+    else if( AxisField(field, nrrdField_kinds, nrrd, baseDim, axis) )
+      {
+      if( ExposeMetaData<std::string>(dict, key, value) )
+        {
+        nrrd->axis[axis].kind = airEnumVal(nrrdKind, value.c_str() );
+        }
+      }
+    else if( AxisField(field, nrrdField_labels, nrrd, baseDim, axis) )
+      {
+      if( ExposeMetaData<std::string>(dict, key, value) )
+        {
+        airFree(nrrd->axis[axis].label);
+        nrrd->axis[axis].label = airStrdup(value.c_str() );
+        }
+      }
+    else if( AxisField(field, nrrdField_units, nrrd, baseDim, axis) )
+      {
+      if( ExposeMetaData<std::string>(dict, key, value) )
+        {
+        airFree(nrrd->axis[axis].units);
+        nrrd->axis[axis].units = airStrdup(value.c_str() );
+        }
+      }
+    else if( field == airEnumStr(nrrdField, nrrdField_space_units) )
+      {
+      // One unit per axis of the space, quoted or not
+      if( ExposeMetaData<std::string>(dict, key, value) )
+        {
+        std::replace(value.begin(), value.end(), '"', ' ');
+        std::istringstream units(value);
+        std::string        unit;
+        for( unsigned int saxi = 0; saxi < nrrd->spaceDim && units >> unit; ++saxi )
+          {
+          airFree(nrrd->spaceUnits[saxi]);
+          nrrd->spaceUnits[saxi] = airStrdup(unit.c_str() );
+          }
+        }
+      }
+    else if( field == airEnumStr(nrrdField, nrrdField_old_min) )
+      {
+      ExposeMetaData<double>(dict, key, nrrd->oldMin);
+      }
+    else if( field == airEnumStr(nrrdField, nrrdField_old_max) )
+      {
+      ExposeMetaData<double>(dict, key, nrrd->oldMax);
+      }
+    else if( field == airEnumStr(nrrdField, nrrdField_content) )
+      {
+      if( ExposeMetaData<std::string>(dict, key, value) )
+        {
+        airFree(nrrd->content);
+        nrrd->content = airStrdup(value.c_str() );
+        }
+      }
+    else if( field == airEnumStr(nrrdField, nrrdField_measurement_frame) )
+      {
+      std::vector<std::vector<double> > frame;
+      if( ExposeMetaData<std::vector<std::vector<double> > >(dict, key, frame) )
+        {
+        for( unsigned int saxi = 0; saxi < nrrd->spaceDim; ++saxi )
+          {
+          for( unsigned int saxj = 0; saxj < nrrd->spaceDim; ++saxj )
+            {
+            nrrd->measurementFrame[saxi][saxj] =
+              saxi < frame.size() && saxj < frame[saxi].size() ? frame[saxi][saxj] : AIR_NAN;
+            }
+          }
+        }
+      }
+    }
+}
+}
+
+ParallelNrrdImageIO::ParallelNrrdImageIO() :
+  m_CompressionLevel(-1),
+  m_ChunkSize(4 << 20),
+  m_NumberOfThreads(MultiThreader::GetGlobalDefaultNumberOfThreads() )
+{
+}
+
+void
+ParallelNrrdImageIO::ReadImageInformation()
+{
+  Superclass::ReadImageInformation();
+
+  m_Chunks = "";
+  MetaDataDictionary & dict = this->GetMetaDataDictionary();
+  if( !ExposeMetaData<std::string>(dict, GetChunksKey(), m_Chunks) )
+    {
+    return;
+    }
+  MetaDataDictionary stripped;
+  for( MetaDataDictionary::ConstIterator it = dict.Begin(); it != dict.End(); ++it )
+    {
+    if( it->first != GetChunksKey() )
+      {
+      stripped[it->first] = it->second;
+      }
+    }
+  this->SetMetaDataDictionary(stripped);
+}
+
+void
+ParallelNrrdImageIO::Read(void *buffer)
+{
+  if( m_Chunks.empty() || !this->ReadChunks(buffer) )
+    {
+    Superclass::Read(buffer);
+    }
+}
+
+bool
+ParallelNrrdImageIO::ReadChunks(void *buffer)
+{
+  // The whole image is decompressed at once
+  SizeValueType pixels = 1;
+  for( unsigned int i = 0; i < this->GetNumberOfDimensions(); ++i )
+    {
+    pixels *= this->GetDimensions(i);
+    }
+  if( this->GetIORegion().GetNumberOfPixels() != pixels )
+    {
+    return false;
+    }
+
+  ChunkJob job;
+  job.Size = static_cast<SizeValueType>(this->GetImageSizeInBytes() );
+  std::istringstream chunks(m_Chunks);
+  chunks.imbue(std::locale::classic() );
+  SizeValueType compressedSize;
+  if( !( chunks >> job.ChunkSize ) || job.ChunkSize == 0 )
+    {
+    return false;
+    }
+  job.Offsets.push_back(0);
+  while( chunks >> compressedSize )
+    {
+    job.Offsets.push_back(job.Offsets.back() + static_cast<std::streamoff>(compressedSize) );
+    }
+  const SizeValueType numberOfChunks = job.Offsets.size() - 1;
+  if( !chunks.eof() || numberOfChunks != ( job.Size + job.ChunkSize - 1 ) / job.ChunkSize )
+    {
+    return false;
+    }
+
+  // The data starts after the first empty line, and must be the
+  // members listed in the header
+  std::ifstream file(m_FileName.c_str(), std::ios::in | std::ios::binary);
+  std::string   line;
+  bool          gzip = false;
+  bool          attached = true;
+  bool          sameEndian = true;
+  while( std::getline(file, line) && !line.empty() && line != "\r" )
+    {
+    if( line.compare(0, 9, "encoding:") == 0 )
+      {
+      gzip = line.find("gz") != std::string::npos;
+      }
+    else if( line.compare(0, 10, "data file:") == 0 || line.compare(0, 9, "datafile:") == 0
+             || line.compare(0, 10, "line skip:") == 0 || line.compare(0, 10, "byte skip:") == 0 )
+      {
+      attached = false;
+      }
+    else if( line.compare(0, 7, "endian:") == 0 )
+      {
+      sameEndian = ( line.find("little") != std::string::npos ) == SystemIsLittleEndian();
+      }
+    }
+  if( !file || !gzip || !attached || !sameEndian )
+    {
+    return false;
+    }
+  const std::streamoff dataStart = file.tellg();
+  file.seekg(0, std::ios::end);
+  if( file.tellg() - dataStart != job.Offsets.back() )
+    {
+    return false;
+    }
+  for( SizeValueType c = 0; c <= numberOfChunks; ++c )
+    {
+    job.Offsets[c] += dataStart;
+    }
+  file.close();
+
+  job.Output = static_cast<char *>(buffer);
+  job.FileName = m_FileName;
+  job.Failed.assign(numberOfChunks, 0);
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads(static_cast<ThreadIdType>(std::min<SizeValueType>(m_NumberOfThreads, numberOfChunks) ) );
+  threader->SetSingleMethod(DecompressThreaderCallback, &job);
+  threader->SingleMethodExecute();
+  for( SizeValueType c = 0; c < numberOfChunks; ++c )
+    {
+    if( job.Failed[c] )
+      {
+      itkWarningMacro(<< "Chunk " << c << " of " << m_FileName << " cannot be decompressed, reading it serially");
+      return false;
+      }
+    }
+  return true;
+}
+
+ITK_THREAD_RETURN_TYPE
+ParallelNrrdImageIO::DecompressThreaderCallback(void *arg)
+{
+  MultiThreader::ThreadInfoStruct * info = static_cast<MultiThreader::ThreadInfoStruct *>(arg);
+  ChunkJob &                        job = *static_cast<ChunkJob *>(info->UserData);
+  const SizeValueType               numberOfChunks = job.Failed.size();
+
+  std::ifstream     file(job.FileName.c_str(), std::ios::in | std::ios::binary);
+  std::vector<char> compressed;
+  for( SizeValueType c = info->ThreadID; c < numberOfChunks; c += info->NumberOfThreads )
+    {
+    const SizeValueType start = c * job.ChunkSize;
+    const SizeValueType size = std::min(job.ChunkSize, job.Size - start);
+    compressed.resize(static_cast<std::size_t>(job.Offsets[c + 1] - job.Offsets[c]) );
+    file.seekg(job.Offsets[c]);
+    if( compressed.empty() || !file.read(&compressed[0], compressed.size() ) ||
+        compressed.size() > NumericTraits<uInt>::max() )
+      {
+      job.Failed[c] = 1;
+      continue;
+      }
+
+    // 16 + MAX_WBITS: gzip member
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    stream.next_in = reinterpret_cast<Bytef *>(&compressed[0]);
+    stream.avail_in = static_cast<uInt>(compressed.size() );
+    stream.next_out = reinterpret_cast<Bytef *>(job.Output + start);
+    stream.avail_out = static_cast<uInt>(size);
+    if( inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK )
+      {
+      job.Failed[c] = 1;
+      continue;
+      }
+    const int status = inflate(&stream, Z_FINISH);
+    job.Failed[c] = status != Z_STREAM_END || stream.avail_in != 0 || stream.total_out != size;
+    inflateEnd(&stream);
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+ITK_THREAD_RETURN_TYPE
+ParallelNrrdImageIO::CompressThreaderCallback(void *arg)
+{
+  MultiThreader::ThreadInfoStruct * info = static_cast<MultiThreader::ThreadInfoStruct *>(arg);
+  ChunkJob &                        job = *static_cast<ChunkJob *>(info->UserData);
+  const SizeValueType               numberOfChunks = job.Compressed.size();
+
+  for( SizeValueType c = info->ThreadID; c < numberOfChunks; c += info->NumberOfThreads )
+    {
+    const SizeValueType start = c * job.ChunkSize;
+    const SizeValueType size = std::min(job.ChunkSize, job.Size - start);
+    std::vector<char> & compressed = job.Compressed[c];
+
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    if( deflateInit2(&stream, job.Level, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK )
+      {
+      job.Failed[c] = 1;
+      continue;
+      }
+    // The bound does not count the gzip header and trailer
+    compressed.resize(deflateBound(&stream, static_cast<uLong>(size) ) + 32);
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(job.Input + start) );
+    stream.avail_in = static_cast<uInt>(size);
+    stream.next_out = reinterpret_cast<Bytef *>(&compressed[0]);
+    stream.avail_out = static_cast<uInt>(compressed.size() );
+    const int status = deflate(&stream, Z_FINISH);
+    job.Failed[c] = status != Z_STREAM_END;
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+bool
+ParallelNrrdImageIO::WriteHeader(std::ostream & os, const void *buffer,
+                                 const std::vector<std::vector<char> > & compressed) const
+{
+  int type;
+  switch( this->GetComponentType() )
+    {
+    case UCHAR:
+      type = nrrdTypeUChar;
+      break;
+    case CHAR:
+      type = nrrdTypeChar;
+      break;
+    case USHORT:
+      type = nrrdTypeUShort;
+      break;
+    case SHORT:
+      type = nrrdTypeShort;
+      break;
+    case UINT:
+      type = nrrdTypeUInt;
+      break;
+    case INT:
+      type = nrrdTypeInt;
+      break;
+    case ULONG:
+      type = sizeof( unsigned long ) == 4 ? nrrdTypeUInt : nrrdTypeULLong;
+      break;
+    case LONG:
+      type = sizeof( long ) == 4 ? nrrdTypeInt : nrrdTypeLLong;
+      break;
+    case FLOAT:
+      type = nrrdTypeFloat;
+      break;
+    case DOUBLE:
+      type = nrrdTypeDouble;
+      break;
+    default:
+      return false;
+    }
+
+  // The axes of the nrrd, as NrrdImageIO sets them: the components, if
+  // any, then the domain
+  const unsigned int spaceDim = this->GetNumberOfDimensions();
+  const unsigned int baseDim = this->GetNumberOfComponents() > 1 ? 1 : 0;
+  const unsigned int nrrdDim = baseDim + spaceDim;
+  if( nrrdDim > NRRD_DIM_MAX || spaceDim > NRRD_SPACE_DIM_MAX )
+    {
+    return false;
+    }
+  size_t size[NRRD_DIM_MAX];
+  int    kind[NRRD_DIM_MAX];
+  double spaceDir[NRRD_DIM_MAX][NRRD_SPACE_DIM_MAX];
+  double origin[NRRD_SPACE_DIM_MAX];
+  if( baseDim )
+    {
+    size[0] = this->GetNumberOfComponents();
+    kind[0] = this->GetComponentKind();
+    for( unsigned int saxi = 0; saxi < spaceDim; ++saxi )
+      {
+      spaceDir[0][saxi] = AIR_NAN;
+      }
+    }
+  for( unsigned int axi = 0; axi < spaceDim; ++axi )
+    {
+    size[axi + baseDim] = this->GetDimensions(axi);
+    kind[axi + baseDim] = nrrdKindDomain;
+    origin[axi] = this->GetOrigin(axi);
+    const std::vector<double> direction = this->GetDirection(axi);
+    for( unsigned int saxi = 0; saxi < spaceDim; ++saxi )
+      {
+      spaceDir[axi + baseDim][saxi] = this->GetSpacing(axi) * direction[saxi];
+      }
+    }
+
+  Nrrd *        nrrd = nrrdNew();
+  NrrdIoState * nio = nrrdIoStateNew();
+  char *        header = ITK_NULLPTR;
+  bool          written = !nrrdWrap_nva(nrrd, const_cast<void *>(buffer), type, nrrdDim, size)
+    && !( spaceDim == 3 ? nrrdSpaceSet(nrrd, nrrdSpaceLeftPosteriorSuperior) : nrrdSpaceDimensionSet(nrrd, spaceDim) )
+    && !nrrdSpaceOriginSet(nrrd, origin);
+  if( written )
+    {
+    nrrdAxisInfoSet_nva(nrrd, nrrdAxisInfoKind, kind);
+    nrrdAxisInfoSet_nva(nrrd, nrrdAxisInfoSpaceDirection, spaceDir);
+    SetNrrdFields(this->GetMetaDataDictionary(), nrrd, baseDim);
+
+    std::ostringstream chunks;
+    chunks.imbue(std::locale::classic() );
+    chunks << m_ChunkSize;
+    for( unsigned int c = 0; c < compressed.size(); ++c )
+      {
+      chunks << " " << compressed[c].size();
+      }
+    nrrdKeyValueAdd(nrrd, GetChunksKey(), chunks.str().c_str() );
+
+    // Only the header is written to the string, by teem as NrrdImageIO
+    // writes it
+    nio->format = nrrdFormatNRRD;
+    nio->encoding = nrrdEncodingGzip;
+    nio->endian = SystemIsLittleEndian() ? airEndianLittle : airEndianBig;
+    written = !nrrdStringWrite(&header, nrrd, nio);
+    }
+  if( written )
+    {
+    // The data starts after the first empty line
+    std::string text(header);
+    while( !text.empty() && text[text.size() - 1] == '\n' )
+      {
+      text.erase(text.size() - 1);
+      }
+    os << text << "\n\n";
+    }
+  else
+    {
+    char * error = biffGetDone(NRRD);
+    itkWarningMacro(<< "Could not write the header of " << m_FileName << ": " << error);
+    free(error);
+    }
+  airFree(header);
+  nrrdNix(nrrd);
+  nrrdIoStateNix(nio);
+  return written;
+}
+
+int
+ParallelNrrdImageIO::GetComponentKind() const
+{
+  // Same kinds as NrrdImageIO
+  switch( this->GetPixelType() )
+    {
+    case RGB:
+      return nrrdKindRGBColor;
+    case RGBA:
+      return nrrdKindRGBAColor;
+    case POINT:
+      return nrrdKindPoint;
+    case COVARIANTVECTOR:
+      return nrrdKindCovariantVector;
+    case SYMMETRICSECONDRANKTENSOR:
+    case DIFFUSIONTENSOR3D:
+      return nrrdKind3DSymMatrix;
+    case COMPLEX:
+      return nrrdKindComplex;
+    case VECTOR:
+    case OFFSET:
+    case FIXEDARRAY:
+      return nrrdKindVector;
+    case MATRIX:
+      return this->GetNumberOfComponents() == 9 ? nrrdKind3DMatrix : nrrdKindList;
+    default:
+      return nrrdKindList;
+    }
+}
+
+void
+ParallelNrrdImageIO::Write(const void *buffer)
+{
+  const std::string::size_type extension = m_FileName.rfind('.');
+  SizeValueType                pixels = 1;
+  for( unsigned int i = 0; i < this->GetNumberOfDimensions(); ++i )
+    {
+    pixels *= this->GetDimensions(i);
+    }
+  if( !this->GetUseCompression() || extension == std::string::npos || m_FileName.substr(extension) != ".nrrd"
+      || this->GetIORegion().GetNumberOfPixels() != pixels || this->GetImageSizeInBytes() == 0 )
+    {
+    Superclass::Write(buffer);
+    return;
+    }
+
+  ChunkJob job;
+  job.Input = static_cast<const char *>(buffer);
+  job.Size = static_cast<SizeValueType>(this->GetImageSizeInBytes() );
+  job.ChunkSize = m_ChunkSize;
+  job.Level = m_CompressionLevel;
+  const SizeValueType numberOfChunks = ( job.Size + job.ChunkSize - 1 ) / job.ChunkSize;
+  job.Compressed.resize(numberOfChunks);
+  job.Failed.assign(numberOfChunks, 0);
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads(static_cast<ThreadIdType>(std::min<SizeValueType>(m_NumberOfThreads, numberOfChunks) ) );
+  threader->SetSingleMethod(CompressThreaderCallback, &job);
+  threader->SingleMethodExecute();
+  for( SizeValueType c = 0; c < numberOfChunks; ++c )
+    {
+    if( job.Failed[c] )
+      {
+      itkExceptionMacro(<< "Could not compress " << m_FileName);
+      }
+    }
+
+  std::ostringstream header;
+  if( !this->WriteHeader(header, buffer, job.Compressed) )
+    {
+    Superclass::Write(buffer);
+    return;
+    }
+
+  std::ofstream file(m_FileName.c_str(), std::ios::out | std::ios::binary);
+  file << header.str();
+  for( SizeValueType c = 0; c < numberOfChunks && file; ++c )
+    {
+    file.write(&job.Compressed[c][0], job.Compressed[c].size() );
+    std::vector<char>().swap(job.Compressed[c]);
+    }
+  file.close();
+  if( !file )
+    {
+    itkExceptionMacro(<< "Could not write " << m_FileName);
+    }
+}
+
+void
+ParallelNrrdImageIO::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "CompressionLevel: " << m_CompressionLevel << std::endl;
+  os << indent << "ChunkSize: " << m_ChunkSize << std::endl;
+  os << indent << "NumberOfThreads: " << m_NumberOfThreads << std::endl;
+}
+
+} // end namespace itk
@@ -0,0 +1,141 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkParallelNrrdImageIO_h
+#define __itkParallelNrrdImageIO_h
+
+#include <itkNrrdImageIO.h>
+#include <itkMultiThreader.h>
+#include <string>
+#include <vector>
+
+namespace itk
+{
+/** \class ParallelNrrdImageIO
+ * \brief NRRD image IO compressing and decompressing gzip data on all
+ * the cores.
+ *
+ * With compression, the data of an attached header (.nrrd) is split in
+ * chunks of ChunkSize bytes, which are compressed in parallel as
+ * independent gzip members and written one after the other.  A
+ * concatenation of gzip members is a valid gzip stream, so the file is
+ * a regular gzip-encoded NRRD that any NRRD reader can load.  The
+ * compressed size of each member is stored in the
+ * "DTIProcess_gzip_chunks" key of the header, which lets this IO
+ * decompress the members in parallel when the file is read.
+ *
+ * The files without that key, detached headers, other encodings and
+ * streamed regions are handled by NrrdImageIO.  The key is checked
+ * against the size of the file and of the decompressed chunks, so a
+ * key copied by another writer into a file it compressed differently
+ * also falls back to NrrdImageIO.  The key is not exposed in the
+ * meta-data dictionary.
+ */
+class ParallelNrrdImageIO : public NrrdImageIO
+{
+public:
+  /** Standard class typedefs. */
+  typedef ParallelNrrdImageIO      Self;
+  typedef NrrdImageIO              Superclass;
+  typedef SmartPointer<Self>       Pointer;
+  typedef SmartPointer<const Self> ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(ParallelNrrdImageIO, NrrdImageIO);
+
+  /** Key of the header holding the chunk size and the compressed size of
+   * the members */
+  static const char * GetChunksKey()
+  {
+    return "DTIProcess_gzip_chunks";
+  }
+
+  /** zlib level, from 1 to 9, or -1 for the default level of zlib */
+  itkSetClampMacro(CompressionLevel, int, -1, 9);
+  itkGetConstMacro(CompressionLevel, int);
+
+  /** Uncompressed size of the chunks.  4 MiB by default. */
+  itkSetClampMacro(ChunkSize, SizeValueType, 1, NumericTraits<unsigned int>::max() );
+  itkGetConstMacro(ChunkSize, SizeValueType);
+
+  /** Number of threads compressing or decompressing the chunks.  The
+   * global default number of threads of ITK by default. */
+  itkSetClampMacro(NumberOfThreads, ThreadIdType, 1, ITK_MAX_THREADS);
+  itkGetConstMacro(NumberOfThreads, ThreadIdType);
+
+  /** Reads the header, and takes the chunks key out of the dictionary */
+  virtual void ReadImageInformation() ITK_OVERRIDE;
+
+  virtual void Read(void *buffer) ITK_OVERRIDE;
+
+  virtual void Write(const void *buffer) ITK_OVERRIDE;
+
+protected:
+  ParallelNrrdImageIO();
+  ~ParallelNrrdImageIO()
+  {
+  }
+
+  void PrintSelf(std::ostream & os, Indent indent) const ITK_OVERRIDE;
+
+private:
+  ParallelNrrdImageIO(const Self &); // purposely not implemented
+  void operator=(const Self &);      // purposely not implemented
+
+  /** Chunks compressed or decompressed by the threads */
+  struct ChunkJob
+  {
+    const char *                    Input;
+    char *                          Output;
+    SizeValueType                   Size;
+    SizeValueType                   ChunkSize;
+    std::vector<std::vector<char> > Compressed;
+    std::vector<std::streamoff>     Offsets;
+    std::string                     FileName;
+    int                             Level;
+    std::vector<char>               Failed;
+  };
+
+  static ITK_THREAD_RETURN_TYPE CompressThreaderCallback(void *arg);
+
+  static ITK_THREAD_RETURN_TYPE DecompressThreaderCallback(void *arg);
+
+  /** Header of the data, built by teem from the image information and
+   * the dictionary as NrrdImageIO builds it.  Returns false if the
+   * component type has no NRRD equivalent or if teem rejects the
+   * header. */
+  bool WriteHeader(std::ostream & os, const void *buffer, const std::vector<std::vector<char> > & compressed) const;
+
+  /** Kind of the axis of the components, as NrrdImageIO sets it */
+  int GetComponentKind() const;
+
+  /** Decompress the chunks into the buffer.  Returns false if the file
+   * does not match the chunks of its header. */
+  bool ReadChunks(void *buffer);
+
+  int           m_CompressionLevel;
+  SizeValueType m_ChunkSize;
+  ThreadIdType  m_NumberOfThreads;
+
+  /** Value of the chunks key of the last header read */
+  std::string m_Chunks;
+};
+
+} // end namespace itk
+
+#endif
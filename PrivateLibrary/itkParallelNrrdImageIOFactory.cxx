@@ -0,0 +1,57 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkParallelNrrdImageIOFactory.h"
+#include "itkParallelNrrdImageIO.h"
+#include <itkCreateObjectFunction.h>
+#include <itkVersion.h>
+
+namespace itk
+{
+
+ParallelNrrdImageIOFactory::ParallelNrrdImageIOFactory()
+{
+  this->RegisterOverride("itkImageIOBase",
+                         "itkParallelNrrdImageIO",
+                         "NRRD Image IO with parallel gzip compression",
+                         1,
+                         CreateObjectFunction<ParallelNrrdImageIO>::New() );
+}
+
+const char *
+ParallelNrrdImageIOFactory::GetITKSourceVersion() const
+{
+  return ITK_SOURCE_VERSION;
+}
+
+const char *
+ParallelNrrdImageIOFactory::GetDescription() const
+{
+  return "NRRD ImageIO Factory, allows the loading of NRRD images into ITK with parallel gzip compression";
+}
+
+void
+ParallelNrrdImageIOFactory::RegisterOneFactory()
+{
+  static bool registered = false;
+
+  if( !registered )
+    {
+    ObjectFactoryBase::RegisterFactory(ParallelNrrdImageIOFactory::New(), ObjectFactoryBase::INSERT_AT_FRONT);
+    registered = true;
+    }
+}
+
+} // end namespace itk
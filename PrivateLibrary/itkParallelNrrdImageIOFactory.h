@@ -0,0 +1,66 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkParallelNrrdImageIOFactory_h
+#define __itkParallelNrrdImageIOFactory_h
+
+#include <itkObjectFactoryBase.h>
+#include <itkImageIOBase.h>
+
+namespace itk
+{
+/** \class ParallelNrrdImageIOFactory
+ * \brief Creates ParallelNrrdImageIO instances.
+ *
+ * RegisterOneFactory() registers it before the factory of NrrdImageIO,
+ * so that the readers and writers of NRRD files use ParallelNrrdImageIO.
+ */
+class ParallelNrrdImageIOFactory : public ObjectFactoryBase
+{
+public:
+  /** Standard class typedefs. */
+  typedef ParallelNrrdImageIOFactory Self;
+  typedef ObjectFactoryBase          Superclass;
+  typedef SmartPointer<Self>         Pointer;
+  typedef SmartPointer<const Self>   ConstPointer;
+
+  /** Class methods used to interface with the registered factories. */
+  virtual const char * GetITKSourceVersion() const ITK_OVERRIDE;
+
+  virtual const char * GetDescription() const ITK_OVERRIDE;
+
+  /** Method for class instantiation. */
+  itkFactorylessNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(ParallelNrrdImageIOFactory, ObjectFactoryBase);
+
+  /** Register one factory of this type, in front of the other factories */
+  static void RegisterOneFactory();
+
+protected:
+  ParallelNrrdImageIOFactory();
+  ~ParallelNrrdImageIOFactory()
+  {
+  }
+
+private:
+  ParallelNrrdImageIOFactory(const Self &); // purposely not implemented
+  void operator=(const Self &);             // purposely not implemented
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,181 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkTransformChainResampleImageFilter_h
+#define __itkTransformChainResampleImageFilter_h
+
+#include <itkImageToImageFilter.h>
+#include <itkImageFunction.h>
+#include <itkNumericTraits.h>
+#include "transformchain.h"
+
+namespace itk
+{
+namespace Functor
+{
+/** Value of the interpolator cast to the output pixel, clamped to the
+ * range of the output pixel type.  For scalar and label images. */
+template <typename TInput, typename TOutput>
+class TransformChainCast
+{
+public:
+  typedef TInput                    InputType;
+  typedef TOutput                   OutputType;
+  typedef TransformChain::PointType PointType;
+
+  bool operator!=(const TransformChainCast &) const
+  {
+    return false;
+  }
+
+  bool operator==(const TransformChainCast & other) const
+  {
+    return !(*this != other);
+  }
+
+  inline TOutput operator()(const TInput & value, const PointType &) const
+  {
+    if( value < static_cast<TInput>(NumericTraits<TOutput>::NonpositiveMin() ) )
+      {
+      return NumericTraits<TOutput>::NonpositiveMin();
+      }
+    if( value > static_cast<TInput>(NumericTraits<TOutput>::max() ) )
+      {
+      return NumericTraits<TOutput>::max();
+      }
+    return static_cast<TOutput>(value);
+  }
+};
+} // end namespace Functor
+
+/** \class TransformChainResampleImageFilter
+ * \brief Resamples an image once through a TransformChain.
+ *
+ * Every output voxel is mapped through the whole chain to a point of the
+ * input image, where the interpolator is evaluated.  The output points
+ * are mapped one scanline at a time, so each transform of the chain is
+ * applied to the whole scanline before the next one.  The value of the
+ * interpolator goes through TPixelFunctor, which is given the value and
+ * the output point; points outside of the input take the default pixel
+ * value.
+ *
+ * The output is on the grid of the input.  The chain is not owned by
+ * the filter and has to outlive the update.
+ *
+ * \ingroup Multithreaded
+ */
+template <typename TInputImage, typename TOutputImage,
+          typename TPixelFunctor =
+            Functor::TransformChainCast<typename NumericTraits<typename TInputImage::PixelType>::RealType,
+                                        typename TOutputImage::PixelType> >
+class ITK_EXPORT TransformChainResampleImageFilter :
+  public ImageToImageFilter<TInputImage, TOutputImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef TransformChainResampleImageFilter             Self;
+  typedef ImageToImageFilter<TInputImage, TOutputImage> Superclass;
+  typedef SmartPointer<Self>                            Pointer;
+  typedef SmartPointer<const Self>                      ConstPointer;
+
+  typedef TInputImage                          InputImageType;
+  typedef TOutputImage                         OutputImageType;
+  typedef typename OutputImageType::PixelType  OutputPixelType;
+  typedef typename OutputImageType::RegionType OutputImageRegionType;
+  typedef TPixelFunctor                        FunctorType;
+  typedef TransformChain::PointType            PointType;
+  typedef typename FunctorType::InputType      InterpolatedType;
+
+  /** Interpolator of the input, evaluated at the mapped points */
+  typedef ImageFunction<InputImageType, InterpolatedType, double> InterpolatorType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Runtime information support. */
+  itkTypeMacro(TransformChainResampleImageFilter, ImageToImageFilter);
+
+  /** Chain mapping the output points to the input points (required) */
+  void SetTransformChain(const TransformChain * chain)
+  {
+    if( m_TransformChain != chain )
+      {
+      m_TransformChain = chain;
+      this->Modified();
+      }
+  }
+
+  const TransformChain * GetTransformChain() const
+  {
+    return m_TransformChain;
+  }
+
+  /** Interpolator of the input (required) */
+  itkSetObjectMacro(Interpolator, InterpolatorType);
+  itkGetObjectMacro(Interpolator, InterpolatorType);
+
+  /** Value of the output points mapped outside of the input */
+  itkSetMacro(DefaultPixelValue, OutputPixelType);
+  itkGetConstReferenceMacro(DefaultPixelValue, OutputPixelType);
+
+  FunctorType & GetFunctor()
+  {
+    return m_Functor;
+  }
+
+  void SetFunctor(const FunctorType & functor)
+  {
+    if( m_Functor != functor )
+      {
+      m_Functor = functor;
+      this->Modified();
+      }
+  }
+
+protected:
+  TransformChainResampleImageFilter();
+  virtual ~TransformChainResampleImageFilter()
+  {
+  }
+
+  void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
+
+  /** The chain can map the output to any point of the input */
+  virtual void GenerateInputRequestedRegion() ITK_OVERRIDE;
+
+  virtual void BeforeThreadedGenerateData() ITK_OVERRIDE;
+
+  virtual void ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread,
+                                    ThreadIdType threadId) ITK_OVERRIDE;
+
+  virtual void AfterThreadedGenerateData() ITK_OVERRIDE;
+
+private:
+  TransformChainResampleImageFilter(const Self &); // purposely not implemented
+  void operator=(const Self &);                    // purposely not implemented
+
+  const TransformChain *             m_TransformChain;
+  typename InterpolatorType::Pointer m_Interpolator;
+  OutputPixelType                    m_DefaultPixelValue;
+  FunctorType                        m_Functor;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkTransformChainResampleImageFilter.txx"
+#endif
+
+#endif
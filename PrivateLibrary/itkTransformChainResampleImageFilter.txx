@@ -0,0 +1,129 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkTransformChainResampleImageFilter_txx
+#define __itkTransformChainResampleImageFilter_txx
+
+#include "itkTransformChainResampleImageFilter.h"
+#include <itkImageLinearIteratorWithIndex.h>
+#include <itkProgressReporter.h>
+#include <vector>
+
+namespace itk
+{
+
+template <typename TInputImage, typename TOutputImage, typename TPixelFunctor>
+TransformChainResampleImageFilter<TInputImage, TOutputImage, TPixelFunctor>
+::TransformChainResampleImageFilter()
+{
+  m_TransformChain = ITK_NULLPTR;
+  m_DefaultPixelValue = NumericTraits<OutputPixelType>::ZeroValue();
+}
+
+template <typename TInputImage, typename TOutputImage, typename TPixelFunctor>
+void
+TransformChainResampleImageFilter<TInputImage, TOutputImage, TPixelFunctor>
+::PrintSelf(std::ostream& os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  os << indent << "TransformChain:    " << m_TransformChain << std::endl;
+  os << indent << "Interpolator:      " << m_Interpolator.GetPointer() << std::endl;
+  os << indent << "DefaultPixelValue: " << m_DefaultPixelValue << std::endl;
+}
+
+template <typename TInputImage, typename TOutputImage, typename TPixelFunctor>
+void
+TransformChainResampleImageFilter<TInputImage, TOutputImage, TPixelFunctor>
+::GenerateInputRequestedRegion()
+{
+  Superclass::GenerateInputRequestedRegion();
+
+  InputImageType * input = const_cast<InputImageType *>(this->GetInput() );
+  if( input )
+    {
+    input->SetRequestedRegionToLargestPossibleRegion();
+    }
+}
+
+template <typename TInputImage, typename TOutputImage, typename TPixelFunctor>
+void
+TransformChainResampleImageFilter<TInputImage, TOutputImage, TPixelFunctor>
+::BeforeThreadedGenerateData()
+{
+  if( !m_TransformChain )
+    {
+    itkExceptionMacro(<< "Transform chain not set");
+    }
+  if( !m_Interpolator )
+    {
+    itkExceptionMacro(<< "Interpolator not set");
+    }
+  m_Interpolator->SetInputImage(this->GetInput() );
+}
+
+template <typename TInputImage, typename TOutputImage, typename TPixelFunctor>
+void
+TransformChainResampleImageFilter<TInputImage, TOutputImage, TPixelFunctor>
+::AfterThreadedGenerateData()
+{
+  m_Interpolator->SetInputImage(ITK_NULLPTR);
+}
+
+template <typename TInputImage, typename TOutputImage, typename TPixelFunctor>
+void
+TransformChainResampleImageFilter<TInputImage, TOutputImage, TPixelFunctor>
+::ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread, ThreadIdType threadId)
+{
+  OutputImageType * output = this->GetOutput();
+  // The functors may keep state between the voxels
+  FunctorType functor = m_Functor;
+
+  const unsigned int     length = outputRegionForThread.GetSize(0);
+  std::vector<PointType> points(length);
+  std::vector<PointType> mapped(length);
+
+  ProgressReporter progress(this, threadId, outputRegionForThread.GetNumberOfPixels() );
+
+  ImageLinearIteratorWithIndex<OutputImageType> it(output, outputRegionForThread);
+  it.SetDirection(0);
+  for( it.GoToBegin(); !it.IsAtEnd(); it.NextLine() )
+    {
+    // Map the whole scanline through the chain
+    typename OutputImageType::IndexType index = it.GetIndex();
+    for( unsigned int i = 0; i < length; ++i, ++index[0] )
+      {
+      output->TransformIndexToPhysicalPoint(index, points[i]);
+      }
+    m_TransformChain->TransformPoints(&points[0], length, &mapped[0]);
+
+    for( unsigned int i = 0; !it.IsAtEndOfLine(); ++i, ++it )
+      {
+      if( m_Interpolator->IsInsideBuffer(mapped[i]) )
+        {
+        it.Set(functor(m_Interpolator->Evaluate(mapped[i]), points[i]) );
+        }
+      else
+        {
+        it.Set(m_DefaultPixelValue);
+        }
+      progress.CompletedPixel();
+      }
+    }
+}
+
+} // end namespace itk
+
+#endif
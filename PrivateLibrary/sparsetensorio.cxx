@@ -0,0 +1,358 @@
+#include "sparsetensorio.h"
+
+#include <itkByteSwapper.h>
+#include <itkIntTypes.h>
+#include <itkMetaDataObject.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+namespace
+{
+const char *       SPARSE_TENSOR_MAGIC = "DTISPARSE0001";
+const unsigned int TENSOR_COMPONENTS = 6;
+const char *       MEASUREMENT_FRAME_KEY = "NRRD_measurement frame";
+// Tensors converted at once when reading or writing
+const itk::SizeValueType TENSOR_BLOCK = 4096;
+
+void throwException(const std::string & message)
+{
+  throw itk::ExceptionObject(__FILE__, __LINE__, message.c_str(), ITK_LOCATION);
+}
+
+// Values of a header field, "(x,y,z)" vectors included
+std::vector<double> parseNumbers(std::string value)
+{
+  std::replace(value.begin(), value.end(), '(', ' ');
+  std::replace(value.begin(), value.end(), ')', ' ');
+  std::replace(value.begin(), value.end(), ',', ' ');
+  std::istringstream  iss(value);
+  std::vector<double> numbers;
+  double              number;
+  while( iss >> number )
+    {
+    numbers.push_back(number);
+    }
+  return numbers;
+}
+
+template <class T>
+void writeTensors(std::ostream & os, const SparseTensorImageType * tensors)
+{
+  const TensorPixelType *  packed = tensors->GetPackedImage()->GetBufferPointer();
+  const itk::SizeValueType count = tensors->GetNumberOfForegroundPixels();
+  std::vector<T>           block(TENSOR_BLOCK * TENSOR_COMPONENTS);
+  for( itk::SizeValueType start = 0; start < count && os; start += TENSOR_BLOCK )
+    {
+    const itk::SizeValueType n = std::min(TENSOR_BLOCK, count - start);
+    for( itk::SizeValueType i = 0; i < n; ++i )
+      {
+      for( unsigned int c = 0; c < TENSOR_COMPONENTS; ++c )
+        {
+        block[i * TENSOR_COMPONENTS + c] = static_cast<T>(packed[start + i][c]);
+        }
+      }
+    itk::ByteSwapper<T>::SwapRangeFromSystemToLittleEndian(&block[0], n * TENSOR_COMPONENTS);
+    os.write(reinterpret_cast<const char *>(&block[0]), n * TENSOR_COMPONENTS * sizeof( T ) );
+    }
+}
+
+template <class T>
+void readTensors(std::istream & is, SparseTensorImageType * tensors)
+{
+  TensorPixelType *        packed = tensors->GetPackedImage()->GetBufferPointer();
+  const itk::SizeValueType count = tensors->GetNumberOfForegroundPixels();
+  std::vector<T>           block(TENSOR_BLOCK * TENSOR_COMPONENTS);
+  for( itk::SizeValueType start = 0; start < count; start += TENSOR_BLOCK )
+    {
+    const itk::SizeValueType n = std::min(TENSOR_BLOCK, count - start);
+    if( !is.read(reinterpret_cast<char *>(&block[0]), n * TENSOR_COMPONENTS * sizeof( T ) ) )
+      {
+      throwException("The sparse tensor file is truncated");
+      }
+    itk::ByteSwapper<T>::SwapRangeFromSystemToLittleEndian(&block[0], n * TENSOR_COMPONENTS);
+    for( itk::SizeValueType i = 0; i < n; ++i )
+      {
+      for( unsigned int c = 0; c < TENSOR_COMPONENTS; ++c )
+        {
+        packed[start + i][c] = block[i * TENSOR_COMPONENTS + c];
+        }
+      }
+    }
+}
+}
+
+bool isSparseTensorFile(const std::string & filename)
+{
+  return filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".sdt") == 0;
+}
+
+void writeSparseTensors(const std::string & filename, const SparseTensorImageType * tensors, bool floatComponents)
+{
+  const SparseTensorImageType::RegionType &    region = tensors->GetRegion();
+  const SparseTensorImageType::DirectionType & direction = tensors->GetDirection();
+  const SparseTensorImageType::RunListType &   runs = tensors->GetRuns();
+
+  std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary);
+  file.precision(17);
+  file << SPARSE_TENSOR_MAGIC << "\n";
+  file << "type: " << ( floatComponents ? "float" : "double" ) << "\n";
+  file << "dimension: " << DIM << "\n";
+  file << "sizes:";
+  for( unsigned int i = 0; i < DIM; ++i )
+    {
+    file << " " << region.GetSize(i);
+    }
+  file << "\nindex:";
+  for( unsigned int i = 0; i < DIM; ++i )
+    {
+    file << " " << region.GetIndex(i);
+    }
+  file << "\nspace directions:";
+  for( unsigned int i = 0; i < DIM; ++i )
+    {
+    file << " (";
+    for( unsigned int j = 0; j < DIM; ++j )
+      {
+      file << ( j ? "," : "" ) << direction[j][i] * tensors->GetSpacing()[i];
+      }
+    file << ")";
+    }
+  file << "\nspace origin: (";
+  for( unsigned int i = 0; i < DIM; ++i )
+    {
+    file << ( i ? "," : "" ) << tensors->GetOrigin()[i];
+    }
+  file << ")\nbackground:";
+  for( unsigned int c = 0; c < TENSOR_COMPONENTS; ++c )
+    {
+    file << " " << tensors->GetBackgroundTensor()[c];
+    }
+  file << "\nruns: " << runs.size() << "\n";
+  file << "endian: little\n";
+
+  const itk::MetaDataDictionary &   dict = tensors->GetMetaDataDictionary();
+  std::vector<std::vector<double> > frame;
+  if( itk::ExposeMetaData<std::vector<std::vector<double> > >(dict, MEASUREMENT_FRAME_KEY, frame) )
+    {
+    file << "measurement frame:";
+    for( unsigned int i = 0; i < frame.size(); ++i )
+      {
+      file << " (";
+      for( unsigned int j = 0; j < frame[i].size(); ++j )
+        {
+        file << ( j ? "," : "" ) << frame[i][j];
+        }
+      file << ")";
+      }
+    file << "\n";
+    }
+  const std::vector<std::string> keys = dict.GetKeys();
+  for( std::vector<std::string>::const_iterator it = keys.begin(); it != keys.end(); ++it )
+    {
+    std::string value;
+    if( it->compare(0, 5, "NRRD_") != 0 && it->compare(0, 4, "ITK_") != 0
+        && it->find(':') == std::string::npos && itk::ExposeMetaData<std::string>(dict, *it, value)
+        && value.find('\n') == std::string::npos )
+      {
+      file << *it << ":=" << value << "\n";
+      }
+    }
+  file << "\n";
+
+  std::vector<itk::uint64_t> runData(2 * runs.size() );
+  for( itk::SizeValueType r = 0; r < runs.size(); ++r )
+    {
+    runData[2 * r] = runs[r].Offset;
+    runData[2 * r + 1] = runs[r].Length;
+    }
+  if( !runData.empty() )
+    {
+    itk::ByteSwapper<itk::uint64_t>::SwapRangeFromSystemToLittleEndian(&runData[0], runData.size() );
+    file.write(reinterpret_cast<const char *>(&runData[0]), runData.size() * sizeof( itk::uint64_t ) );
+    }
+  if( floatComponents )
+    {
+    writeTensors<float>(file, tensors);
+    }
+  else
+    {
+    writeTensors<double>(file, tensors);
+    }
+  file.close();
+  if( !file )
+    {
+    throwException("Could not write " + filename);
+    }
+}
+
+SparseTensorImageType::Pointer readSparseTensors(const std::string & filename)
+{
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+  std::string   line;
+  if( !std::getline(file, line) || line != SPARSE_TENSOR_MAGIC )
+    {
+    throwException(filename + " is not a sparse tensor file");
+    }
+
+  SparseTensorImageType::Pointer tensors = SparseTensorImageType::New();
+  itk::MetaDataDictionary &      dict = tensors->GetMetaDataDictionary();
+  std::string                    type;
+  std::vector<double>            sizes;
+  std::vector<double>            index(DIM, 0.0);
+  std::vector<double>            directions;
+  std::vector<double>            origin;
+  std::vector<double>            background(TENSOR_COMPONENTS, 0.0);
+  itk::SizeValueType             numberOfRuns = 0;
+  while( std::getline(file, line) && !line.empty() )
+    {
+    const std::string::size_type colon = line.find(':');
+    if( line[0] == '#' || colon == std::string::npos )
+      {
+      continue;
+      }
+    const std::string field = line.substr(0, colon);
+    if( line.compare(colon, 2, ":=") == 0 )
+      {
+      itk::EncapsulateMetaData<std::string>(dict, field, line.substr(colon + 2) );
+      continue;
+      }
+    const std::string value = line.substr(colon + 1);
+    if( field == "type" )
+      {
+      std::istringstream(value) >> type;
+      }
+    else if( field == "dimension" )
+      {
+      if( parseNumbers(value) != std::vector<double>(1, DIM) )
+        {
+        throwException(filename + " is not a 3D tensor image");
+        }
+      }
+    else if( field == "sizes" )
+      {
+      sizes = parseNumbers(value);
+      }
+    else if( field == "index" )
+      {
+      index = parseNumbers(value);
+      }
+    else if( field == "space directions" )
+      {
+      directions = parseNumbers(value);
+      }
+    else if( field == "space origin" )
+      {
+      origin = parseNumbers(value);
+      }
+    else if( field == "background" )
+      {
+      background = parseNumbers(value);
+      }
+    else if( field == "runs" )
+      {
+      std::istringstream(value) >> numberOfRuns;
+      }
+    else if( field == "endian" )
+      {
+      if( value.find("little") == std::string::npos )
+        {
+        throwException(filename + " is not little endian");
+        }
+      }
+    else if( field == "measurement frame" )
+      {
+      const std::vector<double> numbers = parseNumbers(value);
+      if( numbers.size() == DIM * DIM )
+        {
+        std::vector<std::vector<double> > frame(DIM, std::vector<double>(DIM) );
+        for( unsigned int i = 0; i < DIM; ++i )
+          {
+          for( unsigned int j = 0; j < DIM; ++j )
+            {
+            frame[i][j] = numbers[i * DIM + j];
+            }
+          }
+        itk::EncapsulateMetaData<std::vector<std::vector<double> > >(dict, MEASUREMENT_FRAME_KEY, frame);
+        }
+      }
+    }
+  if( !file || ( type != "float" && type != "double" ) || sizes.size() != DIM || index.size() != DIM
+      || directions.size() != DIM * DIM || origin.size() != DIM || background.size() != TENSOR_COMPONENTS )
+    {
+    throwException("Invalid header in " + filename);
+    }
+
+  SparseTensorImageType::RegionType    region;
+  SparseTensorImageType::SpacingType   spacing;
+  SparseTensorImageType::PointType     point;
+  SparseTensorImageType::DirectionType direction;
+  for( unsigned int i = 0; i < DIM; ++i )
+    {
+    region.SetIndex(i, static_cast<itk::IndexValueType>(index[i]) );
+    region.SetSize(i, static_cast<itk::SizeValueType>(sizes[i]) );
+    point[i] = origin[i];
+    double norm = 0;
+    for( unsigned int j = 0; j < DIM; ++j )
+      {
+      norm += directions[i * DIM + j] * directions[i * DIM + j];
+      }
+    spacing[i] = std::sqrt(norm);
+    if( spacing[i] == 0 )
+      {
+      throwException("Invalid space directions in " + filename);
+      }
+    for( unsigned int j = 0; j < DIM; ++j )
+      {
+      direction[j][i] = directions[i * DIM + j] / spacing[i];
+      }
+    }
+  tensors->SetSpacing(spacing);
+  tensors->SetOrigin(point);
+  tensors->SetDirection(direction);
+
+  // Guards the allocation against a corrupted number of runs
+  if( numberOfRuns > region.GetNumberOfPixels() )
+    {
+    throwException("Invalid number of runs in " + filename);
+    }
+  std::vector<itk::uint64_t> runData(2 * numberOfRuns);
+  if( numberOfRuns > 0 &&
+      !file.read(reinterpret_cast<char *>(&runData[0]), runData.size() * sizeof( itk::uint64_t ) ) )
+    {
+    throwException("The sparse tensor file " + filename + " is truncated");
+    }
+  if( !runData.empty() )
+    {
+    itk::ByteSwapper<itk::uint64_t>::SwapRangeFromSystemToLittleEndian(&runData[0], runData.size() );
+    }
+  SparseTensorImageType::RunListType runs(numberOfRuns);
+  for( itk::SizeValueType r = 0; r < numberOfRuns; ++r )
+    {
+    if( runData[2 * r] > std::numeric_limits<itk::SizeValueType>::max()
+        || runData[2 * r + 1] > std::numeric_limits<itk::SizeValueType>::max() )
+      {
+      throwException("Invalid runs in " + filename);
+      }
+    runs[r].Offset = static_cast<itk::SizeValueType>(runData[2 * r]);
+    runs[r].Length = static_cast<itk::SizeValueType>(runData[2 * r + 1]);
+    }
+  TensorPixelType backgroundTensor;
+  for( unsigned int c = 0; c < TENSOR_COMPONENTS; ++c )
+    {
+    backgroundTensor[c] = background[c];
+    }
+  tensors->Allocate(region, runs, backgroundTensor);
+
+  if( type == "float" )
+    {
+    readTensors<float>(file, tensors);
+    }
+  else
+    {
+    readTensors<double>(file, tensors);
+    }
+  return tensors;
+}
@@ -0,0 +1,27 @@
+#ifndef SPARSETENSORIO_H
+#define SPARSETENSORIO_H
+
+#include "dtitypes.h"
+#include "itkSparseTensorImage.h"
+#include <string>
+
+typedef itk::SparseTensorImage<double, DIM> SparseTensorImageType;
+
+// Sparse tensor files (.sdt) store the foreground of a tensor image: a
+// text header with the grid, the background tensor and the meta-data
+// of the image, then the runs of foreground voxels (pairs of 64 bit
+// offset and length) and their packed tensors (6 components each, float
+// or double), in little endian.
+
+// True if the file name has the extension of sparse tensor files
+bool isSparseTensorFile(const std::string & filename);
+
+// Throws an itk::ExceptionObject if the file cannot be read.  Float
+// tensors are converted to double.
+SparseTensorImageType::Pointer readSparseTensors(const std::string & filename);
+
+// Throws an itk::ExceptionObject if the file cannot be written.
+void writeSparseTensors(const std::string & filename, const SparseTensorImageType * tensors,
+                        bool floatComponents = true);
+
+#endif
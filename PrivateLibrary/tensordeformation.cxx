@@ -1,128 +1,36 @@
 #include "tensordeformation.h"
 #include "transforms.h"
 
-#include <itkVectorResampleImageFilter.h>
-#include <itkWarpVectorImageFilter.h>
 #include <itkVectorLinearInterpolateImageFunction.h>
 #include <itkVectorNearestNeighborInterpolateImageFunction.h>
 #include <itkImageFileWriter.h>
 #include <itkImageFileReader.h>
-#include <itkTransformFileReader.h>
-#include <itkTransformBase.h>
 
-#include "itkDeformationFieldJacobianFilter.h"
 #include "itkHFieldToDeformationFieldImageFilter.h"
 #include "itkLogEuclideanTensorImageFilter.h"
 #include "itkExpEuclideanTensorImageFilter.h"
 #include "itkVectorBSplineInterpolateImageFunction.h"
-#include "itkTensorRotateImageFilter.h"
+#include "itkAffineTensorResampleImageFilter.h"
 #include "itkTensorRotateFromDeformationFieldImageFilter.h"
 #include "itkTensorRotateFromDeformationFieldPPDImageFilter.h"
+#include "itkTensorWarpImageFilter.h"
+#include "itkTransformChainResampleImageFilter.h"
 
 TensorImageType::Pointer createROT(TensorImageType::Pointer timg,
+                                   const ImageSizeType & imageSize,
                                    const std::string & doffile,
                                    int doffiletype)
 {
-  // Depending on which kind of input is given for the transformation we adapt the readers:
-  // doffiletype = 0 -> Old dof file, = 1 -> New dof file (dof2mat), = 2 -> itk format.
-
-  AffineTransformType::Pointer transform;
-
-  // Deal with DOF files
-  if( doffiletype == 0 )
-    {
-    RViewTransform<TransformRealType> dof(readDOFFile<TransformRealType>(doffile) );
-    // AffineTransformType::Pointer transform =
-    AffineTransformType::Pointer transform_tmp =
-      createITKAffine(dof,
-                      timg->GetLargestPossibleRegion().GetSize(),
-                      timg->GetSpacing(),
-                      timg->GetOrigin() );
-    transform = transform_tmp;
-    }
-  if( doffiletype == 1 )
-    {
-    newRViewTransform<TransformRealType> dof(readDOF2MATFile<TransformRealType>(doffile) );
-    AffineTransformType::Pointer         transform_tmp =
-      createnewITKAffine(dof,
-                         timg->GetLargestPossibleRegion().GetSize(),
-                         timg->GetSpacing(),
-                         timg->GetOrigin() );
-    transform = transform_tmp;
-    }
-  // Deal with itk affine files
-  else if( doffiletype == 2 )
-    {
-    // Create a temporary transform filter before copying it to transform
-    AffineTransformType::Pointer transform_tmp = AffineTransformType::New();
-
-    typedef itk::TransformFileReader TransformationReader;
-    typedef itk::TransformBase       TransformBaseType;
-    TransformationReader::Pointer treader = TransformationReader::New();
-
-    treader->SetFileName(doffile);
-    try
-      {
-      treader->Update();
-      }
-    catch( itk::ExceptionObject & e )
-      {
-      std::cerr << e << std::endl;
-      }
-
-    TransformBaseType::Pointer basetransform = treader->GetTransformList()->front();
-
-    // Fill out the Affine matrix
-    AffineTransformType::MatrixType aff3itk;
-    int                             x = 0;
-    int                             y = 0;
-    for( unsigned int i = 0; i < 9; i++ )
-      {
-      aff3itk(x, y) = basetransform->GetParameters() (i);
-      y++;
-      if( y == 3 )
-        {
-        y = 0;
-        x++;
-        }
-      }
-    transform_tmp->SetMatrix(aff3itk);
-
-    // Set the translation values
-    AffineTransformType::TranslationType itktranslation;
-    itktranslation[0] = basetransform->GetParameters() (9);
-    itktranslation[1] = basetransform->GetParameters() (10);
-    itktranslation[2] = basetransform->GetParameters() (11);
-    transform_tmp->SetTranslation(itktranslation);
-
-    // Get the fixed parameters (center of rotation)
-    AffineTransformType::CenterType itkcenter;
-    itkcenter[0] = basetransform->GetFixedParameters() (0);
-    itkcenter[1] = basetransform->GetFixedParameters() (1);
-    itkcenter[2] = basetransform->GetFixedParameters() (2);
-    transform_tmp->SetCenter(itkcenter);
-
-    // Copy the temporary transform in the transform filter
-    transform = transform_tmp;
-    }
+  AffineTransformType::Pointer transform =
+    readAffineTransform(doffile, doffiletype, imageSize, timg->GetSpacing(), timg->GetOrigin() );
 
   vnl_matrix<TransformRealType> R =
     getInverseRotation(transform);
 
-  typedef itk::TensorRotateImageFilter<TensorImageType, TensorImageType, TransformRealType> TensorRotateType;
-  TensorRotateType::Pointer trotfilt = TensorRotateType::New();
-  trotfilt->SetRotation(R);
-  trotfilt->SetInput(timg);
-  trotfilt->Update();
-
-  typedef itk::LogEuclideanTensorImageFilter<RealType> LogEuclideanFilter;
-  typedef LogEuclideanFilter::OutputImageType          LogTensorImageType;
-  LogEuclideanFilter::Pointer logf = LogEuclideanFilter::New();
-  logf->SetInput(trotfilt->GetOutput() );
-  logf->Update();
-
-  typedef itk::VectorResampleImageFilter<
-      LogTensorImageType, LogTensorImageType> ResampleFilterType; // TODO: Should accept precision
+  // The rotation, the log, the resampling and the exponential are
+  // computed together
+  typedef itk::AffineTensorResampleImageFilter<TensorImageType> ResampleFilterType;
+  typedef ResampleFilterType::LogTensorImageType                LogTensorImageType;
   ResampleFilterType::Pointer resampler = ResampleFilterType::New();
 
   // Set interpolator
@@ -131,140 +39,185 @@ TensorImageType::Pointer createROT(TensorImageType::Pointer timg,
 
   resampler->SetInterpolator(interpolator);
 
-  resampler->SetInput(logf->GetOutput() );
+  ResampleFilterType::RotationType rotation;
+  rotation = R;
+  resampler->SetRotation(rotation);
   resampler->SetTransform(transform);
 
-  LogTensorImageType::Pointer logim = logf->GetOutput();
-  resampler->SetSize( logim->GetLargestPossibleRegion().GetSize() );
-  resampler->SetOutputOrigin( logim->GetOrigin() );
-  resampler->SetOutputSpacing( logim->GetSpacing() );
-
-  typedef LogTensorImageType::PixelType LogPixelType;
-  LogPixelType def(0.0);
-  def[0] = -10;
-  def[3] = -10;
-  def[5] = -10;
+  // Exponential of the log-tensor -10 I
+  TensorPixelType def(0.0);
+  def[0] = exp(-10.0);
+  def[3] = exp(-10.0);
+  def[5] = exp(-10.0);
 
   resampler->SetDefaultPixelValue(def);
 
+  resampler->SetInput(timg);
   resampler->Update();
 
-  typedef itk::ExpEuclideanTensorImageFilter<RealType> ExpEuclideanFilter;
-  ExpEuclideanFilter::Pointer expf = ExpEuclideanFilter::New();
-  expf->SetInput(resampler->GetOutput() );
-  expf->Update();
-
-  return expf->GetOutput();
+  return resampler->GetOutput();
 
 }
 
-TensorImageType::Pointer createWarp(TensorImageType::Pointer timg,
-                                    DeformationImageType::Pointer forward,
-                                    TensorReorientationType reorientationtype,
-                                    InterpolationType interpolationtype)
+namespace
 {
-  // Compute jacobian of inverse deformation field
-  typedef itk::DeformationFieldJacobianFilter<DeformationImageType, RealType> JacobianFilterType;
-  typedef JacobianFilterType::OutputImageType                                 JacobianImageType;
-  JacobianFilterType::Pointer jacobian = JacobianFilterType::New();
-  // jacobian->SetInput(inverse);
-  jacobian->SetInput(forward);
-
-  typedef itk::LogEuclideanTensorImageFilter<RealType> LogEuclideanFilter;
-  typedef LogEuclideanFilter::OutputImageType          LogTensorImageType;
-  LogEuclideanFilter::Pointer logf = LogEuclideanFilter::New();
-  logf->SetInput(timg);
-  logf->Update();
-
-  typedef itk::WarpVectorImageFilter<LogTensorImageType, LogTensorImageType, DeformationImageType>
-    WarpImageFilterType;
-  WarpImageFilterType::Pointer warp = WarpImageFilterType::New();
+template <class TReorientationFunctor>
+TensorImageType::Pointer warpTensors(TensorImageType::Pointer timg,
+                                     DeformationImageType::Pointer forward,
+                                     InterpolationType interpolationtype,
+                                     const TensorImageType::RegionType & outputRegion)
+{
+  typedef itk::TensorWarpImageFilter<TensorImageType, DeformationImageType, TReorientationFunctor> WarpFilterType;
+  typedef typename WarpFilterType::LogTensorImageType                                              LogTensorImageType;
+  typename WarpFilterType::Pointer warp = WarpFilterType::New();
 
   if( interpolationtype == Cubic )
     {
     typedef itk::VectorBSplineInterpolateImageFunction<LogTensorImageType, double, double> InterpolatorType;
-    InterpolatorType::Pointer interpolator = InterpolatorType::New();
-
-    warp->SetInterpolator(interpolator);
+    warp->SetInterpolator(InterpolatorType::New() );
     }
   else if( interpolationtype == Linear )
     {
     typedef itk::VectorLinearInterpolateImageFunction<LogTensorImageType, double> InterpolatorType;
-    InterpolatorType::Pointer interpolator = InterpolatorType::New();
-
-    warp->SetInterpolator(interpolator);
+    warp->SetInterpolator(InterpolatorType::New() );
     }
   else if( interpolationtype == NearestNeighbor )
     {
     typedef itk::VectorNearestNeighborInterpolateImageFunction<LogTensorImageType, double> InterpolatorType;
-    InterpolatorType::Pointer interpolator = InterpolatorType::New();
-
-    warp->SetInterpolator(interpolator);
+    warp->SetInterpolator(InterpolatorType::New() );
     }
 
-  warp->SetInput(logf->GetOutput() );
-#if ITK_VERSION_MAJOR < 4
-  warp->SetDeformationField(forward);
-#else
+  // The warp, the exponential, the jacobian and the rotation are
+  // computed together, and only in the output region
+  warp->SetInput(timg);
   warp->SetDisplacementField(forward);
-#endif
-  warp->SetOutputSpacing(logf->GetOutput()->GetSpacing() );
-  warp->SetOutputOrigin(logf->GetOutput()->GetOrigin() );
+  warp->SetOutputSpacing(timg->GetSpacing() );
+  warp->SetOutputOrigin(timg->GetOrigin() );
+  warp->SetOutputRegion(outputRegion);
   warp->Update();
+  return warp->GetOutput();
+}
+}
 
-  typedef LogTensorImageType::PixelType LogPixelType;
-  LogPixelType def(0.0);
-  def[0] = -1e10;
-  def[3] = -1e10;
-  def[5] = -1e10;
-
-  warp->SetEdgePaddingValue(def);
-  warp->Update();
-
-  typedef itk::ExpEuclideanTensorImageFilter<RealType> ExpEuclideanFilter;
-  ExpEuclideanFilter::Pointer expf = ExpEuclideanFilter::New();
-  expf->SetInput(warp->GetOutput() );
-  expf->Update();
-
-  // return expf->GetOutput();
-
-  // Rotate tensor based on inverse deformation field
-  typedef itk::InPlaceImageFilter<
-      TensorImageType,
-      TensorImageType> TensorRotateImageFilterBaseType;
-
-  typedef itk::TensorRotateFromDeformationFieldImageFilter<
-      TensorImageType,
-      JacobianImageType,
-      TensorImageType> TensorFSRotateImageFilterType;
-
-  typedef itk::TensorRotateFromDeformationFieldPPDImageFilter<
-      TensorImageType,
-      JacobianImageType,
-      TensorImageType> TensorPPDRotateImageFilterType;
-
-  TensorRotateImageFilterBaseType::Pointer rotate;
-  if( reorientationtype == FiniteStrain )
+TensorImageType::Pointer createWarp(TensorImageType::Pointer timg,
+                                    DeformationImageType::Pointer forward,
+                                    TensorReorientationType reorientationtype,
+                                    InterpolationType interpolationtype,
+                                    const TensorImageType::RegionType & outputRegion)
+{
+  // Rotate tensor based on the jacobian of the deformation field
+  typedef itk::Matrix<RealType, 3, 3> JacobianType;
+  if( reorientationtype == PreservationPrincipalDirection )
     {
-    TensorFSRotateImageFilterType::Pointer fsrotate;
-    fsrotate = TensorFSRotateImageFilterType::New();
+    typedef itk::Functor::TensorRotateFromDeformationFieldPPDFunction<TensorPixelType, JacobianType, TensorPixelType>
+      PPDFunctorType;
+    return warpTensors<PPDFunctorType>(timg, forward, interpolationtype, outputRegion);
+    }
+  typedef itk::Functor::TensorRotateFromDeformationFieldFunction<TensorPixelType, JacobianType, TensorPixelType>
+    FSFunctorType;
+  return warpTensors<FSFunctorType>(timg, forward, interpolationtype, outputRegion);
+}
 
-    fsrotate->SetInput1(expf->GetOutput() );
+namespace
+{
+// Exponential of the interpolated log-tensor, reoriented with the
+// jacobian of the chain at the output point
+template <class TReorientationFunctor>
+class TransformChainTensorFunction
+{
+public:
+  typedef itk::Vector<double, 6>                              InputType;
+  typedef TensorPixelType                                     OutputType;
+  typedef TransformChain::PointType                           PointType;
+  typedef itk::Functor::ExpEuclideanTensorFunction<InputType> ExpFunctorType;
+
+  TransformChainTensorFunction() : m_TransformChain(ITK_NULLPTR)
+  {
+  }
+
+  void SetTransformChain(const TransformChain * chain)
+  {
+    m_TransformChain = chain;
+  }
+
+  bool operator!=(const TransformChainTensorFunction & other) const
+  {
+    return m_TransformChain != other.m_TransformChain;
+  }
+
+  OutputType operator()(const InputType & logtensor, const PointType & point)
+  {
+    const typename ExpFunctorType::OutputType tensor = m_Exponential(logtensor);
+
+    TensorPixelType warped;
+    for( unsigned int c = 0; c < 6; ++c )
+      {
+      warped[c] = static_cast<RealType>(tensor[c]);
+      }
+    return m_Reorient(warped, m_TransformChain->ComputeDisplacementJacobian(point) );
+  }
+
+private:
+  const TransformChain * m_TransformChain;
+  ExpFunctorType         m_Exponential;
+  TReorientationFunctor  m_Reorient;
+};
+
+template <class TReorientationFunctor>
+TensorImageType::Pointer resampleTensors(TensorImageType::Pointer timg,
+                                         const TransformChain & chain,
+                                         InterpolationType interpolationtype)
+{
+  typedef itk::LogEuclideanTensorImageFilter<RealType>        LogEuclideanFilter;
+  typedef LogEuclideanFilter::OutputImageType                 LogTensorImageType;
+  typedef TransformChainTensorFunction<TReorientationFunctor> FunctorType;
+  typedef itk::TransformChainResampleImageFilter<LogTensorImageType, TensorImageType, FunctorType>
+    ResampleFilterType;
 
-    fsrotate->SetInput2(jacobian->GetOutput() );
+  LogEuclideanFilter::Pointer logf = LogEuclideanFilter::New();
+  logf->SetInput(timg);
+  logf->Update();
 
-    rotate = fsrotate;
+  typename ResampleFilterType::Pointer resampler = ResampleFilterType::New();
+  if( interpolationtype == Cubic )
+    {
+    typedef itk::VectorBSplineInterpolateImageFunction<LogTensorImageType, double, double> InterpolatorType;
+    resampler->SetInterpolator(InterpolatorType::New() );
+    }
+  else if( interpolationtype == Linear )
+    {
+    typedef itk::VectorLinearInterpolateImageFunction<LogTensorImageType, double> InterpolatorType;
+    resampler->SetInterpolator(InterpolatorType::New() );
     }
-  else if( reorientationtype == PreservationPrincipalDirection )
+  else if( interpolationtype == NearestNeighbor )
     {
-    TensorPPDRotateImageFilterType::Pointer ppdrotate;
-    ppdrotate = TensorPPDRotateImageFilterType::New();
+    typedef itk::VectorNearestNeighborInterpolateImageFunction<LogTensorImageType, double> InterpolatorType;
+    resampler->SetInterpolator(InterpolatorType::New() );
+    }
 
-    ppdrotate->SetInput1(expf->GetOutput() );
+  FunctorType functor;
+  functor.SetTransformChain(&chain);
+  resampler->SetFunctor(functor);
+  resampler->SetTransformChain(&chain);
+  resampler->SetInput(logf->GetOutput() );
+  resampler->Update();
+  return resampler->GetOutput();
+}
+}
 
-    ppdrotate->SetInput2(jacobian->GetOutput() );
-    rotate = ppdrotate;
+TensorImageType::Pointer createChainWarp(TensorImageType::Pointer timg,
+                                         const TransformChain & chain,
+                                         TensorReorientationType reorientationtype,
+                                         InterpolationType interpolationtype)
+{
+  typedef itk::Matrix<RealType, 3, 3> JacobianType;
+  if( reorientationtype == PreservationPrincipalDirection )
+    {
+    typedef itk::Functor::TensorRotateFromDeformationFieldPPDFunction<TensorPixelType, JacobianType, TensorPixelType>
+      PPDFunctorType;
+    return resampleTensors<PPDFunctorType>(timg, chain, interpolationtype);
     }
-  rotate->Update();
-  return rotate->GetOutput();
+  typedef itk::Functor::TensorRotateFromDeformationFieldFunction<TensorPixelType, JacobianType, TensorPixelType>
+    FSFunctorType;
+  return resampleTensors<FSFunctorType>(timg, chain, interpolationtype);
 }
@@ -2,12 +2,31 @@
 #define TENSORDEFORMATION_H
 
 #include "dtitypes.h"
+#include "transformchain.h"
 
 // warping functions
-TensorImageType::Pointer createROT(TensorImageType::Pointer, const std::string &, int doffiletype);
 
+// The rotated tensors cover the largest region of the input tensors.
+// imageSize is the size of the image the tensors were read from, which
+// defines the center of the rview transforms when the tensors only
+// cover part of it.
+TensorImageType::Pointer createROT(TensorImageType::Pointer, const ImageSizeType & imageSize,
+                                   const std::string &, int doffiletype);
+
+// The warped tensors are computed in outputRegion only, a region of
+// the deformation field.  The jacobian of the field which reorients
+// them is computed in index space, without the spacing of the field.
 TensorImageType::Pointer createWarp(TensorImageType::Pointer,
                                     DeformationImageType::Pointer,
-                                    TensorReorientationType, InterpolationType);
+                                    TensorReorientationType, InterpolationType,
+                                    const TensorImageType::RegionType & outputRegion);
+
+// The tensors resampled once through the chain, on the grid of the
+// input tensors.  The tensors are reoriented with the jacobian of the
+// whole chain, in world coordinates: on a field of unit spacing only,
+// it is the jacobian createWarp computes in index space.
+TensorImageType::Pointer createChainWarp(TensorImageType::Pointer,
+                                         const TransformChain &,
+                                         TensorReorientationType, InterpolationType);
 
 #endif
@@ -8,211 +8,19 @@
 #include <itkGradientMagnitudeRecursiveGaussianImageFilter.h>
 #include <itkImageFileReader.h>
 #include <itkImageFileWriter.h>
-#include "itkSymmetricEigenAnalysisImageFilter.h"
-#include "itkVectorIndexSelectionCastImageFilter.h"
-#include <itkAddImageFilter.h>
-
-#if ITK_VERSION_MAJOR < 4
-#include <itkMultiplyByConstantImageFilter.h>
-#else
-#include <itkMultiplyImageFilter.h>
-#endif
+#include <vnl/algo/vnl_svd.h>
+#include <fstream>
+#include <iomanip>
 
 // My ITK Filters
 #include "itkVectorMaskNegatedImageFilter.h"
-#include "itkTensorMeanDiffusivityImageFilter.h"
-#include "itkTensorFrobeniusNormImageFilter.h"
-#include "itkTensorColorFAImageFilter.h"
 #include "itkTensorNegativeEigenValueImageFilter.h"
-#include "itkTensorPrincipalEigenvectorImageFilter.h"
 #include "itkVectorClosestDotProductImageFilter.h"
 #include "itkTensorFAGradientImageFilter.h"
-#include "itkTensorRotateImageFilter.h"
 
 // Global constants
 const char* NRRD_MEASUREMENT_KEY = "NRRD_measurement frame";
 
-template <>
-itk::Image<double, 3>::Pointer createFA<double>(TensorImageType::Pointer timg) // Tensor image
-{
-  typedef itk::TensorFractionalAnisotropyImageFilter<TensorImageType, RealImageType> FAFilterType;
-  FAFilterType::Pointer fafilter = FAFilterType::New();
-  fafilter->SetInput(timg);
-  fafilter->Update();
-
-  return fafilter->GetOutput();
-}
-
-template <>
-itk::Image<unsigned short, 3>::Pointer createFA<unsigned short>(TensorImageType::Pointer timg)      // Tensor image
-{
-  RealImageType::Pointer realfa = createFA<double>(timg);
-
-  typedef itk::ShiftScaleImageFilter<RealImageType, IntImageType> ShiftScaleFilterType;
-  ShiftScaleFilterType::Pointer scalefilter = ShiftScaleFilterType::New();
-  scalefilter->SetInput(realfa);
-  scalefilter->SetShift(0);
-  scalefilter->SetScale(10000);
-  scalefilter->Update();
-
-  return scalefilter->GetOutput();
-}
-
-template <>
-itk::Image<double, 3>::Pointer createMD<double>(TensorImageType::Pointer timg) // Tensor image
-{
-  typedef itk::TensorMeanDiffusivityImageFilter<TensorImageType, RealImageType> MDFilterType;
-  MDFilterType::Pointer mdfilter = MDFilterType::New();
-  mdfilter->SetInput(timg);
-  mdfilter->Update();
-
-  return mdfilter->GetOutput();
-}
-
-template <>
-itk::Image<unsigned short, 3>::Pointer createMD<unsigned short>(TensorImageType::Pointer timg)      // Tensor image
-{
-  RealImageType::Pointer realmd = createMD<double>(timg);
-
-  typedef itk::ShiftScaleImageFilter<RealImageType, IntImageType> ShiftScaleFilterType;
-  ShiftScaleFilterType::Pointer scalefilter = ShiftScaleFilterType::New();
-  scalefilter->SetInput(realmd);
-  scalefilter->SetShift(0);
-  scalefilter->SetScale(100000);
-  scalefilter->Update();
-
-  return scalefilter->GetOutput();
-}
-
-template <>
-itk::Image<double, 3>::Pointer createLambda<double>(TensorImageType::Pointer timg, // Tensor image
-                                                    EigenValueIndex lambdaind)     // Lambda index
-{
-  // Not really a deformation image output jsut a 3-vector of doubles.
-  typedef itk::SymmetricEigenAnalysisImageFilter<TensorImageType, DeformationImageType> LambdaFilterType;
-  LambdaFilterType::Pointer lambdafilter = LambdaFilterType::New();
-  lambdafilter->SetInput(timg);
-  lambdafilter->OrderEigenValuesBy(LambdaFilterType::FunctorType::OrderByValue);
-  lambdafilter->SetDimension(3);
-  lambdafilter->Update();
-
-  typedef itk::VectorIndexSelectionCastImageFilter<LambdaFilterType::OutputImageType,
-                                                   RealImageType> ElementSelectAdaptorType;
-  ElementSelectAdaptorType::Pointer elementSelect = ElementSelectAdaptorType::New();
-  elementSelect->SetInput(lambdafilter->GetOutput() );
-  // Reverse semanatics of lambda_1 from ITK.
-  // In our convention lambda_1 is the largest eigenvalue whereas in
-  // ITK its the smallest
-  elementSelect->SetIndex(2 - lambdaind);
-  elementSelect->Update();
-
-  return elementSelect->GetOutput();
-}
-
-template <>
-itk::Image<unsigned short, 3>::Pointer createLambda<unsigned short>(TensorImageType::Pointer timg, // Tensor image
-                                                                    EigenValueIndex lambdaind)     // Lambda index
-{
-  RealImageType::Pointer reallambda = createLambda<double>(timg, lambdaind);
-
-  typedef itk::ShiftScaleImageFilter<RealImageType, IntImageType> ShiftScaleFilterType;
-  ShiftScaleFilterType::Pointer scalefilter = ShiftScaleFilterType::New();
-  scalefilter->SetInput(reallambda);
-  scalefilter->SetShift(0);
-  scalefilter->SetScale(100000);
-  scalefilter->Update();
-
-  return scalefilter->GetOutput();
-}
-
-template <>
-itk::Image<double, 3>::Pointer createRD<double>(TensorImageType::Pointer timg) // Tensor image
-{
-  typedef itk::SymmetricEigenAnalysisImageFilter<TensorImageType, DeformationImageType> LambdaFilterType;
-  LambdaFilterType::Pointer lambdafilter = LambdaFilterType::New();
-  lambdafilter->SetInput(timg);
-  lambdafilter->OrderEigenValuesBy(LambdaFilterType::FunctorType::OrderByValue);
-  lambdafilter->SetDimension(3);
-  lambdafilter->Update();
-
-  typedef itk::AddImageFilter<RealImageType, RealImageType, RealImageType> RDFilterType;
-  RDFilterType::Pointer rdfilter = RDFilterType::New();
-
-  typedef itk::VectorIndexSelectionCastImageFilter<LambdaFilterType::OutputImageType,
-                                                   RealImageType> ElementSelectAdaptorType;
-  ElementSelectAdaptorType::Pointer elementSelect1 = ElementSelectAdaptorType::New();
-  elementSelect1->SetInput(lambdafilter->GetOutput() );
-  // lambda3
-  elementSelect1->SetIndex(0);
-  elementSelect1->Update();
-  rdfilter->SetInput1(elementSelect1->GetOutput() );
-
-  ElementSelectAdaptorType::Pointer elementSelect2 = ElementSelectAdaptorType::New();
-  elementSelect2->SetInput(lambdafilter->GetOutput() );
-  // lambda2
-  elementSelect2->SetIndex(1);
-  elementSelect2->Update();
-  rdfilter->SetInput2(elementSelect2->GetOutput() );
-
-  rdfilter->Update();
-
-#if ITK_VERSION_MAJOR < 4
-  typedef itk::MultiplyByConstantImageFilter<RDFilterType::OutputImageType, float, RealImageType>
-    DivideFilterType;
-#else
-  typedef itk::MultiplyImageFilter<RDFilterType::OutputImageType,
-    RDFilterType::OutputImageType, RealImageType> DivideFilterType;
-#endif
-  DivideFilterType::Pointer dividefilter = DivideFilterType::New();
-  dividefilter->SetInput(rdfilter->GetOutput() );
-  dividefilter->SetConstant(0.5);
-  dividefilter->Update();
-
-  return dividefilter->GetOutput();
-
-}
-
-template <>
-itk::Image<unsigned short, 3>::Pointer createRD<unsigned short>(TensorImageType::Pointer timg)      // Tensor image
-{
-  RealImageType::Pointer realfro = createRD<double>(timg);
-
-  typedef itk::ShiftScaleImageFilter<RealImageType, IntImageType> ShiftScaleFilterType;
-  ShiftScaleFilterType::Pointer scalefilter = ShiftScaleFilterType::New();
-  scalefilter->SetInput(realfro);
-  scalefilter->SetShift(0);
-  scalefilter->SetScale(100000);
-  scalefilter->Update();
-
-  return scalefilter->GetOutput();
-}
-
-template <>
-itk::Image<double, 3>::Pointer createFro<double>(TensorImageType::Pointer timg) // Tensor image
-{
-  typedef itk::TensorFrobeniusNormImageFilter<TensorImageType, RealImageType> MDFilterType;
-  MDFilterType::Pointer mdfilter = MDFilterType::New();
-  mdfilter->SetInput(timg);
-  mdfilter->Update();
-
-  return mdfilter->GetOutput();
-}
-
-template <>
-itk::Image<unsigned short, 3>::Pointer createFro<unsigned short>(TensorImageType::Pointer timg)      // Tensor image
-{
-  RealImageType::Pointer realfro = createFro<double>(timg);
-
-  typedef itk::ShiftScaleImageFilter<RealImageType, IntImageType> ShiftScaleFilterType;
-  ShiftScaleFilterType::Pointer scalefilter = ShiftScaleFilterType::New();
-  scalefilter->SetInput(realfro);
-  scalefilter->SetShift(0);
-  scalefilter->SetScale(100000);
-  scalefilter->Update();
-
-  return scalefilter->GetOutput();
-}
-
 GradientImageType::Pointer createFAGradient(TensorImageType::Pointer timg, // Tensor image
                                             double sigma)                  // sigma
 {
@@ -250,71 +58,236 @@ RealImageType::Pointer createFAGradMag(TensorImageType::Pointer timg,      // Te
   return gradmag->GetOutput();
 }
 
-RGBImageType::Pointer createColorFA(TensorImageType::Pointer timg)      // Tensor image
+// Rotation from the measurement frame to the image frame of the
+// tensors.  The measurement frame of the tensor image is reset to the
+// identity.  Returns false if the image has no measurement frame.
+static bool measurementFrameToImageRotation(TensorImageType::Pointer timg, // Tensor image
+                                            vnl_matrix<double> & rotation)
 {
-  typedef itk::RGBPixel<unsigned char>                                 RGBPixel;
-  typedef itk::Image<RGBPixel, 3>                                      RGBImageType;
-  typedef itk::TensorColorFAImageFilter<TensorImageType, RGBImageType> FAFilterType;
-  FAFilterType::Pointer fafilter = FAFilterType::New();
-  fafilter->SetInput(timg);
-  fafilter->Update();
+  itk::MetaDataDictionary & dict = timg->GetMetaDataDictionary();
+
+  if( !dict.HasKey(NRRD_MEASUREMENT_KEY) )
+    {
+    return false;
+    }
 
-  return fafilter->GetOutput();
+  // measurement frame
+  vnl_matrix<double> mf(3, 3);
+  // imaging frame
+  vnl_matrix<double> imgf(3, 3);
+
+  std::vector<std::vector<double> > nrrdmf;
+  itk::ExposeMetaData<std::vector<std::vector<double> > >(dict, NRRD_MEASUREMENT_KEY, nrrdmf);
+
+  imgf = timg->GetDirection().GetVnlMatrix();
+  for( unsigned int i = 0; i < 3; ++i )
+    {
+    for( unsigned int j = 0; j < 3; ++j )
+      {
+      mf(i, j) = nrrdmf[i][j];
+
+      if( i == j )
+        {
+        nrrdmf[i][j] = 1.0;
+        }
+      else
+        {
+        nrrdmf[i][j] = 0.0;
+        }
+      }
+    }
+
+  itk::EncapsulateMetaData<std::vector<std::vector<double> > >(dict, NRRD_MEASUREMENT_KEY, nrrdmf);
+
+  rotation = vnl_svd<double>(imgf).inverse() * mf;
+  return true;
 }
 
-GradientImageType::Pointer createPrincipalEigenvector(TensorImageType::Pointer timg) // Tensor image
+template <class T>
+typename ScalarMapsFilter<T>::Type::Pointer createScalarMaps(TensorImageType::Pointer timg,             // Tensor image
+                                                             const bool computeMap[],                  // Maps to compute
+                                                             const StatisticsLabelImageType * labels,  // Label map
+                                                             const bool computeStatistics[],           // Maps to summarize
+                                                             const std::vector<double> & percentiles)
 {
-  itk::MetaDataDictionary & dict = timg->GetMetaDataDictionary();
+  typedef typename ScalarMapsFilter<T>::Type FilterType;
+  typename FilterType::Pointer mapsfilter = FilterType::New();
+  mapsfilter->SetInput(timg);
+  for( unsigned int i = 0; i < itk::TensorScalarMaps::NumberOfMaps; ++i )
+    {
+    mapsfilter->SetComputeMap(static_cast<itk::TensorScalarMaps::MapType>(i), computeMap[i]);
+    }
 
-  if( dict.HasKey(NRRD_MEASUREMENT_KEY) )
+  // Same scaling as the other integer outputs
+  if( !itk::NumericTraits<T>::is_iec559 )
     {
-    // measurement frame
-    vnl_matrix<double> mf(3, 3);
-    // imaging frame
-    vnl_matrix<double> imgf(3, 3);
+    mapsfilter->SetFractionalAnisotropyScale(10000);
+    mapsfilter->SetDiffusivityScale(100000);
+    }
 
-    std::vector<std::vector<double> > nrrdmf;
-    itk::ExposeMetaData<std::vector<std::vector<double> > >(dict, NRRD_MEASUREMENT_KEY, nrrdmf);
+  // The principal eigenvector is expressed in the image frame
+  vnl_matrix<double> rotation;
+  if( computeMap[itk::TensorScalarMaps::PrincipalEigenvector] &&
+      measurementFrameToImageRotation(timg, rotation) )
+    {
+    typename FilterType::RotationMatrixType pdrotation;
+    pdrotation = rotation;
+    mapsfilter->SetPrincipalEigenvectorRotation(pdrotation);
+    }
 
-    imgf = timg->GetDirection().GetVnlMatrix();
-    for( unsigned int i = 0; i < 3; ++i )
+  if( labels )
+    {
+    mapsfilter->SetLabelImage(labels);
+    for( unsigned int i = 0; i < itk::TensorScalarMaps::ColorFractionalAnisotropy; ++i )
       {
-      for( unsigned int j = 0; j < 3; ++j )
-        {
-        mf(i, j) = nrrdmf[i][j];
-
-        if( i == j )
-          {
-          nrrdmf[i][j] = 1.0;
-          }
-        else
-          {
-          nrrdmf[i][j] = 0.0;
-          }
-        }
+      mapsfilter->SetComputeStatistics(static_cast<itk::TensorScalarMaps::MapType>(i), computeStatistics[i]);
+      }
+    if( !percentiles.empty() )
+      {
+      mapsfilter->SetPercentiles(percentiles);
       }
+    }
 
-    itk::EncapsulateMetaData<std::vector<std::vector<double> > >(dict, NRRD_MEASUREMENT_KEY, nrrdmf);
+  mapsfilter->Update();
+  return mapsfilter;
+}
+
+template ScalarMapsFilter<double>::Type::Pointer createScalarMaps<double>(TensorImageType::Pointer,
+                                                                          const bool computeMap[],
+                                                                          const StatisticsLabelImageType *,
+                                                                          const bool computeStatistics[],
+                                                                          const std::vector<double> &);
+template ScalarMapsFilter<unsigned short>::Type::Pointer createScalarMaps<unsigned short>(TensorImageType::Pointer,
+                                                                                          const bool computeMap[],
+                                                                                          const StatisticsLabelImageType *,
+                                                                                          const bool computeStatistics[],
+                                                                                          const std::vector<double> &);
+
+// Component names of the mean tensors
+static const char * const tensorComponentNames[6] = { "xx", "xy", "xz", "yy", "yz", "zz" };
+
+template <class TTensor>
+static void writeJSONTensor(std::ostream & out, const TTensor & tensor)
+{
+  out << "[";
+  for( unsigned int c = 0; c < 6; ++c )
+    {
+    out << ( c ? ", " : "" ) << tensor[c];
+    }
+  out << "]";
+}
+
+template <class T>
+bool writeLabelStatistics(const std::string & filename,                          // Output file
+                          const typename ScalarMapsFilter<T>::Type * mapsfilter) // Updated filter
+{
+  typedef typename ScalarMapsFilter<T>::Type FilterType;
+  typedef typename FilterType::LabelStatisticsMapType StatisticsMapType;
+  const StatisticsMapType &   statistics = mapsfilter->GetLabelStatistics();
+  const std::vector<double> & percentiles = mapsfilter->GetPercentiles();
 
-    typedef itk::TensorRotateImageFilter<TensorImageType, TensorImageType, double> TensorRotateFilterType;
-    TensorRotateFilterType::Pointer trotate = TensorRotateFilterType::New();
-    trotate->SetInput(timg);
-    trotate->SetRotation(vnl_svd<double>(imgf).inverse() * mf);
-    trotate->Update();
-    timg = trotate->GetOutput();
+  std::ofstream out(filename.c_str() );
+  if( !out )
+    {
+    return false;
+    }
+  out << std::setprecision(17);
 
+  std::vector<itk::TensorScalarMaps::MapType> maps;
+  for( unsigned int i = 0; i < itk::TensorScalarMaps::ColorFractionalAnisotropy; ++i )
+    {
+    if( mapsfilter->GetComputeStatistics(static_cast<itk::TensorScalarMaps::MapType>(i) ) )
+      {
+      maps.push_back(static_cast<itk::TensorScalarMaps::MapType>(i) );
+      }
     }
 
-  typedef itk::CovariantVector<double, 3>                                              VectorPixel;
-  typedef itk::Image<VectorPixel, 3>                                                   VectorImageType;
-  typedef itk::TensorPrincipalEigenvectorImageFilter<TensorImageType, VectorImageType> PrincipalEigenvectorFilterType;
+  const bool json = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0;
+  if( json )
+    {
+    out << "{\n  \"percentiles\": [";
+    for( unsigned int p = 0; p < percentiles.size(); ++p )
+      {
+      out << ( p ? ", " : "" ) << percentiles[p];
+      }
+    out << "],\n  \"labels\": [";
+    for( typename StatisticsMapType::const_iterator it = statistics.begin(); it != statistics.end(); ++it )
+      {
+      out << ( it == statistics.begin() ? "\n" : ",\n" );
+      out << "    {\n      \"label\": " << it->first << ",\n      \"count\": " << it->second.Count << ",\n";
+      for( unsigned int m = 0; m < maps.size(); ++m )
+        {
+        const typename FilterType::ScalarStatistics & scalar = it->second.Scalars[maps[m]];
+        out << "      \"" << itk::TensorScalarMaps::GetMapName(maps[m]) << "\": { \"mean\": " << scalar.Mean
+            << ", \"std\": " << scalar.StandardDeviation << ", \"min\": " << scalar.Minimum
+            << ", \"max\": " << scalar.Maximum << ", \"percentiles\": [";
+        for( unsigned int p = 0; p < scalar.Percentiles.size(); ++p )
+          {
+          out << ( p ? ", " : "" ) << scalar.Percentiles[p];
+          }
+        out << "] },\n";
+        }
+      out << "      \"tensorCount\": " << it->second.TensorCount << ",\n";
+      out << "      \"logEuclideanMean\": ";
+      writeJSONTensor(out, it->second.LogEuclideanMean);
+      out << ",\n      \"affineInvariantMean\": ";
+      writeJSONTensor(out, it->second.AffineInvariantMean);
+      out << "\n    }";
+      }
+    out << "\n  ]\n}\n";
+    return out.good();
+    }
 
-  PrincipalEigenvectorFilterType::Pointer ppdfilter = PrincipalEigenvectorFilterType::New();
-  ppdfilter->SetInput(timg);
-  ppdfilter->Update();
-  return ppdfilter->GetOutput();
+  // One line per label
+  out << "label,count";
+  for( unsigned int m = 0; m < maps.size(); ++m )
+    {
+    const std::string name = itk::TensorScalarMaps::GetMapName(maps[m]);
+    out << "," << name << "_mean," << name << "_std," << name << "_min," << name << "_max";
+    for( unsigned int p = 0; p < percentiles.size(); ++p )
+      {
+      out << "," << name << "_p" << percentiles[p];
+      }
+    }
+  out << ",tensor_count";
+  for( unsigned int c = 0; c < 6; ++c )
+    {
+    out << ",le_" << tensorComponentNames[c];
+    }
+  for( unsigned int c = 0; c < 6; ++c )
+    {
+    out << ",ai_" << tensorComponentNames[c];
+    }
+  out << "\n";
+  for( typename StatisticsMapType::const_iterator it = statistics.begin(); it != statistics.end(); ++it )
+    {
+    out << it->first << "," << it->second.Count;
+    for( unsigned int m = 0; m < maps.size(); ++m )
+      {
+      const typename FilterType::ScalarStatistics & scalar = it->second.Scalars[maps[m]];
+      out << "," << scalar.Mean << "," << scalar.StandardDeviation << "," << scalar.Minimum << "," << scalar.Maximum;
+      for( unsigned int p = 0; p < scalar.Percentiles.size(); ++p )
+        {
+        out << "," << scalar.Percentiles[p];
+        }
+      }
+    out << "," << it->second.TensorCount;
+    for( unsigned int c = 0; c < 6; ++c )
+      {
+      out << "," << it->second.LogEuclideanMean[c];
+      }
+    for( unsigned int c = 0; c < 6; ++c )
+      {
+      out << "," << it->second.AffineInvariantMean[c];
+      }
+    out << "\n";
+    }
+  return out.good();
 }
 
+template bool writeLabelStatistics<double>(const std::string &, const ScalarMapsFilter<double>::Type *);
+template bool writeLabelStatistics<unsigned short>(const std::string &, const ScalarMapsFilter<unsigned short>::Type *);
+
 LabelImageType::Pointer createNegativeEigenValueLabel(TensorImageType::Pointer timg)
 {
   typedef itk::TensorNegativeEigenValueImageFilter<TensorImageType,
@@ -3,31 +3,44 @@
 
 #include "dtitypes.h"
 #include <itkImage.h>
+#include <string>
+#include <vector>
+#include "itkTensorScalarMapsImageFilter.h"
 
 // derived output functions
-template <class T>
-typename itk::Image<T, 3>::Pointer createFA(TensorImageType::Pointer);
 
+// Filter computing the FA, MD, Frobenius norm, eigenvalues, RD, color
+// FA and principal eigenvector of a tensor image in a single pass
 template <class T>
-typename itk::Image<T, 3>::Pointer createMD(TensorImageType::Pointer);
-
+struct ScalarMapsFilter
+{
+  typedef itk::TensorScalarMapsImageFilter<TensorImageType, itk::Image<T, 3> > Type;
+};
+
+// Label map of the statistics of the scalar maps
+typedef ScalarMapsFilter<double>::Type::LabelImageType StatisticsLabelImageType;
+
+// computeMap is indexed by itk::TensorScalarMaps::MapType.  With
+// unsigned short maps, FA is scaled by 10000 and the other scalars by
+// 100000.  If labels is set, the maps selected in computeStatistics
+// (FA to RD) are summarized in each non-zero label.
 template <class T>
-typename itk::Image<T, 3>::Pointer createFro(TensorImageType::Pointer);
-
+typename ScalarMapsFilter<T>::Type::Pointer createScalarMaps(TensorImageType::Pointer, const bool computeMap[],
+                                                             const StatisticsLabelImageType * labels = ITK_NULLPTR,
+                                                             const bool computeStatistics[] = ITK_NULLPTR,
+                                                             const std::vector<double> & percentiles =
+                                                               std::vector<double>() );
+
+// Write the label statistics of a scalar maps filter, in JSON if the
+// file name ends with .json and in CSV otherwise.  Returns false if the
+// file cannot be written.
 template <class T>
-typename itk::Image<T, 3>::Pointer createLambda(TensorImageType::Pointer, EigenValueIndex lambdanum);
-
-template <class T>
-typename itk::Image<T, 3>::Pointer createRD(TensorImageType::Pointer);
+bool writeLabelStatistics(const std::string & filename, const typename ScalarMapsFilter<T>::Type * mapsfilter);
 
 GradientImageType::Pointer createFAGradient(TensorImageType::Pointer, double);
 
 RealImageType::Pointer createFAGradMag(TensorImageType::Pointer, double);
 
-RGBImageType::Pointer createColorFA(TensorImageType::Pointer);
-
 LabelImageType::Pointer createNegativeEigenValueLabel(TensorImageType::Pointer);
 
-GradientImageType::Pointer createPrincipalEigenvector(TensorImageType::Pointer);
-
 #endif
@@ -0,0 +1,227 @@
+#include "transformchain.h"
+#include "transforms.h"
+
+#include <itkTransformFileReader.h>
+#include <itkTransformBase.h>
+
+void TransformChain::AddAffine(AffineTransformType::Pointer transform)
+{
+  Step step;
+
+  step.affine = transform;
+  m_Steps.push_back(step);
+}
+
+void TransformChain::AddDeformation(DeformationImageType::Pointer field)
+{
+  Step step;
+
+  step.displacement = DisplacementInterpolatorType::New();
+  step.displacement->SetInputImage(field);
+  step.jacobian = DisplacementJacobianType::New();
+  step.jacobian->SetUseImageSpacingOn();
+  step.jacobian->SetInputImage(field);
+  m_Steps.push_back(step);
+}
+
+TransformChain::PointType TransformChain::MapPoint(const Step & step, const PointType & point) const
+{
+  if( step.affine )
+    {
+    return step.affine->TransformPoint(point);
+    }
+  PointType mapped = point;
+  if( step.displacement->IsInsideBuffer(point) )
+    {
+    const DisplacementInterpolatorType::OutputType displacement = step.displacement->Evaluate(point);
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      mapped[d] += displacement[d];
+      }
+    }
+  return mapped;
+}
+
+TransformChain::JacobianType TransformChain::StepJacobian(const Step & step, const PointType & point) const
+{
+  if( step.affine )
+    {
+    return step.affine->GetMatrix();
+    }
+  JacobianType jacobian;
+  jacobian.SetIdentity();
+  if( step.displacement->IsInsideBuffer(point) )
+    {
+    jacobian += step.jacobian->Evaluate(point);
+    }
+  return jacobian;
+}
+
+void TransformChain::TransformPoints(const PointType * points, unsigned int count, PointType * mapped) const
+{
+  for( unsigned int i = 0; i < count; ++i )
+    {
+    mapped[i] = points[i];
+    }
+  for( std::vector<Step>::const_reverse_iterator step = m_Steps.rbegin(); step != m_Steps.rend(); ++step )
+    {
+    for( unsigned int i = 0; i < count; ++i )
+      {
+      mapped[i] = this->MapPoint(*step, mapped[i]);
+      }
+    }
+}
+
+TransformChain::JacobianType TransformChain::ComputeDisplacementJacobian(const PointType & point) const
+{
+  // Chain rule, from the output to the input
+  JacobianType jacobian;
+  jacobian.SetIdentity();
+  PointType mapped = point;
+  for( std::vector<Step>::const_reverse_iterator step = m_Steps.rbegin(); step != m_Steps.rend(); ++step )
+    {
+    jacobian = this->StepJacobian(*step, mapped) * jacobian;
+    mapped = this->MapPoint(*step, mapped);
+    }
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    jacobian(d, d) -= 1.0;
+    }
+  return jacobian;
+}
+
+AffineTransformType::Pointer readAffineTransform(const std::string & doffile, int doffiletype,
+                                                 const ImageSizeType & imageSize,
+                                                 const ImageSpacingType & spacing,
+                                                 const TensorImageType::PointType & origin)
+{
+  // Depending on which kind of input is given for the transformation we adapt the readers:
+  // doffiletype = 0 -> Old dof file, = 1 -> New dof file (dof2mat), = 2 -> itk format.
+
+  AffineTransformType::Pointer transform;
+
+  // Deal with DOF files
+  if( doffiletype == 0 )
+    {
+    RViewTransform<TransformRealType> dof(readDOFFile<TransformRealType>(doffile) );
+    // AffineTransformType::Pointer transform =
+    AffineTransformType::Pointer transform_tmp =
+      createITKAffine(dof,
+                      imageSize,
+                      spacing,
+                      origin);
+    transform = transform_tmp;
+    }
+  if( doffiletype == 1 )
+    {
+    newRViewTransform<TransformRealType> dof(readDOF2MATFile<TransformRealType>(doffile) );
+    AffineTransformType::Pointer         transform_tmp =
+      createnewITKAffine(dof,
+                         imageSize,
+                         spacing,
+                         origin);
+    transform = transform_tmp;
+    }
+  // Deal with itk affine files
+  else if( doffiletype == 2 )
+    {
+    // Create a temporary transform filter before copying it to transform
+    AffineTransformType::Pointer transform_tmp = AffineTransformType::New();
+
+    typedef itk::TransformFileReader TransformationReader;
+    typedef itk::TransformBase       TransformBaseType;
+    TransformationReader::Pointer treader = TransformationReader::New();
+
+    treader->SetFileName(doffile);
+    try
+      {
+      treader->Update();
+      }
+    catch( itk::ExceptionObject & e )
+      {
+      std::cerr << e << std::endl;
+      }
+
+    TransformBaseType::Pointer basetransform = treader->GetTransformList()->front();
+
+    // Fill out the Affine matrix
+    AffineTransformType::MatrixType aff3itk;
+    int                             x = 0;
+    int                             y = 0;
+    for( unsigned int i = 0; i < 9; i++ )
+      {
+      aff3itk(x, y) = basetransform->GetParameters() (i);
+      y++;
+      if( y == 3 )
+        {
+        y = 0;
+        x++;
+        }
+      }
+    transform_tmp->SetMatrix(aff3itk);
+
+    // Set the translation values
+    AffineTransformType::TranslationType itktranslation;
+    itktranslation[0] = basetransform->GetParameters() (9);
+    itktranslation[1] = basetransform->GetParameters() (10);
+    itktranslation[2] = basetransform->GetParameters() (11);
+    transform_tmp->SetTranslation(itktranslation);
+
+    // Get the fixed parameters (center of rotation)
+    AffineTransformType::CenterType itkcenter;
+    itkcenter[0] = basetransform->GetFixedParameters() (0);
+    itkcenter[1] = basetransform->GetFixedParameters() (1);
+    itkcenter[2] = basetransform->GetFixedParameters() (2);
+    transform_tmp->SetCenter(itkcenter);
+
+    // Copy the temporary transform in the transform filter
+    transform = transform_tmp;
+    }
+
+  return transform;
+}
+
+TransformChain readTransformChain(const std::vector<std::string> & transforms,
+                                  const ImageSizeType & imageSize,
+                                  const ImageSpacingType & spacing,
+                                  const TensorImageType::PointType & origin)
+{
+  TransformChain chain;
+
+  for( std::vector<std::string>::const_iterator it = transforms.begin(); it != transforms.end(); ++it )
+    {
+    const std::string::size_type separator = it->find(':');
+    const std::string            type = it->substr(0, separator);
+    const std::string            file = separator == std::string::npos ? "" : it->substr(separator + 1);
+    if( file == "" )
+      {
+      throw itk::ExceptionObject(__FILE__, __LINE__, "Transform without file: " + *it, ITK_LOCATION);
+      }
+
+    if( type == "dof" )
+      {
+      chain.AddAffine(readAffineTransform(file, 0, imageSize, spacing, origin) );
+      }
+    else if( type == "newdof" )
+      {
+      chain.AddAffine(readAffineTransform(file, 1, imageSize, spacing, origin) );
+      }
+    else if( type == "itk" )
+      {
+      chain.AddAffine(readAffineTransform(file, 2, imageSize, spacing, origin) );
+      }
+    else if( type == "hfield" )
+      {
+      chain.AddDeformation(readDeformationField(file, HField) );
+      }
+    else if( type == "displacement" )
+      {
+      chain.AddDeformation(readDeformationField(file, Displacement) );
+      }
+    else
+      {
+      throw itk::ExceptionObject(__FILE__, __LINE__, "Unknown transform type: " + type, ITK_LOCATION);
+      }
+    }
+  return chain;
+}
@@ -0,0 +1,93 @@
+#ifndef TRANSFORMCHAIN_H
+#define TRANSFORMCHAIN_H
+
+#include "dtitypes.h"
+#include "deformationfieldio.h"
+#include <itkVectorLinearInterpolateImageFunction.h>
+#include "itkDeformationFieldJacobianFunction.h"
+
+#include <string>
+#include <vector>
+
+// Sequence of affine transforms and deformation fields applied to an
+// image one after the other, in the order they are added.  The
+// transforms are only composed when a point is sampled, so an image
+// is resampled once through the whole chain.
+//
+// Like the resamplers, the chain maps the points of the output image
+// to the points of the input image: the last transform added is the
+// first one applied to the output points.  Each transform follows the
+// convention of its own resampler: TransformPoint for the affine
+// transforms (VectorResampleImageFilter in createROT), p + u(p) for
+// the displacement fields (WarpImageFilter).  The displacements are
+// interpolated linearly and are zero outside of their field.
+class TransformChain
+{
+public:
+  typedef itk::Point<double, 3>     PointType;
+  typedef itk::Matrix<double, 3, 3> JacobianType;
+
+  void AddAffine(AffineTransformType::Pointer transform);
+
+  void AddDeformation(DeformationImageType::Pointer field);
+
+  unsigned int GetNumberOfTransforms() const
+  {
+    return m_Steps.size();
+  }
+
+  // Points of the input image sampled for the count output points.
+  // The points are mapped through one transform at a time, so the
+  // displacements of a scanline are looked up together.
+  void TransformPoints(const PointType * points, unsigned int count, PointType * mapped) const;
+
+  PointType TransformPoint(const PointType & point) const
+  {
+    PointType mapped;
+
+    this->TransformPoints(&point, 1, &mapped);
+    return mapped;
+  }
+
+  // Jacobian of the composed mapping at an output point, minus the
+  // identity: the jacobian of the displacement that the reorientation
+  // functors expect.  The jacobians of the fields are computed in
+  // world coordinates.
+  JacobianType ComputeDisplacementJacobian(const PointType & point) const;
+
+private:
+  typedef itk::VectorLinearInterpolateImageFunction<DeformationImageType, double> DisplacementInterpolatorType;
+  typedef itk::DeformationFieldJacobianFunction<DeformationImageType, double>     DisplacementJacobianType;
+
+  struct Step
+    {
+    AffineTransformType::Pointer          affine;
+    DisplacementInterpolatorType::Pointer displacement;
+    DisplacementJacobianType::Pointer     jacobian;
+    };
+
+  // Point of the input of a step, and jacobian of the step there
+  PointType MapPoint(const Step & step, const PointType & point) const;
+
+  JacobianType StepJacobian(const Step & step, const PointType & point) const;
+
+  std::vector<Step> m_Steps;
+};
+
+// Affine transform of a dof file (doffiletype 0), of a dof2mat text
+// file (1) or of an ITK transform file (2).  The rview transforms are
+// centered on the image of the given size, spacing and origin.
+AffineTransformType::Pointer readAffineTransform(const std::string & doffile, int doffiletype,
+                                                 const ImageSizeType & imageSize,
+                                                 const ImageSpacingType & spacing,
+                                                 const TensorImageType::PointType & origin);
+
+// Chain of the transforms "type:file", in the order they are applied
+// to the image.  The types are dof, newdof (dof2mat), itk, hfield and
+// displacement.  Throws an itk::ExceptionObject for an unknown type.
+TransformChain readTransformChain(const std::vector<std::string> & transforms,
+                                  const ImageSizeType & imageSize,
+                                  const ImageSpacingType & spacing,
+                                  const TensorImageType::PointType & origin);
+
+#endif
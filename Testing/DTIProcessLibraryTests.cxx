@@ -0,0 +1,21 @@
+// Test driver of the filters of Library and PrivateLibrary.  Each test
+// compares a filter to the filters it replaces.  ExtractImageRegion crops
+// the outputs of the command line tests.
+#include "itkTestMainExtended.h"
+
+void RegisterTests()
+{
+  REGISTER_TEST(itkDiffusionTensor3DEigenSolverTest);
+  REGISTER_TEST(itkParallelNrrdImageIOTest);
+  REGISTER_TEST(itkMappedImageFileReaderTest);
+  REGISTER_TEST(itkTensorPlanesTest);
+  REGISTER_TEST(itkTensorWarpImageFilterTest);
+  REGISTER_TEST(itkVectorBSplineInterpolateImageFunctionTest);
+  REGISTER_TEST(itkDeformationFieldJacobianFunctionTest);
+  REGISTER_TEST(itkTransformChainResampleImageFilterTest);
+  REGISTER_TEST(itkAffineTensorResampleImageFilterTest);
+  REGISTER_TEST(itkDiffusionTensor3DReconstructionIterativeImageFilterTest);
+  REGISTER_TEST(itkDiffusionTensor3DGradientSchemeRegistryTest);
+  REGISTER_TEST(itkTensorScalarMapsImageFilterTest);
+  REGISTER_TEST(ExtractImageRegion);
+}
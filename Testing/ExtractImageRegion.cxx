@@ -0,0 +1,58 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+// Writes a region of a scalar image, given by its start index and size
+// in voxels as the --roi of dtiprocess, to compare the outputs of an ROI
+// to the crop of the outputs of the whole image
+
+#include <itkImage.h>
+#include <itkImageFileReader.h>
+#include <itkImageFileWriter.h>
+#include <itkRegionOfInterestImageFilter.h>
+#include <cstdlib>
+#include <iostream>
+
+int ExtractImageRegion(int argc, char * argv[])
+{
+  if( argc < 9 )
+    {
+    std::cerr << "Usage: " << argv[0] << " inputImage outputImage x y z sizeX sizeY sizeZ" << std::endl;
+    return EXIT_FAILURE;
+    }
+  typedef itk::Image<double, 3>                                  ImageType;
+  typedef itk::RegionOfInterestImageFilter<ImageType, ImageType> ExtractFilterType;
+
+  itk::ImageFileReader<ImageType>::Pointer reader = itk::ImageFileReader<ImageType>::New();
+  reader->SetFileName(argv[1]);
+
+  ImageType::RegionType region;
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    region.SetIndex(d, atoi(argv[3 + d]) );
+    region.SetSize(d, atoi(argv[6 + d]) );
+    }
+  ExtractFilterType::Pointer extract = ExtractFilterType::New();
+  extract->SetInput(reader->GetOutput() );
+  extract->SetRegionOfInterest(region);
+
+  itk::ImageFileWriter<ImageType>::Pointer writer = itk::ImageFileWriter<ImageType>::New();
+  writer->SetInput(extract->GetOutput() );
+  writer->SetFileName(argv[2]);
+  writer->Update();
+
+  std::cout << "Region " << region.GetIndex() << " " << region.GetSize() << " of " << argv[1] << " written"
+            << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+// Compares AffineTensorResampleImageFilter to the pipeline createROT
+// used before: TensorRotateImageFilter, LogEuclideanTensorImageFilter,
+// VectorResampleImageFilter of the log-tensors and
+// ExpEuclideanTensorImageFilter, with the B-spline and the linear
+// interpolators
+
+#include "itkAffineTensorResampleImageFilter.h"
+#include "itkLogEuclideanTensorImageFilter.h"
+#include "itkExpEuclideanTensorImageFilter.h"
+#include "itkTensorRotateImageFilter.h"
+#include "itkTensorTestFixtures.h"
+#include "itkVectorBSplineInterpolateImageFunction.h"
+#include <itkAffineTransform.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkVectorLinearInterpolateImageFunction.h>
+#include <itkVectorResampleImageFilter.h>
+#include <itkVersor.h>
+#include <vnl/algo/vnl_matrix_inverse.h>
+#include <vnl/algo/vnl_svd.h>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+typedef itk::DiffusionTensor3D<double>                                         TensorType;
+typedef itk::Image<TensorType, 3>                                              TensorImageType;
+typedef itk::LogEuclideanTensorImageFilter<double>                             LogFilterType;
+typedef itk::ExpEuclideanTensorImageFilter<double>                             ExpFilterType;
+typedef LogFilterType::OutputImageType                                         LogImageType;
+typedef itk::TensorRotateImageFilter<TensorImageType, TensorImageType, double> RotateFilterType;
+typedef itk::VectorResampleImageFilter<LogImageType, LogImageType>             VectorResampleFilterType;
+typedef itk::AffineTensorResampleImageFilter<TensorImageType>                  ResampleFilterType;
+typedef itk::AffineTransform<double, 3>                                        AffineTransformType;
+
+// A rotation around an oblique axis, an anisotropic scaling and a
+// translation, centered on the image like the rview transforms
+AffineTransformType::Pointer Transform(const TensorImageType * tensors)
+{
+  itk::Versor<double>::VectorType axis;
+  axis[0] = 0.3;
+  axis[1] = -0.5;
+  axis[2] = 1.0;
+  itk::Versor<double> versor;
+  versor.Set(axis, 0.35);
+  AffineTransformType::MatrixType matrix = versor.GetMatrix();
+  AffineTransformType::MatrixType scale;
+  scale.Fill(0.0);
+  scale(0, 0) = 0.9;
+  scale(1, 1) = 1.15;
+  scale(2, 2) = 1.05;
+  matrix = matrix * scale;
+
+  AffineTransformType::Pointer transform = AffineTransformType::New();
+  AffineTransformType::CenterType center;
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    center[d] = tensors->GetOrigin()[d]
+      + ( tensors->GetLargestPossibleRegion().GetSize(d) - 1 ) / 2.0 * tensors->GetSpacing()[d];
+    }
+  transform->SetCenter(center);
+  transform->SetMatrix(matrix);
+  AffineTransformType::OutputVectorType translation;
+  translation[0] = 1.7;
+  translation[1] = -0.6;
+  translation[2] = 2.2;
+  transform->SetTranslation(translation);
+  return transform;
+}
+
+// Resamples the tensors with the pipeline and with
+// AffineTensorResampleImageFilter, and compares them
+template <typename TInterpolator>
+bool CompareResamplers(TensorImageType * tensors, const AffineTransformType * transform, const char * description)
+{
+  // The rotation of the tensors, as getInverseRotation computes it: the
+  // orthogonal part of the inverse of the matrix
+  const vnl_matrix<double> inverse = vnl_matrix_inverse<double>(transform->GetMatrix().GetVnlMatrix() );
+  vnl_svd<double>          svd(inverse);
+  const vnl_matrix<double> R = svd.U() * svd.V().transpose();
+
+  // The pipeline of createROT
+  RotateFilterType::Pointer rotate = RotateFilterType::New();
+  rotate->SetRotation(R);
+  rotate->SetInput(tensors);
+
+  LogFilterType::Pointer logf = LogFilterType::New();
+  logf->SetInput(rotate->GetOutput() );
+  logf->Update();
+
+  VectorResampleFilterType::Pointer resampler = VectorResampleFilterType::New();
+  resampler->SetInterpolator(TInterpolator::New() );
+  resampler->SetInput(logf->GetOutput() );
+  resampler->SetTransform(transform);
+  resampler->SetOutputStartIndex(tensors->GetLargestPossibleRegion().GetIndex() );
+  resampler->SetSize(tensors->GetLargestPossibleRegion().GetSize() );
+  resampler->SetOutputOrigin(tensors->GetOrigin() );
+  resampler->SetOutputSpacing(tensors->GetSpacing() );
+  LogImageType::PixelType logDefault(0.0);
+  logDefault[0] = -10;
+  logDefault[3] = -10;
+  logDefault[5] = -10;
+  resampler->SetDefaultPixelValue(logDefault);
+
+  ExpFilterType::Pointer expf = ExpFilterType::New();
+  expf->SetInput(resampler->GetOutput() );
+  expf->Update();
+
+  // The single pass
+  ResampleFilterType::Pointer affineResampler = ResampleFilterType::New();
+  affineResampler->SetInterpolator(TInterpolator::New() );
+  ResampleFilterType::RotationType rotation;
+  rotation = R;
+  affineResampler->SetRotation(rotation);
+  affineResampler->SetTransform(transform);
+  TensorType tensorDefault(0.0);
+  tensorDefault[0] = std::exp(-10.0);
+  tensorDefault[3] = std::exp(-10.0);
+  tensorDefault[5] = std::exp(-10.0);
+  affineResampler->SetDefaultPixelValue(tensorDefault);
+  affineResampler->SetInput(tensors);
+  affineResampler->Update();
+
+  const TensorImageType * output = affineResampler->GetOutput();
+  const TensorImageType * reference = expf->GetOutput();
+  if( output->GetLargestPossibleRegion() != reference->GetLargestPossibleRegion()
+      || output->GetSpacing() != reference->GetSpacing() || output->GetOrigin() != reference->GetOrigin() )
+    {
+    std::cerr << description << ": the grids differ" << std::endl;
+    return false;
+    }
+  unsigned int defaultCount = 0;
+  itk::ImageRegionConstIterator<TensorImageType> it(output, output->GetLargestPossibleRegion() );
+  itk::ImageRegionConstIterator<TensorImageType> rit(reference, reference->GetLargestPossibleRegion() );
+  for( ; !it.IsAtEnd(); ++it, ++rit )
+    {
+    if( DTITesting::Difference(it.Get(), rit.Get() ) > 1.0e-9 )
+      {
+      std::cerr << description << ": " << it.Get() << " instead of " << rit.Get() << " at "
+                << it.GetIndex() << std::endl;
+      return false;
+      }
+    if( it.Get() == tensorDefault )
+      {
+      ++defaultCount;
+      }
+    }
+  // Some points are mapped out of the tensors
+  if( defaultCount == 0 || defaultCount == output->GetLargestPossibleRegion().GetNumberOfPixels() )
+    {
+    std::cerr << description << ": " << defaultCount << " points outside of the tensors" << std::endl;
+    return false;
+    }
+  return true;
+}
+}
+
+int itkAffineTensorResampleImageFilterTest(int, char *[])
+{
+  // Random tensors on a grid which is not the identity
+  const itk::SizeValueType     size[3] = { 19, 14, 9 };
+  const double                 spacing[3] = { 1.25, 1.0, 2.5 };
+  const double                 origin[3] = { -12.0, 5.5, 1.0 };
+  TensorImageType::Pointer     tensors = DTITesting::RandomTensors<TensorImageType>(size, spacing, origin);
+  AffineTransformType::Pointer transform = Transform(tensors);
+
+  typedef itk::VectorBSplineInterpolateImageFunction<LogImageType, double, double> BSplineInterpolatorType;
+  typedef itk::VectorLinearInterpolateImageFunction<LogImageType, double>          LinearInterpolatorType;
+  if( !CompareResamplers<BSplineInterpolatorType>(tensors, transform, "B-spline")
+      || !CompareResamplers<LinearInterpolatorType>(tensors, transform, "Linear") )
+    {
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "AffineTensorResampleImageFilter resamples as the pipeline it replaces" << std::endl;
+  return EXIT_SUCCESS;
+}
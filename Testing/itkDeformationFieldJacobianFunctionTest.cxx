@@ -0,0 +1,191 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+// Compares DeformationFieldJacobianFunction to the jacobian image of
+// DeformationFieldJacobianFilter: at the indices, with and without the
+// spacing, and interpolated at continuous indices
+
+#include "itkDeformationFieldJacobianFunction.h"
+#include "itkDeformationFieldJacobianFilter.h"
+#include "itkTensorTestFixtures.h"
+#include <itkImageRegionConstIteratorWithIndex.h>
+#include <itkImageRegionIterator.h>
+#include <vnl/vnl_random.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+typedef itk::Image<itk::Vector<double, 3>, 3>                             DeformationImageType;
+typedef itk::DeformationFieldJacobianFunction<DeformationImageType>       JacobianFunctionType;
+typedef itk::DeformationFieldJacobianFilter<DeformationImageType, double> JacobianFilterType;
+typedef JacobianFilterType::OutputImageType                               JacobianImageType;
+typedef JacobianFunctionType::OutputType                                  JacobianType;
+
+// Random displacements, on a region which does not start at the origin
+DeformationImageType::Pointer RandomField(vnl_random & random)
+{
+  DeformationImageType::Pointer    field = DeformationImageType::New();
+  DeformationImageType::RegionType region;
+  region.SetIndex(0, 2);
+  region.SetIndex(1, 1);
+  region.SetIndex(2, 0);
+  region.SetSize(0, 12);
+  region.SetSize(1, 9);
+  region.SetSize(2, 7);
+  field->SetRegions(region);
+  DeformationImageType::SpacingType spacing;
+  spacing[0] = 0.5;
+  spacing[1] = 1.25;
+  spacing[2] = 2.0;
+  field->SetSpacing(spacing);
+  DeformationImageType::PointType origin;
+  origin[0] = 3.0;
+  origin[1] = -1.0;
+  origin[2] = 0.5;
+  field->SetOrigin(origin);
+  field->Allocate();
+
+  itk::ImageRegionIterator<DeformationImageType> it(field, region);
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+    DeformationImageType::PixelType displacement;
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      displacement[d] = random.drand64(-3.0, 3.0);
+      }
+    it.Set(displacement);
+    }
+  return field;
+}
+
+// Trilinear interpolation of the jacobian image, the indices outside
+// of the image taking the jacobian of the edge
+JacobianType Interpolate(const JacobianImageType * jacobians, const JacobianFunctionType::ContinuousIndexType & index)
+{
+  const JacobianImageType::RegionType & region = jacobians->GetLargestPossibleRegion();
+  JacobianType                          J;
+  J.Fill(0.0);
+  for( unsigned int corner = 0; corner < 8; ++corner )
+    {
+    JacobianImageType::IndexType neighbor;
+    double                       weight = 1.0;
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      const double base = std::floor(index[d]);
+      const bool   upper = ( corner >> d ) & 1;
+      weight *= upper ? index[d] - base : 1.0 - ( index[d] - base );
+      const itk::IndexValueType last = region.GetIndex(d) + static_cast<itk::IndexValueType>(region.GetSize(d) ) - 1;
+      neighbor[d] = std::max(std::min(static_cast<itk::IndexValueType>(base) + ( upper ? 1 : 0 ), last),
+                             region.GetIndex(d) );
+      }
+    const JacobianType & jacobian = jacobians->GetPixel(neighbor);
+    for( unsigned int r = 0; r < 3; ++r )
+      {
+      for( unsigned int c = 0; c < 3; ++c )
+        {
+        J(r, c) += weight * jacobian(r, c);
+        }
+      }
+    }
+  return J;
+}
+
+// Compares the function to the filter at every index of the field
+bool CompareAtIndices(DeformationImageType * field, bool useImageSpacing, const char * description)
+{
+  JacobianFilterType::Pointer filter = JacobianFilterType::New();
+  filter->SetInput(field);
+  filter->SetUseImageSpacing(useImageSpacing);
+  filter->Update();
+
+  JacobianFunctionType::Pointer function = JacobianFunctionType::New();
+  function->SetInputImage(field);
+  function->SetUseImageSpacing(useImageSpacing);
+  JacobianFunctionType::Cache cache;
+
+  itk::ImageRegionConstIteratorWithIndex<JacobianImageType> it(filter->GetOutput(),
+                                                               filter->GetOutput()->GetLargestPossibleRegion() );
+  for( ; !it.IsAtEnd(); ++it )
+    {
+    const JacobianType J = function->EvaluateAtIndex(it.GetIndex() );
+    if( DTITesting::MaximumDifference(J, it.Get() ) > 1.0e-12 )
+      {
+      std::cerr << description << ": " << J << " instead of " << it.Get() << " at " << it.GetIndex() << std::endl;
+      return false;
+      }
+    if( DTITesting::MaximumDifference(function->EvaluateAtIndex(it.GetIndex(), cache), J) != 0.0 )
+      {
+      std::cerr << description << ": the cached jacobian differs at " << it.GetIndex() << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+}
+
+int itkDeformationFieldJacobianFunctionTest(int, char *[])
+{
+  vnl_random                    random(DTITesting::RandomSeed);
+  DeformationImageType::Pointer field = RandomField(random);
+
+  if( !CompareAtIndices(field, false, "Index space") || !CompareAtIndices(field, true, "Physical space") )
+    {
+    return EXIT_FAILURE;
+    }
+
+  // Continuous indices, in the field and up to one voxel out of it,
+  // against the interpolation of the jacobian image
+  JacobianFilterType::Pointer filter = JacobianFilterType::New();
+  filter->SetInput(field);
+  filter->Update();
+  JacobianFunctionType::Pointer function = JacobianFunctionType::New();
+  function->SetInputImage(field);
+  JacobianFunctionType::Cache cache;
+
+  const DeformationImageType::RegionType & region = field->GetLargestPossibleRegion();
+  for( unsigned int i = 0; i < 2000; ++i )
+    {
+    JacobianFunctionType::ContinuousIndexType index;
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      index[d] = random.drand64(region.GetIndex(d) - 1.0, region.GetIndex(d) + region.GetSize(d) );
+      }
+    const JacobianType reference = Interpolate(filter->GetOutput(), index);
+    const JacobianType J = function->EvaluateAtContinuousIndex(index);
+    if( DTITesting::MaximumDifference(J, reference) > 1.0e-12 )
+      {
+      std::cerr << J << " instead of " << reference << " at " << index << std::endl;
+      return EXIT_FAILURE;
+      }
+    if( DTITesting::MaximumDifference(function->EvaluateAtContinuousIndex(index, cache), J) > 1.0e-12 )
+      {
+      std::cerr << "The cached interpolation differs at " << index << std::endl;
+      return EXIT_FAILURE;
+      }
+    JacobianFunctionType::PointType point;
+    field->TransformContinuousIndexToPhysicalPoint(index, point);
+    if( DTITesting::MaximumDifference(function->Evaluate(point), J) > 1.0e-9 )
+      {
+      std::cerr << "The jacobian at " << point << " differs from the jacobian at " << index << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  std::cout << "DeformationFieldJacobianFunction computes the jacobians of DeformationFieldJacobianFilter"
+            << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,206 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+// Compares DiffusionTensor3DEigenSolver to the iterative eigen-analysis
+// of DiffusionTensor3D on random, diagonal and degenerate tensors
+
+#include "itkDiffusionTensor3DEigenSolver.h"
+#include "itkTensorTestFixtures.h"
+#include <vnl/vnl_random.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+typedef itk::DiffusionTensor3D<double>                TensorType;
+typedef itk::DiffusionTensor3DEigenSolver<TensorType> SolverType;
+typedef TensorType::EigenValuesArrayType              EigenValuesArrayType;
+typedef TensorType::EigenVectorsMatrixType            EigenVectorsMatrixType;
+
+// Sum_k values[k] v_k v_k^T
+TensorType Recompose(const EigenValuesArrayType & values, const EigenVectorsMatrixType & vectors)
+{
+  return DTITesting::ComposeTensor<TensorType>(vectors, values[0], values[1], values[2]);
+}
+
+// True if the eigenvalues are the same, up to the rounding
+bool SameEigenValues(const EigenValuesArrayType & values, const EigenValuesArrayType & reference)
+{
+  const double scale = std::max(std::fabs(reference[0]), std::fabs(reference[2]) );
+
+  for( unsigned int k = 0; k < 3; ++k )
+    {
+    if( std::fabs(values[k] - reference[k]) > 1.0e-9 * scale )
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+// Checks the eigen-analysis of tensor against the iterative solver.
+// The eigenvectors of simple eigenvalues are compared up to their sign.
+bool CheckTensor(const TensorType & tensor, const EigenValuesArrayType & values,
+                 const EigenVectorsMatrixType & vectors, const char * description)
+{
+  EigenValuesArrayType   referenceValues;
+  EigenVectorsMatrixType referenceVectors;
+
+  tensor.ComputeEigenAnalysis(referenceValues, referenceVectors);
+
+  if( !SameEigenValues(values, referenceValues) )
+    {
+    std::cerr << description << ": eigenvalues " << values << " instead of " << referenceValues
+              << " for " << tensor << std::endl;
+    return false;
+    }
+  const double scale = std::max(std::fabs(referenceValues[0]), std::fabs(referenceValues[2]) );
+  for( unsigned int k = 0; k < 3; ++k )
+    {
+    const bool simple = ( k == 0 || referenceValues[k] - referenceValues[k - 1] > 1.0e-3 * scale )
+      && ( k == 2 || referenceValues[k + 1] - referenceValues[k] > 1.0e-3 * scale );
+    if( !simple )
+      {
+      continue;
+      }
+    double dot = 0.0;
+    for( unsigned int c = 0; c < 3; ++c )
+      {
+      dot += vectors(k, c) * referenceVectors(k, c);
+      }
+    if( std::fabs(std::fabs(dot) - 1.0) > 1.0e-8 )
+      {
+      std::cerr << description << ": eigenvector " << k << " differs from the iterative solver ("
+                << dot << ") for " << tensor << std::endl;
+      return false;
+      }
+    }
+  if( DTITesting::Difference(Recompose(values, vectors), tensor) > 1.0e-9 )
+    {
+    std::cerr << description << ": the eigen-analysis does not recompose " << tensor << std::endl;
+    return false;
+    }
+  return true;
+}
+}
+
+int itkDiffusionTensor3DEigenSolverTest(int, char *[])
+{
+  vnl_random              random(DTITesting::RandomSeed);
+  std::vector<TensorType> tensors;
+
+  // Random positive definite tensors, of diffusivities in mm^2/s
+  for( unsigned int i = 0; i < 1000; ++i )
+    {
+    tensors.push_back(DTITesting::RandomTensor<TensorType>(random, 1.0e-5, 3.0e-3) );
+    }
+  // Tensors with a negative eigenvalue, as estimated in noisy voxels
+  for( unsigned int i = 0; i < 100; ++i )
+    {
+    const itk::Matrix<double, 3, 3> R = DTITesting::RandomRotation(random);
+    const double                    negative = -random.drand64(1.0e-6, 1.0e-3);
+    const double                    a = random.drand64(1.0e-5, 3.0e-3);
+    const double                    b = random.drand64(1.0e-5, 3.0e-3);
+    tensors.push_back(DTITesting::ComposeTensor<TensorType>(R, negative, a, b) );
+    }
+  // Prolate, oblate and isotropic tensors: solved in the plane
+  // orthogonal to the simple eigenvector
+  for( unsigned int i = 0; i < 100; ++i )
+    {
+    const double a = random.drand64(1.0e-5, 3.0e-3);
+    const double b = random.drand64(1.0e-5, 3.0e-3);
+    tensors.push_back(DTITesting::ComposeTensor<TensorType>(DTITesting::RandomRotation(random), a, a, b) );
+    tensors.push_back(DTITesting::ComposeTensor<TensorType>(DTITesting::RandomRotation(random), a, b, b) );
+    tensors.push_back(DTITesting::ComposeTensor<TensorType>(DTITesting::RandomRotation(random), a,
+                                                            a * ( 1.0 + 1.0e-7 ), b) );
+    tensors.push_back(DTITesting::ComposeTensor<TensorType>(DTITesting::RandomRotation(random), a, a, a) );
+    }
+  // Diagonal tensors, and the background
+  itk::Matrix<double, 3, 3> identity;
+  identity.SetIdentity();
+  tensors.push_back(DTITesting::ComposeTensor<TensorType>(identity, 3.0e-3, 1.0e-3, 2.0e-3) );
+  tensors.push_back(DTITesting::ComposeTensor<TensorType>(identity, 1.0e-3, 1.0e-3, 2.0e-3) );
+  tensors.push_back(DTITesting::ComposeTensor<TensorType>(identity, 0.0, 0.0, 0.0) );
+
+  // One tensor at a time
+  for( unsigned int i = 0; i < tensors.size(); ++i )
+    {
+    EigenValuesArrayType   values;
+    EigenVectorsMatrixType vectors;
+    SolverType::ComputeEigenAnalysis(tensors[i], values, vectors);
+    if( !CheckTensor(tensors[i], values, vectors, "ComputeEigenAnalysis") )
+      {
+      return EXIT_FAILURE;
+      }
+    EigenValuesArrayType valuesOnly;
+    SolverType::ComputeEigenValues(tensors[i], valuesOnly);
+    if( !SameEigenValues(valuesOnly, values) )
+      {
+      std::cerr << "ComputeEigenValues differs from ComputeEigenAnalysis for " << tensors[i] << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // The batch methods, on a count which is not a multiple of the lanes
+  const itk::SizeValueType            count = tensors.size() - 1;
+  std::vector<EigenValuesArrayType>   values(count);
+  std::vector<EigenVectorsMatrixType> vectors(count);
+  SolverType::ComputeEigenAnalysis(&tensors[0], count, &values[0], &vectors[0]);
+  for( itk::SizeValueType i = 0; i < count; ++i )
+    {
+    if( !CheckTensor(tensors[i], values[i], vectors[i], "Batch ComputeEigenAnalysis") )
+      {
+      return EXIT_FAILURE;
+      }
+    }
+  std::vector<EigenValuesArrayType> valuesOnly(count);
+  SolverType::ComputeEigenValues(&tensors[0], count, &valuesOnly[0]);
+  for( itk::SizeValueType i = 0; i < count; ++i )
+    {
+    if( !SameEigenValues(valuesOnly[i], values[i]) )
+      {
+      std::cerr << "Batch ComputeEigenValues differs from ComputeEigenAnalysis for " << tensors[i] << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // ComposeTensors gives back the tensors
+  std::vector<double> planes[6];
+  double *            components[6];
+  for( unsigned int c = 0; c < 6; ++c )
+    {
+    planes[c].resize(count);
+    components[c] = &planes[c][0];
+    }
+  SolverType::ComposeTensors(&values[0], &vectors[0], count, components);
+  for( itk::SizeValueType i = 0; i < count; ++i )
+    {
+    TensorType composed;
+    for( unsigned int c = 0; c < 6; ++c )
+      {
+      composed[c] = planes[c][i];
+      }
+    if( DTITesting::Difference(composed, tensors[i]) > 1.0e-9 )
+      {
+      std::cerr << "ComposeTensors gives " << composed << " instead of " << tensors[i] << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  std::cout << tensors.size() << " tensors solved as DiffusionTensor3D does" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,197 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+// Compares the tensors estimated with a gradient scheme computed, found
+// in memory and read from the cache directory of
+// DiffusionTensor3DGradientSchemeRegistry, and checks that the global
+// registry is the same on all the threads
+
+#include "itkDiffusionTensor3DGradientSchemeRegistry.h"
+#include "itkDiffusionTensor3DReconstructionLinearImageFilter.h"
+#include "itkTensorTestFixtures.h"
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIterator.h>
+#include <itkMultiThreader.h>
+#include <itksys/Directory.hxx>
+#include <itksys/SystemTools.hxx>
+#include <vnl/vnl_random.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+typedef itk::DiffusionTensor3DReconstructionLinearImageFilter<unsigned short, double> FilterType;
+typedef FilterType::GradientSchemeRegistryType                                        RegistryType;
+typedef FilterType::GradientImagesType                                                DWIImageType;
+typedef FilterType::TensorImageType                                                   TensorImageType;
+typedef FilterType::GradientDirectionContainerType                                    GradientContainerType;
+
+DWIImageType::Pointer RandomSignals(unsigned int numberOfComponents)
+{
+  vnl_random             random(DTITesting::RandomSeed);
+  DWIImageType::Pointer  dwi = DWIImageType::New();
+  DWIImageType::SizeType size;
+  size[0] = 9;
+  size[1] = 8;
+  size[2] = 7;
+  dwi->SetRegions(size);
+  dwi->SetVectorLength(numberOfComponents);
+  dwi->Allocate();
+
+  DWIImageType::PixelType                signals(numberOfComponents);
+  itk::ImageRegionIterator<DWIImageType> it(dwi, dwi->GetLargestPossibleRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+    signals[0] = static_cast<unsigned short>(random.lrand32(500, 1000) );
+    for( unsigned int m = 1; m < numberOfComponents; ++m )
+      {
+      signals[m] = static_cast<unsigned short>(random.lrand32(50, signals[0]) );
+      }
+    it.Set(signals);
+    }
+  return dwi;
+}
+
+TensorImageType::Pointer Estimate(DWIImageType * dwi, RegistryType * registry)
+{
+  FilterType::Pointer filter = FilterType::New();
+  filter->SetGradientSchemeRegistry(registry);
+  filter->SetGradientImage(DTITesting::Gradients<GradientContainerType>(), dwi);
+  filter->SetBValue(1000.0);
+  filter->SetThreshold(0);
+  filter->Update();
+  return filter->GetOutput();
+}
+
+bool SameTensors(const TensorImageType * image, const TensorImageType * reference, const char * description)
+{
+  itk::ImageRegionConstIterator<TensorImageType> it(image, image->GetLargestPossibleRegion() );
+  itk::ImageRegionConstIterator<TensorImageType> rit(reference, reference->GetLargestPossibleRegion() );
+  for( ; !it.IsAtEnd(); ++it, ++rit )
+    {
+    if( it.Get() != rit.Get() )
+      {
+      std::cerr << description << ": " << it.Get() << " instead of " << rit.Get() << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+bool CheckCounts(const RegistryType * registry, itk::SizeValueType hits, itk::SizeValueType cacheFileHits,
+                 itk::SizeValueType misses, const char * description)
+{
+  if( registry->GetNumberOfHits() != hits || registry->GetNumberOfCacheFileHits() != cacheFileHits
+      || registry->GetNumberOfMisses() != misses )
+    {
+    std::cerr << description << ": " << registry->GetNumberOfHits() << " hits, "
+              << registry->GetNumberOfCacheFileHits() << " cache file hits, " << registry->GetNumberOfMisses()
+              << " misses instead of " << hits << ", " << cacheFileHits << ", " << misses << std::endl;
+    return false;
+    }
+  return true;
+}
+
+ITK_THREAD_RETURN_TYPE GetInstanceCallback(void * arg)
+{
+  itk::MultiThreader::ThreadInfoStruct * info = static_cast<itk::MultiThreader::ThreadInfoStruct *>(arg);
+  std::vector<RegistryType *> *          instances = static_cast<std::vector<RegistryType *> *>(info->UserData);
+  ( *instances )[info->ThreadID] = RegistryType::GetInstance();
+  return ITK_THREAD_RETURN_VALUE;
+}
+}
+
+int itkDiffusionTensor3DGradientSchemeRegistryTest(int argc, char * argv[])
+{
+  if( argc < 2 )
+    {
+    std::cerr << "Usage: " << argv[0] << " outputDirectory" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const std::string directory = std::string(argv[1]) + "/gradientSchemeCache";
+  itksys::SystemTools::RemoveADirectory(directory.c_str() );
+  itksys::SystemTools::MakeDirectory(directory.c_str() );
+
+  DWIImageType::Pointer dwi = RandomSignals(DTITesting::Gradients<GradientContainerType>()->Size() );
+
+  // Computed, without a cache directory
+  RegistryType::Pointer    computed = RegistryType::New();
+  TensorImageType::Pointer reference = Estimate(dwi, computed);
+  if( !CheckCounts(computed, 0, 0, 1, "Computed") )
+    {
+    return EXIT_FAILURE;
+    }
+
+  // Computed and written to the cache directory, then found in memory
+  RegistryType::Pointer writer = RegistryType::New();
+  writer->SetCacheDirectory(directory);
+  if( !SameTensors(Estimate(dwi, writer), reference, "Computed and written")
+      || !SameTensors(Estimate(dwi, writer), reference, "Found in memory")
+      || !CheckCounts(writer, 1, 0, 1, "Written") )
+    {
+    return EXIT_FAILURE;
+    }
+
+  // Read from the cache directory by another registry, as by another
+  // process
+  RegistryType::Pointer reader = RegistryType::New();
+  reader->SetCacheDirectory(directory);
+  if( !SameTensors(Estimate(dwi, reader), reference, "Read from the cache")
+      || !CheckCounts(reader, 0, 1, 0, "Read") )
+    {
+    return EXIT_FAILURE;
+    }
+
+  // The cache holds the scheme and no temporary file
+  itksys::Directory files;
+  files.Load(directory.c_str() );
+  unsigned int numberOfFiles = 0;
+  for( unsigned long i = 0; i < files.GetNumberOfFiles(); ++i )
+    {
+    const std::string name = files.GetFile(i);
+    if( name != "." && name != ".." )
+      {
+      ++numberOfFiles;
+      if( name.find(".tmp") != std::string::npos )
+        {
+        std::cerr << "Temporary file left in the cache: " << name << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+  if( numberOfFiles != 1 )
+    {
+    std::cerr << numberOfFiles << " files in the cache instead of 1" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // A single global registry, whichever thread creates it
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  std::vector<RegistryType *> instances(threader->GetNumberOfThreads(), ITK_NULLPTR);
+  threader->SetSingleMethod(GetInstanceCallback, &instances);
+  threader->SingleMethodExecute();
+  for( unsigned int i = 0; i < instances.size(); ++i )
+    {
+    if( instances[i] != RegistryType::GetInstance() )
+      {
+      std::cerr << "Thread " << i << " got another global registry" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  std::cout << "The cached gradient schemes give the tensors of the computed ones" << std::endl;
+  return EXIT_SUCCESS;
+}
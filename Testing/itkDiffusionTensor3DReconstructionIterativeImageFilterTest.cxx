@@ -0,0 +1,214 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+// Checks the iterative estimators of dtiestim, the non-linear least
+// squares (-m nls) and the Rician maximum likelihood (-m ml), on the
+// signals of known tensors: the tensors they estimate, their iteration
+// cap and the counts of the voxels they optimized and did not converge
+
+#include "itkDiffusionTensor3DReconstructionNonlinearImageFilter.h"
+#include "itkDiffusionTensor3DReconstructionRicianImageFilter.h"
+#include "itkDiffusionTensor3DReconstructionWeightedImageFilter.h"
+#include "itkTensorTestFixtures.h"
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
+#include <itkImageRegionIterator.h>
+#include <vnl/vnl_random.h>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+typedef unsigned short                                                                      PixelType;
+typedef itk::DiffusionTensor3DReconstructionNonlinearImageFilter<PixelType, double>         NonlinearFilterType;
+typedef itk::DiffusionTensor3DReconstructionWeightedImageFilter<PixelType, double>          WeightedFilterType;
+typedef itk::DiffusionTensor3DReconstructionRicianImageFilter<PixelType, PixelType, double> RicianFilterType;
+typedef NonlinearFilterType::GradientImagesType                                             DWIImageType;
+typedef NonlinearFilterType::TensorImageType                                                TensorImageType;
+typedef TensorImageType::PixelType                                                          TensorType;
+typedef NonlinearFilterType::GradientDirectionContainerType                                 GradientContainerType;
+typedef NonlinearFilterType::GradientDirectionType                                          GradientType;
+
+const double    BValue = 1000.0;
+const PixelType Threshold = 100;
+
+// A baseline and 12 directions.  The Rician filter normalizes the
+// directions in place, each filter gets its own container.
+GradientContainerType::Pointer Gradients()
+{
+  return DTITesting::Gradients<GradientContainerType>();
+}
+
+// Random positive definite tensors and their signals, rounded to
+// integers.  The baseline of the first slice is below the threshold.
+DWIImageType::Pointer Signals(const GradientContainerType * gradients, TensorImageType::Pointer & tensors)
+{
+  vnl_random                random(DTITesting::RandomSeed);
+  TensorImageType::SizeType size;
+  size[0] = 8;
+  size[1] = 7;
+  size[2] = 5;
+  tensors = TensorImageType::New();
+  tensors->SetRegions(size);
+  tensors->Allocate();
+  DWIImageType::Pointer dwi = DWIImageType::New();
+  dwi->SetRegions(size);
+  dwi->SetVectorLength(gradients->Size() );
+  dwi->Allocate();
+
+  itk::ImageRegionIterator<TensorImageType> tit(tensors, tensors->GetLargestPossibleRegion() );
+  itk::ImageRegionIterator<DWIImageType>    dit(dwi, dwi->GetLargestPossibleRegion() );
+  for( ; !tit.IsAtEnd(); ++tit, ++dit )
+    {
+    const TensorType tensor = DTITesting::RandomTensor<TensorType>(random, 2.0e-4, 2.0e-3);
+    tit.Set(tensor);
+
+    const double            S0 = tit.GetIndex()[2] == 0 ? 50.0 : 1000.0;
+    DWIImageType::PixelType signals(gradients->Size() );
+    for( unsigned int m = 0; m < gradients->Size(); ++m )
+      {
+      const GradientType & g = gradients->ElementAt(m);
+      double               gDg = 0.0;
+      for( unsigned int i = 0; i < 3; ++i )
+        {
+        for( unsigned int j = 0; j < 3; ++j )
+          {
+          gDg += g[i] * tensor(i, j) * g[j];
+          }
+        }
+      signals[m] = static_cast<PixelType>(S0 * std::exp(-BValue * gDg) + 0.5);
+      }
+    dit.Set(signals);
+    }
+  return dwi;
+}
+
+// Compares the tensors of the voxels above the threshold
+bool CompareForeground(const TensorImageType * image, const TensorImageType * reference, double tolerance,
+                       const char * description)
+{
+  itk::ImageRegionConstIteratorWithIndex<TensorImageType> it(image, image->GetLargestPossibleRegion() );
+  itk::ImageRegionConstIterator<TensorImageType>          rit(reference, reference->GetLargestPossibleRegion() );
+  for( ; !it.IsAtEnd(); ++it, ++rit )
+    {
+    if( it.GetIndex()[2] > 0 && !( DTITesting::Difference(it.Get(), rit.Get() ) <= tolerance ) )
+      {
+      std::cerr << description << ": " << it.Get() << " instead of " << rit.Get() << " at "
+                << it.GetIndex() << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+NonlinearFilterType::Pointer NonlinearEstimate(DWIImageType * dwi, unsigned int maximumNumberOfIterations)
+{
+  NonlinearFilterType::Pointer estimator = NonlinearFilterType::New();
+  estimator->SetGradientImage(Gradients(), dwi);
+  estimator->SetBValue(BValue);
+  estimator->SetThreshold(Threshold);
+  estimator->SetMaximumNumberOfIterations(maximumNumberOfIterations);
+  estimator->Update();
+  return estimator;
+}
+
+RicianFilterType::Pointer RicianEstimate(DWIImageType * dwi, TensorImageType * initialTensors,
+                                         unsigned int maximumNumberOfIterations)
+{
+  RicianFilterType::Pointer estimator = RicianFilterType::New();
+  estimator->SetGradientImage(Gradients(), dwi);
+  estimator->SetBValue(BValue);
+  estimator->SetThreshold(Threshold);
+  estimator->SetInitialTensor(initialTensors);
+  estimator->SetSigma(1.0);
+  estimator->SetMaximumNumberOfIterations(maximumNumberOfIterations);
+  estimator->Update();
+  return estimator;
+}
+}
+
+int itkDiffusionTensor3DReconstructionIterativeImageFilterTest(int, char *[])
+{
+  TensorImageType::Pointer tensors;
+  DWIImageType::Pointer    dwi = Signals(Gradients(), tensors);
+
+  const TensorImageType::SizeType size = tensors->GetLargestPossibleRegion().GetSize();
+  const unsigned long             numberOfForegroundVoxels = size[0] * size[1] * ( size[2] - 1 );
+
+  // The one-step weighted least-squares estimate, the initialization of
+  // both estimators
+  WeightedFilterType::Pointer weighted = WeightedFilterType::New();
+  weighted->SetGradientImage(Gradients(), dwi);
+  weighted->SetBValue(BValue);
+  weighted->SetThreshold(Threshold);
+  weighted->SetNumberOfIterations(1);
+  weighted->Update();
+
+  // The non-linear fit converges in every voxel to the tensors, up to
+  // the rounding of the signals
+  NonlinearFilterType::Pointer nls = NonlinearEstimate(dwi, 100);
+  if( nls->GetNumberOfFailedVoxels() != 0 )
+    {
+    std::cerr << "nls: the fit did not converge in " << nls->GetNumberOfFailedVoxels() << " voxels" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if( !CompareForeground(nls->GetOutput(), tensors, 5.0e-2, "nls") )
+    {
+    return EXIT_FAILURE;
+    }
+
+  // Without iterations, every voxel above the threshold fails and keeps
+  // the weighted estimate
+  nls = NonlinearEstimate(dwi, 0);
+  if( nls->GetNumberOfFailedVoxels() != numberOfForegroundVoxels )
+    {
+    std::cerr << "nls, no iteration: " << nls->GetNumberOfFailedVoxels() << " failed voxels instead of "
+              << numberOfForegroundVoxels << std::endl;
+    return EXIT_FAILURE;
+    }
+  if( !CompareForeground(nls->GetOutput(), weighted->GetOutput(), 0.0, "nls, no iteration") )
+    {
+    return EXIT_FAILURE;
+    }
+
+  // The maximum likelihood optimizes every voxel above the threshold
+  RicianFilterType::Pointer ml = RicianEstimate(dwi, weighted->GetOutput(), 100);
+  if( ml->GetNumberOfOptimizedVoxels() != numberOfForegroundVoxels
+      || ml->GetNumberOfNonConvergedVoxels() > ml->GetNumberOfOptimizedVoxels() )
+    {
+    std::cerr << "ml: " << ml->GetNumberOfOptimizedVoxels() << " optimized voxels, "
+              << ml->GetNumberOfNonConvergedVoxels() << " not converged, instead of "
+              << numberOfForegroundVoxels << " optimized" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Without iterations, none converges and the initial tensors are kept
+  ml = RicianEstimate(dwi, weighted->GetOutput(), 0);
+  if( ml->GetNumberOfOptimizedVoxels() != numberOfForegroundVoxels
+      || ml->GetNumberOfNonConvergedVoxels() != numberOfForegroundVoxels )
+    {
+    std::cerr << "ml, no iteration: " << ml->GetNumberOfOptimizedVoxels() << " optimized voxels, "
+              << ml->GetNumberOfNonConvergedVoxels() << " not converged, instead of "
+              << numberOfForegroundVoxels << std::endl;
+    return EXIT_FAILURE;
+    }
+  if( !CompareForeground(ml->GetOutput(), weighted->GetOutput(), 0.0, "ml, no iteration") )
+    {
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "The iterative estimators converge and count their voxels" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+// Reads raw NRRD tensor files with MappedImageFileReader and with
+// ImageFileReader: attached and detached headers, float files read as
+// double, and masked tensors, which are not mapped
+
+#include "itkMappedImageFileReader.h"
+#include <itkByteSwapper.h>
+#include <itkDiffusionTensor3D.h>
+#include <itkImage.h>
+#include <itkImageFileReader.h>
+#include <itkImageRegionConstIterator.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+typedef itk::Image<itk::DiffusionTensor3D<double>, 3> TensorImageType;
+typedef itk::MappedImageFileReader<TensorImageType>  MappedReaderType;
+typedef itk::ImageFileReader<TensorImageType>        ReaderType;
+
+const unsigned int Size[3] = { 7, 5, 3 };
+
+// Header of a raw tensor file of Size voxels
+std::string Header(const char * type, const char * kind, unsigned int components, const std::string & dataFile)
+{
+  std::ostringstream header;
+  header << "NRRD0004\n"
+         << "type: " << type << "\n"
+         << "dimension: 4\n"
+         << "space: left-posterior-superior\n"
+         << "sizes: " << components << " " << Size[0] << " " << Size[1] << " " << Size[2] << "\n"
+         << "space directions: none (0.5,0,0) (0,0.5,0) (0,0,2)\n"
+         << "kinds: " << kind << " domain domain domain\n"
+         << "endian: " << ( itk::ByteSwapper<int>::SystemIsLittleEndian() ? "little" : "big" ) << "\n"
+         << "encoding: raw\n"
+         << "space origin: (1,2,3)\n"
+         << "measurement frame: (1,0,0) (0,1,0) (0,0,1)\n";
+  if( !dataFile.empty() )
+    {
+    header << "data file: " << dataFile << "\n";
+    }
+  return header.str();
+}
+
+// Components of the voxels, the mask first if masked
+template <typename T>
+std::vector<T> Components(unsigned int components)
+{
+  std::vector<T> values;
+  for( unsigned int v = 0; v < Size[0] * Size[1] * Size[2]; ++v )
+    {
+    for( unsigned int c = 0; c < components; ++c )
+      {
+      values.push_back(static_cast<T>( components == 7 && c == 0 ? 1.0 : 1.0e-3 * ( v % 13 ) + 1.0e-4 / ( c + 3 ) ) );
+      }
+    }
+  return values;
+}
+
+template <typename T>
+void WriteData(std::ofstream & file, const std::vector<T> & values)
+{
+  file.write(reinterpret_cast<const char *>(&values[0]), values.size() * sizeof( T ) );
+}
+
+// Reads the file with both readers, and checks whether it was mapped
+bool ReadAndCompare(const std::string & fileName, bool mapped, const char * description, bool useMapping = true)
+{
+  MappedReaderType::Pointer mappedReader = MappedReaderType::New();
+  mappedReader->SetFileName(fileName);
+  mappedReader->SetUseMapping(useMapping);
+  mappedReader->Update();
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(fileName);
+  reader->Update();
+
+  if( mappedReader->GetMapped() != mapped )
+    {
+    std::cerr << description << ": " << ( mapped ? "not mapped" : "mapped" ) << std::endl;
+    return false;
+    }
+  const TensorImageType * image = mappedReader->GetOutput();
+  const TensorImageType * reference = reader->GetOutput();
+  if( image->GetLargestPossibleRegion() != reference->GetLargestPossibleRegion()
+      || image->GetSpacing() != reference->GetSpacing() || image->GetOrigin() != reference->GetOrigin()
+      || image->GetDirection() != reference->GetDirection() )
+    {
+    std::cerr << description << ": the grids differ" << std::endl;
+    return false;
+    }
+  itk::ImageRegionConstIterator<TensorImageType> it(image, image->GetLargestPossibleRegion() );
+  itk::ImageRegionConstIterator<TensorImageType> rit(reference, reference->GetLargestPossibleRegion() );
+  for( ; !it.IsAtEnd(); ++it, ++rit )
+    {
+    if( it.Get() != rit.Get() )
+      {
+      std::cerr << description << ": " << it.Get() << " instead of " << rit.Get() << " at "
+                << it.GetIndex() << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+}
+
+int itkMappedImageFileReaderTest(int argc, char * argv[])
+{
+  if( argc < 2 )
+    {
+    std::cerr << "Usage: " << argv[0] << " outputDirectory" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const std::string directory = argv[1];
+
+  // Attached header
+  const std::string attached = directory + "/mapped_attached.nrrd";
+    {
+    std::ofstream file(attached.c_str(), std::ios::out | std::ios::binary);
+    file << Header("double", "3D-symmetric-matrix", 6, "") << "\n";
+    WriteData(file, Components<double>(6) );
+    }
+  // Detached header, the data file relative to the header
+  const std::string detached = directory + "/mapped_detached.nhdr";
+    {
+    std::ofstream header(detached.c_str(), std::ios::out | std::ios::binary);
+    header << Header("double", "3D-symmetric-matrix", 6, "mapped_detached.raw");
+    std::ofstream file( ( directory + "/mapped_detached.raw" ).c_str(), std::ios::out | std::ios::binary);
+    WriteData(file, Components<double>(6) );
+    }
+  // Float components, converted to double
+  const std::string floatFile = directory + "/mapped_float.nrrd";
+    {
+    std::ofstream file(floatFile.c_str(), std::ios::out | std::ios::binary);
+    file << Header("float", "3D-symmetric-matrix", 6, "") << "\n";
+    WriteData(file, Components<float>(6) );
+    }
+  // Masked tensors: 7 components in the file, 6 in the pixels
+  const std::string masked = directory + "/mapped_masked.nrrd";
+    {
+    std::ofstream file(masked.c_str(), std::ios::out | std::ios::binary);
+    file << Header("double", "3D-masked-symmetric-matrix", 7, "") << "\n";
+    WriteData(file, Components<double>(7) );
+    }
+
+  if( !ReadAndCompare(attached, true, "Attached header") || !ReadAndCompare(detached, true, "Detached header")
+      || !ReadAndCompare(floatFile, true, "Float components") || !ReadAndCompare(masked, false, "Masked tensors")
+      || !ReadAndCompare(attached, false, "Mapping off", false) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "MappedImageFileReader reads as ImageFileReader" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,282 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+// Writes a tensor image with ParallelNrrdImageIO and with NrrdImageIO,
+// compares their headers and reads the chunks back
+
+#include "itkParallelNrrdImageIO.h"
+#include <itkDiffusionTensor3D.h>
+#include <itkImage.h>
+#include <itkImageFileReader.h>
+#include <itkImageFileWriter.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIterator.h>
+#include <itkMetaDataObject.h>
+#include "itk_NrrdIO.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+typedef itk::Image<itk::DiffusionTensor3D<double>, 3> TensorImageType;
+
+// Key of a field of the header, as NrrdImageIO names it
+std::string NrrdKey(int field, int axis = -1)
+{
+  std::ostringstream key;
+  key << "NRRD_" << airEnumStr(nrrdField, field);
+  if( axis >= 0 )
+    {
+    key << "[" << axis << "]";
+    }
+  return key.str();
+}
+
+// Lines of the header of a NRRD file, without the chunks key
+std::vector<std::string> ReadHeader(const std::string & fileName)
+{
+  std::ifstream            file(fileName.c_str(), std::ios::in | std::ios::binary);
+  std::vector<std::string> lines;
+  std::string              line;
+  const std::string        chunksKey = std::string(itk::ParallelNrrdImageIO::GetChunksKey() ) + ":=";
+  while( std::getline(file, line) && !line.empty() )
+    {
+    if( line.compare(0, chunksKey.size(), chunksKey) != 0 )
+      {
+      lines.push_back(line);
+      }
+    }
+  return lines;
+}
+
+bool HasChunks(const std::string & fileName)
+{
+  std::ifstream     file(fileName.c_str(), std::ios::in | std::ios::binary);
+  std::string       line;
+  const std::string chunksKey = std::string(itk::ParallelNrrdImageIO::GetChunksKey() ) + ":=";
+  while( std::getline(file, line) && !line.empty() )
+    {
+    if( line.compare(0, chunksKey.size(), chunksKey) == 0 )
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+bool HasLine(const std::vector<std::string> & header, const std::string & line)
+{
+  if( std::find(header.begin(), header.end(), line) == header.end() )
+    {
+    std::cerr << "The header has no line " << line << std::endl;
+    return false;
+    }
+  return true;
+}
+
+void Write(TensorImageType * image, const std::string & fileName, itk::ImageIOBase * io)
+{
+  typedef itk::ImageFileWriter<TensorImageType> WriterType;
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetInput(image);
+  writer->SetFileName(fileName);
+  writer->SetImageIO(io);
+  writer->SetUseCompression(true);
+  writer->Update();
+}
+
+TensorImageType::Pointer Read(const std::string & fileName, itk::ImageIOBase * io)
+{
+  typedef itk::ImageFileReader<TensorImageType> ReaderType;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(fileName);
+  reader->SetImageIO(io);
+  reader->Update();
+  return reader->GetOutput();
+}
+
+bool SameTensors(const TensorImageType * image, const TensorImageType * reference, const char * description)
+{
+  if( image->GetLargestPossibleRegion() != reference->GetLargestPossibleRegion() )
+    {
+    std::cerr << description << ": region " << image->GetLargestPossibleRegion() << std::endl;
+    return false;
+    }
+  itk::ImageRegionConstIterator<TensorImageType> it(image, image->GetLargestPossibleRegion() );
+  itk::ImageRegionConstIterator<TensorImageType> rit(reference, reference->GetLargestPossibleRegion() );
+  for( ; !it.IsAtEnd(); ++it, ++rit )
+    {
+    if( it.Get() != rit.Get() )
+      {
+      std::cerr << description << ": " << it.Get() << " instead of " << rit.Get() << " at "
+                << it.GetIndex() << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+}
+
+int itkParallelNrrdImageIOTest(int argc, char * argv[])
+{
+  if( argc < 2 )
+    {
+    std::cerr << "Usage: " << argv[0] << " outputDirectory" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const std::string directory = argv[1];
+
+  // A rotated grid, and the fields of the header NrrdImageIO keeps in
+  // the dictionary
+  TensorImageType::Pointer image = TensorImageType::New();
+  TensorImageType::SizeType size;
+  size[0] = 23;
+  size[1] = 17;
+  size[2] = 11;
+  image->SetRegions(size);
+  TensorImageType::SpacingType spacing;
+  spacing[0] = 0.5;
+  spacing[1] = 1.0;
+  spacing[2] = 2.25;
+  image->SetSpacing(spacing);
+  TensorImageType::PointType origin;
+  origin[0] = 1.5;
+  origin[1] = -2.0;
+  origin[2] = 3.125;
+  image->SetOrigin(origin);
+  TensorImageType::DirectionType direction;
+  direction.Fill(0.0);
+  direction(0, 1) = 1.0;
+  direction(1, 0) = -1.0;
+  direction(2, 2) = 1.0;
+  image->SetDirection(direction);
+  image->Allocate();
+  unsigned int count = 0;
+  itk::ImageRegionIterator<TensorImageType> it(image, image->GetLargestPossibleRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it, ++count )
+    {
+    TensorImageType::PixelType tensor;
+    for( unsigned int c = 0; c < 6; ++c )
+      {
+      tensor[c] = 1.0e-3 * ( count % 97 ) + 1.0e-4 * c;
+      }
+    it.Set(tensor);
+    }
+
+  itk::MetaDataDictionary & dict = image->GetMetaDataDictionary();
+  itk::EncapsulateMetaData<double>(dict, NrrdKey(nrrdField_thicknesses, 2), 2.5);
+  itk::EncapsulateMetaData<std::string>(dict, NrrdKey(nrrdField_centers, 0), "cell");
+  itk::EncapsulateMetaData<std::string>(dict, NrrdKey(nrrdField_centers, 1), "cell");
+  itk::EncapsulateMetaData<std::string>(dict, NrrdKey(nrrdField_centers, 2), "cell");
+  itk::EncapsulateMetaData<std::string>(dict, NrrdKey(nrrdField_kinds, 0), "space");
+  itk::EncapsulateMetaData<std::string>(dict, NrrdKey(nrrdField_kinds, 1), "space");
+  itk::EncapsulateMetaData<std::string>(dict, NrrdKey(nrrdField_kinds, 2), "space");
+  itk::EncapsulateMetaData<std::string>(dict, NrrdKey(nrrdField_labels, 1), "anterior posterior");
+  std::vector<std::vector<double> > frame(3, std::vector<double>(3, 0.0) );
+  frame[0][0] = 1.0;
+  frame[1][2] = 1.0;
+  frame[2][1] = -1.0;
+  itk::EncapsulateMetaData<std::vector<std::vector<double> > >(dict, NrrdKey(nrrdField_measurement_frame), frame);
+  itk::EncapsulateMetaData<std::string>(dict, "modality", "DTMRI");
+  itk::EncapsulateMetaData<std::string>(dict, "DTIProcess_multiline", "first\nsecond");
+
+  // Small chunks, so that the data is compressed in several members
+  itk::ParallelNrrdImageIO::Pointer parallelIO = itk::ParallelNrrdImageIO::New();
+  parallelIO->SetChunkSize(4096);
+  parallelIO->SetNumberOfThreads(4);
+  const std::string parallelFile = directory + "/parallel.nrrd";
+  const std::string serialFile = directory + "/serial.nrrd";
+  Write(image, parallelFile, parallelIO);
+  Write(image, serialFile, itk::NrrdImageIO::New() );
+  if( !HasChunks(parallelFile) )
+    {
+    std::cerr << parallelFile << " was not compressed in chunks" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Same header as NrrdImageIO, but for the chunks
+  const std::vector<std::string> parallelHeader = ReadHeader(parallelFile);
+  const std::vector<std::string> serialHeader = ReadHeader(serialFile);
+  if( parallelHeader != serialHeader )
+    {
+    std::cerr << "The headers differ" << std::endl << "ParallelNrrdImageIO:" << std::endl;
+    for( unsigned int i = 0; i < parallelHeader.size(); ++i )
+      {
+      std::cerr << "  " << parallelHeader[i] << std::endl;
+      }
+    std::cerr << "NrrdImageIO:" << std::endl;
+    for( unsigned int i = 0; i < serialHeader.size(); ++i )
+      {
+      std::cerr << "  " << serialHeader[i] << std::endl;
+      }
+    return EXIT_FAILURE;
+    }
+
+  // The chunks are decompressed in parallel or serially
+  itk::ParallelNrrdImageIO::Pointer parallelReadIO = itk::ParallelNrrdImageIO::New();
+  parallelReadIO->SetNumberOfThreads(4);
+  TensorImageType::Pointer parallelRead = Read(parallelFile, parallelReadIO);
+  TensorImageType::Pointer serialRead = Read(parallelFile, itk::NrrdImageIO::New() );
+  if( !SameTensors(parallelRead, image, "ParallelNrrdImageIO") || !SameTensors(serialRead, image, "NrrdImageIO") )
+    {
+    return EXIT_FAILURE;
+    }
+  if( parallelRead->GetMetaDataDictionary().HasKey(itk::ParallelNrrdImageIO::GetChunksKey() ) )
+    {
+    std::cerr << "The chunks key is in the dictionary" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if( parallelRead->GetDirection() != direction || parallelRead->GetOrigin() != origin )
+    {
+    std::cerr << "The grid of " << parallelFile << " differs" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::string value;
+  if( !itk::ExposeMetaData<std::string>(parallelRead->GetMetaDataDictionary(), "DTIProcess_multiline", value)
+      || value != "first\nsecond" )
+    {
+    std::cerr << "The multiline value is " << value << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // The space units and the numbers of the dictionary
+  itk::EncapsulateMetaData<std::string>(dict, NrrdKey(nrrdField_space_units), "\"mm\" \"mm\" \"mm\"");
+  itk::EncapsulateMetaData<double>(dict, "DTIProcess_scale", 0.5);
+  itk::EncapsulateMetaData<int>(dict, "DTIProcess_iterations", 12);
+  std::vector<double> bvalues;
+  bvalues.push_back(0.0);
+  bvalues.push_back(1000.0);
+  itk::EncapsulateMetaData<std::vector<double> >(dict, "DTIProcess_bvalues", bvalues);
+  const std::string numbersFile = directory + "/parallel_numbers.nrrd";
+  Write(image, numbersFile, parallelIO);
+  const std::vector<std::string> numbersHeader = ReadHeader(numbersFile);
+  if( !HasChunks(numbersFile) || !HasLine(numbersHeader, "space units: \"mm\" \"mm\" \"mm\"")
+      || !HasLine(numbersHeader, "DTIProcess_scale:=0.5") || !HasLine(numbersHeader, "DTIProcess_iterations:=12")
+      || !HasLine(numbersHeader, "DTIProcess_bvalues:=0 1000") )
+    {
+    return EXIT_FAILURE;
+    }
+  if( !SameTensors(Read(numbersFile, itk::NrrdImageIO::New() ), image, "NrrdImageIO") )
+    {
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "ParallelNrrdImageIO writes the header of NrrdImageIO" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+// Compares the planes of TensorToPlanesImageFilter to the components
+// read through NthElementImageAdaptor, interleaves them back with
+// PlanesToTensorImageFilter, and compares the log- and exp-Euclidean
+// filters, which compose the tensors in planes, to their functors
+
+#include "itkTensorToPlanesImageFilter.h"
+#include "itkPlanesToTensorImageFilter.h"
+#include "itkLogEuclideanTensorImageFilter.h"
+#include "itkExpEuclideanTensorImageFilter.h"
+#include "itkTensorTestFixtures.h"
+#include <itkImageRegionConstIterator.h>
+#include <itkNthElementImageAdaptor.h>
+#include <iostream>
+
+namespace
+{
+typedef itk::DiffusionTensor3D<double>                                  TensorType;
+typedef itk::Image<TensorType, 3>                                       TensorImageType;
+typedef itk::Image<double, 3>                                           PlaneImageType;
+typedef itk::TensorToPlanesImageFilter<TensorImageType, PlaneImageType> ToPlanesFilterType;
+typedef itk::PlanesToTensorImageFilter<PlaneImageType, TensorImageType> ToTensorFilterType;
+typedef itk::LogEuclideanTensorImageFilter<double>                      LogFilterType;
+typedef itk::ExpEuclideanTensorImageFilter<double>                      ExpFilterType;
+typedef LogFilterType::OutputImageType                                  LogImageType;
+typedef itk::Functor::LogEuclideanTensorFunction<TensorType>            LogFunctorType;
+typedef itk::Functor::ExpEuclideanTensorFunction<LogImageType::PixelType> ExpFunctorType;
+}
+
+int itkTensorPlanesTest(int, char *[])
+{
+  // Random tensors, on lines which are not a multiple of the blocks of
+  // the filters
+  const itk::SizeValueType size[3] = { 37, 13, 5 };
+  const double             spacing[3] = { 1.0, 1.0, 1.0 };
+  const double             origin[3] = { 0.0, 0.0, 0.0 };
+  TensorImageType::Pointer tensors = DTITesting::RandomTensors<TensorImageType>(size, spacing, origin);
+
+  ToPlanesFilterType::Pointer toPlanes = ToPlanesFilterType::New();
+  toPlanes->SetInput(tensors);
+  toPlanes->Update();
+
+  // Each plane is the component the adaptor reads
+  for( unsigned int c = 0; c < 6; ++c )
+    {
+    typedef itk::NthElementImageAdaptor<TensorImageType, double> AdaptorType;
+    AdaptorType::Pointer adaptor = AdaptorType::New();
+    adaptor->SelectNthElement(c);
+    adaptor->SetImage(tensors);
+
+    itk::ImageRegionConstIterator<AdaptorType>    ait(adaptor, adaptor->GetLargestPossibleRegion() );
+    itk::ImageRegionConstIterator<PlaneImageType> pit(toPlanes->GetPlane(c), tensors->GetLargestPossibleRegion() );
+    for( ; !ait.IsAtEnd(); ++ait, ++pit )
+      {
+      if( ait.Get() != pit.Get() )
+        {
+        std::cerr << "Plane " << c << " has " << pit.Get() << " instead of " << ait.Get() << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+
+  // The planes interleaved back are the tensors
+  ToTensorFilterType::Pointer toTensors = ToTensorFilterType::New();
+  for( unsigned int c = 0; c < 6; ++c )
+    {
+    toTensors->SetPlane(c, toPlanes->GetPlane(c) );
+    }
+  toTensors->Update();
+  itk::ImageRegionConstIterator<TensorImageType> it(tensors, tensors->GetLargestPossibleRegion() );
+  itk::ImageRegionConstIterator<TensorImageType> tit(toTensors->GetOutput(), tensors->GetLargestPossibleRegion() );
+  for( ; !it.IsAtEnd(); ++it, ++tit )
+    {
+    if( it.Get() != tit.Get() )
+      {
+      std::cerr << "Interleaved " << tit.Get() << " instead of " << it.Get() << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // Log and exp composed in planes, against their functors which
+  // compose each tensor as a matrix product
+  LogFilterType::Pointer logFilter = LogFilterType::New();
+  logFilter->SetInput(tensors);
+  ExpFilterType::Pointer expFilter = ExpFilterType::New();
+  expFilter->SetInput(logFilter->GetOutput() );
+  expFilter->Update();
+
+  LogFunctorType logFunctor;
+  ExpFunctorType expFunctor;
+  itk::ImageRegionConstIterator<LogImageType>    lit(logFilter->GetOutput(), tensors->GetLargestPossibleRegion() );
+  itk::ImageRegionConstIterator<TensorImageType> eit(expFilter->GetOutput(), tensors->GetLargestPossibleRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it, ++lit, ++eit )
+    {
+    const LogFunctorType::OutputType logTensor = logFunctor(it.Get() );
+    if( DTITesting::Difference(lit.Get(), logTensor) > 1.0e-12 )
+      {
+      std::cerr << "Log-Euclidean " << lit.Get() << " instead of " << logTensor << std::endl;
+      return EXIT_FAILURE;
+      }
+    const TensorType tensor = expFunctor(lit.Get() );
+    if( DTITesting::Difference(eit.Get(), tensor) > 1.0e-12 )
+      {
+      std::cerr << "Exp-Euclidean " << eit.Get() << " instead of " << tensor << std::endl;
+      return EXIT_FAILURE;
+      }
+    if( DTITesting::Difference(eit.Get(), it.Get() ) > 1.0e-9 )
+      {
+      std::cerr << "exp(log(" << it.Get() << ")) is " << eit.Get() << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  std::cout << "The planes and the Euclidean filters match the per-tensor computations" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,294 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+// Checks the label statistics of TensorScalarMapsImageFilter against
+// their known values: a label of a single tensor, with background
+// voxels, a label of isotropic tensors of diffusivities 1..N (times a
+// constant) and a label of tensors with a negative eigenvalue, which
+// are left out of the mean tensors
+
+#include "itkTensorScalarMapsImageFilter.h"
+#include <itkDiffusionTensor3D.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkVersor.h>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+typedef itk::DiffusionTensor3D<double>                                      TensorType;
+typedef itk::Image<TensorType, 3>                                           TensorImageType;
+typedef itk::Image<double, 3>                                               ScalarImageType;
+typedef itk::TensorScalarMapsImageFilter<TensorImageType, ScalarImageType> FilterType;
+typedef FilterType::LabelImageType                                          LabelImageType;
+typedef FilterType::LabelStatistics                                         LabelStatisticsType;
+typedef FilterType::ScalarStatistics                                        ScalarStatisticsType;
+
+const unsigned int NumberOfScalarMaps = itk::TensorScalarMaps::ColorFractionalAnisotropy;
+
+// The isotropic tensors of label 2 are Step * (1 + i), i < 192
+const double Step = 1.0e-4;
+
+// R^T diag(3, 2, 1) 10^-3 R, the tensor of label 1
+TensorType RotatedTensor()
+{
+  itk::Versor<double>::VectorType axis;
+  axis[0] = 0.2;
+  axis[1] = -0.7;
+  axis[2] = 0.4;
+  itk::Versor<double> versor;
+  versor.Set(axis, 0.8);
+  const itk::Matrix<double, 3, 3> R = versor.GetMatrix();
+  const double                    values[3] = { 3.0e-3, 2.0e-3, 1.0e-3 };
+  TensorType                      tensor;
+  for( unsigned int i = 0; i < 3; ++i )
+    {
+    for( unsigned int j = i; j < 3; ++j )
+      {
+      double sum = 0.0;
+      for( unsigned int k = 0; k < 3; ++k )
+        {
+        sum += values[k] * R(k, i) * R(k, j);
+        }
+      tensor(i, j) = sum;
+      }
+    }
+  return tensor;
+}
+
+// Labels along x: 0 (background) for x < 2, 1 for x < 5, 2 for x < 9
+// and 7 for x = 9.  The tensors of label 1 are null in the slice z = 0.
+void CreateImages(TensorImageType::Pointer & tensors, LabelImageType::Pointer & labels)
+{
+  TensorImageType::SizeType size;
+  size[0] = 10;
+  size[1] = 8;
+  size[2] = 6;
+  tensors = TensorImageType::New();
+  tensors->SetRegions(size);
+  tensors->Allocate();
+  labels = LabelImageType::New();
+  labels->SetRegions(size);
+  labels->Allocate();
+
+  const TensorType rotated = RotatedTensor();
+  TensorType       negative(0.0);
+  negative(0, 0) = 2.0e-3;
+  negative(1, 1) = 1.0e-3;
+  negative(2, 2) = -1.0e-3;
+
+  itk::ImageRegionIteratorWithIndex<TensorImageType> it(tensors, tensors->GetLargestPossibleRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+    const TensorImageType::IndexType index = it.GetIndex();
+    TensorType                       tensor(0.0);
+    unsigned int                     label = 0;
+    if( index[0] < 2 )
+      {
+      tensor(0, 0) = tensor(1, 1) = tensor(2, 2) = 5.0e-3;
+      tensor(0, 1) = 1.0e-3;
+      }
+    else if( index[0] < 5 )
+      {
+      label = 1;
+      if( index[2] > 0 )
+        {
+        tensor = rotated;
+        }
+      }
+    else if( index[0] < 9 )
+      {
+      label = 2;
+      const unsigned int i = static_cast<unsigned int>( ( index[2] * size[1] + index[1] ) * 4 + index[0] - 5 );
+      tensor(0, 0) = tensor(1, 1) = tensor(2, 2) = Step * ( 1 + i );
+      }
+    else
+      {
+      label = 7;
+      tensor = negative;
+      }
+    it.Set(tensor);
+    labels->SetPixel(index, label);
+    }
+}
+
+bool Close(double value, double expected, double tolerance)
+{
+  return std::fabs(value - expected) <= tolerance;
+}
+
+// Checks the summary of the values scale * v, v having the mean, the
+// standard deviation, the minimum and the maximum given and the
+// percentiles given by percentile(p) = first + p / 100 * (last - first)
+bool CheckScalar(const ScalarStatisticsType & scalar, const std::vector<double> & percentiles, double scale,
+                 double mean, double deviation, double minimum, double maximum, double tolerance,
+                 unsigned int label, unsigned int map)
+{
+  bool same = Close(scalar.Mean, scale * mean, tolerance)
+    && Close(scalar.StandardDeviation, scale * deviation, tolerance)
+    && Close(scalar.Minimum, scale * minimum, tolerance) && Close(scalar.Maximum, scale * maximum, tolerance)
+    && scalar.Percentiles.size() == percentiles.size();
+  for( unsigned int p = 0; same && p < percentiles.size(); ++p )
+    {
+    same = Close(scalar.Percentiles[p], scale * ( minimum + percentiles[p] / 100.0 * ( maximum - minimum ) ),
+                 tolerance);
+    }
+  if( !same )
+    {
+    std::cerr << "Label " << label << ", " << itk::TensorScalarMaps::GetMapName(itk::TensorScalarMaps::MapType(map) )
+              << ": mean " << scalar.Mean << ", deviation " << scalar.StandardDeviation << ", range "
+              << scalar.Minimum << " " << scalar.Maximum << " instead of " << scale * mean << ", "
+              << scale * deviation << ", " << scale * minimum << " " << scale * maximum << std::endl;
+    }
+  return same;
+}
+
+bool CheckCounts(const LabelStatisticsType & statistics, itk::SizeValueType count, itk::SizeValueType tensorCount,
+                 unsigned int label)
+{
+  if( statistics.Count != count || statistics.TensorCount != tensorCount )
+    {
+    std::cerr << "Label " << label << ": " << statistics.Count << " voxels, " << statistics.TensorCount
+              << " tensors instead of " << count << ", " << tensorCount << std::endl;
+    return false;
+    }
+  return true;
+}
+
+bool CheckMean(const TensorType & mean, const TensorType & expected, double tolerance, const char * description,
+               unsigned int label)
+{
+  for( unsigned int c = 0; c < 6; ++c )
+    {
+    if( !Close(mean[c], expected[c], tolerance) )
+      {
+      std::cerr << "Label " << label << ", " << description << " mean " << mean << " instead of " << expected
+                << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+}
+
+int itkTensorScalarMapsImageFilterTest(int, char *[])
+{
+  TensorImageType::Pointer tensors;
+  LabelImageType::Pointer  labels;
+  CreateImages(tensors, labels);
+
+  std::vector<double> percentiles;
+  percentiles.push_back(0.0);
+  percentiles.push_back(5.0);
+  percentiles.push_back(50.0);
+  percentiles.push_back(95.0);
+  percentiles.push_back(100.0);
+
+  FilterType::Pointer filter = FilterType::New();
+  filter->SetInput(tensors);
+  filter->SetLabelImage(labels);
+  filter->SetComputeMap(itk::TensorScalarMaps::FractionalAnisotropy, true);
+  for( unsigned int map = 0; map < NumberOfScalarMaps; ++map )
+    {
+    filter->SetComputeStatistics(itk::TensorScalarMaps::MapType(map), true);
+    }
+  filter->SetPercentiles(percentiles);
+  filter->Update();
+
+  const FilterType::LabelStatisticsMapType & statistics = filter->GetLabelStatistics();
+  if( statistics.size() != 3 || !statistics.count(1) || !statistics.count(2) || !statistics.count(7) )
+    {
+    std::cerr << statistics.size() << " labels instead of 1, 2 and 7" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Label 1: a single tensor, of eigenvalues 3, 2 and 1 (10^-3), and
+  // the null tensors which are not counted.  FA, MD, Frobenius norm,
+  // lambda1 to lambda3 and RD.
+  const LabelStatisticsType & single = statistics.find(1)->second;
+  const double                singleValues[NumberOfScalarMaps] =
+    { std::sqrt(3.0 / 14.0), 2.0e-3, std::sqrt(14.0) * 1.0e-3, 3.0e-3, 2.0e-3, 1.0e-3, 1.5e-3 };
+  if( !CheckCounts(single, 3 * 8 * 5, 3 * 8 * 5, 1) )
+    {
+    return EXIT_FAILURE;
+    }
+  for( unsigned int map = 0; map < NumberOfScalarMaps; ++map )
+    {
+    const double value = singleValues[map];
+    if( !CheckScalar(single.Scalars[map], percentiles, 1.0, value, 0.0, value, value, 1.0e-9 * value, 1, map) )
+      {
+      return EXIT_FAILURE;
+      }
+    }
+  const TensorType rotated = RotatedTensor();
+  if( !CheckMean(single.LogEuclideanMean, rotated, 1.0e-12, "Log-Euclidean", 1)
+      || !CheckMean(single.AffineInvariantMean, rotated, 1.0e-12, "affine-invariant", 1) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  // Label 2: isotropic tensors Step * v, v = 1..N.  The mean is
+  // (N + 1) / 2, the standard deviation sqrt(N (N + 1) / 12), and both
+  // mean tensors are the geometric mean of the diffusivities.
+  const LabelStatisticsType & isotropic = statistics.find(2)->second;
+  const unsigned int          N = 4 * 8 * 6;
+  if( !CheckCounts(isotropic, N, N, 2) )
+    {
+    return EXIT_FAILURE;
+    }
+  const double isotropicScales[NumberOfScalarMaps] = { 0.0, Step, std::sqrt(3.0) * Step, Step, Step, Step, Step };
+  for( unsigned int map = 0; map < NumberOfScalarMaps; ++map )
+    {
+    // The FA of isotropic tensors is zero up to the rounding of the
+    // anisotropy, of the order of the square root of the epsilon
+    const double tolerance = map == itk::TensorScalarMaps::FractionalAnisotropy ? 1.0e-7 : 1.0e-9 * Step * N;
+    if( !CheckScalar(isotropic.Scalars[map], percentiles, isotropicScales[map], ( N + 1 ) / 2.0,
+                     std::sqrt(N * ( N + 1 ) / 12.0), 1.0, N, tolerance, 2, map) )
+      {
+      return EXIT_FAILURE;
+      }
+    }
+  double logSum = 0.0;
+  for( unsigned int i = 1; i <= N; ++i )
+    {
+    logSum += std::log(Step * i);
+    }
+  TensorType geometricMean(0.0);
+  geometricMean(0, 0) = geometricMean(1, 1) = geometricMean(2, 2) = std::exp(logSum / N);
+  // The affine-invariant mean is iterated until the squared norm of its
+  // gradient is below 1e-12
+  if( !CheckMean(isotropic.LogEuclideanMean, geometricMean, 1.0e-9 * geometricMean(0, 0), "Log-Euclidean", 2)
+      || !CheckMean(isotropic.AffineInvariantMean, geometricMean, 1.0e-5 * geometricMean(0, 0), "affine-invariant",
+                    2) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  // Label 7: tensors with a negative eigenvalue, summarized but not
+  // averaged
+  const LabelStatisticsType & negative = statistics.find(7)->second;
+  if( !CheckCounts(negative, 8 * 6, 0, 7)
+      || !CheckScalar(negative.Scalars[itk::TensorScalarMaps::Lambda3], percentiles, -1.0e-3, 1.0, 0.0, 1.0, 1.0,
+                      1.0e-12, 7, itk::TensorScalarMaps::Lambda3)
+      || !CheckMean(negative.LogEuclideanMean, TensorType(0.0), 0.0, "Log-Euclidean", 7)
+      || !CheckMean(negative.AffineInvariantMean, TensorType(0.0), 0.0, "affine-invariant", 7) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "TensorScalarMapsImageFilter summarizes the labels as expected" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,209 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkTensorTestFixtures_h
+#define __itkTensorTestFixtures_h
+
+// The data the library tests share: random tensors drawn from the same
+// seed, a smooth deformation field, a gradient scheme, and the
+// differences the tests compare the pixels with.  Everything is inline
+// or a template, the tests being linked in one driver.
+
+#include <itkImageRegionIterator.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkMatrix.h>
+#include <itkVersor.h>
+#include <vnl/vnl_random.h>
+#include <algorithm>
+#include <cmath>
+
+namespace DTITesting
+{
+// The seed of the random tensors
+const unsigned long RandomSeed = 20090109;
+
+// A random rotation, of an axis which is not the null vector
+inline itk::Matrix<double, 3, 3> RandomRotation(vnl_random & random)
+{
+  itk::Versor<double>::VectorType axis;
+  for( unsigned int i = 0; i < 3; ++i )
+    {
+    axis[i] = random.drand64(-1.0, 1.0);
+    }
+  axis[2] += 1.0e-3; // not the null vector
+  itk::Versor<double> versor;
+  versor.Set(axis, random.drand64(-3.14, 3.14) );
+  return versor.GetMatrix();
+}
+
+// R^T diag(values) R: the rows of R are the eigenvectors
+template <typename TTensor>
+TTensor ComposeTensor(const itk::Matrix<double, 3, 3> & R, double l0, double l1, double l2)
+{
+  const double values[3] = { l0, l1, l2 };
+  TTensor      tensor;
+
+  for( unsigned int i = 0; i < 3; ++i )
+    {
+    for( unsigned int j = i; j < 3; ++j )
+      {
+      double sum = 0.0;
+      for( unsigned int k = 0; k < 3; ++k )
+        {
+        sum += values[k] * R(k, i) * R(k, j);
+        }
+      tensor(i, j) = sum;
+      }
+    }
+  return tensor;
+}
+
+// A tensor of random orientation and eigenvalues in
+// [minimum, maximum], drawn in that order
+template <typename TTensor>
+TTensor RandomTensor(vnl_random & random, double minimum, double maximum)
+{
+  const itk::Matrix<double, 3, 3> R = RandomRotation(random);
+  const double                    values[3] =
+    { random.drand64(minimum, maximum), random.drand64(minimum, maximum), random.drand64(minimum, maximum) };
+  return ComposeTensor<TTensor>(R, values[0], values[1], values[2]);
+}
+
+// Random positive definite tensors, of diffusivities in mm^2/s, on the
+// grid given.  The same grid always gets the same tensors.
+template <typename TTensorImage>
+typename TTensorImage::Pointer RandomTensors(const itk::SizeValueType size[3], const double spacing[3],
+                                             const double origin[3])
+{
+  typename TTensorImage::Pointer     image = TTensorImage::New();
+  typename TTensorImage::SizeType    imageSize;
+  typename TTensorImage::SpacingType imageSpacing;
+  typename TTensorImage::PointType   imageOrigin;
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    imageSize[d] = size[d];
+    imageSpacing[d] = spacing[d];
+    imageOrigin[d] = origin[d];
+    }
+  image->SetRegions(imageSize);
+  image->SetSpacing(imageSpacing);
+  image->SetOrigin(imageOrigin);
+  image->Allocate();
+
+  vnl_random                              random(RandomSeed);
+  itk::ImageRegionIterator<TTensorImage> it(image, image->GetLargestPossibleRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+    it.Set(RandomTensor<typename TTensorImage::PixelType>(random, 1.0e-5, 3.0e-3) );
+    }
+  return image;
+}
+
+// Smooth displacements, in mm, on the grid of image, plus a constant
+// translation.  They move the points near the borders out of the
+// image.
+template <typename TField, typename TImage>
+typename TField::Pointer SmoothField(const TImage * image, const typename TField::PixelType & translation)
+{
+  typename TField::Pointer field = TField::New();
+  field->CopyInformation(image);
+  field->SetRegions(image->GetLargestPossibleRegion() );
+  field->Allocate();
+
+  itk::ImageRegionIteratorWithIndex<TField> it(field, field->GetLargestPossibleRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+    typename TField::PointType point;
+    field->TransformIndexToPhysicalPoint(it.GetIndex(), point);
+    typename TField::PixelType displacement;
+    displacement[0] = 2.0 * std::sin(0.3 * point[1]) + 0.1 * point[2];
+    displacement[1] = 1.5 * std::cos(0.2 * point[0] + 0.1 * point[2]);
+    displacement[2] = 0.05 * point[0] * point[1] / ( 1.0 + 0.01 * point[0] * point[0] );
+    it.Set(displacement + translation);
+    }
+  return field;
+}
+
+template <typename TField, typename TImage>
+typename TField::Pointer SmoothField(const TImage * image)
+{
+  return SmoothField<TField>(image, typename TField::PixelType(0.0) );
+}
+
+// A baseline and 12 directions
+template <typename TGradientContainer>
+typename TGradientContainer::Pointer Gradients()
+{
+  static const double directions[13][3] =
+    {
+      { 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 1, 1, 0 }, { 1, 0, 1 }, { 0, 1, 1 },
+      { 1, -1, 0 }, { 1, 0, -1 }, { 0, 1, -1 }, { 1, 1, 1 }, { 1, -1, 1 }, { -1, 1, 1 }
+    };
+  typename TGradientContainer::Pointer gradients = TGradientContainer::New();
+  for( unsigned int m = 0; m < 13; ++m )
+    {
+    typename TGradientContainer::Element g(directions[m]);
+    if( m > 0 )
+      {
+      g.normalize();
+      }
+    gradients->InsertElement(m, g);
+    }
+  return gradients;
+}
+
+// Largest difference of the components of the pixels: tensors, vectors
+template <typename TPixel>
+double MaximumDifference(const TPixel & value, const TPixel & reference)
+{
+  double difference = 0.0;
+  for( unsigned int c = 0; c < TPixel::Size(); ++c )
+    {
+    difference = std::max(difference, static_cast<double>(std::fabs(value[c] - reference[c]) ) );
+    }
+  return difference;
+}
+
+// Largest difference of the coefficients of the matrices
+template <typename TValue, unsigned int NRows, unsigned int NColumns>
+double MaximumDifference(const itk::Matrix<TValue, NRows, NColumns> & value,
+                         const itk::Matrix<TValue, NRows, NColumns> & reference)
+{
+  double difference = 0.0;
+  for( unsigned int r = 0; r < NRows; ++r )
+    {
+    for( unsigned int c = 0; c < NColumns; ++c )
+      {
+      difference = std::max(difference, static_cast<double>(std::fabs(value(r, c) - reference(r, c) ) ) );
+      }
+    }
+  return difference;
+}
+
+// Largest difference of the components, relative to the largest
+// component of reference
+template <typename TPixel>
+double Difference(const TPixel & value, const TPixel & reference)
+{
+  double norm = 1.0e-300;
+  for( unsigned int c = 0; c < TPixel::Size(); ++c )
+    {
+    norm = std::max(norm, static_cast<double>(std::fabs(reference[c]) ) );
+    }
+  return MaximumDifference(value, reference) / norm;
+}
+} // end namespace DTITesting
+
+#endif
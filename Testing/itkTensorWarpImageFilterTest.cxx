@@ -0,0 +1,166 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+// Compares TensorWarpImageFilter, with the finite strain and the PPD
+// reorientations, to the pipeline it replaces: WarpVectorImageFilter of
+// the log-tensors, ExpEuclideanTensorImageFilter,
+// DeformationFieldJacobianFilter and
+// TensorRotateFromDeformationField(PPD)ImageFilter
+
+#include "itkTensorWarpImageFilter.h"
+#include "itkLogEuclideanTensorImageFilter.h"
+#include "itkExpEuclideanTensorImageFilter.h"
+#include "itkDeformationFieldJacobianFilter.h"
+#include "itkTensorRotateFromDeformationFieldImageFilter.h"
+#include "itkTensorRotateFromDeformationFieldPPDImageFilter.h"
+#include "itkTensorTestFixtures.h"
+#include <itkImageRegionConstIteratorWithIndex.h>
+#include <itkVectorLinearInterpolateImageFunction.h>
+#include <itkWarpVectorImageFilter.h>
+#include <iostream>
+
+namespace
+{
+typedef itk::DiffusionTensor3D<double>                                               TensorType;
+typedef itk::Image<TensorType, 3>                                                    TensorImageType;
+typedef itk::Image<itk::Vector<double, 3>, 3>                                        DeformationImageType;
+typedef itk::LogEuclideanTensorImageFilter<double>                                   LogFilterType;
+typedef itk::ExpEuclideanTensorImageFilter<double>                                   ExpFilterType;
+typedef LogFilterType::OutputImageType                                               LogImageType;
+typedef itk::VectorLinearInterpolateImageFunction<LogImageType, double>              InterpolatorType;
+typedef itk::WarpVectorImageFilter<LogImageType, LogImageType, DeformationImageType> WarpFilterType;
+typedef itk::DeformationFieldJacobianFilter<DeformationImageType, double>            JacobianFilterType;
+typedef JacobianFilterType::OutputImageType                                          JacobianImageType;
+typedef itk::Matrix<double, 3, 3>                                                    JacobianType;
+
+// Warps the tensors with the pipeline and with TensorWarpImageFilter,
+// and compares them
+template <typename TRotateFilter, typename TReorientationFunctor>
+bool CompareWarps(TensorImageType * tensors, DeformationImageType * field, const char * description)
+{
+  // The pipeline of createWarp
+  LogFilterType::Pointer logf = LogFilterType::New();
+  logf->SetInput(tensors);
+  logf->Update();
+
+  WarpFilterType::Pointer warp = WarpFilterType::New();
+  warp->SetInterpolator(InterpolatorType::New() );
+  warp->SetInput(logf->GetOutput() );
+  warp->SetDisplacementField(field);
+  warp->SetOutputSpacing(logf->GetOutput()->GetSpacing() );
+  warp->SetOutputOrigin(logf->GetOutput()->GetOrigin() );
+  LogImageType::PixelType padding(0.0);
+  padding[0] = -1e10;
+  padding[3] = -1e10;
+  padding[5] = -1e10;
+  warp->SetEdgePaddingValue(padding);
+
+  ExpFilterType::Pointer expf = ExpFilterType::New();
+  expf->SetInput(warp->GetOutput() );
+
+  JacobianFilterType::Pointer jacobian = JacobianFilterType::New();
+  jacobian->SetInput(field);
+
+  typename TRotateFilter::Pointer rotate = TRotateFilter::New();
+  rotate->SetInput1(expf->GetOutput() );
+  rotate->SetInput2(jacobian->GetOutput() );
+  rotate->Update();
+
+  // The single pass
+  typedef itk::TensorWarpImageFilter<TensorImageType, DeformationImageType, TReorientationFunctor> TensorWarpFilterType;
+  typename TensorWarpFilterType::Pointer tensorWarp = TensorWarpFilterType::New();
+  tensorWarp->SetInterpolator(InterpolatorType::New() );
+  tensorWarp->SetInput(tensors);
+  tensorWarp->SetDisplacementField(field);
+  tensorWarp->SetOutputSpacing(tensors->GetSpacing() );
+  tensorWarp->SetOutputOrigin(tensors->GetOrigin() );
+  tensorWarp->Update();
+
+  const TensorImageType * output = tensorWarp->GetOutput();
+  const TensorImageType * reference = rotate->GetOutput();
+  if( output->GetLargestPossibleRegion() != reference->GetLargestPossibleRegion()
+      || output->GetSpacing() != reference->GetSpacing() || output->GetOrigin() != reference->GetOrigin() )
+    {
+    std::cerr << description << ": the grids differ" << std::endl;
+    return false;
+    }
+
+  // The points outside of the tensors are null tensors, where the
+  // pipeline rotated the exponential of the padding value
+  InterpolatorType::Pointer inside = InterpolatorType::New();
+  inside->SetInputImage(logf->GetOutput() );
+  unsigned int outsideCount = 0;
+  itk::ImageRegionConstIteratorWithIndex<TensorImageType> it(output, output->GetLargestPossibleRegion() );
+  itk::ImageRegionConstIteratorWithIndex<TensorImageType> rit(reference, reference->GetLargestPossibleRegion() );
+  for( ; !it.IsAtEnd(); ++it, ++rit )
+    {
+    TensorImageType::PointType point;
+    output->TransformIndexToPhysicalPoint(it.GetIndex(), point);
+    const DeformationImageType::PixelType & displacement = field->GetPixel(it.GetIndex() );
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      point[d] += displacement[d];
+      }
+    if( !inside->IsInsideBuffer(point) )
+      {
+      ++outsideCount;
+      if( it.Get() != TensorType(0.0) )
+        {
+        std::cerr << description << ": " << it.Get() << " outside of the tensors at " << it.GetIndex() << std::endl;
+        return false;
+        }
+      }
+    else if( DTITesting::Difference(it.Get(), rit.Get() ) > 1.0e-9 )
+      {
+      std::cerr << description << ": " << it.Get() << " instead of " << rit.Get() << " at "
+                << it.GetIndex() << std::endl;
+      return false;
+      }
+    }
+  if( outsideCount == 0 || outsideCount == output->GetLargestPossibleRegion().GetNumberOfPixels() )
+    {
+    std::cerr << description << ": " << outsideCount << " points outside of the tensors" << std::endl;
+    return false;
+    }
+  return true;
+}
+}
+
+int itkTensorWarpImageFilterTest(int, char *[])
+{
+  // Random tensors on a grid which is not the identity
+  const itk::SizeValueType      size[3] = { 15, 13, 11 };
+  const double                  spacing[3] = { 1.5, 1.0, 2.0 };
+  const double                  origin[3] = { -10.0, 4.0, 2.5 };
+  TensorImageType::Pointer      tensors = DTITesting::RandomTensors<TensorImageType>(size, spacing, origin);
+  DeformationImageType::Pointer field = DTITesting::SmoothField<DeformationImageType>(tensors.GetPointer() );
+
+  typedef itk::TensorRotateFromDeformationFieldImageFilter<TensorImageType, JacobianImageType, TensorImageType>
+    FSFilterType;
+  typedef itk::Functor::TensorRotateFromDeformationFieldFunction<TensorType, JacobianType, TensorType>
+    FSFunctorType;
+  typedef itk::TensorRotateFromDeformationFieldPPDImageFilter<TensorImageType, JacobianImageType, TensorImageType>
+    PPDFilterType;
+  typedef itk::Functor::TensorRotateFromDeformationFieldPPDFunction<TensorType, JacobianType, TensorType>
+    PPDFunctorType;
+  if( !CompareWarps<FSFilterType, FSFunctorType>(tensors, field, "Finite strain")
+      || !CompareWarps<PPDFilterType, PPDFunctorType>(tensors, field, "Preservation of the principal direction") )
+    {
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "TensorWarpImageFilter warps as the pipeline it replaces" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,157 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+// Compares the tensors resampled through a transform chain
+// (createChainWarp) to the tensors warped by createWarp, the
+// --deformation_output of dtiprocess: a deformation field alone, and a
+// translation composed with the field, which createWarp applies as one
+// field.  The grid has a unit spacing, where the jacobians of the chain,
+// in world coordinates, are those of createWarp, in index space.  On a
+// grid of another spacing, the jacobians of the chain are compared to
+// those of DeformationFieldJacobianFilter with the spacing.
+
+#include "tensordeformation.h"
+#include "transformchain.h"
+#include "itkDeformationFieldJacobianFilter.h"
+#include "itkTensorTestFixtures.h"
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
+#include <iostream>
+
+namespace
+{
+typedef itk::DeformationFieldJacobianFilter<DeformationImageType, double> JacobianFilterType;
+typedef JacobianFilterType::OutputImageType                               JacobianImageType;
+
+bool SameTensors(const TensorImageType * image, const TensorImageType * reference, const char * description)
+{
+  if( image->GetLargestPossibleRegion() != reference->GetLargestPossibleRegion()
+      || image->GetSpacing() != reference->GetSpacing() || image->GetOrigin() != reference->GetOrigin() )
+    {
+    std::cerr << description << ": the grids differ" << std::endl;
+    return false;
+    }
+  itk::ImageRegionConstIterator<TensorImageType> it(image, image->GetLargestPossibleRegion() );
+  itk::ImageRegionConstIterator<TensorImageType> rit(reference, reference->GetLargestPossibleRegion() );
+  for( ; !it.IsAtEnd(); ++it, ++rit )
+    {
+    if( DTITesting::Difference(it.Get(), rit.Get() ) > 1.0e-9 )
+      {
+      std::cerr << description << ": " << it.Get() << " instead of " << rit.Get() << " at "
+                << it.GetIndex() << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+// The jacobians of the chain at the points of the field, in world
+// coordinates
+bool SameJacobians(const TransformChain & chain, DeformationImageType * field, const char * description)
+{
+  JacobianFilterType::Pointer jacobians = JacobianFilterType::New();
+  jacobians->SetInput(field);
+  jacobians->SetUseImageSpacingOn();
+  jacobians->Update();
+
+  const JacobianImageType *                                 reference = jacobians->GetOutput();
+  itk::ImageRegionConstIteratorWithIndex<JacobianImageType> it(reference, reference->GetLargestPossibleRegion() );
+  for( ; !it.IsAtEnd(); ++it )
+    {
+    TransformChain::PointType point;
+    field->TransformIndexToPhysicalPoint(it.GetIndex(), point);
+    const TransformChain::JacobianType J = chain.ComputeDisplacementJacobian(point);
+    if( DTITesting::MaximumDifference(J, it.Get() ) > 1.0e-9 )
+      {
+      std::cerr << description << ": " << J << " instead of " << it.Get() << " at " << it.GetIndex() << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+}
+
+int itkTransformChainResampleImageFilterTest(int, char *[])
+{
+  const itk::SizeValueType size[3] = { 15, 13, 11 };
+  const double             spacing[3] = { 1.0, 1.0, 1.0 };
+  const double             origin[3] = { -7.0, 3.0, 2.0 };
+  TensorImageType::Pointer tensors = DTITesting::RandomTensors<TensorImageType>(size, spacing, origin);
+
+  DeformationPixelType translation;
+  translation[0] = 0.75;
+  translation[1] = -1.25;
+  translation[2] = 0.5;
+  DeformationImageType::Pointer field = DTITesting::SmoothField<DeformationImageType>(tensors.GetPointer() );
+  DeformationImageType::Pointer translatedField =
+    DTITesting::SmoothField<DeformationImageType>(tensors.GetPointer(), translation);
+
+  // The field alone
+  TransformChain fieldChain;
+  fieldChain.AddDeformation(field);
+
+  // The translation, applied after the field
+  AffineTransformType::Pointer          affine = AffineTransformType::New();
+  AffineTransformType::OutputVectorType affineTranslation;
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    affineTranslation[d] = translation[d];
+    }
+  affine->SetTranslation(affineTranslation);
+  TransformChain translatedChain;
+  translatedChain.AddAffine(affine);
+  translatedChain.AddDeformation(field);
+
+  const TensorReorientationType reorientations[2] = { FiniteStrain, PreservationPrincipalDirection };
+  for( unsigned int r = 0; r < 2; ++r )
+    {
+    TensorImageType::Pointer warped =
+      createWarp(tensors, field, reorientations[r], Linear, field->GetLargestPossibleRegion() );
+    TensorImageType::Pointer chained = createChainWarp(tensors, fieldChain, reorientations[r], Linear);
+    if( !SameTensors(chained, warped, r == 0 ? "Field, finite strain" : "Field, PPD") )
+      {
+      return EXIT_FAILURE;
+      }
+
+    warped = createWarp(tensors, translatedField, reorientations[r], Linear,
+                        translatedField->GetLargestPossibleRegion() );
+    chained = createChainWarp(tensors, translatedChain, reorientations[r], Linear);
+    if( !SameTensors(chained, warped, r == 0 ? "Translated field, finite strain" : "Translated field, PPD") )
+      {
+      return EXIT_FAILURE;
+      }
+    }
+
+  // An anisotropic spacing: the jacobians of the chain are in world
+  // coordinates, the translation does not change them
+  const double             anisotropicSpacing[3] = { 1.5, 0.75, 2.0 };
+  TensorImageType::Pointer anisotropicTensors =
+    DTITesting::RandomTensors<TensorImageType>(size, anisotropicSpacing, origin);
+  DeformationImageType::Pointer anisotropicField =
+    DTITesting::SmoothField<DeformationImageType>(anisotropicTensors.GetPointer() );
+  TransformChain anisotropicChain;
+  anisotropicChain.AddDeformation(anisotropicField);
+  TransformChain anisotropicTranslatedChain;
+  anisotropicTranslatedChain.AddAffine(affine);
+  anisotropicTranslatedChain.AddDeformation(anisotropicField);
+  if( !SameJacobians(anisotropicChain, anisotropicField, "Anisotropic field")
+      || !SameJacobians(anisotropicTranslatedChain, anisotropicField, "Anisotropic translated field") )
+    {
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "The transform chains warp as createWarp" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,167 @@
+/*=========================================================================
+
+  Program:   NeuroLib (DTI command line tools)
+  Language:  C++
+  Date:      $Date: 2009/01/09 15:39:51 $
+  Version:   $Revision: 1.3 $
+
+  Copyright (c)  Casey Goodlett. All rights reserved.
+  See NeuroLibCopyright.txt or http://www.ia.unc.edu/dev/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+// Compares VectorBSplineInterpolateImageFunction to the cubic
+// BSplineInterpolateImageFunction of each component, extracted with
+// VectorIndexSelectionCastImageFilter, as the function used to
+// interpolate
+
+#include "itkVectorBSplineInterpolateImageFunction.h"
+#include "itkTensorTestFixtures.h"
+#include <itkBSplineInterpolateImageFunction.h>
+#include <itkImageRegionIterator.h>
+#include <itkVectorIndexSelectionCastImageFilter.h>
+#include <vnl/vnl_random.h>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+typedef itk::Vector<double, 6>                                                        PixelType;
+typedef itk::Image<PixelType, 3>                                                      VectorImageType;
+typedef itk::Image<double, 3>                                                         ComponentImageType;
+typedef itk::VectorBSplineInterpolateImageFunction<VectorImageType, double, double>   InterpolatorType;
+typedef InterpolatorType::ContinuousIndexType                                         ContinuousIndexType;
+typedef InterpolatorType::OutputType                                                  OutputType;
+typedef itk::VectorIndexSelectionCastImageFilter<VectorImageType, ComponentImageType> ComponentFilterType;
+typedef itk::BSplineInterpolateImageFunction<ComponentImageType, double, double>      ComponentInterpolatorType;
+
+// Random components, on lines which are not a multiple of the threads
+VectorImageType::Pointer RandomVectors(vnl_random & random)
+{
+  VectorImageType::Pointer image = VectorImageType::New();
+  VectorImageType::SizeType size;
+  size[0] = 17;
+  size[1] = 9;
+  size[2] = 6;
+  image->SetRegions(size);
+  VectorImageType::SpacingType spacing;
+  spacing[0] = 0.75;
+  spacing[1] = 1.0;
+  spacing[2] = 2.5;
+  image->SetSpacing(spacing);
+  image->Allocate();
+
+  itk::ImageRegionIterator<VectorImageType> it(image, image->GetLargestPossibleRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+    PixelType value;
+    for( unsigned int c = 0; c < 6; ++c )
+      {
+      value[c] = random.drand64(-1.0, 1.0);
+      }
+    it.Set(value);
+    }
+  return image;
+}
+}
+
+int itkVectorBSplineInterpolateImageFunctionTest(int, char *[])
+{
+  vnl_random               random(DTITesting::RandomSeed);
+  VectorImageType::Pointer image = RandomVectors(random);
+  const VectorImageType::SizeType size = image->GetLargestPossibleRegion().GetSize();
+
+  // The interpolators of the components
+  std::vector<ComponentFilterType::Pointer>       components(6);
+  std::vector<ComponentInterpolatorType::Pointer> componentInterpolators(6);
+  for( unsigned int c = 0; c < 6; ++c )
+    {
+    components[c] = ComponentFilterType::New();
+    components[c]->SetInput(image);
+    components[c]->SetIndex(c);
+    components[c]->Update();
+    componentInterpolators[c] = ComponentInterpolatorType::New();
+    componentInterpolators[c]->SetSplineOrder(3);
+    componentInterpolators[c]->SetInputImage(components[c]->GetOutput() );
+    }
+
+  // Prefilters on one and on several threads
+  InterpolatorType::Pointer interpolator = InterpolatorType::New();
+  interpolator->SetNumberOfThreads(4);
+  interpolator->SetInputImage(image);
+  InterpolatorType::Pointer serialInterpolator = InterpolatorType::New();
+  serialInterpolator->SetNumberOfThreads(1);
+  serialInterpolator->SetInputImage(image);
+
+  // Random positions in the buffer, the voxels and the corners
+  std::vector<ContinuousIndexType> indices;
+  for( unsigned int i = 0; i < 2000; ++i )
+    {
+    ContinuousIndexType index;
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      index[d] = random.drand64(0.0, size[d] - 1.0);
+      }
+    indices.push_back(index);
+    }
+  for( unsigned int i = 0; i < 100; ++i )
+    {
+    ContinuousIndexType index;
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      index[d] = static_cast<double>(random.lrand32(0, size[d] - 1) );
+      }
+    indices.push_back(index);
+    }
+  for( unsigned int corner = 0; corner < 8; ++corner )
+    {
+    ContinuousIndexType index;
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      index[d] = ( corner >> d ) & 1 ? size[d] - 1.0 : 0.0;
+      }
+    indices.push_back(index);
+    }
+
+  std::vector<OutputType> values(indices.size() );
+  interpolator->EvaluateAtContinuousIndices(&indices[0], indices.size(), &values[0]);
+  for( unsigned int i = 0; i < indices.size(); ++i )
+    {
+    OutputType reference;
+    for( unsigned int c = 0; c < 6; ++c )
+      {
+      reference[c] = componentInterpolators[c]->EvaluateAtContinuousIndex(indices[i]);
+      }
+    const OutputType value = interpolator->EvaluateAtContinuousIndex(indices[i]);
+    if( DTITesting::MaximumDifference(value, reference) > 1.0e-10 )
+      {
+      std::cerr << value << " instead of " << reference << " at " << indices[i] << std::endl;
+      return EXIT_FAILURE;
+      }
+    if( DTITesting::MaximumDifference(values[i], value) > 1.0e-12 )
+      {
+      std::cerr << "EvaluateAtContinuousIndices gives " << values[i] << " instead of " << value << " at "
+                << indices[i] << std::endl;
+      return EXIT_FAILURE;
+      }
+    if( DTITesting::MaximumDifference(serialInterpolator->EvaluateAtContinuousIndex(indices[i]), value) > 1.0e-12 )
+      {
+      std::cerr << "The prefilter on one thread differs at " << indices[i] << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // A null input releases the coefficients
+  interpolator->SetInputImage(ITK_NULLPTR);
+  if( interpolator->GetCoefficients() != ITK_NULLPTR )
+    {
+    std::cerr << "The coefficients were not released" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << indices.size() << " positions interpolated as the components are" << std::endl;
+  return EXIT_SUCCESS;
+}
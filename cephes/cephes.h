@@ -8,6 +8,10 @@ double i0( double x );
 
 double i0e( double x );
 
+double i1( double x );
+
+double i1e( double x );
+
 }
 #endif // __cplusplus
 #endif // __CEPHES__